@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+
+import subprocess as sp
+import tempfile
+import re
+import sys
+from pathlib import Path
+
+from libbuild import *
+
+argparser=ArgParser("preprocess many translation units in one process, and check that memory use stays flat")
+
+argparser.add(name="--translation-units",short="-n",help="number of translation units to preprocess",key="num_translation_units",arg_store_op=ArgStore.store_value,default=10000,type=int)
+argparser.add(name="--files",help="number of distinct input files",key="num_files",arg_store_op=ArgStore.store_value,default=16,type=int)
+argparser.add(name="--headers",help="number of headers shared by the input files",key="num_headers",arg_store_op=ArgStore.store_value,default=32,type=int)
+argparser.add(name="--max-growth",help="maximum allowed growth of resident memory after warmup, in KiB",key="max_growth",arg_store_op=ArgStore.store_value,default=512,type=int)
+argparser.add(name="--help",short="-h",help="Prints this help message",key="show_help",arg_store_op=ArgStore.presence_flag)
+
+args=argparser.parse(sys.argv[1:])
+
+if args.get("show_help",False):
+    argparser.print_help()
+    exit(0)
+
+def write_workload(directory:Path,num_files:int,num_headers:int)->list[str]:
+    """ write headers (guarded, with object- and function-like macros, including each other) and input files """
+    for h in range(num_headers):
+        lines=[f"#ifndef HEADER_{h}_H",f"#define HEADER_{h}_H"]
+        if h>0:
+            lines.append(f'#include "header{h-1}.h"')
+        lines+=[
+            f"#define VALUE_{h} {h}",
+            f"#define ADD_{h}(a,b) ((a)+(b)+VALUE_{h})",
+            f"#define NAME_{h}(x) x##_{h}",
+            f"#define STR_{h}(x) #x",
+            f"#if VALUE_{h} % 2 == 0",
+            f"int NAME_{h}(even)=ADD_{h}(VALUE_{h},1);",
+            "#else",
+            f"int NAME_{h}(odd)=ADD_{h}(ADD_{h}(1,2),VALUE_{h});",
+            "#endif",
+            f"const char*name_{h}=STR_{h}(header {h});",
+            "#endif",
+        ]
+        (directory/f"header{h}.h").write_text("\n".join(lines)+"\n")
+
+    files=[]
+    for f in range(num_files):
+        h=f%num_headers
+        lines=[
+            f'#include "header{h}.h"',
+            f'#include "header{(h*7)%num_headers}.h"',
+            f"int file_{f}(){{ return ADD_{h}(VALUE_{h},{f}); }}",
+        ]
+        path=directory/f"file{f}.c"
+        path.write_text("\n".join(lines)+"\n")
+        files.append(str(path))
+    return files
+
+with tempfile.TemporaryDirectory() as directory:
+    files=write_workload(Path(directory),args["num_files"],args["num_headers"])
+
+    command=["bin/main",f"--bench-tus={args['num_translation_units']}",*files]
+    result=sp.run(command,stdout=sp.PIPE,stderr=sp.PIPE,text=True)
+    if result.returncode!=0:
+        print(result.stderr)
+        print(f"benchmark failed with exit code {result.returncode}")
+        exit(1)
+
+samples=[]
+for line in result.stdout.splitlines():
+    match=re.match(r"translation units: (\d+), tokens: (\d+), resident memory: (-?\d+) KiB",line)
+    if match:
+        samples.append((int(match[1]),int(match[2]),int(match[3])))
+        print(line)
+
+if len(samples)<2 or any(rss<0 for _,_,rss in samples):
+    print("could not measure resident memory")
+    exit(1)
+
+# the first sample includes warmup (e.g. header cache, allocator pools)
+warm_rss=samples[0][2]
+final_rss=samples[-1][2]
+growth=final_rss-warm_rss
+print(f"resident memory grew by {growth} KiB after the first {samples[0][0]} translation units")
+# allows for some allocator noise, while a leak of ~100 bytes per translation unit already exceeds this over 10k units
+if growth>args["max_growth"]:
+    print(f"memory grows by more than {args['max_growth']} KiB, preprocessor state is likely leaking")
+    exit(1)
@@ -0,0 +1,49 @@
+#pragma once
+
+#include<util/array.h>
+#include<preprocessor/batch.h>
+#include<preprocessor/target.h>
+
+/*
+compilation database (compile_commands.json, --compile-commands=)
+
+every entry of the database is a translation unit with the command line that compiles it, given either as list of
+arguments or as a single command string (which is split like a shell would). only the flags that affect preprocessing
+are taken from the command line: -I, -isystem, -D and -U. all other flags are ignored.
+
+relative paths of an entry (the file and the include paths) are relative to the directory of the entry.
+*/
+
+/* entry of a compilation database, and the settings to preprocess it with */
+struct CompileCommand{
+	/* path of the translation unit, resolved against the directory of the entry */
+	char*file;
+
+	/* element type is const char*, resolved against the directory of the entry */
+	array include_paths;
+	array system_include_paths;
+	/* -D flags, as a table of macros (-DNAME is NAME=1, like compilers do) */
+	array macros;
+	struct PreprocessorTarget macro_table;
+	/* -U flags, element type is const char* */
+	array undefines;
+
+	/* settings of the translation unit in a batch, see CompileCommand_getBatchConfig */
+	struct PreprocessorBatchConfig batch_config;
+	/* paths and undefines of the command, followed by those of the batch (the strings are not owned) */
+	array batch_include_paths;
+	array batch_system_include_paths;
+	array batch_undefines;
+};
+
+/* read all entries of the compilation database at path (fatal on failure), element type of commands is struct CompileCommand */
+void CompileCommands_read(const char*path,array*commands);
+/* release all entries */
+void CompileCommands_free(array*commands);
+
+/*
+settings to preprocess the translation unit of command with, which start out with the settings of batch_config: the
+include paths of the command come before those of batch_config, and the macros of the command are defined after the
+defines of batch_config. the settings are valid as long as command and batch_config are (call it once per command)
+*/
+const struct PreprocessorBatchConfig* CompileCommand_getBatchConfig(struct CompileCommand*command,const struct PreprocessorBatchConfig*batch_config);
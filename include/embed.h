@@ -0,0 +1,18 @@
+#pragma once
+
+#include<util/arena.h>
+
+#include<tokenizer.h>
+
+/*
+expand embed tokens (see TOKEN_LITERAL_TAG_EMBED) that are not used in an initializer
+
+the preprocessor emits the bytes of an #embed directive as a single token. where the token is a whole element of an
+initializer (e.g. `char data[]={ #embed "file" };`) the parser takes it as is, so that large files never turn into one
+token per byte. everywhere else (e.g. in function call arguments, or in a compound literal) the token is replaced by
+the comma separated list of integer literals it stands for.
+
+the tokens are left untouched if no token has to be expanded. otherwise the token list is rebuilt in memory, which
+then also holds the spellings of the integer literals.
+*/
+void Embed_expandOutsideInitializers(Tokenizer*tokenizer,arena*memory);
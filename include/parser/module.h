@@ -2,6 +2,8 @@
 
 typedef struct Module Module;
 
+#include<util/arena.h>
+
 #include<tokenizer.h>
 #include<parser/stack.h>
 
@@ -12,7 +14,11 @@ enum MODULE_PARSE_RESULT{
 enum MODULE_PARSE_RESULT Module_parse(Module* module,struct TokenIter*token_iter_in);
 struct Module{
 	Stack stack;
+	/* everything parsed into the module is allocated from here */
+	arena arena;
 };
 void Module_init(Module*module);
+/* release everything parsed into the module (symbols, types etc. of the module are invalid afterwards) */
+void Module_free(Module*module);
 
 bool Module_equal(Module*a,Module*b);
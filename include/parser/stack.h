@@ -3,11 +3,17 @@
 typedef struct Stack Stack;
 
 #include<util/array.h>
+#include<util/arena.h>
 
 #include<tokenizer.h>
 #include<parser/symbol.h>
 #include<parser/statement.h>
 
+/* reference to a symbol or type that was declared in another file */
+struct StackReference{
+    const char*reference_file;
+    const char*declaration_file;
+};
 struct Stack{
     /* list of symbols defined in this stack */
     array symbols;
@@ -24,6 +30,18 @@ struct Stack{
     item type is Statement
     */
     array statements;
+    /*
+    if not nullptr, every symbol and type found by lookup from a different file than its declaration is recorded here
+    (inherited from the parent stack)
+
+    item type is struct StackReference
+    */
+    array*references;
+    /*
+    arena that the parser allocates the symbols, types, statements and values of this stack from (inherited from the
+    parent stack, the arena of the module, see Module_free)
+    */
+    arena*arena;
 };
 // initialize a stack
 void Stack_init(Stack*stack,Stack*parent);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include<util/arena.h>
+
+#include<tokenizer.h>
+#include<preprocessor/preprocessor.h>
+#include<parser/module.h>
+
+/*
+pipelined preprocessing and parsing (--pipeline)
+
+the preprocessor runs on the calling thread, and passes its output through a bounded queue (see util/ring.h) to a
+parser thread, instead of collecting the whole preprocessed translation unit before parsing starts. the parser thread
+joins string literals (see string_literals.h), expands embedded files (see embed.h) and parses every top-level
+declaration as soon as it is complete (and the token after it is known), so only the tokens of the declaration that is
+still incomplete are kept around.
+
+a top-level declaration is complete at a semicolon outside of any parentheses, brackets and braces, or at the closing
+brace of a function body.
+
+errors are reported like in sequential mode: a fatal error of the preprocessor is reported even if the parser failed
+on an earlier declaration. the parser does not continue after its first error, but output it had written by then (e.g.
+warnings) is not taken back.
+*/
+
+/*
+preprocess the file of token_iter with preprocessor, and parse the output into module (fatal on errors, like
+Module_parse followed by the check for unexpected tokens at the end). tokens_out of the preprocessor is empty
+afterwards.
+
+the spellings of joined string literals and of expanded embedded files are allocated in string_literals and
+embedded_bytes, which must outlive module. token_src is the name of the source of the parsed tokens.
+*/
+void Pipeline_run(
+	struct Preprocessor*preprocessor,
+	struct TokenIter*token_iter,
+	Module*module,
+	const char*token_src,
+	arena*string_literals,
+	arena*embedded_bytes
+);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include<stdint.h>
+
+#include<util/array.h>
+#include<util/writer.h>
+
+struct PreprocessorTarget;
+
+/*
+batch preprocessing (--batch)
+
+preprocesses many translation units in one process, on a number of worker threads that share the header cache (see
+preprocessor/header_cache.h). every file gets its own preprocessor, and a fatal error in one file only fails that file.
+the output of the preprocessor is discarded (or only parsed, see PreprocessorBatchConfig.parse), only the outcome of
+every file is reported.
+
+the largest files are started first, so that no worker is left with a large file when all others are done.
+*/
+
+/* translation unit of a batch, and the outcome of preprocessing it */
+struct PreprocessorBatchFile{
+	const char*path;
+	/* settings of this file, nullptr for the settings of the batch */
+	const struct PreprocessorBatchConfig*config;
+
+	bool succeeded;
+	/* number of tokens in the preprocessed output */
+	int64_t num_tokens;
+	/* wall time spent on the file, in nanoseconds */
+	int64_t duration_ns;
+	/* message of the fatal error, if preprocessing failed */
+	char*error;
+};
+/* settings shared by all files of a batch */
+struct PreprocessorBatchConfig{
+	/* element type is const char* */
+	array*include_paths;
+	array*system_include_paths;
+	/* macros to define (-D), element type is struct PreprocessorTargetMacro (see PreprocessorTargetMacro_parseDefine) */
+	array*defines;
+	/* names of macros to undefine after the defines (-U), element type is const char* */
+	array*undefines;
+	/* predefined macros of the target (see preprocessor/target.h), either may be nullptr */
+	const struct PreprocessorTarget*target;
+	const char*target_profile_path;
+	/* macros with replacement lists, defined after the defines and before the undefines (may be nullptr) */
+	const struct PreprocessorTarget*macros;
+	int max_include_depth;
+
+	/* also join string literals and parse every file (a syntax check), instead of only preprocessing it */
+	bool parse;
+
+	/* number of worker threads */
+	int num_threads;
+};
+
+/*
+append paths listed in the file at path to paths (one path per line, empty lines and lines starting with # are
+skipped). the paths are allocated, and owned by the caller
+*/
+void PreprocessorBatch_readFileList(const char*path,array*paths);
+
+/*
+preprocess all files (element type is struct PreprocessorBatchFile, with only path and config set), and record the
+outcome in the files. returns the number of files that failed, the wall time of the whole batch is stored in duration_ns
+*/
+int PreprocessorBatch_run(const struct PreprocessorBatchConfig*config,array*files,int64_t*duration_ns);
+/* write outcome of every file in the batch, and a summary (duration_ns is the wall time of the whole batch) */
+void PreprocessorBatch_writeReport(array*files,int num_threads,int64_t duration_ns,writer*out);
+/* release the error messages in files */
+void PreprocessorBatch_freeFiles(array*files);
@@ -0,0 +1,111 @@
+#pragma once
+
+#include<stdint.h>
+
+#include<util/array.h>
+#include<util/arena.h>
+#include<util/hashmap.h>
+#include<preprocessor/preprocessor.h>
+
+#include<tokenizer.h>
+
+/*
+conditional-region map (--cond-cache=)
+
+records, per file, where each conditional block starts and ends, and which macros every #if/#elif depended on. a
+directive is identified by the token index of its '#' in the file. ranges are token indices instead of byte offsets,
+since the preprocessor only ever sees tokens (and the tokenization of a file is deterministic).
+
+with the map, the preprocessor
+ - jumps from a directive whose block is skipped straight to the next #elif/#else/#endif of the same chain, instead of
+   scanning the block (and evaluating the conditions nested in it)
+ - takes the recorded value of an #if/#elif without parsing or evaluating the expression, if all macros it depended on
+   still have the same definition (compared by fingerprint)
+
+maps are persisted in a sidecar directory (one file per source file), so that reruns with the same relevant macro
+values can take the active ranges directly. a map is discarded when the file it was recorded for changes.
+*/
+
+/* macro that the value of a condition depended on */
+struct PreprocessorConditionalDependency{
+	/* range of the name in PreprocessorConditionalMap.names */
+	int name_offset;
+	int name_len;
+	/* fingerprint of the definition at the time the condition was evaluated (see PreprocessorDefine_fingerprint) */
+	uint64_t fingerprint;
+};
+/* #if/#ifdef/#ifndef/#elif/#else directive */
+struct PreprocessorConditional{
+	/* token index of the '#' of the directive */
+	int directive;
+	/* token index of the '#' of the next #elif/#else/#endif of the same chain, -1 if not known yet */
+	int next;
+	/* iterator position after the condition of an #if/#elif, -1 if no value is recorded */
+	int end;
+	/* value of the condition */
+	bool value;
+	/* range in PreprocessorConditionalMap.dependencies */
+	int first_dependency;
+	int num_dependencies;
+};
+/* conditional directives of one file */
+struct PreprocessorConditionalMap{
+	const char*path;
+	int num_tokens;
+
+	/* file on disk when the map was created, the map is only written if the file could be read */
+	bool has_file_id;
+	int64_t size;
+	int64_t mtime;
+	uint64_t hash;
+
+	/* element type is struct PreprocessorConditional */
+	array conditionals;
+	/* element type is struct PreprocessorConditionalDependency */
+	array dependencies;
+	/* names of the dependencies, element type is char */
+	array names;
+	/* index of the conditional for each token index, plus one (0 for tokens that do not start a conditional) */
+	int*conditional_at;
+	/* map changed since it was loaded */
+	bool dirty;
+};
+struct PreprocessorConditionalCache{
+	/* sidecar directory the maps are loaded from and written to, nullptr to keep maps in memory only */
+	const char*directory;
+	/* maps path to struct PreprocessorConditionalMap* */
+	hashmap maps;
+	/* maps and their paths */
+	arena arena;
+};
+
+void PreprocessorConditionalCache_init(struct PreprocessorConditionalCache*cache,const char*directory);
+void PreprocessorConditionalCache_free(struct PreprocessorConditionalCache*cache);
+/* write all maps that changed into the cache directory (which is created if it does not exist) */
+void PreprocessorConditionalCache_write(struct PreprocessorConditionalCache*cache);
+
+/* get map of the file that tokenizer was created from (loaded from the cache directory on first use, if still valid) */
+struct PreprocessorConditionalMap* PreprocessorConditionalCache_getMap(struct PreprocessorConditionalCache*cache,const Tokenizer*tokenizer);
+
+/* get conditional starting at token index directive, returns nullptr if none was recorded */
+struct PreprocessorConditional* PreprocessorConditionalMap_get(struct PreprocessorConditionalMap*map,int directive);
+/* get conditional starting at token index directive, which is created if it does not exist yet */
+struct PreprocessorConditional* PreprocessorConditionalMap_add(struct PreprocessorConditionalMap*map,int directive);
+/*
+record value of the condition of an #if/#elif (replacing the previous record), the macros it depended on are added
+with addDependency afterwards
+*/
+void PreprocessorConditionalMap_setValue(struct PreprocessorConditionalMap*map,struct PreprocessorConditional*conditional,int end,bool value);
+/* add dependency to the conditional that was last passed to setValue */
+void PreprocessorConditionalMap_addDependency(
+	struct PreprocessorConditionalMap*map,
+	struct PreprocessorConditional*conditional,
+	const char*name,
+	int name_len,
+	uint64_t fingerprint
+);
+/* record that the directive at token index next follows the directive at token index directive in its chain */
+void PreprocessorConditionalMap_link(struct PreprocessorConditionalMap*map,int directive,int next);
+
+/* hash of a macro definition (i.e. equal for equal definitions), 0 for nullptr (i.e. undefined) */
+uint64_t PreprocessorDefine_fingerprint(const struct PreprocessorDefine*define);
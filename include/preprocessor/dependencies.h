@@ -0,0 +1,30 @@
+#pragma once
+
+#include<preprocessor/preprocessor.h>
+
+/*
+make-style dependency output (-M, -MM, -MD, -MMD, -MF, -MP, -MT)
+
+the rule lists the input file, followed by every file resolved by an include directive (each file only once, in order
+of first inclusion, as the path it was first reached by), e.g.
+
+	main.o: main.c include/a.h \
+	 include/b.h
+*/
+
+struct PreprocessorDependencyConfig{
+	/* target of the rule, usually the object file */
+	const char*target;
+	/* omit headers found in system include paths (-MM, -MMD) */
+	bool exclude_system_headers;
+	/* add an empty rule for each header, so that make does not fail when a header is removed (-MP) */
+	bool phony_targets;
+};
+
+/* write dependency rule for input_path, with the includes resolved by preprocessor, to path ("-" for stdout) */
+void Preprocessor_writeDependencies(
+	struct Preprocessor*preprocessor,
+	const char*input_path,
+	const char*path,
+	const struct PreprocessorDependencyConfig*config
+);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include<tokenizer.h>
+#include<util/array.h>
+
+/*
+process-wide cache of tokenized headers
+
+headers are read and tokenized once per process, and then shared by all preprocessors (which may run on different
+threads). an entry is identified by the resolved path of the header, and is only reused while the file identity
+(device, inode, size and modification time) matches the file on disk.
+
+cached tokenizers are immutable, i.e. must not be modified by the caller. they are never freed.
+*/
+
+/* get tokenized contents of the file at path, reading and tokenizing the file on a cache miss (fatal on failure) */
+Tokenizer* HeaderCache_get(const char*path);
+/*
+append the paths of all headers that were tokenized by this process since the last call (element type is const char*),
+e.g. so that another process can tokenize them ahead of time (see server.h). the paths are owned by the cache
+*/
+void HeaderCache_takeNewPaths(array*paths);
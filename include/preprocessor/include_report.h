@@ -0,0 +1,26 @@
+#pragma once
+
+#include<util/array.h>
+#include<util/writer.h>
+#include<preprocessor/preprocessor.h>
+
+/*
+include graph analysis (--include-report)
+
+writes the include graph of a translation unit, with the number of tokens each include brings in (including nested
+includes), followed by the includes that could be removed, ranked by the number of tokens that removing them saves.
+
+an include is removable if nothing that is defined in the included file, or in the files that it includes in turn, is
+used from outside of these files. uses is a list of struct PreprocessorFileUse, i.e. the file_uses recorded by the
+preprocessor, plus the references to declarations found by the parser.
+
+e.g.
+
+	include graph:
+	main.c:1: a.h (120 tokens)
+	  a.h:3: b.h (40 tokens)
+	  a.h:4: c.h (skipped)
+	removable includes:
+	       120  main.c:1: a.h
+*/
+void Preprocessor_writeIncludeReport(struct Preprocessor*preprocessor,array*uses,writer*out);
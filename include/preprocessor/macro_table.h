@@ -0,0 +1,58 @@
+#pragma once
+
+#include<stdint.h>
+
+#include<util/arena.h>
+
+/* number of bits of a macro id that select the child on each level of the table */
+#define PREPROCESSOR_MACRO_TABLE_BITS 5
+#define PREPROCESSOR_MACRO_TABLE_FANOUT (1<<PREPROCESSOR_MACRO_TABLE_BITS)
+
+/* state of a macro */
+struct PreprocessorMacroBinding{
+	/* index of the definition in Preprocessor.defines, or -1 if the macro is not defined */
+	int define_index;
+	/* changes every time the macro is defined or undefined (unique within a preprocessor, also across restores) */
+	uint32_t generation;
+};
+struct PreprocessorMacroTableNode{
+	/* nodes of the current epoch are not shared with any snapshot yet, and can be changed in place */
+	uint32_t epoch;
+	union{
+		/* on inner levels, nullptr for subtrees without any bound macro */
+		struct PreprocessorMacroTableNode*children[PREPROCESSOR_MACRO_TABLE_FANOUT];
+		/* on the last level */
+		struct PreprocessorMacroBinding bindings[PREPROCESSOR_MACRO_TABLE_FANOUT];
+	};
+};
+/* table contents at some point in time, which is not affected by later changes of the table */
+struct PreprocessorMacroTableSnapshot{
+	struct PreprocessorMacroTableNode*root;
+	int depth;
+};
+/*
+persistent map from macro id to the binding of the macro
+
+the table is a trie with PREPROCESSOR_MACRO_TABLE_FANOUT children per node, indexed by the bits of the (dense) macro
+id, i.e. a hash array mapped trie where the id is the hash. taking a snapshot only copies the root pointer. changing a
+binding afterwards copies the nodes on the path to the binding (copy-on-write), unchanged subtrees stay shared with the
+snapshot. nodes are only copied once per snapshot, so that a run without snapshots changes all nodes in place.
+*/
+struct PreprocessorMacroTable{
+	struct PreprocessorMacroTableNode*root;
+	/* number of levels below the root, i.e. the table holds ids up to FANOUT^(depth+1)-1 */
+	int depth;
+	/* incremented by every snapshot and restore, so that all existing nodes are treated as shared */
+	uint32_t epoch;
+};
+
+void PreprocessorMacroTable_init(struct PreprocessorMacroTable*table);
+/* get binding of macro id (not defined if id was never bound) */
+struct PreprocessorMacroBinding PreprocessorMacroTable_get(const struct PreprocessorMacroTable*table,int id);
+/* bind macro id, new nodes are allocated from node_arena (which must outlive the table and all its snapshots) */
+void PreprocessorMacroTable_set(struct PreprocessorMacroTable*table,arena*node_arena,int id,struct PreprocessorMacroBinding binding);
+
+/* O(1) snapshot of all bindings */
+struct PreprocessorMacroTableSnapshot PreprocessorMacroTable_snapshot(struct PreprocessorMacroTable*table);
+/* replace all bindings with the bindings of a snapshot (which can be restored again later) */
+void PreprocessorMacroTable_restore(struct PreprocessorMacroTable*table,struct PreprocessorMacroTableSnapshot snapshot);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include<tokenizer.h>
+#include<util/array.h>
+#include<util/writer.h>
+
+/*
+textual preprocessor output (-E)
+
+tokens are streamed into a writer as the preprocessor produces them. token spellings are copied straight from the
+source, and the whitespace between tokens is reconstructed from their source locations:
+ - tokens that come from the source file keep their line, and the spacing they had in the source
+ - tokens produced by macro expansion are placed on the line of the macro invocation (if the expansion table is known)
+ - a line marker '# <line> "<file>"' is written when the output switches files, or would otherwise need to skip
+   many lines (unless line markers are disabled)
+*/
+struct PreprocessorOutput{
+	writer*out;
+
+	/* file and line that the output is currently at */
+	const char*filename;
+	int line;
+	/* nothing has been written on the current output line yet */
+	bool at_line_start;
+
+	/* expansion table of the preprocessor (element type is struct PreprocessorExpansion, see Token.expansion), nullptr if unknown */
+	array*expansions;
+
+	/* write line markers (set by init), otherwise gaps are only filled with empty lines (e.g. for partial preprocessing) */
+	bool line_markers;
+
+	/* last token that has been written, used to reconstruct spacing between tokens */
+	bool has_last_token;
+	Token last_token;
+};
+
+void PreprocessorOutput_init(struct PreprocessorOutput*output,writer*out);
+/*
+write tokens, which are the result of expanding the source tokens
+
+source tokens must be a contiguous range of tokens from a single file, they determine where the output is placed
+*/
+void PreprocessorOutput_writeTokens(
+	struct PreprocessorOutput*output,
+	int num_source_tokens,
+	const Token*source_tokens,
+	int num_tokens,
+	const Token*tokens
+);
+/* terminate the last output line (does not flush the writer) */
+void PreprocessorOutput_finish(struct PreprocessorOutput*output);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include<util/hashmap.h>
+#include<preprocessor/preprocessor.h>
+
+/*
+partial preprocessing, i.e. header slicing (--partial)
+
+only a chosen set of macros is known: the macros that are defined when the preprocessor is attached (e.g. with -D), and
+the macros that are known to be undefined (-U). everything else is kept verbatim, which reduces a header to the code
+that remains for the chosen configuration:
+ - conditionals that only test known macros are resolved, i.e. their directives are removed along with the blocks that
+   are not taken. conditionals that test any other macro (or use __has_include) are written as they are, and all of their
+   blocks are kept. chains that mix both are rewritten, e.g. an #elif that is known to be true becomes #else, and an
+   #elif that follows a removed #if becomes #if
+ - all other directives (#define, #include, #pragma, ...) are written as they are, and have no effect, i.e. macros
+   defined in the input stay unknown, and included files are not read
+ - uses of known macros are expanded, all other macro uses are kept
+
+the output has no line markers, so that it can be used as a header again.
+*/
+struct PreprocessorPartial{
+	/* names of macros that are known to be undefined, values are unused */
+	hashmap undefined_macros;
+};
+
+void PreprocessorPartial_init(struct PreprocessorPartial*partial);
+void PreprocessorPartial_free(struct PreprocessorPartial*partial);
+/* mark macro as known to be undefined (name must outlive partial) */
+void PreprocessorPartial_addUndefined(struct PreprocessorPartial*partial,const char*name);
+/*
+switch preprocessor to partial preprocessing, after all known macros have been defined
+
+__FILE__ and __LINE__ are removed, since their values depend on where the reduced header is used.
+*/
+void PreprocessorPartial_attach(struct PreprocessorPartial*partial,struct Preprocessor*preprocessor);
+/*
+process a directive in partial mode (called by Preprocessor_step), the current token is the name of the directive
+
+directives that are kept are written to the output of the preprocessor (or appended to tokens_out)
+*/
+void PreprocessorPartial_processDirective(struct Preprocessor*preprocessor,const Token*hash_token);
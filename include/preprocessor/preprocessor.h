@@ -1,137 +1,21 @@
+#pragma once
+
+#include <sys/types.h> // dev_t, ino_t
+#include <time.h> // struct timespec
+
 #include<util/array.h>
+#include<util/arena.h>
+#include<util/hashmap.h>
+#include<preprocessor/output.h>
+#include<preprocessor/macro_table.h>
 
 #include<tokenizer.h>
 
 struct Preprocessor;
-struct PreprocessorExpression;
-
-enum PreprocessorExpressionTag{
-	PREPROCESSOR_EXPRESSION_TAG_UNKNOWN=0,
-
-	PREPROCESSOR_EXPRESSION_TAG_DEFINED,
-
-	PREPROCESSOR_EXPRESSION_TAG_NOT,
-	PREPROCESSOR_EXPRESSION_TAG_AND,
-	PREPROCESSOR_EXPRESSION_TAG_OR,
-
-	PREPROCESSOR_EXPRESSION_TAG_SUBTRACT,
-	PREPROCESSOR_EXPRESSION_TAG_ADD,
-
-	PREPROCESSOR_EXPRESSION_TAG_EQUAL,
-	PREPROCESSOR_EXPRESSION_TAG_UNEQUAL,
-	PREPROCESSOR_EXPRESSION_TAG_GREATER_THAN,
-	PREPROCESSOR_EXPRESSION_TAG_GREATER_THAN_OR_EQUAL,
-	PREPROCESSOR_EXPRESSION_TAG_LESSER_THAN,
-	PREPROCESSOR_EXPRESSION_TAG_LESSER_THAN_OR_EQUAL,
-
-	PREPROCESSOR_EXPRESSION_TAG_TERNARY,
-
-	// specifically an integer literal
-	PREPROCESSOR_EXPRESSION_TAG_LITERAL,
+struct PreprocessorStats;
+struct PreprocessorConditionalCache;
+struct PreprocessorPartial;
 
-	PREPROCESSOR_EXPRESSION_TAG_ELSE
-};
-struct PreprocessorExpression{
-	enum PreprocessorExpressionTag tag;
-	/* (cached) value that this expression evaluates to */
-	int value;
-	bool value_is_known;
-	union{
-		struct{
-			char* name;
-		}defined;
-
-		/* unary operands */
-		union{
-			struct{
-				struct PreprocessorExpression*expr;
-			}unary_operand;
-			struct{
-				struct PreprocessorExpression*expr;
-			}not;
-		};
-
-		/* binary operands */
-		union{
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}binary_operands;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}and;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}or;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}subtract;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}add;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}equal;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}unequal;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}greater_than;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}greater_than_or_equal;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}lesser_than;
-			struct{
-				struct PreprocessorExpression*lhs;
-				struct PreprocessorExpression*rhs;
-			}lesser_than_or_equal;
-		};
-
-		/* ternary operands */
-		union{
-			struct{
-				struct PreprocessorExpression*condition;
-				struct PreprocessorExpression*then;
-				struct PreprocessorExpression*else_;
-			}ternary;
-		};
-
-		struct{
-			int _reservedAndUnused;
-		}else_;
-
-		struct{
-			Token token;
-		}literal;
-	};
-};
-/*
-parse expression by consuming tokens (until end of line), then evaluating the expression
-
-can use: <symbol>, <symbol>(args), defined, !, &&, ||, ==, !=, <=, >=, <, >, +, -, *, /, %, (, )
-
-e.g.
-1) #if FOO
-2) #if defined(FOO)
-3) #if !defined(FOO)
-4) #if defined(FOO) && defined(BAR)
-5) #if defined(FOO) || defined(BAR)
-6) #if defined(FOO) && defined(BAR) || defined(BAZ)
-7) #if defined(FOO) && ( defined(BAR) || defined(BAZ) )
-*/
-struct PreprocessorExpression*Preprocessor_parseExpression(struct Preprocessor*preprocessor);
 
 /* stack of if[/elif[/else]] directives */
 struct PreprocessorIfStack{
@@ -139,6 +23,13 @@ struct PreprocessorIfStack{
 	bool inherited_doSkip;
 	/* any previous path in this stack has evaluated to true, used to track if a newly added may still be taken or not */
 	bool anyPathEvaluatedToTrue;
+	/* the current path is skipped, i.e. the value of doSkip when a nested stack ends */
+	bool doSkip;
+	/* (partial preprocessing) a directive of this stack has been written to the output, so its #endif is written too */
+	bool is_written;
+	/* token index of the '#' of the last directive in this stack, and the file it is in (for the conditional map) */
+	int last_directive;
+	const Tokenizer*directive_file;
 	/* array of struct PreprocessorStackItem */
 	array items;
 };
@@ -154,12 +45,14 @@ struct PreprocessorIfStackItem{
 		struct{
 			/* the if token at the start of the statement */
 			Token if_token;
-			struct PreprocessorExpression*expr;
+			/* value of the condition */
+			bool value;
 		}if_;
 		struct{
 			/* the else token at the start of the statement */
 			Token else_token;
-			struct PreprocessorExpression*expr;
+			/* value of the condition */
+			bool value;
 		}else_if;
 		struct{
 			/* the else token */
@@ -184,6 +77,158 @@ struct PreprocessorDefineFunctionlikeArg{
 		}varargs;
 	};
 };
+/*
+macro name, which is created on first use and lives as long as the preprocessor
+
+the current definition of the macro is kept in Preprocessor.macro_table (see Preprocessor_getMacroBinding).
+*/
+struct PreprocessorMacro{
+	/* key in Preprocessor.macro_table */
+	int id;
+	/* key in Preprocessor.macros */
+	const char*name;
+	int name_len;
+};
+/*
+macro invocation that produced tokens (see Token.expansion), an entry of Preprocessor.expansions
+
+a token produced by an expansion keeps the location where it is spelled (i.e. in the replacement list of the macro), the
+entry adds where the macro was expanded, and which expansion that location is part of in turn. tokens that were passed
+as arguments keep the reference they had at the invocation.
+*/
+struct PreprocessorExpansion{
+	/* macro that was expanded, see PreprocessorMacro.id */
+	int macro_id;
+	/* definition that was expanded, index into Preprocessor.defines (definitions are never removed from it) */
+	int define_index;
+	/* location of the macro name at the invocation */
+	const char*filename;
+	int line;
+	int col;
+	/* expansion that produced the macro name at the invocation, 0 if it is spelled in a source file */
+	uint32_t parent;
+};
+/* state of a macro at the time a cached result was computed */
+struct PreprocessorMacroDependency{
+	struct PreprocessorMacro*macro;
+	uint32_t generation;
+};
+
+/*
+value in a #if expression, which is either intmax_t or uintmax_t (C11 6.10.1), operands of binary operators go through
+the usual arithmetic conversions (i.e. the result is unsigned if either operand is)
+*/
+struct PreprocessorIfValue{
+	/* value, to be reinterpreted as uint64_t if is_unsigned */
+	int64_t value;
+	bool is_unsigned;
+};
+enum PreprocessorIfOpcode{
+	/* push value */
+	PREPROCESSOR_IF_OP_PUSH=0,
+	/* push 1 if macro is defined, otherwise 0 */
+	PREPROCESSOR_IF_OP_DEFINED,
+	/* push 1 if the include argument names an existing file (__has_include), otherwise 0 */
+	PREPROCESSOR_IF_OP_HAS_INCLUDE,
+
+	/* unary operators, replace top of stack */
+	PREPROCESSOR_IF_OP_NEGATE,
+	PREPROCESSOR_IF_OP_NOT,
+	PREPROCESSOR_IF_OP_BITWISE_NOT,
+	PREPROCESSOR_IF_OP_TO_BOOL,
+	/* convert to unsigned, e.g. the result of ?: when only one of its operands is unsigned */
+	PREPROCESSOR_IF_OP_TO_UNSIGNED,
+
+	/* binary operators, pop rhs and lhs, push result */
+	PREPROCESSOR_IF_OP_MULTIPLY,
+	PREPROCESSOR_IF_OP_DIVIDE,
+	PREPROCESSOR_IF_OP_MODULO,
+	PREPROCESSOR_IF_OP_ADD,
+	PREPROCESSOR_IF_OP_SUBTRACT,
+	PREPROCESSOR_IF_OP_SHIFT_LEFT,
+	PREPROCESSOR_IF_OP_SHIFT_RIGHT,
+	PREPROCESSOR_IF_OP_LESSER_THAN,
+	PREPROCESSOR_IF_OP_LESSER_THAN_OR_EQUAL,
+	PREPROCESSOR_IF_OP_GREATER_THAN,
+	PREPROCESSOR_IF_OP_GREATER_THAN_OR_EQUAL,
+	PREPROCESSOR_IF_OP_EQUAL,
+	PREPROCESSOR_IF_OP_UNEQUAL,
+	PREPROCESSOR_IF_OP_BITWISE_AND,
+	PREPROCESSOR_IF_OP_BITWISE_XOR,
+	PREPROCESSOR_IF_OP_BITWISE_OR,
+
+	/* control flow for short circuiting operators (&&, ||, ?:) */
+	PREPROCESSOR_IF_OP_JUMP,
+	/* pop value, jump if it is zero */
+	PREPROCESSOR_IF_OP_JUMP_IF_ZERO,
+	/* pop value, jump if it is not zero */
+	PREPROCESSOR_IF_OP_JUMP_IF_NOT_ZERO,
+};
+struct PreprocessorIfInstruction{
+	enum PreprocessorIfOpcode op;
+	union{
+		/* for PREPROCESSOR_IF_OP_PUSH */
+		struct PreprocessorIfValue value;
+		/* for PREPROCESSOR_IF_OP_DEFINED */
+		struct PreprocessorMacro*macro;
+		/* for PREPROCESSOR_IF_OP_HAS_INCLUDE, zero terminated spelling including the quotes or angle brackets */
+		const char*include_argument;
+		/* for jumps, index of the instruction to continue at */
+		int target;
+	};
+};
+/*
+#if/#elif expression, compiled into postfix instructions
+
+expressions are cached per translation unit, keyed by their raw token sequence. macro expansion of the expression
+happens at compile time, so the program stays valid until any macro that was looked up during expansion changes.
+defined() is evaluated at runtime, which only invalidates the memoized value.
+*/
+struct PreprocessorIfExpression{
+	/* element type is struct PreprocessorIfInstruction */
+	array program;
+	/* maximum number of values on the stack while running the program */
+	int max_stack_depth;
+	/* macros looked up while expanding the expression, element type is struct PreprocessorMacroDependency */
+	array expansion_dependencies;
+
+	/* program contains __has_include, whose value depends on the current file, hence the result is not memoized */
+	bool depends_on_files;
+	/* memoized result of running the program */
+	bool value_is_known;
+	int64_t value;
+	/* macros tested with defined() when value was computed, element type is struct PreprocessorMacroDependency */
+	array defined_dependencies;
+};
+/* compile expression from raw tokens (i.e. before macro expansion), overwrites previous program */
+void PreprocessorIfExpression_compile(struct Preprocessor*preprocessor,struct PreprocessorIfExpression*expr,int num_tokens,const Token*tokens);
+/*
+get value of compiled expression (memoized). operations whose behaviour would be undefined in C (e.g. signed overflow,
+division by zero, shift counts outside of 0..63) are fatal
+*/
+int64_t PreprocessorIfExpression_evaluate(struct Preprocessor*preprocessor,struct PreprocessorIfExpression*expr);
+/* check that no macro in list of struct PreprocessorMacroDependency has changed */
+bool PreprocessorMacroDependencies_areValid(struct Preprocessor*preprocessor,const array*dependencies);
+/*
+parse #if/#elif expression by consuming tokens (until end of line), then evaluating the expression
+
+returns the value of the expression. the expression is compiled once per distinct token sequence (see struct
+PreprocessorIfExpression), and the value is reused until any macro that the expression depends on changes. compiled
+is set to the compiled expression (if not nullptr).
+
+can use: <symbol>, <symbol>(args), defined, !, ~, &&, ||, ==, !=, <=, >=, <, >, +, -, *, /, %, <<, >>, &, ^, |, ?:, (, )
+
+e.g.
+1) #if FOO
+2) #if defined(FOO)
+3) #if !defined(FOO)
+4) #if defined(FOO) && defined(BAR)
+5) #if defined(FOO) || defined(BAR)
+6) #if defined(FOO) && defined(BAR) || defined(BAZ)
+7) #if defined(FOO) && ( defined(BAR) || defined(BAZ) )
+*/
+int64_t Preprocessor_parseIfExpression(struct Preprocessor*preprocessor,struct PreprocessorIfExpression**compiled);
+
 /* get value of last item in the stack (fatal if called on empty stack) */
 bool PreprocessorIfStack_getLastValue(struct PreprocessorIfStack*item);
 /* preprocessor define directive definition */
@@ -197,37 +242,284 @@ struct PreprocessorDefine{
 	*/
 	array*args;
 };
+/* file that has been resolved by an include directive, i.e. an edge in the include graph */
+struct PreprocessorIncludedFile{
+	const char*path;
+	/* identity of the file, which is shared by all paths that refer to it */
+	struct PreprocessorFileInfo*file_info;
+	/* file was found in a system include path */
+	bool is_system_header;
+
+	/* file containing the include directive, and line of the directive */
+	const char*includer;
+	int line;
+	/*
+	number of files that were being processed when the directive was found (1 for includes in the main file). 0 for
+	files that contributed to a loaded snapshot, which have no includer
+	*/
+	int depth;
+	/* file was not processed (#pragma once, include guard) */
+	bool skipped;
+	/* number of tokens in the file (0 if skipped), not including files that it includes */
+	int num_tokens;
+};
+/* cached result of searching a file named by an include argument */
+struct PreprocessorIncludeLookup{
+	/* path of the file, nullptr if it does not exist */
+	const char*path;
+	bool is_system_header;
+};
+/* snapshot file mapped into memory */
+struct PreprocessorSnapshotMapping{
+	void*mapping;
+	size_t size;
+};
+/* file mapped into memory by an #embed directive */
+struct PreprocessorEmbeddedFile{
+	const char*path;
+	/* mapping of the whole file, nullptr if the file is empty */
+	void*mapping;
+	size_t size;
+
+	/* identity and modification time of the file when it was mapped, to notice changes (see Preprocessor_resume) */
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+};
+/* reference from one file to a macro (or declaration) defined in another file */
+struct PreprocessorFileUse{
+	const char*reference_file;
+	const char*definition_file;
+};
+/* identity of a file on disk, which does not depend on the path used to reach it (e.g. via symlinks or ..) */
+struct PreprocessorFileId{
+	dev_t dev;
+	ino_t ino;
+};
+/* state of a file that is shared by all paths that refer to it */
+struct PreprocessorFileInfo{
+	/* key in Preprocessor.files */
+	struct PreprocessorFileId id;
+	/* path the file was first seen as, only used for diagnostics */
+	const char*path;
+
+	/* file contains #pragma once, i.e. is skipped on every further include */
+	bool pragma_once;
+	/* include guard detection has been run on the file contents */
+	bool guard_detected;
+	/*
+	if not nullptr, all tokens in the file are inside #ifndef <guard_macro> ... #endif (or #if !defined ...), so that
+	the file can be skipped without reading it while the macro is defined
+	*/
+	struct PreprocessorMacro*guard_macro;
+};
+/*
+preprocessor state at an include directive in the main file (or at the start of the main file), from which
+preprocessing can be resumed (see Preprocessor_resume)
+
+all state that only grows while preprocessing (e.g. defines, output tokens) is recorded by its length, the macro
+definitions by a snapshot of the macro table.
+*/
+struct PreprocessorCheckpoint{
+	/* iterator of the main file, at the '#' of the include directive (or at the first token of the file) */
+	struct TokenIter token_iter;
+	struct PreprocessorMacroTableSnapshot macros;
+	/* copy of Preprocessor.stack, element type is struct PreprocessorIfStack (with copies of the items) */
+	array stack;
+	bool doSkip;
+
+	/* state of the streamed output (if any), and the number of bytes written to it so far */
+	struct PreprocessorOutput output;
+	int64_t output_len;
+
+	int num_defines;
+	int num_expansions;
+	int num_tokens_out;
+	int num_source_files;
+	int num_included_files;
+	int num_embedded_files;
+	int num_pushed_files;
+	int num_pragma_once_files;
+};
+/* default for Preprocessor.max_include_depth */
+#define PREPROCESSOR_DEFAULT_MAX_INCLUDE_DEPTH 200
+
 struct Preprocessor{
 	/* include paths, type char* */
 	array include_paths;
+	/* system include paths (searched after include_paths), type char* */
+	array system_include_paths;
 	
 	/* definitions, element type is struct PreprocessorDefine */
 	array defines;
-	/* protect against double include with pragma once, the results of which are saved here, i.e. element is char* */
-	array already_included_files;
+	/* maps macro name to struct PreprocessorMacro* (i.e. assigns an id to every name) */
+	hashmap macros;
+	/* current definition of every macro, by id */
+	struct PreprocessorMacroTable macro_table;
+	/* generation of the last binding in macro_table */
+	uint32_t macro_generation;
+	/* if not nullptr, every macro lookup is recorded here, element type is struct PreprocessorMacroDependency */
+	array*macro_dependencies;
+	/*
+	every macro invocation that produced tokens, element type is struct PreprocessorExpansion. Token.expansion is an
+	index into this plus one, i.e. tokens only carry a 32-bit reference instead of a chain of invocations
+	*/
+	array expansions;
+	/* compiled #if/#elif expressions, maps raw expression spelling to struct PreprocessorIfExpression* */
+	hashmap if_expressions;
+	/* files seen by this preprocessor, maps struct PreprocessorFileId to struct PreprocessorFileInfo* */
+	hashmap files;
+	/* paths of all files that were consumed (i.e. contributed to the output), element is const char* */
+	array source_files;
+	/* every file resolved by an include directive (including files that were skipped, e.g. due to pragma once), element is struct PreprocessorIncludedFile */
+	array included_files;
+	/* tokenized files in the order they were processed (see Preprocessor_pushFile), the main file first, element is Tokenizer* */
+	array pushed_files;
+	/* files in the order they were marked with pragma once (to undo the marks when resuming), element type is struct PreprocessorFileInfo* */
+	array pragma_once_files;
+	/*
+	results of include file searches (for #include, #embed and __has_include), maps include argument (prefixed by the
+	including file for "..." arguments) to struct PreprocessorIncludeLookup*
+	*/
+	hashmap include_lookups;
+	/* files mapped by #embed directives (embed tokens point into them), element is struct PreprocessorEmbeddedFile */
+	array embedded_files;
+	/*
+	if not nullptr, every use of a macro defined in another file is recorded here, i.e. expansions and tests with
+	#ifdef, #ifndef, defined() and #if. element type is struct PreprocessorFileUse
+	*/
+	array*file_uses;
 
-	/* iterator over tokenizer_in */
+	/* iterator over the file that is currently processed */
 	struct TokenIter token_iter;
+	/* iterators of the files that include the current file (innermost last), element is struct TokenIter */
+	array include_stack;
+	/* maximum number of nested includes, exceeding it is an error */
+	int max_include_depth;
+	/*
+	if not zero, a step (see Preprocessor_step) ends after a semicolon outside of parentheses once it has collected this
+	many tokens, instead of at the next directive, so that the output of long runs of tokens is available earlier. a
+	macro invocation that is only completed by tokens after such a semicolon (when the expansion of a macro ends in an
+	unbalanced parenthesis) is not expanded then.
+	*/
+	int max_run_tokens;
+
+	/* spellings of tokens that are synthesized during macro expansion (e.g. by ## and #) */
+	arena spellings;
+	/* objects that live as long as the preprocessor (e.g. macro table entries, file info, macro expansion context) */
+	arena arena;
+	/*
+	token arrays of the macro expansion in progress (see Preprocessor_expandMacros), which are released when it is done.
+	after a fatal error during expansion they are released by Preprocessor_free
+	*/
+	arena expansion_arena;
+	/*
+	snapshot files mapped by Preprocessor_loadSnapshot (e.g. a target profile and a precompiled header), which defines
+	and tokens may point into. element type is struct PreprocessorSnapshotMapping
+	*/
+	array snapshot_mappings;
 
 	/* eventual output*/
 	array tokens_out;
+	/* tokens of the run that is being expanded (see Preprocessor_step), reused by every run */
+	array run_tokens;
+	/* if not nullptr, output tokens are streamed into this as textual output, instead of being kept in tokens_out */
+	struct PreprocessorOutput*output;
 
 	/* stack of struct PreprocessorIfStack (for [nested] if statements) */
 	array stack;
 
 	/* based on if directives, quickly indicate if non-conditional statements should be processed (include non-directive tokens) */
 	bool doSkip;
+
+	/* if not nullptr, profiling data is recorded here (see preprocessor/stats.h), not owned by the preprocessor */
+	struct PreprocessorStats*stats;
+	/*
+	if not nullptr, conditional directives are recorded in and taken from this map (see preprocessor/conditional_cache.h),
+	not owned by the preprocessor
+	*/
+	struct PreprocessorConditionalCache*conditional_cache;
+	/*
+	if not nullptr, only the macros known to this are evaluated, and all other directives are kept in the output (see
+	preprocessor/partial.h), not owned by the preprocessor
+	*/
+	struct PreprocessorPartial*partial;
+
+	/* take a checkpoint at the start of the main file and at every include directive in it (see Preprocessor_resume) */
+	bool take_checkpoints;
+	/* element type is struct PreprocessorCheckpoint, in the order they were taken */
+	array checkpoints;
 };
 /* initialize fields, must be called before any other function is called */
 void Preprocessor_init(struct Preprocessor*preprocessor);
+/*
+release all memory owned by the preprocessor (i.e. everything allocated while processing a translation unit)
 
-/* evaluate expression and return its value (see also docs for struct PreprocessorExpression) */
-int Preprocessor_evalExpression(struct Preprocessor *preprocessor,struct PreprocessorExpression*expr);
+tokens in tokens_out may point into memory that is released. the preprocessor must be initialized again before it can
+be reused.
+*/
+void Preprocessor_free(struct Preprocessor*preprocessor);
+
+/* get macro table entry for name, which is created (as not defined) if it does not exist yet */
+struct PreprocessorMacro* Preprocessor_getMacro(struct Preprocessor*preprocessor,const char*name,int name_len);
+/* get current state of a macro */
+struct PreprocessorMacroBinding Preprocessor_getMacroBinding(struct Preprocessor*preprocessor,const struct PreprocessorMacro*macro);
+/* get current definition of a macro, returns nullptr if the macro is not defined */
+struct PreprocessorDefine* Preprocessor_getDefine(struct Preprocessor*preprocessor,const Token*name);
+/* add definition of a macro, replacing the current definition (if any) */
+void Preprocessor_addDefine(struct Preprocessor*preprocessor,const struct PreprocessorDefine*define);
+/* remove current definition of a macro (if any) */
+void Preprocessor_removeDefine(struct Preprocessor*preprocessor,const Token*name);
+
+/* get expansion that produced a token from its reference (see Token.expansion), returns nullptr for 0 */
+const struct PreprocessorExpansion* Preprocessor_getExpansion(struct Preprocessor*preprocessor,uint32_t expansion);
+/*
+describe the macro expansions that produced token for diagnostics, innermost first, e.g.
+" (in expansion of macro A defined at a.h:1:9, invoked at a.c:5:1)". empty if the token was not produced by macro
+expansion. the string is allocated in the arena of the preprocessor
+*/
+const char* Preprocessor_expansionTrace(struct Preprocessor*preprocessor,const Token*token);
 
+/* get info for file at path (created on first use), returns nullptr if the file does not exist */
+struct PreprocessorFileInfo* Preprocessor_getFileInfo(struct Preprocessor*preprocessor,const char*path);
+
+/* returns true if the include argument (with quotes or angle brackets) names a file that #include would find */
+bool Preprocessor_hasInclude(struct Preprocessor*preprocessor,const char*include_argument);
 /* process an include statement */
 void Preprocessor_processInclude(struct Preprocessor*preprocessor);
+/*
+process #embed directive: the named file is mapped into memory, and emitted as a single embed token (see
+TOKEN_LITERAL_TAG_EMBED), surrounded by the prefix and suffix parameters (or replaced by if_empty when there are no
+bytes to embed). the limit parameter is an #if expression that caps the number of embedded bytes
+*/
+void Preprocessor_processEmbed(struct Preprocessor*preprocessor);
 /* process a define statements */
 void Preprocessor_processDefine(struct Preprocessor*preprocessor);
+/* expand macros in tokens_in and append expanded tokens to tokens_out (which must already be initialized) */
+void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_in_arg,Token*tokens_in_arg,array*tokens_out_arg);
 
-/* run preprocessor on a stream of tokens */
+/*
+start processing a file, the file that is currently processed (if any) is suspended until the new file is done
+
+the file is processed by Preprocessor_step
+*/
+void Preprocessor_pushFile(struct Preprocessor*preprocessor,struct TokenIter*token_iter);
+/*
+process the next directive, or the next run of tokens up to a directive, of the current file (see pushFile)
+
+output is appended to tokens_out (or streamed to output). includes do not recurse, i.e. this can be used to pull output
+incrementally. returns false when all files are done.
+*/
+bool Preprocessor_step(struct Preprocessor*preprocessor);
+/* run preprocessor on a stream of tokens (until it and all files it includes are done) */
 void Preprocessor_consume(struct Preprocessor *preprocessor, struct TokenIter *token_iter);
+/*
+prepare to preprocess again after source files changed on disk (requires take_checkpoints while preprocessing the main
+file, which must have been tokenized by the header cache). returns false if no source file has changed.
+
+the state is rewound to the latest checkpoint that no change affects, i.e. all files that were read before it are
+unchanged, and so are the tokens of the main file up to it. the output (tokens_out, or the streamed output, which must
+be a regular file then) is truncated to what was written at the checkpoint. preprocessing then continues with
+Preprocessor_step, and produces the same output as preprocessing the changed files from scratch.
+*/
+bool Preprocessor_resume(struct Preprocessor*preprocessor);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include<preprocessor/preprocessor.h>
+
+/*
+snapshot of preprocessor state, i.e. a precompiled header
+
+a snapshot contains the defines, the list of files that have been included with pragma once, and all tokens
+that have been emitted so far. it is written after a prefix header has been consumed, and can be loaded by a later
+invocation, which then continues preprocessing from that state.
+
+the file format is position independent (all references are offsets into the file), so that the file can be mapped
+into memory at any address. token spellings are not copied out of the mapping.
+
+the snapshot also records size, modification time (in nanoseconds) and content hash of every file that contributed to
+it. the snapshot is only valid as long as none of these files changed: a file with a different modification time is
+only accepted if its contents still have the same hash.
+*/
+
+/* write snapshot of the current preprocessor state to path (fatal on failure) */
+void Preprocessor_writeSnapshot(struct Preprocessor*preprocessor,const char*path);
+/*
+load snapshot from path into preprocessor
+
+replaces all defines, already included files and emitted tokens in the preprocessor.
+
+returns false if the snapshot is stale, i.e. if any file that contributed to it has changed since it was written
+*/
+bool Preprocessor_loadSnapshot(struct Preprocessor*preprocessor,const char*path);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include<stdint.h>
+
+#include<util/array.h>
+#include<util/arena.h>
+#include<util/hashmap.h>
+#include<util/writer.h>
+
+/*
+preprocessor profiling (--pp-stats)
+
+statistics are only collected while Preprocessor.stats is set, otherwise the preprocessor skips all bookkeeping.
+
+headers are identified like for include skipping (see struct PreprocessorFileInfo), so all paths that refer to the same
+file share one row, which shows the path the file was first seen as.
+*/
+
+struct PreprocessorFileInfo;
+
+struct PreprocessorHeaderStats{
+	/* identity of the file, key in PreprocessorStats.headers */
+	const struct PreprocessorFileInfo*file;
+	const char*path;
+	/* number of times the file was processed */
+	int times_included;
+	/* number of times an include of the file was skipped (#pragma once or include guard) */
+	int times_skipped;
+	/* tokens read from the file, summed over all times it was processed */
+	int64_t num_tokens;
+	/* time spent processing the file, with and without the time spent in files it includes, in nanoseconds */
+	int64_t inclusive_ns;
+	int64_t exclusive_ns;
+};
+struct PreprocessorMacroStats{
+	const char*name;
+	int64_t num_expansions;
+	/* tokens emitted by the macro body (after argument substitution), summed over all expansions */
+	int64_t num_tokens_produced;
+	/* number of enclosing macro expansions of the deepest expansion of the macro (0 if only expanded in source text) */
+	int max_rescan_depth;
+};
+/* file that is currently processed */
+struct PreprocessorStatsFrame{
+	struct PreprocessorHeaderStats*header;
+	int64_t start_ns;
+	/* inclusive time of the files included by this file so far */
+	int64_t children_ns;
+};
+struct PreprocessorStats{
+	/* maps file (i.e. the bytes of the struct PreprocessorFileInfo pointer) to struct PreprocessorHeaderStats* */
+	hashmap headers;
+	/* maps macro name to struct PreprocessorMacroStats* */
+	hashmap macros;
+	/* files that are currently processed (innermost last), element type is struct PreprocessorStatsFrame */
+	array frames;
+	/* records and their keys */
+	arena arena;
+};
+
+void PreprocessorStats_init(struct PreprocessorStats*stats);
+void PreprocessorStats_free(struct PreprocessorStats*stats);
+
+/* start timing a file with num_tokens tokens, which is processed until the matching leaveFile */
+void PreprocessorStats_enterFile(struct PreprocessorStats*stats,const struct PreprocessorFileInfo*file,int num_tokens);
+/* stop timing the innermost file (no-op if no file is timed) */
+void PreprocessorStats_leaveFile(struct PreprocessorStats*stats);
+/* record that an include of file was skipped */
+void PreprocessorStats_skipFile(struct PreprocessorStats*stats,const struct PreprocessorFileInfo*file);
+/* record an expansion of macro name that emitted num_tokens tokens, while rescan_depth other expansions were active */
+void PreprocessorStats_recordExpansion(struct PreprocessorStats*stats,const char*name,int name_len,int num_tokens,int rescan_depth);
+
+/* write human readable summary, headers sorted by inclusive time, macros by number of expansions */
+void PreprocessorStats_print(struct PreprocessorStats*stats,writer*out);
+/* write all statistics as json to path ("-" for stdout) */
+void PreprocessorStats_writeJson(struct PreprocessorStats*stats,const char*path);
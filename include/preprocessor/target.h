@@ -0,0 +1,46 @@
+#pragma once
+
+#include<preprocessor/preprocessor.h>
+
+/*
+target profiles, i.e. the predefined macros that describe a target platform (--target=, --target-profile=)
+
+a built-in profile is a table of macro definitions, which are tokenized and defined when the profile is applied.
+
+a profile file is a snapshot (see preprocessor/snapshot.h) that contains nothing but the defines, written once with
+--emit-target-profile= (e.g. after a built-in profile and a list of -D flags). loading it maps the file into memory,
+and defines all macros from it without tokenizing anything, token spellings are used straight from the mapping.
+*/
+
+/* predefined macro of a built-in profile */
+struct PreprocessorTargetMacro{
+	const char*name;
+	/* replacement list, as written in a #define directive */
+	const char*value;
+};
+struct PreprocessorTarget{
+	/* target triple, e.g. x86_64-linux-gnu */
+	const char*name;
+	const struct PreprocessorTargetMacro*macros;
+	int num_macros;
+};
+
+/* get built-in profile by name (fatal if there is none) */
+const struct PreprocessorTarget* PreprocessorTarget_get(const char*name);
+/* define all macros of a built-in profile (replacing existing definitions) */
+void PreprocessorTarget_apply(struct Preprocessor*preprocessor,const struct PreprocessorTarget*target);
+
+/*
+parse the argument of a -D flag, NAME=VALUE or just NAME (which defines NAME as 1, like compilers do), into macro. the
+name and value are allocated, see PreprocessorTargetMacros_free
+*/
+void PreprocessorTargetMacro_parseDefine(const char*define,struct PreprocessorTargetMacro*macro);
+/* define macros of -D flags (element type is struct PreprocessorTargetMacro), replacing existing definitions */
+void PreprocessorTargetMacros_apply(struct Preprocessor*preprocessor,array*macros);
+/* release the names and values of the macros of -D flags (see PreprocessorTargetMacro_parseDefine), and macros itself */
+void PreprocessorTargetMacros_free(array*macros);
+
+/* write all current defines of the preprocessor as profile file to path (fatal on failure) */
+void PreprocessorTarget_writeProfile(struct Preprocessor*preprocessor,const char*path);
+/* load profile file from path, which replaces all defines of the preprocessor (fatal on failure) */
+void PreprocessorTarget_loadProfile(struct Preprocessor*preprocessor,const char*path);
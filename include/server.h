@@ -0,0 +1,30 @@
+#pragma once
+
+/*
+compile server (--server=) and its client (--client=)
+
+the server listens on a unix socket, and runs every compilation a client sends in a process that is forked from the
+server. the client sends its arguments, its working directory and its standard streams (as file descriptors), so that
+the compilation writes straight to the streams of the client, and exits with the exit status of the compilation. the
+output is the same as if the client had compiled on its own.
+
+compilations run with the rights of the server, so only clients of the same user are served (checked with the
+credentials of the connection). the working directory of the server does not change, every compilation changes into
+the working directory of its client.
+
+headers that a compilation tokenized are tokenized by the server afterwards as well (see preprocessor/header_cache.h),
+so that later compilations start with them in the header cache. the server does so a few headers at a time while no
+request is waiting, so new requests are accepted right away. entries are still only used while the file on disk
+matches.
+*/
+
+/* compile with the given arguments (like main), returns the exit code */
+typedef int ServerCompileFunction(int argc,const char**argv);
+
+/* serve compilations on socket_path until the process is terminated (fatal if the socket cannot be set up) */
+[[gnu::noreturn]] void Server_run(const char*socket_path,ServerCompileFunction*compile);
+/*
+let the server at socket_path compile with the given arguments (argv[0] is the name of the program), and return its
+exit code. if the compilation was terminated by a signal, the client raises the same signal
+*/
+int Server_forward(const char*socket_path,int argc,const char**argv);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include<util/arena.h>
+
+#include<tokenizer.h>
+
+/*
+join adjacent string literals (translation phase 6)
+
+every run of adjacent string literals (comments in between are skipped) is replaced by a single string literal token,
+which is built once in spellings with the total length of the run. encoding prefixes (u8, L, u, U), which the tokenizer
+returns as a separate symbol directly in front of the literal, become part of the joined literal. a run takes the
+prefix of its prefixed literals, mixing different prefixes is an error.
+
+e.g. L"a" "b" u8"c" is an error, L"a" "b" L"c" becomes L"abc"
+
+the tokens are compacted in place, i.e. num_tokens shrinks. literals without prefix that are not followed by another
+literal are kept as they are.
+*/
+void StringLiterals_concatenate(Tokenizer*tokenizer,arena*spellings);
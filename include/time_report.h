@@ -0,0 +1,61 @@
+#pragma once
+
+#include<stdint.h>
+
+#include<util/array.h>
+#include<util/writer.h>
+
+/*
+per-phase timing report (-ftime-report)
+
+phases form a tree: a phase that begins while another phase is running is recorded as its sub-phase. every node sums
+up wall time (monotonic clock), cpu time of the thread and heap allocations (see util_num_allocations) over all times
+the phase ran under the same parent, e.g. all macro expansions of preprocessing are a single node. a phase that begins
+again while it is already running (e.g. nested macro expansion) is part of the outer run.
+
+phases are only recorded while a report is active on the calling thread (see TimeReport_setActive), otherwise
+TimeReport_begin and TimeReport_end only check for that, so that they can stay in hot code.
+*/
+
+struct TimeReportNode{
+	/* name of the phase (compared by pointer, i.e. a string literal) */
+	const char*name;
+	/* indices into TimeReport.nodes, -1 for none */
+	int parent;
+	int first_child;
+	int next_sibling;
+
+	/* number of times the phase ran */
+	int64_t count;
+	int64_t wall_ns;
+	int64_t cpu_ns;
+	uint64_t num_allocations;
+};
+/* phase that is currently running */
+struct TimeReportFrame{
+	/* index into TimeReport.nodes, -1 if the phase was already running (nothing is recorded for it) */
+	int node;
+	int64_t start_wall_ns;
+	int64_t start_cpu_ns;
+	uint64_t start_allocations;
+};
+struct TimeReport{
+	/* element type is struct TimeReportNode, in the order the phases ran first */
+	array nodes;
+	/* phases that are currently running (innermost last), element type is struct TimeReportFrame */
+	array frames;
+};
+
+void TimeReport_init(struct TimeReport*report);
+void TimeReport_free(struct TimeReport*report);
+
+/* record phases of the calling thread in report, nullptr to stop recording */
+void TimeReport_setActive(struct TimeReport*report);
+
+/* begin phase name (a string literal) as sub-phase of the phase that is currently running */
+void TimeReport_begin(const char*name);
+/* end the phase that began last */
+void TimeReport_end(void);
+
+/* write the tree of phases, with the share of each phase in the total wall time of all top level phases */
+void TimeReport_print(struct TimeReport*report,writer*out);
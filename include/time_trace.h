@@ -0,0 +1,65 @@
+#pragma once
+
+#include<stdint.h>
+
+#include<util/arena.h>
+#include<util/array.h>
+
+/*
+trace of compilation events in the chrome trace event format (-ftime-trace=), e.g. for chrome://tracing or perfetto
+
+a span covers one event, e.g. a compilation phase, a source file (spans of included files are nested in the span of
+the file that includes them), a function definition or a macro invocation. spans that end are kept in memory, and are
+written all at once when the compilation is done. nested spans that are shorter than the minimum duration are dropped to
+keep the trace small, top level spans are always kept.
+
+spans are only recorded while a trace is active on the calling thread (see TimeTrace_setActive).
+*/
+
+/* default minimum duration of nested spans in microseconds (-ftime-trace-granularity=) */
+#define TIME_TRACE_DEFAULT_MIN_DURATION_US 500
+
+/* span that was kept */
+struct TimeTraceEvent{
+	/* name of the span (a string literal) */
+	const char*name;
+	/* what the span is about, e.g. the path of a source file (in TimeTrace.details), nullptr for nothing */
+	const char*detail;
+	/* relative to the start of the trace */
+	int64_t start_ns;
+	int64_t duration_ns;
+};
+/* span that has not ended yet */
+struct TimeTraceSpan{
+	const char*name;
+	/* not copied until the span is kept */
+	const char*detail;
+	int detail_len;
+	int64_t start_ns;
+};
+struct TimeTrace{
+	/* monotonic clock when the trace was started */
+	int64_t start_ns;
+	int64_t min_duration_ns;
+
+	/* element type is struct TimeTraceEvent, in the order the spans ended */
+	array events;
+	/* copies of the details of the events */
+	arena details;
+	/* spans that have not ended (innermost last), element type is struct TimeTraceSpan */
+	array spans;
+};
+
+void TimeTrace_init(struct TimeTrace*trace,int64_t min_duration_us);
+void TimeTrace_free(struct TimeTrace*trace);
+
+/* record spans of the calling thread in trace, nullptr to stop recording */
+void TimeTrace_setActive(struct TimeTrace*trace);
+
+/* begin span name (a string literal), detail may be nullptr (it must stay valid until the span ends) */
+void TimeTrace_begin(const char*name,const char*detail,int detail_len);
+/* end the span that began last */
+void TimeTrace_end(void);
+
+/* write all kept spans to path as json (fatal on failure) */
+void TimeTrace_write(struct TimeTrace*trace,const char*path);
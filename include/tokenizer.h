@@ -20,6 +20,8 @@ enum Token_LiteralTag{
 	TOKEN_LITERAL_TAG_UNDEFINED=0,
 	TOKEN_LITERAL_TAG_NUMERIC,
 	TOKEN_LITERAL_TAG_STRING,
+	/* bytes of a file embedded with #embed (one token for all bytes, spelling is the resource name) */
+	TOKEN_LITERAL_TAG_EMBED,
 };
 enum Token_LiteralNumeric_Tag{
 	TOKEN_LITERAL_NUMERIC_TAG_UNDEFINED=0,
@@ -56,6 +58,11 @@ typedef struct Token{
 
 	// slightly out of place indicator if this token has already been expanded by the preprocessor and hence should not be expanded again
 	bool alreadyExpanded;
+	/*
+	macro expansion that produced this token, as reference into the expansion table of the preprocessor (see
+	PreprocessorExpansion), 0 if the token was not produced by macro expansion
+	*/
+	uint32_t expansion;
 
 	struct{
 		enum Token_LiteralTag tag;
@@ -102,6 +109,12 @@ typedef struct Token{
 					bool hasSuffix;
 				}num_info;
 			}numeric;
+
+			// embedded bytes (not owned by the token, e.g. mapped by the preprocessor)
+			struct{
+				const unsigned char*data;
+				int64_t len;
+			}embed;
 		}/* data */;
 	}literal;
 }Token;
@@ -156,6 +169,7 @@ static const char*KEYWORD_UNION="union";
 static const char*KEYWORD_ENUM="enum";
 
 static const char*KEYWORD_INCLUDE="include";
+static const char*KEYWORD_EMBED="embed";
 static const char*KEYWORD_DEFINE="define";
 static const char*KEYWORD_IFDEF="ifdef";
 static const char*KEYWORD_IFNDEF="ifndef";
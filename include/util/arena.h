@@ -0,0 +1,31 @@
+#pragma once
+
+#include<stddef.h>
+
+/* size of the blocks an arena allocates from (larger allocations get a block of their own) */
+#define ARENA_BLOCK_SIZE (64*1024)
+
+/*
+bump allocator
+
+allocations are carved out of large blocks, and can only be released all at once (arena_free)
+*/
+typedef struct arena{
+    /* block that is currently allocated from (blocks are linked to the previously used block) */
+    struct arena_block*block;
+    /* number of bytes used in block */
+    size_t used;
+}arena;
+
+void arena_init(arena*a);
+/* release all memory allocated from the arena */
+void arena_free(arena*a);
+/* release all memory allocated from the arena, but keep the block that was allocated last for further allocations */
+void arena_reset(arena*a);
+
+/* allocate size bytes (aligned for any type), the memory is not initialized. fatal on allocation failure */
+void* arena_alloc(arena*a,size_t size);
+/* copy size bytes from src into the arena (like allocAndCopy) */
+void* arena_copy(arena*a,size_t size,const void*src);
+/* copy len bytes from str into the arena, and zero terminate the copy */
+char* arena_copy_string(arena*a,const char*str,size_t len);
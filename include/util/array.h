@@ -1,13 +1,20 @@
 #pragma once
 
+struct arena;
+
 typedef struct array{
     void*data;
     int elem_size;
     int len;
     int cap;
+    /* arena the elements are allocated from, nullptr if they are allocated on the heap */
+    struct arena*arena;
 }array;
 
 void array_init(array*a,int elem_size);
+/* initialize an array whose elements are allocated from element_arena, they are released with the arena (see util/arena.h) */
+void array_init_arena(array*a,int elem_size,struct arena*element_arena);
+/* release the elements of the array (does nothing for the elements of an array in an arena) */
 void array_free(array*a);
 
 enum ARRAY_APPEND_RESULT{
@@ -0,0 +1,27 @@
+#pragma once
+
+#include<stdint.h>
+
+/* hash map from string (pointer and length, not zero terminated) to pointer */
+typedef struct hashmap{
+    struct hashmap_entry*entries;
+    /* number of occupied entries */
+    int len;
+    /* number of entries, always zero or a power of two */
+    int cap;
+}hashmap;
+struct hashmap_entry{
+    /* key memory is not owned by the map, i.e. must outlive the map. nullptr marks an empty entry */
+    const char*key;
+    int key_len;
+    uint64_t hash;
+    void*value;
+};
+
+void hashmap_init(hashmap*m);
+void hashmap_free(hashmap*m);
+
+/* get value stored for key, returns nullptr if key is not present */
+void* hashmap_get(const hashmap*m,const char*key,int key_len);
+/* insert value for key, replaces the existing value if key is already present */
+void hashmap_set(hashmap*m,const char*key,int key_len,void*value);
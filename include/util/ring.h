@@ -0,0 +1,46 @@
+#pragma once
+
+#include<pthread.h>
+#include<stdatomic.h>
+#include<stdbool.h>
+
+/*
+bounded single-producer single-consumer queue
+
+one thread pushes elements, another thread pops them, in the same order. the positions are only written by their own
+side, so neither side takes a lock while there is space (or elements) left. a side that has to wait (on a full or empty
+ring) sleeps until the other side makes progress.
+*/
+typedef struct ring{
+    char*data;
+    int elem_size;
+    /* number of elements, a power of two */
+    int cap;
+
+    /* number of elements pushed so far, only written by the producer */
+    atomic_size_t head;
+    /* number of elements popped so far, only written by the consumer */
+    atomic_size_t tail;
+    /* no more elements are pushed */
+    atomic_bool closed;
+
+    /* a side that waits sleeps on cond, while holding mutex to check again */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_bool producer_waits;
+    atomic_bool consumer_waits;
+}ring;
+
+/* init ring with space for at least cap elements of elem_size bytes each */
+void ring_init(ring*r,int elem_size,int cap);
+void ring_free(ring*r);
+
+/* push num_elems elements (producer), waits while the ring is full */
+void ring_push(ring*r,const void*elems,int num_elems);
+/* no more elements are pushed (producer), the consumer pops the remaining elements before it sees the end */
+void ring_close(ring*r);
+/*
+pop up to max_elems elements into elems (consumer), waits while the ring is empty. returns the number of elements,
+which is 0 only once the ring is closed and empty
+*/
+int ring_pop(ring*r,void*elems,int max_elems);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include<setjmp.h> // jmp_buf
+#include<stdint.h> // uint64_t
 #include<stdio.h> // fprintf
 #include<stdlib.h> // exit
 
@@ -11,7 +13,27 @@
 #define fprintln(F,...) {fprint(F,__VA_ARGS__); discard fprintf(F,"\n");}
 #define println(...) fprintln(stdout,__VA_ARGS__)
 #define print(...) fprint(stdout,__VA_ARGS__)
-#define fatal(...) {fprintln(stderr,__VA_ARGS__);exit(-1);}
+#define fatal(...) {fatal_report(__FILE__,__LINE__,__VA_ARGS__);}
+
+/*
+recovery point for fatal errors
+
+fatal errors terminate the process, unless a handler is set on the thread the error occurs on (see fatal_setHandler).
+then the message is stored in the handler instead, and execution continues where setjmp(handler.jump) returns a
+non-zero value. all state that was being worked on when the error occured must be discarded, e.g. the preprocessor of
+a translation unit that failed.
+*/
+struct FatalHandler{
+	jmp_buf jump;
+	char message[512];
+	/* where the error was raised (see fatal) */
+	const char*file;
+	int line;
+};
+/* set handler for fatal errors on the calling thread, nullptr to terminate the process on fatal errors again */
+void fatal_setHandler(struct FatalHandler*handler);
+/* report fatal error raised at file:line (see fatal) */
+[[gnu::noreturn]] [[gnu::format(printf,3,4)]] void fatal_report(const char*file,int line,const char*format,...);
 
 #ifdef DEVELOP
 #define DEBUG
@@ -35,6 +57,12 @@ typedef struct String{
 }String;
 
 #define COPY_(V) (allocAndCopy(sizeof(*(V)),(V)))
+/*
+number of heap allocations (including reallocations) made on the calling thread by the util containers and helpers,
+the tokenizer and file reading, which make nearly all allocations of a compilation (see -ftime-report)
+*/
+extern _Thread_local uint64_t util_num_allocations;
+
 /// @brief allocates size bytes memory and copies bytes memory from src into it
 void* allocAndCopy(size_t size,const void*src);
 
@@ -44,3 +72,6 @@ char* makeString();
 void stringAppend(char*str,char*fmtstr,...);
 /// get indentation string of length n
 char*ind(int n);
+
+/// @brief hash len bytes at data (FNV-1a, 64 bit)
+uint64_t hashBytes(const void*data,size_t len);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include<stdbool.h>
+#include<stdint.h>
+
+/* default size of the output buffer of a writer */
+#define WRITER_BUFFER_SIZE (1<<20)
+
+/* buffered writer on a file descriptor, writes are only issued when the buffer is full (or on flush) */
+typedef struct writer{
+    int fd;
+    /* close fd when the writer is closed */
+    bool owns_fd;
+
+    char*buffer;
+    int len;
+    int cap;
+    /* number of bytes written to the file so far, not including the buffer */
+    int64_t flushed;
+}writer;
+
+/* open path for writing (truncates existing file), path "-" writes to stdout. fatal on failure */
+void writer_open(writer*w,const char*path);
+/* write to an already open file descriptor, which is not closed by writer_close */
+void writer_init_fd(writer*w,int fd);
+/* flush buffer, close file and release buffer */
+void writer_close(writer*w);
+
+/* write buffered data to the file (fatal on failure) */
+void writer_flush(writer*w);
+/* number of bytes written so far, including those that are still buffered */
+int64_t writer_length(const writer*w);
+/* drop everything but the first len bytes written so far, and continue writing after them (the file must be a regular file, fatal on failure) */
+void writer_truncate(writer*w,int64_t len);
+
+void writer_write(writer*w,const char*data,int len);
+void writer_write_char(writer*w,char c);
+/* write zero terminated string */
+void writer_write_str(writer*w,const char*str);
+/* write decimal representation of value */
+void writer_write_int(writer*w,int64_t value);
+/* write str as the contents of a string literal, i.e. escape quotes and backslashes */
+void writer_write_escaped(writer*w,const char*str);
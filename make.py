@@ -27,6 +27,10 @@ if args.get("show_help",False):
 file_paths=[
     "src/util/array.c",
     "src/util/util.c",
+    "src/util/ring.c",
+    "src/util/hashmap.c",
+    "src/util/arena.c",
+    "src/util/writer.c",
 
     "src/parser/parser.c",
     "src/parser/statement.c",
@@ -37,9 +41,28 @@ file_paths=[
     "src/parser/stack.c",
 
     "src/preprocessor/preprocessor.c",
+    "src/preprocessor/if_expression.c",
+    "src/preprocessor/snapshot.c",
+    "src/preprocessor/output.c",
+    "src/preprocessor/dependencies.c",
+    "src/preprocessor/header_cache.c",
+    "src/preprocessor/macro_table.c",
+    "src/preprocessor/stats.c",
+    "src/preprocessor/include_report.c",
+    "src/preprocessor/conditional_cache.c",
+    "src/preprocessor/batch.c",
+    "src/preprocessor/target.c",
+    "src/preprocessor/partial.c",
+    "src/time_report.c",
+    "src/time_trace.c",
+    "src/server.c",
+    "src/compile_commands.c",
+    "src/pipeline.c",
 
     "src/file.c",
     "src/tokenizer.c",
+    "src/string_literals.c",
+    "src/embed.c",
     "src/main.c",
 ]
 
@@ -78,7 +101,7 @@ class Link(Command):
             self.depends(d)
 
         deps_str=" ".join(obj_out_files)
-        self.cmd=f"{CC_CMD} -o {self.out} {deps_str}"
+        self.cmd=f"{CC_CMD} -o {self.out} {deps_str} -pthread"
 
 class Mkdir(Command):
     " create a directory "
@@ -0,0 +1,428 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include<util/util.h>
+#include<file.h>
+
+#include<compile_commands.h>
+
+/* reads the json text of a compilation database */
+struct CompileCommandsParser{
+	const char*path;
+	const char*p;
+	const char*end;
+	/* for error messages */
+	int line;
+};
+
+/* value of a member of an entry that is read, the other members are skipped */
+struct CompileCommandsEntry{
+	char*directory;
+	char*file;
+	char*command;
+	/* element type is char* */
+	array arguments;
+};
+
+static void CompileCommandsParser_skipWhitespace(struct CompileCommandsParser*parser){
+	while(parser->p<parser->end && (*parser->p==' ' || *parser->p=='\t' || *parser->p=='\n' || *parser->p=='\r')){
+		if(*parser->p=='\n'){
+			parser->line++;
+		}
+		parser->p++;
+	}
+}
+/* skip whitespace, and return the next character (0 at the end of the text) */
+static char CompileCommandsParser_peek(struct CompileCommandsParser*parser){
+	CompileCommandsParser_skipWhitespace(parser);
+	return parser->p<parser->end?*parser->p:0;
+}
+static void CompileCommandsParser_expect(struct CompileCommandsParser*parser,char c){
+	if(CompileCommandsParser_peek(parser)!=c){
+		fatal("%s:%d: expected '%c' in compilation database",parser->path,parser->line,c);
+	}
+	parser->p++;
+}
+/* append the utf-8 encoding of codepoint */
+static void CompileCommandsParser_appendUtf8(array*chars,unsigned codepoint){
+	char encoded[4];
+	int len=0;
+	if(codepoint<0x80){
+		encoded[len++]=(char)codepoint;
+	}else if(codepoint<0x800){
+		encoded[len++]=(char)(0xC0|(codepoint>>6));
+		encoded[len++]=(char)(0x80|(codepoint&0x3F));
+	}else if(codepoint<0x10000){
+		encoded[len++]=(char)(0xE0|(codepoint>>12));
+		encoded[len++]=(char)(0x80|((codepoint>>6)&0x3F));
+		encoded[len++]=(char)(0x80|(codepoint&0x3F));
+	}else{
+		encoded[len++]=(char)(0xF0|(codepoint>>18));
+		encoded[len++]=(char)(0x80|((codepoint>>12)&0x3F));
+		encoded[len++]=(char)(0x80|((codepoint>>6)&0x3F));
+		encoded[len++]=(char)(0x80|(codepoint&0x3F));
+	}
+	for(int i=0;i<len;i++){
+		array_append(chars,&encoded[i]);
+	}
+}
+/* read 4 hex digits of a \u escape */
+static unsigned CompileCommandsParser_readHex4(struct CompileCommandsParser*parser){
+	if(parser->end-parser->p<4){
+		fatal("%s:%d: incomplete unicode escape in compilation database",parser->path,parser->line);
+	}
+	unsigned value=0;
+	for(int i=0;i<4;i++){
+		char c=*parser->p++;
+		value<<=4;
+		if(c>='0' && c<='9'){
+			value|=(unsigned)(c-'0');
+		}else if(c>='a' && c<='f'){
+			value|=(unsigned)(c-'a'+10);
+		}else if(c>='A' && c<='F'){
+			value|=(unsigned)(c-'A'+10);
+		}else{
+			fatal("%s:%d: invalid unicode escape in compilation database",parser->path,parser->line);
+		}
+	}
+	return value;
+}
+/* read a string, returns the allocated and unescaped value */
+static char* CompileCommandsParser_readString(struct CompileCommandsParser*parser){
+	CompileCommandsParser_expect(parser,'"');
+
+	array chars={};
+	array_init(&chars,sizeof(char));
+	while(true){
+		if(parser->p>=parser->end){
+			fatal("%s:%d: unterminated string in compilation database",parser->path,parser->line);
+		}
+		char c=*parser->p++;
+		if(c=='"'){
+			break;
+		}
+		if(c!='\\'){
+			array_append(&chars,&c);
+			continue;
+		}
+
+		if(parser->p>=parser->end){
+			fatal("%s:%d: unterminated string in compilation database",parser->path,parser->line);
+		}
+		char escaped=*parser->p++;
+		switch(escaped){
+			case '"': case '\\': case '/': array_append(&chars,&escaped); break;
+			case 'b': array_append(&chars,&(char){'\b'}); break;
+			case 'f': array_append(&chars,&(char){'\f'}); break;
+			case 'n': array_append(&chars,&(char){'\n'}); break;
+			case 'r': array_append(&chars,&(char){'\r'}); break;
+			case 't': array_append(&chars,&(char){'\t'}); break;
+			case 'u':{
+				unsigned codepoint=CompileCommandsParser_readHex4(parser);
+				// characters outside the basic multilingual plane are written as surrogate pair
+				if(codepoint>=0xD800 && codepoint<0xDC00 && parser->end-parser->p>=6 && parser->p[0]=='\\' && parser->p[1]=='u'){
+					parser->p+=2;
+					unsigned low_surrogate=CompileCommandsParser_readHex4(parser);
+					codepoint=0x10000+((codepoint-0xD800)<<10)+(low_surrogate-0xDC00);
+				}
+				CompileCommandsParser_appendUtf8(&chars,codepoint);
+				break;
+			}
+			default:
+				fatal("%s:%d: invalid escape \\%c in compilation database",parser->path,parser->line,escaped);
+		}
+	}
+	array_append(&chars,&(char){0});
+	return chars.data;
+}
+/* skip any value */
+static void CompileCommandsParser_skipValue(struct CompileCommandsParser*parser){
+	char c=CompileCommandsParser_peek(parser);
+	if(c=='"'){
+		free(CompileCommandsParser_readString(parser));
+		return;
+	}
+	if(c=='[' || c=='{'){
+		char close=c=='['?']':'}';
+		parser->p++;
+		if(CompileCommandsParser_peek(parser)==close){
+			parser->p++;
+			return;
+		}
+		while(true){
+			if(c=='{'){
+				free(CompileCommandsParser_readString(parser));
+				CompileCommandsParser_expect(parser,':');
+			}
+			CompileCommandsParser_skipValue(parser);
+			if(CompileCommandsParser_peek(parser)==close){
+				parser->p++;
+				return;
+			}
+			CompileCommandsParser_expect(parser,',');
+		}
+	}
+	// numbers, true, false and null
+	const char*start=parser->p;
+	while(parser->p<parser->end && strchr(",]} \t\r\n",*parser->p)==nullptr){
+		parser->p++;
+	}
+	if(parser->p==start){
+		fatal("%s:%d: expected value in compilation database",parser->path,parser->line);
+	}
+}
+static void CompileCommandsParser_readEntry(struct CompileCommandsParser*parser,struct CompileCommandsEntry*entry){
+	*entry=(struct CompileCommandsEntry){};
+	array_init(&entry->arguments,sizeof(char*));
+
+	CompileCommandsParser_expect(parser,'{');
+	if(CompileCommandsParser_peek(parser)=='}'){
+		parser->p++;
+		return;
+	}
+	while(true){
+		char*key=CompileCommandsParser_readString(parser);
+		CompileCommandsParser_expect(parser,':');
+		if(strcmp(key,"directory")==0){
+			free(entry->directory);
+			entry->directory=CompileCommandsParser_readString(parser);
+		}else if(strcmp(key,"file")==0){
+			free(entry->file);
+			entry->file=CompileCommandsParser_readString(parser);
+		}else if(strcmp(key,"command")==0){
+			free(entry->command);
+			entry->command=CompileCommandsParser_readString(parser);
+		}else if(strcmp(key,"arguments")==0){
+			CompileCommandsParser_expect(parser,'[');
+			if(CompileCommandsParser_peek(parser)==']'){
+				parser->p++;
+			}else{
+				while(true){
+					char*argument=CompileCommandsParser_readString(parser);
+					array_append(&entry->arguments,&argument);
+					if(CompileCommandsParser_peek(parser)==']'){
+						parser->p++;
+						break;
+					}
+					CompileCommandsParser_expect(parser,',');
+				}
+			}
+		}else{
+			CompileCommandsParser_skipValue(parser);
+		}
+		free(key);
+
+		if(CompileCommandsParser_peek(parser)=='}'){
+			parser->p++;
+			return;
+		}
+		CompileCommandsParser_expect(parser,',');
+	}
+}
+
+/* split command into arguments like a shell would (quotes and backslashes, no expansions), arguments are allocated */
+static void CompileCommands_splitCommand(const char*command,array*arguments){
+	const char*p=command;
+	while(true){
+		while(*p==' ' || *p=='\t' || *p=='\n' || *p=='\r'){
+			p++;
+		}
+		if(*p==0){
+			return;
+		}
+
+		array chars={};
+		array_init(&chars,sizeof(char));
+		while(*p!=0 && *p!=' ' && *p!='\t' && *p!='\n' && *p!='\r'){
+			if(*p=='\''){
+				// everything up to the closing quote is literal
+				for(p++;*p!=0 && *p!='\'';p++){
+					array_append(&chars,p);
+				}
+				if(*p=='\''){
+					p++;
+				}
+			}else if(*p=='"'){
+				// backslashes only escape characters that are special within double quotes
+				for(p++;*p!=0 && *p!='"';p++){
+					if(*p=='\\' && (p[1]=='"' || p[1]=='\\' || p[1]=='$' || p[1]=='`')){
+						p++;
+					}
+					array_append(&chars,p);
+				}
+				if(*p=='"'){
+					p++;
+				}
+			}else{
+				if(*p=='\\' && p[1]!=0){
+					p++;
+				}
+				array_append(&chars,p);
+				p++;
+			}
+		}
+		array_append(&chars,&(char){0});
+		array_append(arguments,&chars.data);
+	}
+}
+
+/* path relative to directory (absolute paths, and any path if directory is nullptr, are copied as they are) */
+static char* CompileCommands_resolvePath(const char*directory,const char*path){
+	if(directory==nullptr || path[0]=='/'){
+		return allocAndCopy(strlen(path)+1,path);
+	}
+	size_t directory_len=strlen(directory);
+	char*resolved=calloc(directory_len+1+strlen(path)+1,1);
+	discard sprintf(resolved,directory_len>0 && directory[directory_len-1]=='/'?"%s%s":"%s/%s",directory,path);
+	return resolved;
+}
+
+/* take the flags that affect preprocessing from arguments (the first argument is the compiler) */
+static void CompileCommand_readArguments(struct CompileCommand*command,const char*directory,array*arguments){
+	for(int i=1;i<arguments->len;i++){
+		const char*argument=*(const char**)array_get(arguments,i);
+
+		// flags take their value either in the same argument, or in the next one
+		static const char*const flags[]={"-isystem","-I","-D","-U"};
+		const char*flag=nullptr;
+		for(int j=0;j<(int)(sizeof(flags)/sizeof(flags[0]));j++){
+			if(strncmp(argument,flags[j],strlen(flags[j]))==0){
+				flag=flags[j];
+				break;
+			}
+		}
+		if(flag==nullptr){
+			continue;
+		}
+		const char*value=argument+strlen(flag);
+		if(*value==0){
+			if(i+1>=arguments->len){
+				continue;
+			}
+			value=*(const char**)array_get(arguments,++i);
+		}
+
+		if(strcmp(flag,"-isystem")==0){
+			char*include_path=CompileCommands_resolvePath(directory,value);
+			array_append(&command->system_include_paths,&include_path);
+		}else if(strcmp(flag,"-I")==0){
+			char*include_path=CompileCommands_resolvePath(directory,value);
+			array_append(&command->include_paths,&include_path);
+		}else if(strcmp(flag,"-D")==0){
+			struct PreprocessorTargetMacro macro;
+			PreprocessorTargetMacro_parseDefine(value,&macro);
+			array_append(&command->macros,&macro);
+		}else{
+			char*undefine=allocAndCopy(strlen(value)+1,value);
+			array_append(&command->undefines,&undefine);
+		}
+	}
+}
+
+void CompileCommands_read(const char*path,array*commands){
+	File file;
+	File_read(path,&file);
+
+	struct CompileCommandsParser parser={
+		.path=path,
+		.p=file.contents,
+		.end=file.contents+file.contents_len,
+		.line=1,
+	};
+	CompileCommandsParser_expect(&parser,'[');
+	bool is_empty=CompileCommandsParser_peek(&parser)==']';
+	if(is_empty){
+		parser.p++;
+	}
+	while(!is_empty){
+		struct CompileCommandsEntry entry;
+		CompileCommandsParser_readEntry(&parser,&entry);
+		if(entry.file==nullptr){
+			fatal("%s:%d: entry without file in compilation database",path,parser.line);
+		}
+		if(entry.arguments.len==0 && entry.command!=nullptr){
+			CompileCommands_splitCommand(entry.command,&entry.arguments);
+		}
+
+		struct CompileCommand command={
+			.file=CompileCommands_resolvePath(entry.directory,entry.file),
+		};
+		array_init(&command.include_paths,sizeof(const char*));
+		array_init(&command.system_include_paths,sizeof(const char*));
+		array_init(&command.macros,sizeof(struct PreprocessorTargetMacro));
+		array_init(&command.undefines,sizeof(const char*));
+		CompileCommand_readArguments(&command,entry.directory,&entry.arguments);
+		array_append(commands,&command);
+
+		for(int i=0;i<entry.arguments.len;i++){
+			free(*(char**)array_get(&entry.arguments,i));
+		}
+		array_free(&entry.arguments);
+		free(entry.directory);
+		free(entry.file);
+		free(entry.command);
+
+		if(CompileCommandsParser_peek(&parser)==']'){
+			parser.p++;
+			break;
+		}
+		CompileCommandsParser_expect(&parser,',');
+	}
+	if(CompileCommandsParser_peek(&parser)!=0){
+		fatal("%s:%d: unexpected text after the end of the compilation database",path,parser.line);
+	}
+
+	free((char*)file.contents);
+}
+/* append all elements of from to to */
+static void CompileCommands_appendAll(array*to,array*from){
+	for(int i=0;i<from->len;i++){
+		array_append(to,array_get(from,i));
+	}
+}
+void CompileCommands_free(array*commands){
+	for(int i=0;i<commands->len;i++){
+		struct CompileCommand*command=array_get(commands,i);
+		free(command->file);
+		array*strings[]={&command->include_paths,&command->system_include_paths,&command->undefines};
+		for(int j=0;j<(int)(sizeof(strings)/sizeof(strings[0]));j++){
+			for(int k=0;k<strings[j]->len;k++){
+				free(*(char**)array_get(strings[j],k));
+			}
+			array_free(strings[j]);
+		}
+		PreprocessorTargetMacros_free(&command->macros);
+
+		array_free(&command->batch_include_paths);
+		array_free(&command->batch_system_include_paths);
+		array_free(&command->batch_undefines);
+	}
+}
+
+const struct PreprocessorBatchConfig* CompileCommand_getBatchConfig(struct CompileCommand*command,const struct PreprocessorBatchConfig*batch_config){
+	command->batch_config=*batch_config;
+
+	array_init(&command->batch_include_paths,sizeof(const char*));
+	CompileCommands_appendAll(&command->batch_include_paths,&command->include_paths);
+	CompileCommands_appendAll(&command->batch_include_paths,batch_config->include_paths);
+	command->batch_config.include_paths=&command->batch_include_paths;
+
+	array_init(&command->batch_system_include_paths,sizeof(const char*));
+	CompileCommands_appendAll(&command->batch_system_include_paths,&command->system_include_paths);
+	CompileCommands_appendAll(&command->batch_system_include_paths,batch_config->system_include_paths);
+	command->batch_config.system_include_paths=&command->batch_system_include_paths;
+
+	array_init(&command->batch_undefines,sizeof(const char*));
+	CompileCommands_appendAll(&command->batch_undefines,&command->undefines);
+	CompileCommands_appendAll(&command->batch_undefines,batch_config->undefines);
+	command->batch_config.undefines=&command->batch_undefines;
+
+	command->macro_table=(struct PreprocessorTarget){
+		.name=command->file,
+		.macros=command->macros.data,
+		.num_macros=command->macros.len,
+	};
+	command->batch_config.macros=&command->macro_table;
+
+	return &command->batch_config;
+}
@@ -0,0 +1,132 @@
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include<util/util.h>
+#include<util/array.h>
+
+#include<embed.h>
+
+static bool Embed_isEmbed(const Token*token){
+	return token->tag==TOKEN_TAG_LITERAL && token->literal.tag==TOKEN_LITERAL_TAG_EMBED;
+}
+/* get the closest token before (step -1) or after (step 1) index that is not a comment, nullptr if there is none */
+static const Token* Embed_neighbour(const Tokenizer*tokenizer,int index,int step){
+	for(int i=index+step;i>=0 && i<tokenizer->num_tokens;i+=step){
+		if(tokenizer->tokens[i].tag!=TOKEN_TAG_COMMENT){
+			return &tokenizer->tokens[i];
+		}
+	}
+	return nullptr;
+}
+/* returns true if token starts (or separates) an element of an initializer */
+static bool Embed_startsElement(const Token*token){
+	return token!=nullptr && (Token_equalString(token,"{") || Token_equalString(token,",") || Token_equalString(token,"="));
+}
+
+void Embed_expandOutsideInitializers(Tokenizer*tokenizer,arena*memory){
+	/* for every open bracket, whether it is the brace of an initializer, element type is bool */
+	array brackets={};
+	array_init(&brackets,sizeof(bool));
+	/* indices of the embed tokens that are expanded, element type is int */
+	array expanded={};
+	array_init(&expanded,sizeof(int));
+	int64_t num_tokens_out=tokenizer->num_tokens;
+
+	for(int i=0;i<tokenizer->num_tokens;i++){
+		const Token*token=&tokenizer->tokens[i];
+		bool in_initializer=brackets.len>0 && *(bool*)array_get(&brackets,brackets.len-1);
+
+		if(Token_equalString(token,"{")){
+			// a brace after = starts an initializer, and so does a brace that is an element of an initializer
+			const Token*previous=Embed_neighbour(tokenizer,i,-1);
+			bool is_initializer=
+				(previous!=nullptr && Token_equalString(previous,"="))
+				|| (in_initializer && Embed_startsElement(previous));
+			array_append(&brackets,&is_initializer);
+		}else if(Token_equalString(token,"(") || Token_equalString(token,"[")){
+			array_append(&brackets,&(bool){false});
+		}else if(Token_equalString(token,"}") || Token_equalString(token,")") || Token_equalString(token,"]")){
+			if(brackets.len>0){
+				array_pop_back(&brackets);
+			}
+		}else if(Embed_isEmbed(token)){
+			const Token*next=Embed_neighbour(tokenizer,i,1);
+			bool is_element=
+				in_initializer
+				&& Embed_startsElement(Embed_neighbour(tokenizer,i,-1))
+				&& next!=nullptr && (Token_equalString(next,",") || Token_equalString(next,"}"));
+			if(!is_element){
+				array_append(&expanded,&i);
+				// one integer literal per byte, separated by commas
+				num_tokens_out+=2*token->literal.embed.len-2;
+			}
+		}
+	}
+	array_free(&brackets);
+
+	if(expanded.len==0){
+		array_free(&expanded);
+		return;
+	}
+	if(num_tokens_out>INT_MAX){
+		fatal("too many tokens after expanding embedded files (%lld)",(long long)num_tokens_out);
+	}
+
+	// spellings of all byte values
+	char(*byte_spellings)[4]=arena_alloc(memory,256*sizeof(*byte_spellings));
+	for(int value=0;value<256;value++){
+		discard snprintf(byte_spellings[value],sizeof(byte_spellings[value]),"%d",value);
+	}
+
+	Token*tokens_out=arena_alloc(memory,(size_t)num_tokens_out*sizeof(Token));
+	int num_written=0;
+	int next_expanded=0;
+	for(int i=0;i<tokenizer->num_tokens;i++){
+		const Token*token=&tokenizer->tokens[i];
+		if(next_expanded>=expanded.len || *(int*)array_get(&expanded,next_expanded)!=i){
+			tokens_out[num_written++]=*token;
+			continue;
+		}
+		next_expanded++;
+
+		for(int64_t byte_index=0;byte_index<token->literal.embed.len;byte_index++){
+			// all tokens are located at the embed token
+			if(byte_index>0){
+				tokens_out[num_written++]=(Token){
+					.tag=TOKEN_TAG_KEYWORD,
+					.len=1,
+					.p=KEYWORD_COMMA,
+					.filename=token->filename,
+					.line=token->line,
+					.col=token->col,
+				};
+			}
+
+			int value=token->literal.embed.data[byte_index];
+			tokens_out[num_written++]=(Token){
+				.tag=TOKEN_TAG_LITERAL,
+				.len=(int)strlen(byte_spellings[value]),
+				.p=byte_spellings[value],
+				.filename=token->filename,
+				.line=token->line,
+				.col=token->col,
+				.literal={
+					.tag=TOKEN_LITERAL_TAG_NUMERIC,
+					.numeric={
+						.tag=TOKEN_LITERAL_NUMERIC_TAG_INTEGER,
+						.value={.int_=value},
+						.num_info={
+							.base=10,
+							.hasLeadingDigits=true,
+						},
+					},
+				},
+			};
+		}
+	}
+	array_free(&expanded);
+
+	tokenizer->tokens=tokens_out;
+	tokenizer->num_tokens=num_written;
+}
@@ -14,6 +14,7 @@ void File_read(const char*filepath,File*out){
 	fseek(file,0,SEEK_END);
 	int file_len=ftell(file);
 	fseek(file,0,SEEK_SET);
+	util_num_allocations++;
 	char*file_contents=malloc(file_len+1);
 	fread(file_contents,1,file_len,file);
 	file_contents[file_len]=0;
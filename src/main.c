@@ -1,5 +1,10 @@
+// nanosleep (--watch)
+#define _POSIX_C_SOURCE 199309L
+
 #include<stdio.h>
 #include<string.h>
+#include<time.h>
+#include<unistd.h> // sysconf
 
 #include <tokenizer.h>
 #include <util/array.h>
@@ -9,6 +14,24 @@
 #include <util/ansi_esc_codes.h>
 
 #include<preprocessor/preprocessor.h>
+#include<preprocessor/snapshot.h>
+#include<preprocessor/output.h>
+#include<preprocessor/dependencies.h>
+#include<preprocessor/header_cache.h>
+#include<preprocessor/stats.h>
+#include<preprocessor/conditional_cache.h>
+#include<preprocessor/include_report.h>
+#include<preprocessor/batch.h>
+#include<compile_commands.h>
+#include<preprocessor/target.h>
+#include<preprocessor/partial.h>
+#include<string_literals.h>
+#include<embed.h>
+#include<time_report.h>
+#include<time_trace.h>
+#include<pipeline.h>
+#include<server.h>
+#include<util/writer.h>
 
 void Module_print(Module*module){
 	printf("module:\n");
@@ -18,6 +41,129 @@ void Module_print(Module*module){
 	}
 }
 
+/* resident memory of this process in KiB, or -1 if it cannot be determined */
+static long residentMemoryKiB(void){
+	FILE*statm=fopen("/proc/self/statm","r");
+	if(statm==nullptr){
+		return -1;
+	}
+	long size=0,resident=0;
+	int num_read=fscanf(statm,"%ld %ld",&size,&resident);
+	fclose(statm);
+	if(num_read!=2){
+		return -1;
+	}
+	return resident*(sysconf(_SC_PAGESIZE)/1024);
+}
+/* define the predefined macros of the target, from a profile file and/or a built-in profile (either may be nullptr) */
+static void predefineTargetMacros(struct Preprocessor*preprocessor,const char*target_profile_path,const struct PreprocessorTarget*target){
+	if(target_profile_path!=nullptr){
+		PreprocessorTarget_loadProfile(preprocessor,target_profile_path);
+	}
+	if(target!=nullptr){
+		PreprocessorTarget_apply(preprocessor,target);
+	}
+}
+/*
+define and undefine macros given on the command line (-D, then -U), element type of defines is struct
+PreprocessorTargetMacro and of undefines const char*
+*/
+static void defineCommandLineMacros(struct Preprocessor*preprocessor,array*defines,array*undefines){
+	PreprocessorTargetMacros_apply(preprocessor,defines);
+	for(int i=0;i<undefines->len;i++){
+		const char*undefine=*(const char**)array_get(undefines,i);
+		Preprocessor_removeDefine(preprocessor,&(Token){.tag=TOKEN_TAG_SYMBOL,.p=undefine,.len=(int)strlen(undefine)});
+	}
+}
+/*
+preprocess num_translation_units translation units in this process (cycling through input_filenames), each with its
+own preprocessor that is released afterwards, and report resident memory along the way (which should stay flat)
+*/
+static void benchmarkPreprocessor(
+	int num_translation_units,
+	array*input_filenames,
+	array*include_paths,
+	array*system_include_paths
+){
+	static const int num_reports=10;
+	long num_tokens=0;
+	for(int tu=0;tu<num_translation_units;tu++){
+		const char*input_filename=*(const char**)array_get(input_filenames,tu%input_filenames->len);
+
+		struct Preprocessor preprocessor={};
+		Preprocessor_init(&preprocessor);
+		for(int i=0;i<include_paths->len;i++){
+			array_append(&preprocessor.include_paths,array_get(include_paths,i));
+		}
+		for(int i=0;i<system_include_paths->len;i++){
+			array_append(&preprocessor.system_include_paths,array_get(system_include_paths,i));
+		}
+
+		// input files are tokenized once, like headers
+		struct TokenIter token_iter;
+		TokenIter_init(&token_iter,HeaderCache_get(input_filename),(struct TokenIterConfig){.skip_comments=true,});
+		Preprocessor_consume(&preprocessor,&token_iter);
+		num_tokens+=preprocessor.tokens_out.len;
+
+		Preprocessor_free(&preprocessor);
+
+		if((tu+1)%(num_translation_units/num_reports>0?num_translation_units/num_reports:1)==0 || tu+1==num_translation_units){
+			printf("translation units: %d, tokens: %ld, resident memory: %ld KiB\n",tu+1,num_tokens,residentMemoryKiB());
+		}
+	}
+}
+
+/* interval in which --watch checks the source files for changes, in milliseconds */
+#define WATCH_INTERVAL_MS 100
+/*
+preprocess again whenever a source file changes (--watch), continuing from the latest checkpoint that the change does
+not affect (see Preprocessor_resume), which rewrites the output file from there on. the preprocessor must have
+preprocessed the input file once already, with checkpoints
+*/
+[[gnu::noreturn]] static void watchPreprocessor(struct Preprocessor*preprocessor,struct PreprocessorOutput*output,writer*output_writer){
+	while(true){
+		// the output is complete until the next change
+		writer_flush(output_writer);
+		while(!Preprocessor_resume(preprocessor)){
+			discard nanosleep(&(struct timespec){.tv_sec=0,.tv_nsec=WATCH_INTERVAL_MS*1000*1000},nullptr);
+		}
+
+		while(Preprocessor_step(preprocessor)){}
+		PreprocessorOutput_finish(output);
+	}
+}
+
+/* begin compilation phase, in the time report and the time trace */
+static void beginPhase(const char*name){
+	TimeReport_begin(name);
+	TimeTrace_begin(name,nullptr,0);
+}
+static void endPhase(void){
+	TimeTrace_end();
+	TimeReport_end();
+}
+/*
+stop recording, write the time report to stderr and the time trace to trace_path (report and trace may be nullptr if
+-ftime-report or -ftime-trace= are not given)
+*/
+static void finishTiming(struct TimeReport*report,struct TimeTrace*trace,const char*trace_path){
+	if(report!=nullptr){
+		TimeReport_setActive(nullptr);
+
+		writer report_writer={};
+		writer_init_fd(&report_writer,2);
+		TimeReport_print(report,&report_writer);
+		writer_close(&report_writer);
+
+		TimeReport_free(report);
+	}
+	if(trace!=nullptr){
+		TimeTrace_setActive(nullptr);
+		TimeTrace_write(trace,trace_path);
+		TimeTrace_free(trace);
+	}
+}
+
 void print_test_result(const char*testname,bool passed){
 	if(passed){
 		println(TEXT_COLOR_GREEN "%s passed" TEXT_COLOR_RESET,testname);
@@ -26,7 +172,8 @@ void print_test_result(const char*testname,bool passed){
 	}
 }
 
-int main(int argc, const char**argv){
+/* compile with the given arguments, returns the exit code */
+static int compile(int argc, const char**argv){
 	if(argc<2){
 		fatal("no input file given. aborting.");
 	}
@@ -34,12 +181,87 @@ int main(int argc, const char**argv){
 	char*input_filename=nullptr;
 	bool run_preprocessor=false;
 	bool run_parser=false;
+	/* path to write preprocessor snapshot to, after preprocessing the input file */
+	const char*emit_pch_path=nullptr;
+	/* path to read preprocessor snapshot from, before preprocessing the input file */
+	const char*include_pch_path=nullptr;
+	/* only run the preprocessor, and write its textual output (-E) */
+	bool preprocess_only=false;
+	/* path to write output to, "-" for stdout */
+	const char*output_path="-";
+
+	/* write make dependency rule (-M, -MM, -MD, -MMD) */
+	bool write_dependencies=false;
+	/* write dependency rule instead of preprocessed output, and stop after preprocessing (-M, -MM) */
+	bool dependencies_only=false;
+	/* path of the dependency file (-MF), derived from the output or input file name if not set */
+	const char*dependency_path=nullptr;
+	struct PreprocessorDependencyConfig dependency_config={
+		.target=nullptr,
+		.exclude_system_headers=false,
+		.phony_targets=false,
+	};
+
+	/* if not zero, preprocess this many translation units from the input files and report memory use (--bench-tus=) */
+	int bench_translation_units=0;
+	/* all input files, element type is const char* (only the benchmark accepts more than one) */
+	array input_filenames={};
+	array_init(&input_filenames,sizeof(const char*));
+
+	/* preprocess every input file on its own, and report the outcome of each (--batch) */
+	bool run_batch=false;
+	/* number of worker threads of the batch (--batch-jobs=), defaults to the number of processors */
+	int batch_threads=(int)sysconf(_SC_NPROCESSORS_ONLN);
+	/* preprocess and parse every translation unit of this compilation database as a batch (--compile-commands=) */
+	const char*compile_commands_path=nullptr;
+
+	/* print preprocessor profiling summary to stderr (--pp-stats), and write it as json if a path is given (--pp-stats=) */
+	bool print_pp_stats=false;
+	const char*pp_stats_path=nullptr;
+
+	/* print wall time, cpu time and heap allocations of every compilation phase to stderr (-ftime-report) */
+	bool print_time_report=false;
+	/* write a trace of the compilation to this path (-ftime-trace=), nullptr if not enabled */
+	const char*time_trace_path=nullptr;
+	/* minimum duration of nested spans in the trace, in microseconds (-ftime-trace-granularity=) */
+	int time_trace_granularity=TIME_TRACE_DEFAULT_MIN_DURATION_US;
+
+	/* parse the output of the preprocessor on another thread while preprocessing (--pipeline) */
+	bool pipelined=false;
+
+	/* keep preprocessing the input again whenever a source file changes, until terminated (--watch) */
+	bool watch=false;
+
+	/* reduce the input to the code that remains with only the -D and -U macros known, instead of preprocessing it (--partial) */
+	bool partial_preprocessing=false;
+
+	/* directory of the conditional-region maps (--cond-cache=), nullptr if not enabled */
+	const char*conditional_cache_path=nullptr;
+
+	/* report includes that are not needed by the translation unit (--include-report), to stderr or the given path (--include-report=) */
+	bool write_include_report=false;
+	const char*include_report_path=nullptr;
+
+	/* built-in target profile (--target=), nullptr for none */
+	const struct PreprocessorTarget*target_profile=nullptr;
+	/* target profile file to load before preprocessing (--target-profile=) */
+	const char*target_profile_path=nullptr;
+	/* write the predefined macros (target and -D) as target profile file, instead of processing any input (--emit-target-profile=) */
+	const char*emit_target_profile_path=nullptr;
+
+	/* maximum number of nested includes (-fmax-include-depth=) */
+	int max_include_depth=PREPROCESSOR_DEFAULT_MAX_INCLUDE_DEPTH;
 
 	array defines={};
-	array_init(&defines,sizeof(const char*));
+	array_init(&defines,sizeof(struct PreprocessorTargetMacro));
+	/* names of macros to undefine (-U), element type is const char* */
+	array undefines={};
+	array_init(&undefines,sizeof(const char*));
 
 	array include_paths={};
 	array_init(&include_paths,sizeof(const char*));
+	array system_include_paths={};
+	array_init(&system_include_paths,sizeof(const char*));
 
 	for(int i=1;i<argc;i++){
 		if(
@@ -58,11 +280,179 @@ int main(int argc, const char**argv){
 			continue;
 		}
 
+		if(strcmp(argv[i],"-E")==0){
+			preprocess_only=true;
+			run_preprocessor=true;
+			continue;
+		}
+
+		if(strcmp(argv[i],"-o")==0){
+			if(i+1>=argc){
+				fatal("missing path after -o");
+			}
+			output_path=argv[++i];
+			continue;
+		}
+
+		if(strcmp(argv[i],"-M")==0 || strcmp(argv[i],"-MM")==0){
+			write_dependencies=true;
+			dependencies_only=true;
+			run_preprocessor=true;
+			dependency_config.exclude_system_headers=strcmp(argv[i],"-MM")==0;
+			continue;
+		}
+		if(strcmp(argv[i],"-MD")==0 || strcmp(argv[i],"-MMD")==0){
+			write_dependencies=true;
+			dependency_config.exclude_system_headers=strcmp(argv[i],"-MMD")==0;
+			continue;
+		}
+		if(strcmp(argv[i],"-MP")==0){
+			dependency_config.phony_targets=true;
+			continue;
+		}
+		if(strcmp(argv[i],"-MF")==0 || strcmp(argv[i],"-MT")==0){
+			if(i+1>=argc){
+				fatal("missing argument after %s",argv[i]);
+			}
+			if(strcmp(argv[i],"-MF")==0){
+				dependency_path=argv[i+1];
+			}else{
+				dependency_config.target=argv[i+1];
+			}
+			i++;
+			continue;
+		}
+
+		if(strncmp(argv[i],"--emit-pch=",strlen("--emit-pch="))==0){
+			emit_pch_path=argv[i]+strlen("--emit-pch=");
+			continue;
+		}
+
+		if(strncmp(argv[i],"--include-pch=",strlen("--include-pch="))==0){
+			include_pch_path=argv[i]+strlen("--include-pch=");
+			continue;
+		}
+
+		if(strncmp(argv[i],"--target=",strlen("--target="))==0){
+			target_profile=PreprocessorTarget_get(argv[i]+strlen("--target="));
+			continue;
+		}
+		if(strncmp(argv[i],"--target-profile=",strlen("--target-profile="))==0){
+			target_profile_path=argv[i]+strlen("--target-profile=");
+			continue;
+		}
+		if(strncmp(argv[i],"--emit-target-profile=",strlen("--emit-target-profile="))==0){
+			emit_target_profile_path=argv[i]+strlen("--emit-target-profile=");
+			continue;
+		}
+
+		if(strncmp(argv[i],"-fmax-include-depth=",strlen("-fmax-include-depth="))==0){
+			max_include_depth=atoi(argv[i]+strlen("-fmax-include-depth="));
+			if(max_include_depth<=0){
+				fatal("invalid maximum include depth %s",argv[i]);
+			}
+			continue;
+		}
+
+		if(strcmp(argv[i],"--pp-stats")==0){
+			print_pp_stats=true;
+			continue;
+		}
+		if(strncmp(argv[i],"--pp-stats=",strlen("--pp-stats="))==0){
+			print_pp_stats=true;
+			pp_stats_path=argv[i]+strlen("--pp-stats=");
+			continue;
+		}
+		if(strcmp(argv[i],"-ftime-report")==0){
+			print_time_report=true;
+			continue;
+		}
+		if(strncmp(argv[i],"-ftime-trace=",strlen("-ftime-trace="))==0){
+			time_trace_path=argv[i]+strlen("-ftime-trace=");
+			continue;
+		}
+		if(strncmp(argv[i],"-ftime-trace-granularity=",strlen("-ftime-trace-granularity="))==0){
+			time_trace_granularity=atoi(argv[i]+strlen("-ftime-trace-granularity="));
+			if(time_trace_granularity<0){
+				fatal("invalid time trace granularity %s",argv[i]);
+			}
+			continue;
+		}
+		if(strcmp(argv[i],"--partial")==0){
+			partial_preprocessing=true;
+			preprocess_only=true;
+			run_preprocessor=true;
+			continue;
+		}
+		if(strncmp(argv[i],"--cond-cache=",strlen("--cond-cache="))==0){
+			conditional_cache_path=argv[i]+strlen("--cond-cache=");
+			continue;
+		}
+		if(strcmp(argv[i],"--include-report")==0 || strncmp(argv[i],"--include-report=",strlen("--include-report="))==0){
+			// uses of declarations are only known after parsing
+			write_include_report=true;
+			run_preprocessor=true;
+			run_parser=true;
+			if(argv[i][strlen("--include-report")]=='='){
+				include_report_path=argv[i]+strlen("--include-report=");
+			}
+			continue;
+		}
+		if(strcmp(argv[i],"--pipeline")==0){
+			pipelined=true;
+			run_preprocessor=true;
+			run_parser=true;
+			continue;
+		}
+		if(strcmp(argv[i],"--watch")==0){
+			watch=true;
+			continue;
+		}
+		if(strcmp(argv[i],"--batch")==0){
+			run_batch=true;
+			continue;
+		}
+		if(strncmp(argv[i],"--compile-commands=",strlen("--compile-commands="))==0){
+			compile_commands_path=argv[i]+strlen("--compile-commands=");
+			continue;
+		}
+		if(strncmp(argv[i],"--batch-jobs=",strlen("--batch-jobs="))==0){
+			batch_threads=atoi(argv[i]+strlen("--batch-jobs="));
+			if(batch_threads<=0){
+				fatal("invalid number of batch jobs %s",argv[i]);
+			}
+			continue;
+		}
+		if(strncmp(argv[i],"--bench-tus=",strlen("--bench-tus="))==0){
+			bench_translation_units=atoi(argv[i]+strlen("--bench-tus="));
+			if(bench_translation_units<=0){
+				fatal("invalid number of translation units %s",argv[i]);
+			}
+			continue;
+		}
+
 		if(strncmp(argv[i],"-D",2)==0){
-			char*define=calloc(1,strlen(argv[i])-2+1);
-			strncpy(define,argv[i]+2,strlen(argv[i])-2);
+			struct PreprocessorTargetMacro define;
+			PreprocessorTargetMacro_parseDefine(argv[i]+2,&define);
 			array_append(&defines,&define);
-			println("cli define: %s",define);
+			continue;
+		}
+
+		if(strncmp(argv[i],"-U",2)==0){
+			const char*undefine=argv[i]+2;
+			array_append(&undefines,&undefine);
+			continue;
+		}
+
+		if(strncmp(argv[i],"-isystem",strlen("-isystem"))==0){
+			const char*include_path=argv[i]+strlen("-isystem");
+			if(include_path[0]==0){
+				if(i+1>=argc){
+					fatal("missing path after -isystem");
+				}
+				include_path=argv[++i];
+			}
+			array_append(&system_include_paths,&include_path);
 			continue;
 		}
 
@@ -73,21 +463,148 @@ int main(int argc, const char**argv){
 			continue;
 		}
 
+		// file with a list of input files
+		if(argv[i][0]=='@'){
+			PreprocessorBatch_readFileList(argv[i]+1,&input_filenames);
+			if(input_filename==nullptr && input_filenames.len>0){
+				input_filename=*(char**)array_get(&input_filenames,0);
+			}
+			continue;
+		}
+
 		if(input_filename==nullptr){
 			input_filename=(char*)argv[i];
-			continue;
 		}
+		array_append(&input_filenames,&argv[i]);
+	}
 
-		fatal("unused input argument: %s",argv[i]);
+	if(emit_target_profile_path!=nullptr){
+		struct Preprocessor preprocessor={};
+		Preprocessor_init(&preprocessor);
+		predefineTargetMacros(&preprocessor,target_profile_path,target_profile);
+		defineCommandLineMacros(&preprocessor,&defines,&undefines);
+		PreprocessorTarget_writeProfile(&preprocessor,emit_target_profile_path);
+		Preprocessor_free(&preprocessor);
+
+		array_free(&input_filenames);
+		array_free(&include_paths);
+		array_free(&system_include_paths);
+		PreprocessorTargetMacros_free(&defines);
+		array_free(&undefines);
+		return 0;
+	}
+	if(bench_translation_units>0){
+		if(input_filenames.len==0){
+			fatal("no input file given. aborting.");
+		}
+		benchmarkPreprocessor(bench_translation_units,&input_filenames,&include_paths,&system_include_paths);
+
+		array_free(&input_filenames);
+		array_free(&include_paths);
+		array_free(&system_include_paths);
+		PreprocessorTargetMacros_free(&defines);
+		array_free(&undefines);
+		return 0;
+	}
+	if(run_batch || compile_commands_path!=nullptr){
+		if(input_filenames.len==0 && compile_commands_path==nullptr){
+			fatal("no input file given. aborting.");
+		}
+
+		array batch_files={};
+		array_init(&batch_files,sizeof(struct PreprocessorBatchFile));
+		for(int i=0;i<input_filenames.len;i++){
+			array_append(&batch_files,&(struct PreprocessorBatchFile){
+				.path=*(const char**)array_get(&input_filenames,i),
+			});
+		}
+		struct PreprocessorBatchConfig batch_config={
+			.include_paths=&include_paths,
+			.system_include_paths=&system_include_paths,
+			.defines=&defines,
+			.undefines=&undefines,
+			.target=target_profile,
+			.target_profile_path=target_profile_path,
+			.max_include_depth=max_include_depth,
+			.num_threads=batch_threads>0?batch_threads:1,
+		};
+
+		// translation units of the compilation database are parsed as well, each with the flags of its command
+		array compile_commands={};
+		array_init(&compile_commands,sizeof(struct CompileCommand));
+		if(compile_commands_path!=nullptr){
+			batch_config.parse=true;
+			CompileCommands_read(compile_commands_path,&compile_commands);
+			for(int i=0;i<compile_commands.len;i++){
+				struct CompileCommand*command=array_get(&compile_commands,i);
+				array_append(&batch_files,&(struct PreprocessorBatchFile){
+					.path=command->file,
+					.config=CompileCommand_getBatchConfig(command,&batch_config),
+				});
+			}
+		}
+
+		int64_t batch_duration_ns=0;
+		int num_failed=PreprocessorBatch_run(&batch_config,&batch_files,&batch_duration_ns);
+
+		writer report_writer={};
+		writer_init_fd(&report_writer,1);
+		PreprocessorBatch_writeReport(&batch_files,batch_config.num_threads,batch_duration_ns,&report_writer);
+		writer_close(&report_writer);
+
+		PreprocessorBatch_freeFiles(&batch_files);
+		array_free(&batch_files);
+		CompileCommands_free(&compile_commands);
+		array_free(&compile_commands);
+		array_free(&input_filenames);
+		array_free(&include_paths);
+		array_free(&system_include_paths);
+		PreprocessorTargetMacros_free(&defines);
+		array_free(&undefines);
+		return num_failed>0?1:0;
+	}
+	if(input_filenames.len>1){
+		fatal("unused input argument: %s",*(const char**)array_get(&input_filenames,1));
+	}
+	// textual output (and dependency output) stops before a precompiled header could be written
+	if(emit_pch_path!=nullptr && (preprocess_only || dependencies_only)){
+		fatal("--emit-pch cannot be combined with -E, -M, -MM or --partial");
+	}
+	// the output file is rewritten in place after every change, and nothing else is written
+	if(watch && (
+		!preprocess_only || strcmp(output_path,"-")==0
+		|| partial_preprocessing || write_dependencies || conditional_cache_path!=nullptr
+		|| print_pp_stats || print_time_report || time_trace_path!=nullptr
+	)){
+		fatal("--watch requires -E with -o, and cannot be combined with --partial, -M, -MM, -MD, -MMD, --cond-cache, --pp-stats, -ftime-report or -ftime-trace");
+	}
+
+	struct TimeReport time_report_={};
+	struct TimeReport*time_report=nullptr;
+	if(print_time_report){
+		time_report=&time_report_;
+		TimeReport_init(time_report);
+		TimeReport_setActive(time_report);
+	}
+	struct TimeTrace time_trace_={};
+	struct TimeTrace*time_trace=nullptr;
+	if(time_trace_path!=nullptr){
+		time_trace=&time_trace_;
+		TimeTrace_init(time_trace,time_trace_granularity);
+		TimeTrace_setActive(time_trace);
 	}
 
 	// read file into memory
 	File code_file={};
+	beginPhase("file read");
 	File_read(input_filename,&code_file);
+	endPhase();
 
 	// tokenize file (even preprocessor requires some tokenization, because of string literals)
 	Tokenizer tokenizer={};
+	beginPhase("tokenization");
 	Tokenizer_init(&tokenizer,&code_file);
+	endPhase();
 
 	if(0){
 		print("tokens from file %s:\n",input_filename);
@@ -95,37 +612,192 @@ int main(int argc, const char**argv){
 		Tokenizer_print(&tokenizer);
 	}
 
+	// kept around after preprocessing for the include report
+	struct Preprocessor preprocessor={};
+	/* uses of macros and declarations across files, element type is struct PreprocessorFileUse */
+	array file_uses={};
+	array_init(&file_uses,sizeof(struct PreprocessorFileUse));
+
+	/* element type is struct StackReference */
+	array references={};
+	array_init(&references,sizeof(struct StackReference));
+
+	// the parser may already run while preprocessing (see --pipeline)
+	Module module={};
+	if(run_parser){
+		Module_init(&module);
+		if(write_include_report){
+			module.stack.references=&references;
+		}
+	}
+
+	// the spellings of joined string literals (phase 6) and of expanded embedded files
+	arena string_literals={};
+	arena_init(&string_literals);
+	arena embedded_bytes={};
+	arena_init(&embedded_bytes);
+
+	// the parser only runs after the preprocessor if its output is needed in full
+	pipelined=pipelined && run_preprocessor && run_parser && !preprocess_only && emit_pch_path==nullptr;
+
 	// run preprocessor (phase 4)
 	if(run_preprocessor){
-		struct Preprocessor preprocessor={};
 		Preprocessor_init(&preprocessor);
+		if(write_include_report){
+			preprocessor.file_uses=&file_uses;
+		}
+
+		predefineTargetMacros(&preprocessor,target_profile_path,target_profile);
+
+		// continue from precompiled state, which replaces the default defines (and those of the target)
+		if(include_pch_path!=nullptr){
+			if(!Preprocessor_loadSnapshot(&preprocessor,include_pch_path)){
+				fatal("precompiled header %s is out of date",include_pch_path);
+			}
+		}
 
 		// add defines from command line
-		for(int i=0;i<defines.len;i++){
-			const char*def_str=*(char**)array_get(&defines,i);
-			struct PreprocessorDefine define={
-				.name=(Token){
-					.p=def_str,
-					.len=(int)strlen(def_str),
-					.tag=TOKEN_TAG_SYMBOL,
-				},
-				.tokens={},
-				.args=nullptr,
-			};
-			array_init(&define.tokens,sizeof(Token));
-			println("define: %.*s",define.name.len,define.name.p);
-			array_append(&preprocessor.defines,&define);
+		defineCommandLineMacros(&preprocessor,&defines,&undefines);
+
+		// all other macros are unknown in partial mode
+		struct PreprocessorPartial partial={};
+		if(partial_preprocessing){
+			PreprocessorPartial_init(&partial);
+			for(int i=0;i<undefines.len;i++){
+				PreprocessorPartial_addUndefined(&partial,*(const char**)array_get(&undefines,i));
+			}
+			PreprocessorPartial_attach(&partial,&preprocessor);
 		}
 
+		preprocessor.max_include_depth=max_include_depth;
+
 		// add include paths from command line
 		for(int i=0;i<include_paths.len;i++){
 			array_append(&preprocessor.include_paths,array_get(&include_paths,i));
 		}
+		for(int i=0;i<system_include_paths.len;i++){
+			array_append(&preprocessor.system_include_paths,array_get(&system_include_paths,i));
+		}
 
+		// while watching, the input file is tokenized by the header cache like a header, so that changes are noticed
 		struct TokenIter token_iter;
-		TokenIter_init(&token_iter,&tokenizer,(struct TokenIterConfig){.skip_comments=true,});
+		TokenIter_init(&token_iter,watch?HeaderCache_get(input_filename):&tokenizer,(struct TokenIterConfig){.skip_comments=true,});
+		preprocessor.take_checkpoints=watch;
+
+		// stream textual output while preprocessing
+		writer output_writer={};
+		struct PreprocessorOutput output={};
+		if(preprocess_only && !dependencies_only){
+			writer_open(&output_writer,output_path);
+			PreprocessorOutput_init(&output,&output_writer);
+			// the reduced header of partial preprocessing is plain source text
+			output.line_markers=!partial_preprocessing;
+			output.expansions=&preprocessor.expansions;
+			preprocessor.output=&output;
+
+			// output of a precompiled header comes first, each run of tokens from the same file is written like the source range it came from
+			int first_token=0;
+			for(int i=1;i<=preprocessor.tokens_out.len;i++){
+				const Token*token=array_get(&preprocessor.tokens_out,first_token);
+				if(i<preprocessor.tokens_out.len && ((const Token*)array_get(&preprocessor.tokens_out,i))->filename==token->filename){
+					continue;
+				}
+				PreprocessorOutput_writeTokens(&output,i-first_token,token,i-first_token,token);
+				first_token=i;
+			}
+			preprocessor.tokens_out.len=0;
+		}
 
-		Preprocessor_consume(&preprocessor,&token_iter);
+		struct PreprocessorStats pp_stats={};
+		if(print_pp_stats){
+			PreprocessorStats_init(&pp_stats);
+			preprocessor.stats=&pp_stats;
+		}
+
+		struct PreprocessorConditionalCache conditional_cache={};
+		if(conditional_cache_path!=nullptr){
+			PreprocessorConditionalCache_init(&conditional_cache,conditional_cache_path);
+			preprocessor.conditional_cache=&conditional_cache;
+		}
+
+		if(pipelined){
+			// also phases 6 and 7, see pipeline.h
+			beginPhase("preprocessing and parsing");
+			Pipeline_run(&preprocessor,&token_iter,&module,tokenizer.token_src,&string_literals,&embedded_bytes);
+			endPhase();
+		}else{
+			beginPhase("preprocessing");
+			Preprocessor_consume(&preprocessor,&token_iter);
+			if(preprocess_only && !dependencies_only){
+				PreprocessorOutput_finish(&output);
+			}
+			endPhase();
+		}
+		if(watch){
+			watchPreprocessor(&preprocessor,&output,&output_writer);
+		}
+
+		if(conditional_cache_path!=nullptr){
+			PreprocessorConditionalCache_write(&conditional_cache);
+
+			preprocessor.conditional_cache=nullptr;
+			PreprocessorConditionalCache_free(&conditional_cache);
+		}
+
+		if(print_pp_stats){
+			writer stats_writer={};
+			writer_init_fd(&stats_writer,2);
+			PreprocessorStats_print(&pp_stats,&stats_writer);
+			writer_close(&stats_writer);
+			if(pp_stats_path!=nullptr){
+				PreprocessorStats_writeJson(&pp_stats,pp_stats_path);
+			}
+
+			preprocessor.stats=nullptr;
+			PreprocessorStats_free(&pp_stats);
+		}
+
+		if(write_dependencies){
+			// target and file name default to the name of the input file, with the extension replaced
+			const char*input_basename=strrchr(input_filename,'/')!=nullptr?strrchr(input_filename,'/')+1:input_filename;
+			int input_stem_len=strrchr(input_basename,'.')!=nullptr?(int)(strrchr(input_basename,'.')-input_basename):(int)strlen(input_basename);
+			if(dependency_config.target==nullptr){
+				char*target=calloc(input_stem_len+3,1);
+				discard sprintf(target,"%.*s.o",input_stem_len,input_basename);
+				dependency_config.target=target;
+			}
+			if(dependency_path==nullptr){
+				if(dependencies_only){
+					dependency_path=output_path;
+				}else if(strcmp(output_path,"-")!=0){
+					int output_stem_len=strrchr(output_path,'.')!=nullptr?(int)(strrchr(output_path,'.')-output_path):(int)strlen(output_path);
+					char*path=calloc(output_stem_len+3,1);
+					discard sprintf(path,"%.*s.d",output_stem_len,output_path);
+					dependency_path=path;
+				}else{
+					char*path=calloc(input_stem_len+3,1);
+					discard sprintf(path,"%.*s.d",input_stem_len,input_basename);
+					dependency_path=path;
+				}
+			}
+
+			Preprocessor_writeDependencies(&preprocessor,input_filename,dependency_path,&dependency_config);
+
+			if(dependencies_only){
+				finishTiming(time_report,time_trace,time_trace_path);
+				return 0;
+			}
+		}
+
+		if(preprocess_only){
+			writer_close(&output_writer);
+			finishTiming(time_report,time_trace,time_trace_path);
+			return 0;
+		}
+
+		if(emit_pch_path!=nullptr){
+			Preprocessor_writeSnapshot(&preprocessor,emit_pch_path);
+		}
 		
 		Tokenizer preprocessed_tokenizer={
 			.token_src=tokenizer.token_src,
@@ -146,7 +818,7 @@ int main(int argc, const char**argv){
 		if(0){
 			for(int i=0;i<preprocessor.defines.len;i++){
 				struct PreprocessorDefine*define=array_get(&preprocessor.defines,i);
-				if(define->name.len==0)
+				if(Preprocessor_getDefine(&preprocessor,&define->name)!=define)
 					continue;
 				printf("define (from %s ) %.*s ",define->name.filename,define->name.len,define->name.p);
 				if(define->args!=nullptr){
@@ -171,41 +843,14 @@ int main(int argc, const char**argv){
 		}
 	}
 
-	// join adjacent string literals (phase 5)
-	{
-		// set up new tokenizer
-		// copy tokens from old tokenizer
-		// join adjacent string literals by checking if new token is string literal, if so, check if previous token is string literal, if so, join them, otherwise just append
-
-		array new_tokens={};
-		array_init(&new_tokens,sizeof(Token));
+	if(!pipelined){
+		// join adjacent string literals (phase 6)
+		beginPhase("string literal joining");
+		StringLiterals_concatenate(&tokenizer,&string_literals);
 
-		Token*prev_token=nullptr;
-		Token*new_token=nullptr;
-		for(int i=0;i<tokenizer.num_tokens;i++){
-			prev_token=array_get(&new_tokens,new_tokens.len-1);
-			new_token=&tokenizer.tokens[i];
-			if(prev_token!=nullptr && prev_token->tag==TOKEN_TAG_LITERAL && prev_token->literal.tag==TOKEN_LITERAL_TAG_STRING && new_token->tag==TOKEN_TAG_LITERAL && new_token->literal.tag==TOKEN_LITERAL_TAG_STRING){
-				char*new_p=calloc(1,prev_token->len+new_token->len+1);
-				discard snprintf(new_p,prev_token->len+new_token->len-1,"%.*s%.*s",prev_token->len-1,prev_token->p,new_token->len-1,new_token->p+1);
-
-				prev_token->p=new_p;
-				prev_token->len=prev_token->len+new_token->len-2;
-				prev_token->literal.string.len=prev_token->literal.string.len+new_token->literal.string.len-2;
-				prev_token->literal.string.str=new_p;
-				continue;
-			}
-
-			// append token to tokenizer
-			array_append(&new_tokens,new_token);
-		}	
-
-		// overwrite old tokenizer with new tokenizer
-		tokenizer=(struct Tokenizer){
-			.token_src=tokenizer.token_src,
-			.tokens=new_tokens.data,
-			.num_tokens=new_tokens.len,
-		};
+		// embedded files stay a single token in initializers, and are spelled out as integer literals anywhere else
+		Embed_expandOutsideInitializers(&tokenizer,&embedded_bytes);
+		endPhase();
 	}
 
 	if(run_parser){
@@ -213,19 +858,61 @@ int main(int argc, const char**argv){
 		struct TokenIter token_iter;
 		TokenIter_init(&token_iter,&tokenizer,(struct TokenIterConfig){.skip_comments=true,});
 
-		Module module={};
-		Module_init(&module);
-		Module_parse(&module,&token_iter);
+		if(!pipelined){
+			beginPhase("parsing");
+			Module_parse(&module,&token_iter);
+			endPhase();
+		}
 
+		beginPhase("printing");
 		Module_print(&module);
+		endPhase();
 
 		if(!TokenIter_isEmpty(&token_iter)){
 			Token next_token;
 			TokenIter_lastToken(&token_iter,&next_token);
 			fatal("unexpected tokens at end of file at line %d col %d: %.*s",next_token.line,next_token.col,next_token.len,next_token.p);
 		}
+
+		if(write_include_report){
+			for(int i=0;i<references.len;i++){
+				struct StackReference*reference=array_get(&references,i);
+				array_append(&file_uses,&(struct PreprocessorFileUse){
+					.reference_file=reference->reference_file,
+					.definition_file=reference->declaration_file,
+				});
+			}
+
+			writer report_writer={};
+			if(include_report_path!=nullptr){
+				writer_open(&report_writer,include_report_path);
+			}else{
+				writer_init_fd(&report_writer,2);
+			}
+			Preprocessor_writeIncludeReport(&preprocessor,&file_uses,&report_writer);
+			writer_close(&report_writer);
+		}
 	}
+	array_free(&references);
+	array_free(&file_uses);
+	arena_free(&string_literals);
+	arena_free(&embedded_bytes);
+
+	finishTiming(time_report,time_trace,time_trace_path);
 
-	
 	return 0;
 }
+
+int main(int argc, const char**argv){
+	// serve compilations (--server=), or let a server compile (--client=), either must be the first argument
+	if(argc>=2 && strncmp(argv[1],"--server=",strlen("--server="))==0){
+		Server_run(argv[1]+strlen("--server="),compile);
+	}
+	if(argc>=2 && strncmp(argv[1],"--client=",strlen("--client="))==0){
+		const char*socket_path=argv[1]+strlen("--client=");
+		// the server sees the same arguments as a compilation on its own
+		argv[1]=argv[0];
+		return Server_forward(socket_path,argc-1,argv+1);
+	}
+	return compile(argc,argv);
+}
@@ -1,9 +1,23 @@
+#include <string.h>
+
 #include<parser/parser.h>
 #include<util/util.h>
 #include<tokenizer.h>
 
+/* token named str, allocated in the arena of the module */
+static Token* Module_token(Module*module,const char*str){
+	size_t len=strlen(str);
+	return arena_copy(&module->arena,sizeof(Token),&(Token){
+		.tag=TOKEN_TAG_UNDEFINED,
+		.len=(int)len,
+		.p=arena_copy_string(&module->arena,str,len),
+	});
+}
 void Module_init(Module*module){
+	arena_init(&module->arena);
 	Stack_init(&module->stack,nullptr);
+	// nested stacks inherit the arena
+	module->stack.arena=&module->arena;
 
 	// add basic types
 
@@ -59,8 +73,8 @@ void Module_init(Module*module){
 	{
 		Symbol symbol={
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("sizeof"),
-			.type=allocAndCopy(sizeof(Type),&(Type){
+			.name=Module_token(module,"sizeof"),
+			.type=arena_copy(&module->arena,sizeof(Type),&(Type){
 				.kind=TYPE_KIND_FUNCTION,
 				.function={
 					.args={},
@@ -68,10 +82,10 @@ void Module_init(Module*module){
 				},
 			})
 		};
-		array_init(&symbol.type->function.args,sizeof(Symbol));
+		array_init_arena(&symbol.type->function.args,sizeof(Symbol),&module->arena);
 		array_append(&symbol.type->function.args,&(Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("type"),
+			.name=Module_token(module,"type"),
 			.type=&Type_ANY,
 		});
 
@@ -81,8 +95,8 @@ void Module_init(Module*module){
 	{
 		Symbol symbol={
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("typeof"),
-			.type=allocAndCopy(sizeof(Type),&(Type){
+			.name=Module_token(module,"typeof"),
+			.type=arena_copy(&module->arena,sizeof(Type),&(Type){
 				.kind=TYPE_KIND_FUNCTION,
 				.function={
 					.args={},
@@ -90,10 +104,10 @@ void Module_init(Module*module){
 				},
 			})
 		};
-		array_init(&symbol.type->function.args,sizeof(Symbol));
+		array_init_arena(&symbol.type->function.args,sizeof(Symbol),&module->arena);
 		array_append(&symbol.type->function.args,&(Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("type"),
+			.name=Module_token(module,"type"),
 			.type=&Type_ANY,
 		});
 
@@ -103,7 +117,7 @@ void Module_init(Module*module){
 	{
 		Symbol symbol={
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("nullptr"),
+			.name=Module_token(module,"nullptr"),
 			.type=&Type_NULLPTR_T,
 		};
 		Stack_addSymol(&module->stack,&symbol);
@@ -112,12 +126,12 @@ void Module_init(Module*module){
 	{
 		Symbol symbol={
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("true"),
+			.name=Module_token(module,"true"),
 			.type=&Type_BOOL,
 		};
 		Stack_addSymol(&module->stack,&symbol);
 
-		symbol.name=Token_fromString("false");
+		symbol.name=Module_token(module,"false");
 		Stack_addSymol(&module->stack,&symbol);
 	}
 	// vararg related builtin magic functions
@@ -126,8 +140,8 @@ void Module_init(Module*module){
 		// __builtin_va_start(va_list ap, <name of last arg in the function before varargs start, so e.g. int f(int b,...) -> va_start(my_va_list,b); even though b does not directly have something to do with the vararg list>)
 		Symbol symbol={
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("__builtin_va_start"),
-			.type=allocAndCopy(sizeof(Type),&(Type){
+			.name=Module_token(module,"__builtin_va_start"),
+			.type=arena_copy(&module->arena,sizeof(Type),&(Type){
 				.kind=TYPE_KIND_FUNCTION,
 				.function={
 					.args={},
@@ -135,10 +149,10 @@ void Module_init(Module*module){
 				},
 			}),
 		};
-		array_init(&symbol.type->function.args,sizeof(Symbol));
+		array_init_arena(&symbol.type->function.args,sizeof(Symbol),&module->arena);
 		array_append(&symbol.type->function.args,&(Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("ap"),
+			.name=Module_token(module,"ap"),
 			.type=&Type_VA_LIST,
 		});
 		array_append(&symbol.type->function.args,&(Symbol){
@@ -151,8 +165,8 @@ void Module_init(Module*module){
 		// __builtin_va_arg(va_list ap, <type of next argument>)
 		symbol= (Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("__builtin_va_arg"),
-			.type=allocAndCopy(sizeof(Type),&(Type){
+			.name=Module_token(module,"__builtin_va_arg"),
+			.type=arena_copy(&module->arena,sizeof(Type),&(Type){
 				.kind=TYPE_KIND_FUNCTION,
 				.function={
 					.args={},
@@ -160,15 +174,15 @@ void Module_init(Module*module){
 				},
 			}),
 		};
-		array_init(&symbol.type->function.args,sizeof(Symbol));
+		array_init_arena(&symbol.type->function.args,sizeof(Symbol),&module->arena);
 		array_append(&symbol.type->function.args,&(Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("ap"),
+			.name=Module_token(module,"ap"),
 			.type=&Type_VA_LIST,
 		});
 		array_append(&symbol.type->function.args,&(Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("type"),
+			.name=Module_token(module,"type"),
 			.type=&Type_TYPE,
 		});
 		Stack_addSymol(&module->stack,&symbol);
@@ -177,8 +191,8 @@ void Module_init(Module*module){
 		// __builtin_va_end(va_list ap)
 		symbol= (Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("__builtin_va_end"),
-			.type=allocAndCopy(sizeof(Type),&(Type){
+			.name=Module_token(module,"__builtin_va_end"),
+			.type=arena_copy(&module->arena,sizeof(Type),&(Type){
 				.kind=TYPE_KIND_FUNCTION,
 				.function={
 					.args={},
@@ -186,10 +200,10 @@ void Module_init(Module*module){
 				},
 			}),
 		};
-		array_init(&symbol.type->function.args,sizeof(Symbol));
+		array_init_arena(&symbol.type->function.args,sizeof(Symbol),&module->arena);
 		array_append(&symbol.type->function.args,&(Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("ap"),
+			.name=Module_token(module,"ap"),
 			.type=&Type_VA_LIST,
 		});
 		Stack_addSymol(&module->stack,&symbol);
@@ -198,8 +212,8 @@ void Module_init(Module*module){
 		// __builtin_va_copy(va_list dest, va_list src)
 		symbol= (Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("__builtin_va_copy"),
-			.type=allocAndCopy(sizeof(Type),&(Type){
+			.name=Module_token(module,"__builtin_va_copy"),
+			.type=arena_copy(&module->arena,sizeof(Type),&(Type){
 				.kind=TYPE_KIND_FUNCTION,
 				.function={
 					.args={},
@@ -207,20 +221,27 @@ void Module_init(Module*module){
 				},
 			}),
 		};
-		array_init(&symbol.type->function.args,sizeof(Symbol));
+		array_init_arena(&symbol.type->function.args,sizeof(Symbol),&module->arena);
 		array_append(&symbol.type->function.args,&(Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("dest"),
+			.name=Module_token(module,"dest"),
 			.type=&Type_VA_LIST,
 		});
 		array_append(&symbol.type->function.args,&(Symbol){
 			.kind=SYMBOL_KIND_DECLARATION,
-			.name=Token_fromString("src"),
+			.name=Module_token(module,"src"),
 			.type=&Type_VA_LIST,
 		});
 		Stack_addSymol(&module->stack,&symbol);
 	}
 }
+void Module_free(Module*module){
+	// the arrays of the module stack itself are allocated before its arena is set
+	array_free(&module->stack.symbols);
+	array_free(&module->stack.types);
+	array_free(&module->stack.statements);
+	arena_free(&module->arena);
+}
 enum MODULE_PARSE_RESULT Module_parse(Module* module,struct TokenIter*token_iter_in){
 	struct TokenIter token_iter=*token_iter_in;
 
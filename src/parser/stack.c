@@ -1,8 +1,11 @@
+#include<string.h>
+
 #include<util/util.h>
 #include<parser/stack.h>
 #include<parser/statement.h>
 #include<parser/symbol.h>
 #include<tokenizer.h>
+#include<time_report.h>
 
 void Stack_init(Stack*stack,Stack*parent){
     Stack ret=(Stack){
@@ -10,36 +13,56 @@ void Stack_init(Stack*stack,Stack*parent){
         .parent=parent,
         .types={}, // init below
         .statements={}, // init below
+        .references=parent!=nullptr?parent->references:nullptr,
+        .arena=parent!=nullptr?parent->arena:nullptr,
     };
-    array_init(&ret.symbols,sizeof(Symbol*));
-    array_init(&ret.types,sizeof(Type*));
-    array_init(&ret.statements,sizeof(Statement));
+    array_init_arena(&ret.symbols,sizeof(Symbol*),ret.arena);
+    array_init_arena(&ret.types,sizeof(Type*),ret.arena);
+    array_init_arena(&ret.statements,sizeof(Statement),ret.arena);
 
     *stack=ret;
 }
 void Stack_addSymol(Stack*stack,Symbol*symbol){
     if(symbol==nullptr)fatal("bug");
-    Symbol*sym_copy=COPY_(symbol);
+    Symbol*sym_copy=arena_copy(stack->arena,sizeof(Symbol),symbol);
     array_append(&stack->symbols,&sym_copy);
 }
+// record reference from name to declaration, if references are recorded
+static void Stack_recordReference(Stack*stack,const Token*name,const Token*declaration){
+    if(stack->references==nullptr || name->filename==nullptr || declaration==nullptr || declaration->filename==nullptr){
+        return;
+    }
+    if(strcmp(name->filename,declaration->filename)==0){
+        return;
+    }
+    array_append(stack->references,&(struct StackReference){
+        .reference_file=name->filename,
+        .declaration_file=declaration->filename,
+    });
+}
 Symbol* Stack_findSymbol(Stack*stack,Token*name){
-    for(int i=0;i<stack->symbols.len;i++){
-        Symbol*sym=*(Symbol**)array_get(&stack->symbols,i);
-        if(sym->name==nullptr)continue;
-        if(Token_equalToken(sym->name,name)){
-            return sym;
+    TimeReport_begin("symbol lookup");
+    Symbol*symbol=nullptr;
+    for(Stack*scope=stack;scope!=nullptr && symbol==nullptr;scope=scope->parent){
+        for(int i=0;i<scope->symbols.len;i++){
+            Symbol*sym=*(Symbol**)array_get(&scope->symbols,i);
+            if(sym->name==nullptr)continue;
+            if(Token_equalToken(sym->name,name)){
+                Stack_recordReference(scope,name,sym->name);
+                symbol=sym;
+                break;
+            }
         }
     }
-    if(stack->parent){
-        return Stack_findSymbol(stack->parent,name);
-    }
-    return nullptr;
+    TimeReport_end();
+    return symbol;
 }
 struct Type* Stack_findType(Stack*stack,Token*name){
 	for(int i=0;i<stack->types.len;i++){
 		Type*type=*(Type**)array_get(&stack->types,i);
 
 		if(Token_equalToken(name,type->name)){
+			Stack_recordReference(stack,name,type->name);
 			return type;
 		}
 	}
@@ -64,7 +87,7 @@ void Stack_ingestSymbolType(Stack*stack,Type*type){
             // insert struct type if not already present
             Type*existing_type=Stack_findType(stack,type->name);
             if(existing_type==nullptr && type->union_.name!=nullptr){
-                Type*t_copy=COPY_(type);
+                Type*t_copy=arena_copy(stack->arena,sizeof(Type),type);
                 t_copy->name=type->union_.name;
                 array_append(&stack->types,&t_copy);
             }
@@ -79,7 +102,7 @@ void Stack_ingestSymbolType(Stack*stack,Type*type){
             // insert struct type if not already present
             Type*existing_type=Stack_findType(stack,type->name);
             if(existing_type==nullptr && type->struct_.name!=nullptr){
-                Type*t_copy=COPY_(type);
+                Type*t_copy=arena_copy(stack->arena,sizeof(Type),type);
                 t_copy->name=type->struct_.name;
                 array_append(&stack->types,&t_copy);
             }
@@ -94,7 +117,7 @@ void Stack_ingestSymbolType(Stack*stack,Type*type){
             // insert struct type if not already present
             Type*existing_type=Stack_findType(stack,type->name);
             if(existing_type==nullptr && type->enum_.name!=nullptr){
-                Type*t_copy=COPY_(type);
+                Type*t_copy=arena_copy(stack->arena,sizeof(Type),type);
                 t_copy->name=type->enum_.name;
                 array_append(&stack->types,&t_copy);
             }
@@ -103,8 +126,8 @@ void Stack_ingestSymbolType(Stack*stack,Type*type){
                 struct EnumVariant*field=array_get(&type->enum_.members,i);
                 // add symbol of type int to stack symbols
                 Symbol newsym={
-                    .name=COPY_(field->name),
-                    .type=Stack_findType(stack,Token_fromString("int")),
+                    .name=arena_copy(stack->arena,sizeof(Token),field->name),
+                    .type=Stack_findType(stack,&(Token){.len=3,.p="int"}),
                 };
                 if(newsym.type==nullptr)fatal("bug");
                 Stack_addSymol(stack,&newsym);
@@ -241,7 +264,7 @@ void Stack_ingestStatements(Stack*stack,Statement*statement){
                         .ref=sym->type
                     }
                 };
-                Type*type=COPY_(&t_copy);
+                Type*type=arena_copy(stack->arena,sizeof(t_copy),&t_copy);
                 array_append(&stack->types,&type);
             }
             break;
@@ -313,11 +336,11 @@ void Stack_ingestStatements(Stack*stack,Statement*statement){
 void Stack_addStatement(Stack*stack,Statement*statement){
     Stack_ingestStatements(stack,statement);
 
-    array_append(&stack->statements,COPY_(statement));
+    array_append(&stack->statements,statement);
 }
 
 void Stack_addType(Stack*stack,Type*type){
     if(type->name==nullptr)fatal("bug");
-    Type*t_copy=COPY_(type);
+    Type*t_copy=arena_copy(stack->arena,sizeof(Type),type);
     array_append(&stack->types,&t_copy);
 }
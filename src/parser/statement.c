@@ -2,6 +2,7 @@
 #include<util/util.h>
 #include<tokenizer.h>
 #include<parser/statement.h>
+#include<time_trace.h>
 
 char*Statement_asString(Statement*statement,int depth){
 	char*ret=makeStringn(16000);
@@ -225,7 +226,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 		*out=(Statement){
 			.tag=STATEMENT_KIND_BLOCK,
 			.block={
-				.stack=allocAndCopy(sizeof(Stack),&newStack),
+				.stack=arena_copy(stack->arena,sizeof(Stack),&newStack),
 			}
 		};
 
@@ -259,7 +260,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			TokenIter_lastToken(token_iter,&token);
 			// it is legal to typedef nothing, or a type without a name, i.e. typedef; typedef int; typedef int a; or multiple at once, like typedef int A,*B; are all legal
 			
-			array_init(&out->typedef_.symbols,sizeof(Symbol));
+			array_init_arena(&out->typedef_.symbols,sizeof(Symbol),stack->arena);
 			for(int i=0;i<numTypedefSymbols;i++){
 				array_append(&out->typedef_.symbols,&typedefSymbols[i].symbol);
 			}
@@ -292,7 +293,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 		*out=(Statement){
 			.tag=STATEMENT_KIND_SWITCHCASE,
 			.switchCase={
-				.value=allocAndCopy(sizeof(Value),&caseValue),
+				.value=arena_copy(stack->arena,sizeof(Value),&caseValue),
 			}
 		};
 
@@ -330,8 +331,8 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 		*out=(Statement){
 			.tag=STATEMENT_KIND_IF,
 			.if_={
-				.condition=allocAndCopy(sizeof(Value),&condition),
-				.body=allocAndCopy(sizeof(Statement),&ifBody),
+				.condition=arena_copy(stack->arena,sizeof(Value),&condition),
+				.body=arena_copy(stack->arena,sizeof(Statement),&ifBody),
 				.elseBody=nullptr,
 			}
 		};
@@ -344,7 +345,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			TokenIter_lastToken(token_iter,&token);
 
 			if(res==STATEMENT_PARSE_RESULT_PRESENT){
-				out->if_.elseBody=allocAndCopy(sizeof(Statement),&elseBody);
+				out->if_.elseBody=arena_copy(stack->arena,sizeof(Statement),&elseBody);
 			}
 		}
 
@@ -382,8 +383,8 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 		*out=(Statement){
 			.tag=STATEMENT_KIND_WHILE,
 			.whileLoop={
-				.condition=COPY_(&condition),
-				.body=COPY_(&whileBody),
+				.condition=arena_copy(stack->arena,sizeof(condition),&condition),
+				.body=arena_copy(stack->arena,sizeof(whileBody),&whileBody),
 			}
 		};
 
@@ -434,8 +435,8 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			.tag=STATEMENT_KIND_WHILE,
 			.whileLoop={
 				.doWhile=true,
-				.condition=COPY_(&condition),
-				.body=COPY_(&whileBody)
+				.condition=arena_copy(stack->arena,sizeof(condition),&condition),
+				.body=arena_copy(stack->arena,sizeof(whileBody),&whileBody)
 			}
 		};
 
@@ -461,7 +462,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			out->forLoop.init=nullptr;
 		}else{
 			TokenIter_lastToken(token_iter,&token);
-			out->forLoop.init=allocAndCopy(sizeof(Statement),&init_statement);
+			out->forLoop.init=arena_copy(stack->arena,sizeof(Statement),&init_statement);
 		}
 		// TODO do this better
 		Stack_addStatement(&forStack,&init_statement);
@@ -472,7 +473,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			out->forLoop.condition=nullptr;
 		}else{
 			TokenIter_lastToken(token_iter,&token);
-			out->forLoop.condition=allocAndCopy(sizeof(Value),&condition);
+			out->forLoop.condition=arena_copy(stack->arena,sizeof(Value),&condition);
 		}
 
 		// check for semicolon
@@ -488,7 +489,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 		}else{
 			TokenIter_lastToken(token_iter,&token);
 
-			out->forLoop.step=allocAndCopy(sizeof(Value),&post_expression);
+			out->forLoop.step=arena_copy(stack->arena,sizeof(Value),&post_expression);
 		}
 
 		// check for closing paranthesis
@@ -504,7 +505,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			fatal("invalid statement in if body at line %d col %d %.*s",token.line,token.col,token.len,token.p);
 		}
 
-		out->forLoop.stack=allocAndCopy(sizeof(Stack),&forStack);
+		out->forLoop.stack=arena_copy(stack->arena,sizeof(Stack),&forStack);
 
 		goto STATEMENT_PARSE_RET_SUCCESS;
 	}
@@ -523,7 +524,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			case VALUE_INVALID:
 				break;
 			case VALUE_PRESENT:
-				out->return_.retval=allocAndCopy(sizeof(Value),&returnValue);
+				out->return_.retval=arena_copy(stack->arena,sizeof(Value),&returnValue);
 				break;
 		}
 		if(!Token_equalString(&token,";")){
@@ -583,7 +584,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 					.tag=STATEMENT_KIND_GOTO,
 					.goto_={
 						.variant=VALUE_GOTO_LABEL_VARIANT_LABEL,
-						.label=COPY_(&gotoLabel)
+						.label=arena_copy(stack->arena,sizeof(gotoLabel),&gotoLabel)
 					}
 				};
 				break;
@@ -599,7 +600,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 					.tag=STATEMENT_KIND_GOTO,
 					.goto_={
 						.variant=VALUE_GOTO_LABEL_VARIANT_VALUE,
-						.label=COPY_(&label)
+						.label=arena_copy(stack->arena,sizeof(label),&label)
 					}
 				};
 			}
@@ -637,7 +638,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 		TokenIter_nextToken(token_iter,&token);
 
 		array body;
-		array_init(&body,sizeof(Statement));
+		array_init_arena(&body,sizeof(Statement),stack->arena);
 
 		bool stopParsingSwitchBody=false;
 		while(!stopParsingSwitchBody){
@@ -660,7 +661,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			}
 		}
 
-		out->switch_.condition=allocAndCopy(sizeof(Value),&switchValue);
+		out->switch_.condition=arena_copy(stack->arena,sizeof(Value),&switchValue);
 		out->switch_.body=body;
 
 		goto STATEMENT_PARSE_RET_SUCCESS;
@@ -686,6 +687,8 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 			// add function symbol to stack before parsing the body
 			Stack_addSymol(stack, &symbol);
 
+			TimeTrace_begin("function definition",symbol.name->p,symbol.name->len);
+
 			Statement statement={};
 
 			TokenIter_nextToken(token_iter,&token);
@@ -723,7 +726,9 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 				}
 			}
 
-			statement.functionDef.stack=allocAndCopy(sizeof(Stack),&functionStack);
+			statement.functionDef.stack=arena_copy(stack->arena,sizeof(Stack),&functionStack);
+
+			TimeTrace_end();
 
 			*out=statement;
 			goto STATEMENT_PARSE_RET_SUCCESS;
@@ -736,7 +741,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 				.symbols_defs={},
 			},
 		};
-		array_init(&statement.symbolDef.symbols_defs,sizeof(struct SymbolDefinition));
+		array_init_arena(&statement.symbolDef.symbols_defs,sizeof(struct SymbolDefinition),stack->arena);
 		for(int i=0;i<numSymbols;i++){
 			array_append(&statement.symbolDef.symbols_defs,&symbols[i]);
 		}
@@ -764,7 +769,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 					*out=(Statement){
 						.tag=STATEMENT_KIND_LABEL,
 						.labelDefinition={
-							.label=COPY_(&token)
+							.label=arena_copy(stack->arena,sizeof(token),&token)
 						}
 					};
 					TokenIter_nextToken(token_iter,&token);
@@ -776,7 +781,7 @@ enum STATEMENT_PARSE_RESULT Statement_parse(Stack*stack,Statement*out,struct Tok
 		}
 
 		out->tag=STATEMENT_KIND_VALUE;
-		out->value.value=allocAndCopy(sizeof(Value),&value);
+		out->value.value=arena_copy(stack->arena,sizeof(Value),&value);
 
 		// check for terminating ;
 		if(!Token_equalString(&token,";")){
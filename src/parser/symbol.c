@@ -8,7 +8,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 
 	/* temporary store for return value, i.e. item type is struct SymbolDefinition */
 	array symbol_defs={};
-	array_init(&symbol_defs,sizeof(struct SymbolDefinition));
+	array_init_arena(&symbol_defs,sizeof(struct SymbolDefinition),stack->arena);
 
 	// in preparation for multi-statements, a statement may start with a type, and then be succeeded 
 	// by definitions of multiple symbols, each one with a type derived from the base type
@@ -114,7 +114,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 
 					if(type_is_struct){
 						array structMembers={};
-						array_init(&structMembers,sizeof(Symbol));
+						array_init_arena(&structMembers,sizeof(Symbol),stack->arena);
 
 						// parse struct
 						while(!Token_equalString(&token,"}")){
@@ -138,11 +138,11 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 						TokenIter_nextToken(token_iter,&token);
 
 						base_type.kind=TYPE_KIND_STRUCT;
-						base_type.struct_.name=unnamedTypeDefinition?nullptr:allocAndCopy(sizeof(Token),&nameToken);
+						base_type.struct_.name=unnamedTypeDefinition?nullptr:arena_copy(stack->arena,sizeof(Token),&nameToken);
 						base_type.struct_.members=structMembers;
 					}else if(type_is_union){
 						array unionMembers={};
-						array_init(&unionMembers,sizeof(Symbol));
+						array_init_arena(&unionMembers,sizeof(Symbol),stack->arena);
 
 						// parse union
 						while(!Token_equalString(&token,"}")){
@@ -166,11 +166,11 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 						TokenIter_nextToken(token_iter,&token);
 
 						base_type.kind=TYPE_KIND_UNION;
-						base_type.union_.name=unnamedTypeDefinition?nullptr:allocAndCopy(sizeof(Token),&nameToken);
+						base_type.union_.name=unnamedTypeDefinition?nullptr:arena_copy(stack->arena,sizeof(Token),&nameToken);
 						base_type.union_.members=unionMembers;
 					}else if(type_is_enum){
 						array enumMembers={};
-						array_init(&enumMembers,sizeof(struct EnumVariant));
+						array_init_arena(&enumMembers,sizeof(struct EnumVariant),stack->arena);
 
 						// parse enum
 						while(!Token_equalString(&token,"}")){
@@ -179,7 +179,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 							if(!Token_isValidIdentifier(&token)){
 								fatal("expected identifier at %s",Token_print(&token));
 							}
-							member.name=COPY_(&token);
+							member.name=arena_copy(stack->arena,sizeof(token),&token);
 							TokenIter_nextToken(token_iter,&token);
 							if(Token_equalString(&token,KEYWORD_EQUAL)){
 								TokenIter_nextToken(token_iter,&token);
@@ -189,7 +189,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 									fatal("expected value at %s",Token_print(&token));
 								}
 								TokenIter_lastToken(token_iter,&token);
-								member.value=COPY_(&value);
+								member.value=arena_copy(stack->arena,sizeof(value),&value);
 							}
 
 							array_append(&enumMembers,&member);
@@ -206,7 +206,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 						TokenIter_nextToken(token_iter,&token);
 
 						base_type.kind=TYPE_KIND_ENUM;
-						base_type.enum_.name=unnamedTypeDefinition?nullptr:COPY_(&nameToken);
+						base_type.enum_.name=unnamedTypeDefinition?nullptr:arena_copy(stack->arena,sizeof(nameToken),&nameToken);
 						base_type.enum_.members=enumMembers;
 					}
 					else fatal("");
@@ -218,13 +218,13 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 
 				if(type_is_struct){
 					base_type.kind=TYPE_KIND_STRUCT;
-					base_type.struct_.name=COPY_(&nameToken);
+					base_type.struct_.name=arena_copy(stack->arena,sizeof(nameToken),&nameToken);
 				}else if(type_is_enum){
 					base_type.kind=TYPE_KIND_ENUM;
-					base_type.enum_.name=COPY_(&nameToken);
+					base_type.enum_.name=arena_copy(stack->arena,sizeof(nameToken),&nameToken);
 				}else if(type_is_union){
 					base_type.kind=TYPE_KIND_UNION;
-					base_type.union_.name=COPY_(&nameToken);
+					base_type.union_.name=arena_copy(stack->arena,sizeof(nameToken),&nameToken);
 				}else fatal("bug");
 
 				// search stack for type with name
@@ -252,7 +252,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 					}
 
 					if(base_type.name!=nullptr){
-						Stack_addType(stack,COPY_(&base_type));
+						Stack_addType(stack,&base_type);
 					}
 				}else{
 					base_type=*type;
@@ -308,7 +308,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 
 			if(Token_isValidIdentifier(&token) /* [implicit] && base_type.kind!=TYPE_KIND_UNKNOWN */){
 				if(symbol_def->symbol.name==nullptr){
-					symbol_def->symbol.name=allocAndCopy(sizeof(Token),&token);
+					symbol_def->symbol.name=arena_copy(stack->arena,sizeof(Token),&token);
 					TokenIter_nextToken(token_iter,&token);
 				}else{
 					goto SYMBOL_PARSE_RET_FAILURE;
@@ -321,10 +321,10 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 			if(base_type.kind!=TYPE_KIND_UNKNOWN && Token_equalString(&token,"*")){
 				TokenIter_nextToken(token_iter,&token);
 
-				current_type=allocAndCopy(sizeof(Type),&(Type){
+				current_type=arena_copy(stack->arena,sizeof(Type),&(Type){
 					.kind=TYPE_KIND_POINTER,
 					.pointer={
-						.base=allocAndCopy(sizeof(Type),current_type),
+						.base=arena_copy(stack->arena,sizeof(Type),current_type),
 					},
 				});
 
@@ -343,7 +343,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 
 					if(Token_isValidIdentifier(&token)){
 						if(symbol_def->symbol.name==nullptr){
-							symbol_def->symbol.name=allocAndCopy(sizeof(Token),&token);
+							symbol_def->symbol.name=arena_copy(stack->arena,sizeof(Token),&token);
 							TokenIter_nextToken(token_iter,&token);
 						}else{
 							goto SYMBOL_PARSE_RET_FAILURE;
@@ -365,7 +365,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 				
 				// 2) parse function arguments
 				array args;
-				array_init(&args,sizeof(Symbol));
+				array_init_arena(&args,sizeof(Symbol),stack->arena);
 				bool arg_list_should_end=false;
 				while(1){
 					if(Token_equalString(&token,")")){
@@ -388,7 +388,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 							TokenIter_nextToken(token_iter,&token);
 							Symbol vararg_argument=(Symbol){
 								.kind=SYMBOL_KIND_VARARG,
-								.type=Stack_findType(stack, Token_fromString("__builtin_va_list")),
+								.type=Stack_findType(stack,&(Token){.len=17,.p="__builtin_va_list"}),
 							};
 							array_append(&args,&vararg_argument);
 
@@ -403,19 +403,19 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 					}
 				}
 
-				current_type=allocAndCopy(sizeof(Type),&(Type){
+				current_type=arena_copy(stack->arena,sizeof(Type),&(Type){
 					.kind=TYPE_KIND_FUNCTION,
 					.function={
-						.ret=allocAndCopy(sizeof(Type), current_type),
+						.ret=arena_copy(stack->arena,sizeof(Type), current_type),
 						.args=args,
 					},
 				});
 
 				if(is_function_pointer){
-					current_type=allocAndCopy(sizeof(Type),&(Type){
+					current_type=arena_copy(stack->arena,sizeof(Type),&(Type){
 						.kind=TYPE_KIND_POINTER,
 						.pointer={
-							.base=allocAndCopy(sizeof(Type),current_type),
+							.base=arena_copy(stack->arena,sizeof(Type),current_type),
 						},
 					});
 				}
@@ -440,7 +440,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 				// otherwise, value with some size (may be static or runtime determined)
 				Value*arrayLen=nullptr;
 				if(res==VALUE_PRESENT){
-					arrayLen=allocAndCopy(sizeof(Value),&array_len);
+					arrayLen=arena_copy(stack->arena,sizeof(Value),&array_len);
 					TokenIter_lastToken(token_iter,&token);
 				}else{
 					if(typeLenIsStatic){
@@ -448,10 +448,10 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 					}
 				}
 
-				current_type=allocAndCopy(sizeof(Type),&(Type){
+				current_type=arena_copy(stack->arena,sizeof(Type),&(Type){
 					.kind=TYPE_KIND_ARRAY,
 					.array={
-						.base=allocAndCopy(sizeof(Type),current_type),
+						.base=arena_copy(stack->arena,sizeof(Type),current_type),
 						.len=arrayLen,
 						.is_static=typeLenIsStatic,
 					},
@@ -482,7 +482,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 						fatal("invalid value after assignment operator at %s",Token_print(&token));
 						break;
 					case VALUE_PRESENT:
-						symbol_def->initializer=allocAndCopy(sizeof(Value),&value);
+						symbol_def->initializer=arena_copy(stack->arena,sizeof(Value),&value);
 						break;
 				}
 			}
@@ -495,7 +495,7 @@ enum SYMBOL_PARSE_RESULT SymbolDefinition_parse(Stack*stack,int*num_symbol_defs,
 		}
 
 		// append symbol to output
-		symbol_def->symbol.type=allocAndCopy(sizeof(Type), current_type);
+		symbol_def->symbol.type=arena_copy(stack->arena,sizeof(Type), current_type);
 
 		array_append(&symbol_defs,symbol_def);
 
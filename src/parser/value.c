@@ -26,7 +26,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 							TokenIter_nextToken(token_iter,&token);
 
 							value->kind=VALUE_KIND_STATIC_VALUE;
-							value->static_value.value_repr=allocAndCopy(sizeof(Token),&literalValueToken);
+							value->static_value.value_repr=arena_copy(stack->arena,sizeof(Token),&literalValueToken);
 							break;
 						}
 						case TOKEN_LITERAL_NUMERIC_TAG_INTEGER:
@@ -35,7 +35,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 							TokenIter_nextToken(token_iter,&token);
 
 							value->kind=VALUE_KIND_STATIC_VALUE;
-							value->static_value.value_repr=allocAndCopy(sizeof(Token),&literalValueToken);
+							value->static_value.value_repr=arena_copy(stack->arena,sizeof(Token),&literalValueToken);
 							break;
 						}
 						case TOKEN_LITERAL_NUMERIC_TAG_FLOAT:{
@@ -46,7 +46,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 							println("float literal %.*s at line %d col %d",token.len,token.p,token.line,token.col);
 
 							value->kind=VALUE_KIND_STATIC_VALUE;
-							value->static_value.value_repr=allocAndCopy(sizeof(Token),&literalValueToken);
+							value->static_value.value_repr=arena_copy(stack->arena,sizeof(Token),&literalValueToken);
 
 							break;
 						}
@@ -59,7 +59,16 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 					TokenIter_nextToken(token_iter,&token);
 
 					value->kind=VALUE_KIND_STATIC_VALUE;
-					value->static_value.value_repr=allocAndCopy(sizeof(Token),&literalValueToken);
+					value->static_value.value_repr=arena_copy(stack->arena,sizeof(Token),&literalValueToken);
+					break;
+				}
+				case TOKEN_LITERAL_TAG_EMBED:{
+					// bytes embedded into an initializer, which stand for one element per byte
+					Token literalValueToken=token;
+					TokenIter_nextToken(token_iter,&token);
+
+					value->kind=VALUE_KIND_STATIC_VALUE;
+					value->static_value.value_repr=arena_copy(stack->arena,sizeof(Token),&literalValueToken);
 					break;
 				}
 				default:fatal("bug");
@@ -100,7 +109,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_OPERATOR,
 					.op={
-						.left=allocAndCopy(sizeof(Value),&dereferencedValue),
+						.left=arena_copy(stack->arena,sizeof(Value),&dereferencedValue),
 						.op=VALUE_OPERATOR_DEREFERENCE,
 					}
 				};
@@ -118,7 +127,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_ADDRESS_OF,
 					.addrOf={
-						.addressedValue=allocAndCopy(sizeof(Value), &addressedValue)
+						.addressedValue=arena_copy(stack->arena,sizeof(Value), &addressedValue)
 					},
 				};
 
@@ -179,7 +188,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 									.kind=VALUE_KIND_CAST,
 									.cast={
 										.castTo=castTypeSymbol.type,
-										.value=COPY_(&castValue),
+										.value=arena_copy(stack->arena,sizeof(castValue),&castValue),
 									}
 								};
 								foundValue=true;
@@ -227,7 +236,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 						.kind=VALUE_KIND_CAST,
 						.cast={
 							.castTo=innerValue.typeref.type,
-							.value=COPY_(&castValue),
+							.value=arena_copy(stack->arena,sizeof(castValue),&castValue),
 						}
 					};
 					break;
@@ -236,7 +245,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_PARENS_WRAPPED,
 					.parens_wrapped={
-						.innerValue=allocAndCopy(sizeof(Value),&innerValue),
+						.innerValue=arena_copy(stack->arena,sizeof(Value),&innerValue),
 					}
 				};
 
@@ -246,14 +255,14 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				TokenIter_nextToken(token_iter, &token);
 
 				array fields;
-				array_init(&fields,sizeof(struct FieldInitializer));
+				array_init_arena(&fields,sizeof(struct FieldInitializer),stack->arena);
 				while(!TokenIter_isEmpty(token_iter)){
 					if (Token_equalString(&token, KEYWORD_CURLY_BRACES_CLOSE)){
 						break;
 					}
 
 					struct FieldInitializer field={};
-					array_init(&field.fieldNameSegments,sizeof(struct FieldInitializerSegment));
+					array_init_arena(&field.fieldNameSegments,sizeof(struct FieldInitializerSegment),stack->arena);
 
 					// if next token is dot, parse field name followed by assignment symbol
 					while(1){
@@ -262,7 +271,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 							
 							struct FieldInitializerSegment newSegment={
 								.kind=FIELD_INITIALIZER_SEGMENT_FIELD,
-								.field=allocAndCopy(sizeof(Token),&token),
+								.field=arena_copy(stack->arena,sizeof(Token),&token),
 							};
 							array_append(&field.fieldNameSegments,&newSegment);
 							TokenIter_nextToken(token_iter,&token);
@@ -274,7 +283,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 							}
 							struct FieldInitializerSegment newSegment={
 								.kind=FIELD_INITIALIZER_SEGMENT_INDEX,
-								.index=allocAndCopy(sizeof(Token),&token),
+								.index=arena_copy(stack->arena,sizeof(Token),&token),
 							};
 							array_append(&field.fieldNameSegments,&newSegment);
 							TokenIter_nextToken(token_iter,&token);
@@ -299,7 +308,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 					if(res==VALUE_INVALID){
 						fatal("invalid value in struct initializer");
 					}
-					field.value=allocAndCopy(sizeof(Value),&fieldValue);
+					field.value=arena_copy(stack->arena,sizeof(Value),&fieldValue);
 
 					array_append(&fields,&field);
 
@@ -337,7 +346,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_OPERATOR,
 					.op={
-						.left=allocAndCopy(sizeof(Value),&innerValue),
+						.left=arena_copy(stack->arena,sizeof(Value),&innerValue),
 						.op=VALUE_OPERATOR_LOGICAL_NOT,
 					}
 				};
@@ -355,7 +364,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_OPERATOR,
 					.op={
-						.left=allocAndCopy(sizeof(Value),&innerValue),
+						.left=arena_copy(stack->arena,sizeof(Value),&innerValue),
 						.op=VALUE_OPERATOR_UNARY_PLUS,
 					}
 				};
@@ -373,7 +382,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_OPERATOR,
 					.op={
-						.left=allocAndCopy(sizeof(Value),&innerValue),
+						.left=arena_copy(stack->arena,sizeof(Value),&innerValue),
 						.op=VALUE_OPERATOR_UNARY_MINUS,
 					}
 				};
@@ -391,7 +400,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_OPERATOR,
 					.op={
-						.left=allocAndCopy(sizeof(Value),&innerValue),
+						.left=arena_copy(stack->arena,sizeof(Value),&innerValue),
 						.op=VALUE_OPERATOR_BITWISE_NOT,
 					}
 				};
@@ -409,7 +418,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_OPERATOR,
 					.op={
-						.left=allocAndCopy(sizeof(Value),&innerValue),
+						.left=arena_copy(stack->arena,sizeof(Value),&innerValue),
 						.op=VALUE_OPERATOR_PREFIX_INCREMENT,
 					}
 				};
@@ -427,7 +436,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_OPERATOR,
 					.op={
-						.left=allocAndCopy(sizeof(Value),&innerValue),
+						.left=arena_copy(stack->arena,sizeof(Value),&innerValue),
 						.op=VALUE_OPERATOR_PREFIX_DECREMENT,
 					}
 				};
@@ -626,9 +635,9 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_CONDITIONAL,
 					.conditional={
-						.condition=allocAndCopy(sizeof(Value),value),
-						.onTrue=allocAndCopy(sizeof(Value),&trueValue),
-						.onFalse=allocAndCopy(sizeof(Value),&falseValue),
+						.condition=arena_copy(stack->arena,sizeof(Value),value),
+						.onTrue=arena_copy(stack->arena,sizeof(Value),&trueValue),
+						.onFalse=arena_copy(stack->arena,sizeof(Value),&falseValue),
 					}
 				};
 
@@ -642,8 +651,8 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_DOT,
 					.dot={
-						.left=allocAndCopy(sizeof(Value),value),
-						.right=allocAndCopy(sizeof(Token),&memberToken),
+						.left=arena_copy(stack->arena,sizeof(Value),value),
+						.right=arena_copy(stack->arena,sizeof(Token),&memberToken),
 					}
 				};
 				continue;
@@ -656,8 +665,8 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				*value=(Value){
 					.kind=VALUE_KIND_ARROW,
 					.arrow={
-						.left=allocAndCopy(sizeof(Value),value),
-						.right=allocAndCopy(sizeof(Token),&memberToken),
+						.left=arena_copy(stack->arena,sizeof(Value),value),
+						.right=arena_copy(stack->arena,sizeof(Token),&memberToken),
 					}
 				};
 				continue;
@@ -665,7 +674,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 			case VALUE_OPERATOR_CALL:{
 				// parse arguments
 				array values;
-				array_init(&values,sizeof(Value));
+				array_init_arena(&values,sizeof(Value),stack->arena);
 				while(1){
 					if(Token_equalString(&token,")")){
 						TokenIter_nextToken(token_iter,&token);
@@ -714,7 +723,7 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 					}
 				}
 
-				Value*function=allocAndCopy(sizeof(Value),value);
+				Value*function=arena_copy(stack->arena,sizeof(Value),value);
 
 				value->kind=VALUE_KIND_FUNCTION_CALL;
 				value->function_call.function=function;
@@ -726,13 +735,13 @@ enum VALUE_PARSE_RESULT Value_parse(Stack*stack,Value*value,struct TokenIter*tok
 				Value ret={
 					.kind=VALUE_KIND_OPERATOR,
 					.op={
-						.left=allocAndCopy(sizeof(Value),value),
+						.left=arena_copy(stack->arena,sizeof(Value),value),
 						.op=op,
 					}
 				};
 
 				if(requiresSecondOperand){
-					ret.op.right=malloc(sizeof(Value));
+					ret.op.right=arena_alloc(stack->arena,sizeof(Value));
 
 					enum VALUE_PARSE_RESULT res=Value_parse(stack,ret.op.right,token_iter);
 					switch(res){
@@ -801,6 +810,10 @@ Type*Value_getType(Value*value){
 						case TOKEN_LITERAL_TAG_STRING:{
 							return &Type_STRING;
 						}
+						case TOKEN_LITERAL_TAG_EMBED:{
+							// type of each embedded element
+							return &Type_INT;
+						}
 						default:fatal("unreachable");
 					}
 				}
@@ -1005,7 +1018,12 @@ char*Value_asString(Value*value){
 	char*ret=makeString();
 	switch(value->kind){
 		case VALUE_KIND_STATIC_VALUE:{
-			stringAppend(ret,"%.*s",value->static_value.value_repr->len,value->static_value.value_repr->p);
+			const Token*value_repr=value->static_value.value_repr;
+			if(value_repr->tag==TOKEN_TAG_LITERAL && value_repr->literal.tag==TOKEN_LITERAL_TAG_EMBED){
+				stringAppend(ret,"embed %.*s (%lld bytes)",value_repr->len,value_repr->p,(long long)value_repr->literal.embed.len);
+				break;
+			}
+			stringAppend(ret,"%.*s",value_repr->len,value_repr->p);
 			break;
 		}
 		case VALUE_KIND_OPERATOR:{
@@ -0,0 +1,238 @@
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include<util/util.h>
+#include<util/array.h>
+#include<util/ring.h>
+
+#include<string_literals.h>
+#include<embed.h>
+#include<pipeline.h>
+
+/* number of tokens the queue between preprocessor and parser holds */
+#define PIPELINE_QUEUE_TOKENS 8192
+/* number of tokens the parser thread takes from the queue at once */
+#define PIPELINE_BATCH_TOKENS 512
+/* length of runs of tokens the preprocessor expands at once (see Preprocessor.max_run_tokens) */
+#define PIPELINE_MAX_RUN_TOKENS 1024
+
+struct Pipeline{
+	/* preprocessed tokens, from the preprocessor to the parser thread */
+	ring tokens;
+	/* set when preprocessing failed, the parser thread then only drains the queue */
+	atomic_bool cancelled;
+
+	Module*module;
+	const char*token_src;
+	arena*string_literals;
+	arena*embedded_bytes;
+
+	/* tokens of the current top-level declaration (without comments), element type is Token */
+	array declaration;
+	/* the declaration is complete, and is parsed once the first token after it is known (see Pipeline_parseDeclaration) */
+	bool complete;
+	/* nesting of parentheses, brackets and braces in the current declaration */
+	int depth;
+	/* an initializer started at depth 0, i.e. braces do not enclose a function body */
+	bool in_initializer;
+	/* the brace at depth 0 that is open encloses a function body */
+	bool in_function_body;
+	/* punctuator of the previous token of the current declaration that is not a comment (see Pipeline_punctuator) */
+	char previous_punctuator;
+
+	/* error of the parser thread */
+	struct FatalHandler handler;
+	bool failed;
+};
+
+/*
+parse the tokens of the current declaration into the module, and start the next one with next_token (if not nullptr)
+
+the parser looks at the token after a statement before it returns, so the first token of the next declaration is
+passed along (but not parsed), like when all tokens are parsed at once
+*/
+static void Pipeline_parseDeclaration(struct Pipeline*pipeline,const Token*next_token){
+	if(next_token!=nullptr){
+		array_append(&pipeline->declaration,next_token);
+	}
+
+	Tokenizer tokenizer={
+		.token_src=pipeline->token_src,
+		.tokens=pipeline->declaration.data,
+		.num_tokens=pipeline->declaration.len,
+	};
+	StringLiterals_concatenate(&tokenizer,pipeline->string_literals);
+	Embed_expandOutsideInitializers(&tokenizer,pipeline->embedded_bytes);
+
+	struct TokenIter token_iter;
+	TokenIter_init(&token_iter,&tokenizer,(struct TokenIterConfig){.skip_comments=true,});
+	Module_parse(pipeline->module,&token_iter);
+	if(!TokenIter_isEmpty(&token_iter)){
+		Token last_token;
+		TokenIter_lastToken(&token_iter,&last_token);
+		fatal("unexpected tokens at end of file at line %d col %d: %.*s",last_token.line,last_token.col,last_token.len,last_token.p);
+	}
+
+	pipeline->declaration.len=0;
+	if(next_token!=nullptr){
+		array_append(&pipeline->declaration,next_token);
+	}
+	pipeline->complete=false;
+	pipeline->depth=0;
+	pipeline->in_initializer=false;
+	pipeline->in_function_body=false;
+	pipeline->previous_punctuator=0;
+}
+/* returns the punctuator token is, 0 if it is none of those the declaration boundaries depend on */
+static char Pipeline_punctuator(const Token*token){
+	if(token->tag==TOKEN_TAG_COMMENT || token->tag==TOKEN_TAG_LITERAL || token->len!=1){
+		return 0;
+	}
+	switch(token->p[0]){
+		case '(': case ')': case '[': case ']': case '{': case '}': case '=': case ';':
+			return token->p[0];
+		default:
+			return 0;
+	}
+}
+/* append token to the current declaration, a complete declaration is parsed first (the token then starts the next one) */
+static void Pipeline_addToken(struct Pipeline*pipeline,const Token*token){
+	if(token->tag==TOKEN_TAG_COMMENT){
+		return;
+	}
+	if(pipeline->complete){
+		Pipeline_parseDeclaration(pipeline,token);
+	}else{
+		array_append(&pipeline->declaration,token);
+	}
+
+	char punctuator=Pipeline_punctuator(token);
+	char previous_punctuator=pipeline->previous_punctuator;
+	pipeline->previous_punctuator=punctuator;
+
+	switch(punctuator){
+		case '{':
+			// a function body directly follows the parameter list (or attributes, which end in a parenthesis as well)
+			if(pipeline->depth==0){
+				pipeline->in_function_body=!pipeline->in_initializer && previous_punctuator==')';
+			}
+			pipeline->depth++;
+			break;
+		case '(':
+		case '[':
+			pipeline->depth++;
+			break;
+		case '}':
+			pipeline->depth--;
+			pipeline->complete=pipeline->depth==0 && pipeline->in_function_body;
+			break;
+		case ')':
+		case ']':
+			pipeline->depth--;
+			break;
+		case '=':
+			if(pipeline->depth==0){
+				pipeline->in_initializer=true;
+			}
+			break;
+		case ';':
+			pipeline->complete=pipeline->depth==0;
+			break;
+	}
+}
+
+static void* Pipeline_parser(void*arg){
+	struct Pipeline*pipeline=arg;
+	Token tokens[PIPELINE_BATCH_TOKENS];
+
+	if(setjmp(pipeline->handler.jump)==0){
+		fatal_setHandler(&pipeline->handler);
+
+		int num_tokens;
+		while((num_tokens=ring_pop(&pipeline->tokens,tokens,PIPELINE_BATCH_TOKENS))>0){
+			if(atomic_load(&pipeline->cancelled)){
+				continue;
+			}
+			for(int i=0;i<num_tokens;i++){
+				Pipeline_addToken(pipeline,&tokens[i]);
+			}
+		}
+		// tokens after the last complete declaration
+		if(!atomic_load(&pipeline->cancelled) && pipeline->declaration.len>0){
+			Pipeline_parseDeclaration(pipeline,nullptr);
+		}
+	}else{
+		pipeline->failed=true;
+		// the preprocessor waits for space in the queue until it is done
+		while(ring_pop(&pipeline->tokens,tokens,PIPELINE_BATCH_TOKENS)>0){}
+	}
+	fatal_setHandler(nullptr);
+
+	return nullptr;
+}
+/* pass the output of the preprocessor so far on to the parser thread */
+static void Pipeline_pushOutput(struct Pipeline*pipeline,struct Preprocessor*preprocessor){
+	ring_push(&pipeline->tokens,preprocessor->tokens_out.data,preprocessor->tokens_out.len);
+	preprocessor->tokens_out.len=0;
+}
+
+void Pipeline_run(
+	struct Preprocessor*preprocessor,
+	struct TokenIter*token_iter,
+	Module*module,
+	const char*token_src,
+	arena*string_literals,
+	arena*embedded_bytes
+){
+	struct Pipeline pipeline={
+		.module=module,
+		.token_src=token_src,
+		.string_literals=string_literals,
+		.embedded_bytes=embedded_bytes,
+	};
+	ring_init(&pipeline.tokens,sizeof(Token),PIPELINE_QUEUE_TOKENS);
+	atomic_init(&pipeline.cancelled,false);
+	array_init(&pipeline.declaration,sizeof(Token));
+
+	pthread_t parser_thread;
+	if(pthread_create(&parser_thread,nullptr,Pipeline_parser,&pipeline)!=0){
+		fatal("could not start parser thread");
+	}
+
+	// errors of the preprocessor are reported once the parser thread is done, which then skips the remaining tokens
+	struct FatalHandler handler;
+	if(setjmp(handler.jump)==0){
+		fatal_setHandler(&handler);
+
+		// e.g. output of a precompiled header
+		Pipeline_pushOutput(&pipeline,preprocessor);
+
+		// the parser would otherwise wait for all of a file without directives
+		preprocessor->max_run_tokens=PIPELINE_MAX_RUN_TOKENS;
+
+		Preprocessor_pushFile(preprocessor,token_iter);
+		bool more_output=true;
+		while(more_output){
+			more_output=Preprocessor_step(preprocessor);
+			Pipeline_pushOutput(&pipeline,preprocessor);
+		}
+		fatal_setHandler(nullptr);
+	}else{
+		fatal_setHandler(nullptr);
+
+		atomic_store(&pipeline.cancelled,true);
+		ring_close(&pipeline.tokens);
+		pthread_join(parser_thread,nullptr);
+		fatal_report(handler.file,handler.line,"%s",handler.message);
+	}
+
+	ring_close(&pipeline.tokens);
+	pthread_join(parser_thread,nullptr);
+
+	ring_free(&pipeline.tokens);
+	array_free(&pipeline.declaration);
+
+	if(pipeline.failed){
+		fatal_report(pipeline.handler.file,pipeline.handler.line,"%s",pipeline.handler.message);
+	}
+}
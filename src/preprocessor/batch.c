@@ -0,0 +1,292 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include<util/util.h>
+#include<file.h>
+#include<string_literals.h>
+#include<embed.h>
+#include<parser/module.h>
+
+#include<preprocessor/batch.h>
+#include<preprocessor/preprocessor.h>
+#include<preprocessor/header_cache.h>
+#include<preprocessor/target.h>
+
+/* files that are shared by the worker threads */
+struct PreprocessorBatch{
+	const struct PreprocessorBatchConfig*config;
+	array*files;
+	/* indices into files, in the order the files are started */
+	int*order;
+	/* index into order of the next file that has not been taken by any worker */
+	atomic_int next_file;
+};
+
+/* current time in nanoseconds (standard C, so that no posix feature macros are required) */
+static int64_t PreprocessorBatch_now(void){
+	struct timespec now;
+	discard timespec_get(&now,TIME_UTC);
+	return (int64_t)now.tv_sec*1000000000+now.tv_nsec;
+}
+
+void PreprocessorBatch_readFileList(const char*path,array*paths){
+	File file;
+	File_read(path,&file);
+
+	const char*line=file.contents;
+	const char*contents_end=file.contents+file.contents_len;
+	while(line<contents_end){
+		const char*line_end=memchr(line,'\n',(size_t)(contents_end-line));
+		if(line_end==nullptr){
+			line_end=contents_end;
+		}
+
+		// trim whitespace (including \r of crlf line endings)
+		const char*path_start=line;
+		const char*path_end=line_end;
+		while(path_start<path_end && (*path_start==' ' || *path_start=='\t')){
+			path_start++;
+		}
+		while(path_end>path_start && (path_end[-1]==' ' || path_end[-1]=='\t' || path_end[-1]=='\r')){
+			path_end--;
+		}
+
+		if(path_end>path_start && *path_start!='#'){
+			int path_len=(int)(path_end-path_start);
+			char*listed_path=calloc((size_t)path_len+1,1);
+			memcpy(listed_path,path_start,(size_t)path_len);
+			array_append(paths,&listed_path);
+		}
+
+		line=line_end+1;
+	}
+
+	free((char*)file.contents);
+}
+
+/* join string literals of the preprocessed tokens and parse them into module (fatal on syntax errors) */
+static void PreprocessorBatch_parse(struct Preprocessor*preprocessor,Module*module,const char*path){
+	Tokenizer tokenizer={
+		.token_src=path,
+		.tokens=preprocessor->tokens_out.data,
+		.num_tokens=preprocessor->tokens_out.len,
+	};
+	// the spellings of joined literals live as long as the preprocessor
+	StringLiterals_concatenate(&tokenizer,&preprocessor->arena);
+	Embed_expandOutsideInitializers(&tokenizer,&preprocessor->arena);
+
+	struct TokenIter token_iter;
+	TokenIter_init(&token_iter,&tokenizer,(struct TokenIterConfig){.skip_comments=true,});
+	Module_parse(module,&token_iter);
+	if(!TokenIter_isEmpty(&token_iter)){
+		Token next_token;
+		TokenIter_lastToken(&token_iter,&next_token);
+		fatal("unexpected tokens at end of file at line %d col %d: %.*s",next_token.line,next_token.col,next_token.len,next_token.p);
+	}
+}
+/* preprocess a single file, fatal errors only fail the file */
+static void PreprocessorBatch_processFile(const struct PreprocessorBatchConfig*batch_config,struct PreprocessorBatchFile*file){
+	int64_t start_ns=PreprocessorBatch_now();
+
+	// not modified after setjmp, so that they are still valid after a fatal error (the module is only used to parse)
+	struct Preprocessor*preprocessor=calloc(1,sizeof(struct Preprocessor));
+	Preprocessor_init(preprocessor);
+	Module*module=calloc(1,sizeof(Module));
+	Module_init(module);
+
+	struct FatalHandler handler;
+	if(setjmp(handler.jump)==0){
+		fatal_setHandler(&handler);
+
+		// only looked up after setjmp, which could otherwise clobber it
+		const struct PreprocessorBatchConfig*config=file->config!=nullptr?file->config:batch_config;
+		preprocessor->max_include_depth=config->max_include_depth;
+		for(int i=0;i<config->include_paths->len;i++){
+			array_append(&preprocessor->include_paths,array_get(config->include_paths,i));
+		}
+		for(int i=0;i<config->system_include_paths->len;i++){
+			array_append(&preprocessor->system_include_paths,array_get(config->system_include_paths,i));
+		}
+
+		// a profile file is loaded for every file, which only maps it
+		if(config->target_profile_path!=nullptr){
+			PreprocessorTarget_loadProfile(preprocessor,config->target_profile_path);
+		}
+		if(config->target!=nullptr){
+			PreprocessorTarget_apply(preprocessor,config->target);
+		}
+		PreprocessorTargetMacros_apply(preprocessor,config->defines);
+		if(config->macros!=nullptr){
+			PreprocessorTarget_apply(preprocessor,config->macros);
+		}
+		for(int i=0;i<config->undefines->len;i++){
+			const char*undefine_name=*(const char**)array_get(config->undefines,i);
+			Preprocessor_removeDefine(preprocessor,&(Token){.tag=TOKEN_TAG_SYMBOL,.p=undefine_name,.len=(int)strlen(undefine_name)});
+		}
+
+		// input files are tokenized once, like headers (header sanity checks often preprocess each header on its own)
+		struct TokenIter token_iter;
+		TokenIter_init(&token_iter,HeaderCache_get(file->path),(struct TokenIterConfig){.skip_comments=true,});
+		Preprocessor_consume(preprocessor,&token_iter);
+		file->num_tokens=preprocessor->tokens_out.len;
+
+		if(config->parse){
+			PreprocessorBatch_parse(preprocessor,module,file->path);
+		}
+
+		file->succeeded=true;
+	}else{
+		file->succeeded=false;
+		file->error=allocAndCopy(strlen(handler.message)+1,handler.message);
+	}
+	fatal_setHandler(nullptr);
+
+	Preprocessor_free(preprocessor);
+	free(preprocessor);
+	Module_free(module);
+	free(module);
+
+	file->duration_ns=PreprocessorBatch_now()-start_ns;
+}
+static void* PreprocessorBatch_worker(void*arg){
+	struct PreprocessorBatch*batch=arg;
+	while(true){
+		int order_index=atomic_fetch_add(&batch->next_file,1);
+		if(order_index>=batch->files->len){
+			break;
+		}
+		PreprocessorBatch_processFile(batch->config,array_get(batch->files,batch->order[order_index]));
+	}
+	return nullptr;
+}
+
+/* file index and the size of the file, to sort files by size */
+struct PreprocessorBatchFileSize{
+	int index;
+	int64_t size;
+};
+static int PreprocessorBatchFileSize_compare(const void*a,const void*b){
+	const struct PreprocessorBatchFileSize*file_a=a;
+	const struct PreprocessorBatchFileSize*file_b=b;
+	// largest first, files of the same size in their original order
+	if(file_a->size!=file_b->size){
+		return file_a->size<file_b->size?1:-1;
+	}
+	return file_a->index-file_b->index;
+}
+/*
+order in which the files are started, largest file first (the size of the preprocessed file is only known afterwards,
+so the size of the file itself stands in for it). files that cannot be stat'ed go last, they fail right away
+*/
+static int* PreprocessorBatch_scheduleFiles(array*files){
+	struct PreprocessorBatchFileSize*sizes=calloc((size_t)files->len,sizeof(struct PreprocessorBatchFileSize));
+	for(int i=0;i<files->len;i++){
+		const struct PreprocessorBatchFile*file=array_get(files,i);
+		struct stat file_stat;
+		sizes[i]=(struct PreprocessorBatchFileSize){
+			.index=i,
+			.size=stat(file->path,&file_stat)==0?(int64_t)file_stat.st_size:-1,
+		};
+	}
+	qsort(sizes,(size_t)files->len,sizeof(struct PreprocessorBatchFileSize),PreprocessorBatchFileSize_compare);
+
+	int*order=calloc((size_t)files->len,sizeof(int));
+	for(int i=0;i<files->len;i++){
+		order[i]=sizes[i].index;
+	}
+	free(sizes);
+	return order;
+}
+
+int PreprocessorBatch_run(const struct PreprocessorBatchConfig*config,array*files,int64_t*duration_ns){
+	int64_t start_ns=PreprocessorBatch_now();
+
+	struct PreprocessorBatch batch={
+		.config=config,
+		.files=files,
+		.order=PreprocessorBatch_scheduleFiles(files),
+	};
+	atomic_init(&batch.next_file,0);
+
+	int num_threads=config->num_threads;
+	if(num_threads>files->len){
+		num_threads=files->len;
+	}
+	if(num_threads<1){
+		num_threads=1;
+	}
+
+	// the calling thread is one of the workers
+	pthread_t*threads=calloc((size_t)num_threads,sizeof(pthread_t));
+	for(int i=1;i<num_threads;i++){
+		if(pthread_create(&threads[i],nullptr,PreprocessorBatch_worker,&batch)!=0){
+			fatal("could not start batch worker thread");
+		}
+	}
+	discard PreprocessorBatch_worker(&batch);
+	for(int i=1;i<num_threads;i++){
+		pthread_join(threads[i],nullptr);
+	}
+	free(threads);
+	free(batch.order);
+	*duration_ns=PreprocessorBatch_now()-start_ns;
+
+	int num_failed=0;
+	for(int i=0;i<files->len;i++){
+		const struct PreprocessorBatchFile*file=array_get(files,i);
+		if(!file->succeeded){
+			num_failed++;
+		}
+	}
+	return num_failed;
+}
+
+void PreprocessorBatch_writeReport(array*files,int num_threads,int64_t duration_ns,writer*out){
+	char line[128];
+
+	int num_failed=0;
+	int64_t num_tokens=0;
+	writer_write_str(out,"  status     tokens         ms  path\n");
+	for(int i=0;i<files->len;i++){
+		const struct PreprocessorBatchFile*file=array_get(files,i);
+		if(!file->succeeded){
+			num_failed++;
+		}
+		num_tokens+=file->num_tokens;
+
+		discard snprintf(line,sizeof(line),"%8s %10lld %10.3f  ",
+			file->succeeded?"ok":"FAILED",
+			(long long)file->num_tokens,
+			(double)file->duration_ns/1e6
+		);
+		writer_write_str(out,line);
+		writer_write_str(out,file->path);
+		if(!file->succeeded){
+			writer_write_str(out,": ");
+			writer_write_str(out,file->error);
+		}
+		writer_write_char(out,'\n');
+	}
+
+	discard snprintf(line,sizeof(line),"files: %d, failed: %d, tokens: %lld, time: %.3f ms, threads: %d\n",
+		files->len,
+		num_failed,
+		(long long)num_tokens,
+		(double)duration_ns/1e6,
+		num_threads
+	);
+	writer_write_str(out,line);
+}
+
+void PreprocessorBatch_freeFiles(array*files){
+	for(int i=0;i<files->len;i++){
+		struct PreprocessorBatchFile*file=array_get(files,i);
+		free(file->error);
+		file->error=nullptr;
+	}
+}
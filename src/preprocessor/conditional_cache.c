@@ -0,0 +1,399 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h> // stat, mkdir
+
+#include<util/util.h>
+#include<util/writer.h>
+#include<file.h>
+
+#include<preprocessor/conditional_cache.h>
+
+static const char CONDITIONAL_CACHE_MAGIC[8]="PACCCOND";
+static const uint32_t CONDITIONAL_CACHE_VERSION=1;
+
+/*
+layout of a map file: header, path, conditionals, dependencies, names
+
+maps are only read back on the platform that wrote them (like snapshots), so fields are written in native byte order.
+*/
+struct ConditionalCacheHeader{
+	char magic[8];
+	uint32_t version;
+	uint32_t path_len;
+
+	int64_t size;
+	int64_t mtime;
+	uint64_t hash;
+
+	int32_t num_tokens;
+	int32_t num_conditionals;
+	int32_t num_dependencies;
+	int32_t names_len;
+};
+struct ConditionalCacheConditional{
+	int32_t directive;
+	int32_t next;
+	int32_t end;
+	int32_t value;
+	int32_t first_dependency;
+	int32_t num_dependencies;
+};
+struct ConditionalCacheDependency{
+	int32_t name_offset;
+	int32_t name_len;
+	uint64_t fingerprint;
+};
+
+static uint64_t PreprocessorConditional_hashStep(uint64_t hash,const void*data,size_t len){
+	static const uint64_t FNV_PRIME=0x100000001b3ULL;
+
+	const unsigned char*bytes=data;
+	for(size_t i=0;i<len;i++){
+		hash^=bytes[i];
+		hash*=FNV_PRIME;
+	}
+	return hash;
+}
+uint64_t PreprocessorDefine_fingerprint(const struct PreprocessorDefine*define){
+	if(define==nullptr){
+		return 0;
+	}
+
+	// the spelling of the argument names matters, since the body refers to them. tokens are separated by a byte that
+	// cannot be part of a token, so that e.g. "a b" and "ab" differ
+	uint64_t hash=hashBytes("define",6);
+	int num_args=define->args==nullptr?-1:define->args->len;
+	hash=PreprocessorConditional_hashStep(hash,&num_args,sizeof(num_args));
+	for(int i=0;i<num_args;i++){
+		const struct PreprocessorDefineFunctionlikeArg*arg=array_get(define->args,i);
+		const Token*arg_name=arg->tag==PREPROCESSOR_DEFINE_FUNCTIONLIKE_ARG_TYPE_NAME?&arg->name.name:&arg->varargs.token;
+		hash=PreprocessorConditional_hashStep(hash,arg_name->p,arg_name->len);
+		hash=PreprocessorConditional_hashStep(hash,"\n",1);
+	}
+	for(int i=0;i<define->tokens.len;i++){
+		const Token*token=array_get((array*)&define->tokens,i);
+		hash=PreprocessorConditional_hashStep(hash,token->p,token->len);
+		hash=PreprocessorConditional_hashStep(hash,"\n",1);
+	}
+
+	// 0 is reserved for undefined macros
+	return hash!=0?hash:1;
+}
+
+void PreprocessorConditionalCache_init(struct PreprocessorConditionalCache*cache,const char*directory){
+	cache->directory=directory;
+	hashmap_init(&cache->maps);
+	arena_init(&cache->arena);
+}
+void PreprocessorConditionalCache_free(struct PreprocessorConditionalCache*cache){
+	for(int i=0;i<cache->maps.cap;i++){
+		if(cache->maps.entries[i].key==nullptr){
+			continue;
+		}
+		struct PreprocessorConditionalMap*map=cache->maps.entries[i].value;
+		array_free(&map->conditionals);
+		array_free(&map->dependencies);
+		array_free(&map->names);
+		free(map->conditional_at);
+	}
+	hashmap_free(&cache->maps);
+	arena_free(&cache->arena);
+}
+
+/* path of the file in the cache directory that holds the map for source path. caller frees the path */
+static char* PreprocessorConditionalCache_mapPath(const struct PreprocessorConditionalCache*cache,const char*path){
+	size_t map_path_len=strlen(cache->directory)+1+16+strlen(".cond")+1;
+	char*map_path=calloc(map_path_len,1);
+	discard snprintf(map_path,map_path_len,"%s/%016llx.cond",cache->directory,(unsigned long long)hashBytes(path,strlen(path)));
+	return map_path;
+}
+
+/* read the map file of map->path into map, returns false if there is none or if it does not match the file */
+static bool PreprocessorConditionalCache_load(const struct PreprocessorConditionalCache*cache,struct PreprocessorConditionalMap*map){
+	char*map_path=PreprocessorConditionalCache_mapPath(cache,map->path);
+	FILE*file=fopen(map_path,"rb");
+	free(map_path);
+	if(file==nullptr){
+		return false;
+	}
+	discard fseek(file,0,SEEK_END);
+	long file_len=ftell(file);
+	discard fseek(file,0,SEEK_SET);
+	char*contents=malloc(file_len>0?(size_t)file_len:1);
+	bool read_ok=file_len>0 && fread(contents,1,(size_t)file_len,file)==(size_t)file_len;
+	discard fclose(file);
+
+	struct ConditionalCacheHeader header;
+	bool valid=read_ok && (size_t)file_len>=sizeof(header);
+	if(valid){
+		memcpy(&header,contents,sizeof(header));
+		valid=memcmp(header.magic,CONDITIONAL_CACHE_MAGIC,sizeof(header.magic))==0
+			&& header.version==CONDITIONAL_CACHE_VERSION
+			&& header.num_conditionals>=0 && header.num_dependencies>=0 && header.names_len>=0
+			&& (size_t)file_len==sizeof(header)+header.path_len
+				+(size_t)header.num_conditionals*sizeof(struct ConditionalCacheConditional)
+				+(size_t)header.num_dependencies*sizeof(struct ConditionalCacheDependency)
+				+(size_t)header.names_len;
+	}
+	// the map is only valid for the exact same file contents
+	valid=valid
+		&& header.path_len==strlen(map->path) && memcmp(contents+sizeof(header),map->path,header.path_len)==0
+		&& header.size==map->size && header.hash==map->hash && header.num_tokens==map->num_tokens;
+	if(!valid){
+		free(contents);
+		return false;
+	}
+
+	const char*section=contents+sizeof(header)+header.path_len;
+	for(int i=0;i<header.num_conditionals;i++){
+		struct ConditionalCacheConditional conditional;
+		memcpy(&conditional,section,sizeof(conditional));
+		section+=sizeof(conditional);
+
+		if(conditional.directive<0 || conditional.directive>=map->num_tokens
+			|| conditional.next<-1 || conditional.next>=map->num_tokens
+			|| conditional.end<-1 || conditional.end>map->num_tokens+1
+			|| conditional.first_dependency<0 || conditional.num_dependencies<0
+			|| conditional.first_dependency+conditional.num_dependencies>header.num_dependencies
+		){
+			valid=false;
+			break;
+		}
+		array_append(&map->conditionals,&(struct PreprocessorConditional){
+			.directive=conditional.directive,
+			.next=conditional.next,
+			.end=conditional.end,
+			.value=conditional.value!=0,
+			.first_dependency=conditional.first_dependency,
+			.num_dependencies=conditional.num_dependencies,
+		});
+		map->conditional_at[conditional.directive]=map->conditionals.len;
+	}
+	for(int i=0;valid && i<header.num_dependencies;i++){
+		struct ConditionalCacheDependency dependency;
+		memcpy(&dependency,section,sizeof(dependency));
+		section+=sizeof(dependency);
+
+		if(dependency.name_offset<0 || dependency.name_len<0 || dependency.name_offset+dependency.name_len>header.names_len){
+			valid=false;
+			break;
+		}
+		array_append(&map->dependencies,&(struct PreprocessorConditionalDependency){
+			.name_offset=dependency.name_offset,
+			.name_len=dependency.name_len,
+			.fingerprint=dependency.fingerprint,
+		});
+	}
+	for(int i=0;valid && i<header.names_len;i++){
+		array_append(&map->names,&section[i]);
+	}
+	free(contents);
+
+	if(!valid){
+		// corrupt map, start over
+		map->conditionals.len=0;
+		map->dependencies.len=0;
+		map->names.len=0;
+		memset(map->conditional_at,0,(size_t)map->num_tokens*sizeof(int));
+	}
+	return valid;
+}
+
+struct PreprocessorConditionalMap* PreprocessorConditionalCache_getMap(struct PreprocessorConditionalCache*cache,const Tokenizer*tokenizer){
+	const char*path=tokenizer->token_src;
+	int path_len=(int)strlen(path);
+	struct PreprocessorConditionalMap*map=hashmap_get(&cache->maps,path,path_len);
+	if(map!=nullptr){
+		if(map->num_tokens==tokenizer->num_tokens){
+			return map;
+		}
+		// file changed while the cache was alive (e.g. re-read by the header cache), the old map is dropped
+		array_free(&map->conditionals);
+		array_free(&map->dependencies);
+		array_free(&map->names);
+		free(map->conditional_at);
+	}else{
+		map=arena_alloc(&cache->arena,sizeof(struct PreprocessorConditionalMap));
+		path=arena_copy_string(&cache->arena,path,path_len);
+		hashmap_set(&cache->maps,path,path_len,map);
+	}
+
+	*map=(struct PreprocessorConditionalMap){
+		.path=path,
+		.num_tokens=tokenizer->num_tokens,
+		.conditional_at=calloc((size_t)tokenizer->num_tokens+1,sizeof(int)),
+		.dirty=false,
+	};
+	array_init(&map->conditionals,sizeof(struct PreprocessorConditional));
+	array_init(&map->dependencies,sizeof(struct PreprocessorConditionalDependency));
+	array_init(&map->names,sizeof(char));
+
+	if(cache->directory!=nullptr){
+		struct stat file_stat;
+		if(stat(path,&file_stat)==0){
+			File file;
+			File_read(path,&file);
+			map->has_file_id=true;
+			map->size=file_stat.st_size;
+			map->mtime=file_stat.st_mtime;
+			map->hash=hashBytes(file.contents,file.contents_len);
+			free((char*)file.contents);
+
+			discard PreprocessorConditionalCache_load(cache,map);
+		}
+	}
+	return map;
+}
+
+struct PreprocessorConditional* PreprocessorConditionalMap_get(struct PreprocessorConditionalMap*map,int directive){
+	if(directive<0 || directive>=map->num_tokens || map->conditional_at[directive]==0){
+		return nullptr;
+	}
+	return array_get(&map->conditionals,map->conditional_at[directive]-1);
+}
+struct PreprocessorConditional* PreprocessorConditionalMap_add(struct PreprocessorConditionalMap*map,int directive){
+	struct PreprocessorConditional*conditional=PreprocessorConditionalMap_get(map,directive);
+	if(conditional!=nullptr){
+		return conditional;
+	}
+	if(directive<0 || directive>=map->num_tokens){
+		fatal("conditional directive at token %d out of range in %s",directive,map->path);
+	}
+
+	array_append(&map->conditionals,&(struct PreprocessorConditional){
+		.directive=directive,
+		.next=-1,
+		.end=-1,
+		.value=false,
+		.first_dependency=0,
+		.num_dependencies=0,
+	});
+	map->conditional_at[directive]=map->conditionals.len;
+	map->dirty=true;
+	return array_get(&map->conditionals,map->conditionals.len-1);
+}
+void PreprocessorConditionalMap_setValue(struct PreprocessorConditionalMap*map,struct PreprocessorConditional*conditional,int end,bool value){
+	// dependencies of the previous record stay in the list until the map is written
+	conditional->end=end;
+	conditional->value=value;
+	conditional->first_dependency=map->dependencies.len;
+	conditional->num_dependencies=0;
+	map->dirty=true;
+}
+void PreprocessorConditionalMap_addDependency(
+	struct PreprocessorConditionalMap*map,
+	struct PreprocessorConditional*conditional,
+	const char*name,
+	int name_len,
+	uint64_t fingerprint
+){
+	if(conditional->first_dependency+conditional->num_dependencies!=map->dependencies.len){
+		fatal("bug: dependency added to conditional at token %d out of order",conditional->directive);
+	}
+
+	array_append(&map->dependencies,&(struct PreprocessorConditionalDependency){
+		.name_offset=map->names.len,
+		.name_len=name_len,
+		.fingerprint=fingerprint,
+	});
+	for(int i=0;i<name_len;i++){
+		array_append(&map->names,&name[i]);
+	}
+	conditional->num_dependencies++;
+}
+void PreprocessorConditionalMap_link(struct PreprocessorConditionalMap*map,int directive,int next){
+	struct PreprocessorConditional*conditional=PreprocessorConditionalMap_add(map,directive);
+	if(conditional->next!=next){
+		conditional->next=next;
+		map->dirty=true;
+	}
+}
+
+/* write map into the cache directory, dropping dependencies that are no longer referenced */
+static void PreprocessorConditionalCache_writeMap(const struct PreprocessorConditionalCache*cache,struct PreprocessorConditionalMap*map){
+	array conditionals={};
+	array_init(&conditionals,sizeof(struct ConditionalCacheConditional));
+	array dependencies={};
+	array_init(&dependencies,sizeof(struct ConditionalCacheDependency));
+	array names={};
+	array_init(&names,sizeof(char));
+
+	for(int i=0;i<map->conditionals.len;i++){
+		const struct PreprocessorConditional*conditional=array_get(&map->conditionals,i);
+		array_append(&conditionals,&(struct ConditionalCacheConditional){
+			.directive=conditional->directive,
+			.next=conditional->next,
+			.end=conditional->end,
+			.value=conditional->value,
+			.first_dependency=dependencies.len,
+			.num_dependencies=conditional->num_dependencies,
+		});
+		for(int j=0;j<conditional->num_dependencies;j++){
+			const struct PreprocessorConditionalDependency*dependency=array_get(&map->dependencies,conditional->first_dependency+j);
+			array_append(&dependencies,&(struct ConditionalCacheDependency){
+				.name_offset=names.len,
+				.name_len=dependency->name_len,
+				.fingerprint=dependency->fingerprint,
+			});
+			for(int k=0;k<dependency->name_len;k++){
+				array_append(&names,array_get(&map->names,dependency->name_offset+k));
+			}
+		}
+	}
+
+	struct ConditionalCacheHeader header={
+		.version=CONDITIONAL_CACHE_VERSION,
+		.path_len=(uint32_t)strlen(map->path),
+		.size=map->size,
+		.mtime=map->mtime,
+		.hash=map->hash,
+		.num_tokens=map->num_tokens,
+		.num_conditionals=conditionals.len,
+		.num_dependencies=dependencies.len,
+		.names_len=names.len,
+	};
+	memcpy(header.magic,CONDITIONAL_CACHE_MAGIC,sizeof(header.magic));
+
+	char*map_path=PreprocessorConditionalCache_mapPath(cache,map->path);
+	writer out={};
+	writer_open(&out,map_path);
+	writer_write(&out,(const char*)&header,sizeof(header));
+	writer_write(&out,map->path,(int)header.path_len);
+	// sections may be empty, in which case there is no data to write
+	if(conditionals.len>0){
+		writer_write(&out,conditionals.data,conditionals.len*(int)sizeof(struct ConditionalCacheConditional));
+	}
+	if(dependencies.len>0){
+		writer_write(&out,dependencies.data,dependencies.len*(int)sizeof(struct ConditionalCacheDependency));
+	}
+	if(names.len>0){
+		writer_write(&out,names.data,names.len);
+	}
+	writer_close(&out);
+	free(map_path);
+
+	array_free(&names);
+	array_free(&dependencies);
+	array_free(&conditionals);
+}
+void PreprocessorConditionalCache_write(struct PreprocessorConditionalCache*cache){
+	if(cache->directory==nullptr){
+		return;
+	}
+	if(mkdir(cache->directory,0777)!=0 && errno!=EEXIST){
+		fatal("could not create conditional cache directory %s",cache->directory);
+	}
+
+	for(int i=0;i<cache->maps.cap;i++){
+		if(cache->maps.entries[i].key==nullptr){
+			continue;
+		}
+		struct PreprocessorConditionalMap*map=cache->maps.entries[i].value;
+		if(map->dirty && map->has_file_id){
+			PreprocessorConditionalCache_writeMap(cache,map);
+			map->dirty=false;
+		}
+	}
+}
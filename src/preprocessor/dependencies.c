@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include<util/hashmap.h>
+#include<util/writer.h>
+
+#include<preprocessor/dependencies.h>
+
+/* rules are wrapped to stay within this many columns, like other tools do */
+#define DEPENDENCY_LINE_WIDTH 75
+
+/* write path as make target or prerequisite, i.e. escape characters that are special to make */
+static void Dependencies_writePath(writer*out,const char*path){
+	for(const char*c=path;*c!=0;c++){
+		switch(*c){
+			case ' ':
+			case '#':
+				writer_write_char(out,'\\');
+				writer_write_char(out,*c);
+				break;
+			case '$':
+				writer_write_str(out,"$$");
+				break;
+			default:
+				writer_write_char(out,*c);
+		}
+	}
+}
+
+void Preprocessor_writeDependencies(
+	struct Preprocessor*preprocessor,
+	const char*input_path,
+	const char*path,
+	const struct PreprocessorDependencyConfig*config
+){
+	// collect prerequisites, each file only once (as the path it was first reached by), no matter how many paths refer to it
+	array prerequisites={};
+	array_init(&prerequisites,sizeof(const char*));
+	hashmap seen_files={};
+	hashmap_init(&seen_files);
+
+	array_append(&prerequisites,&input_path);
+	struct PreprocessorFileInfo*input_file_info=Preprocessor_getFileInfo(preprocessor,input_path);
+	if(input_file_info!=nullptr){
+		hashmap_set(&seen_files,(const char*)&input_file_info->id,sizeof(input_file_info->id),input_file_info);
+	}
+	for(int i=0;i<preprocessor->included_files.len;i++){
+		struct PreprocessorIncludedFile*included_file=array_get(&preprocessor->included_files,i);
+		if(config->exclude_system_headers && included_file->is_system_header){
+			continue;
+		}
+
+		struct PreprocessorFileId*id=&included_file->file_info->id;
+		if(hashmap_get(&seen_files,(const char*)id,sizeof(*id))!=nullptr){
+			continue;
+		}
+		hashmap_set(&seen_files,(const char*)id,sizeof(*id),included_file->file_info);
+		array_append(&prerequisites,&included_file->path);
+	}
+
+	writer out={};
+	writer_open(&out,path);
+
+	writer_write_str(&out,config->target);
+	writer_write_char(&out,':');
+	int line_len=(int)strlen(config->target)+1;
+	for(int i=0;i<prerequisites.len;i++){
+		const char*prerequisite=*(const char**)array_get(&prerequisites,i);
+		int prerequisite_len=(int)strlen(prerequisite);
+
+		if(line_len+1+prerequisite_len>DEPENDENCY_LINE_WIDTH && line_len>1){
+			writer_write_str(&out," \\\n");
+			line_len=0;
+		}
+		writer_write_char(&out,' ');
+		Dependencies_writePath(&out,prerequisite);
+		line_len+=1+prerequisite_len;
+	}
+	writer_write_char(&out,'\n');
+
+	// phony targets for all headers (not for the input file itself)
+	if(config->phony_targets){
+		for(int i=1;i<prerequisites.len;i++){
+			const char*prerequisite=*(const char**)array_get(&prerequisites,i);
+			writer_write_char(&out,'\n');
+			Dependencies_writePath(&out,prerequisite);
+			writer_write_str(&out,":\n");
+		}
+	}
+
+	writer_close(&out);
+
+	hashmap_free(&seen_files);
+	array_free(&prerequisites);
+}
@@ -0,0 +1,96 @@
+// struct stat.st_mtim (modification time with nanoseconds)
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h> // dev_t, ino_t
+
+#include<util/util.h>
+#include<util/hashmap.h>
+
+#include<preprocessor/header_cache.h>
+
+struct HeaderCacheEntry{
+	/* resolved path, also the key of the entry */
+	const char*path;
+
+	/* identity of the file that was tokenized */
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+
+	File file;
+	Tokenizer tokenizer;
+};
+
+static pthread_mutex_t header_cache_mutex=PTHREAD_MUTEX_INITIALIZER;
+/* maps path to struct HeaderCacheEntry*, only accessed while holding header_cache_mutex */
+static hashmap header_cache_entries={};
+/* paths of the entries added since the last call of HeaderCache_takeNewPaths, element type is const char*, only accessed while holding header_cache_mutex */
+static array header_cache_new_paths={.elem_size=sizeof(const char*)};
+
+static bool HeaderCacheEntry_matches(const struct HeaderCacheEntry*entry,const struct stat*file_stat){
+	return entry->dev==file_stat->st_dev
+		&& entry->ino==file_stat->st_ino
+		&& entry->size==file_stat->st_size
+		&& entry->mtime.tv_sec==file_stat->st_mtim.tv_sec
+		&& entry->mtime.tv_nsec==file_stat->st_mtim.tv_nsec;
+}
+
+Tokenizer* HeaderCache_get(const char*path){
+	struct stat file_stat;
+	if(stat(path,&file_stat)!=0){
+		fatal("could not stat file %s",path);
+	}
+
+	int path_len=(int)strlen(path);
+
+	pthread_mutex_lock(&header_cache_mutex);
+	struct HeaderCacheEntry*entry=hashmap_get(&header_cache_entries,path,path_len);
+	pthread_mutex_unlock(&header_cache_mutex);
+	if(entry!=nullptr && HeaderCacheEntry_matches(entry,&file_stat)){
+		return &entry->tokenizer;
+	}
+
+	// read and tokenize without holding the lock, so that other headers can be served in the meantime
+	struct HeaderCacheEntry*new_entry=calloc(1,sizeof(struct HeaderCacheEntry));
+	new_entry->path=allocAndCopy(path_len+1,path);
+	new_entry->dev=file_stat.st_dev;
+	new_entry->ino=file_stat.st_ino;
+	new_entry->size=file_stat.st_size;
+	new_entry->mtime=file_stat.st_mtim;
+	File_read(new_entry->path,&new_entry->file);
+	Tokenizer_init(&new_entry->tokenizer,&new_entry->file);
+
+	pthread_mutex_lock(&header_cache_mutex);
+	// another thread may have tokenized the same file in the meantime, in which case its entry is used instead, so
+	// that all preprocessors see the same tokens
+	entry=hashmap_get(&header_cache_entries,path,path_len);
+	bool use_new_entry=entry==nullptr || !HeaderCacheEntry_matches(entry,&file_stat);
+	if(use_new_entry){
+		// entries that are replaced are kept alive, since other preprocessors may still use their tokens
+		hashmap_set(&header_cache_entries,new_entry->path,path_len,new_entry);
+		entry=new_entry;
+		array_append(&header_cache_new_paths,&new_entry->path);
+	}
+	pthread_mutex_unlock(&header_cache_mutex);
+
+	if(!use_new_entry){
+		free(new_entry->tokenizer.tokens);
+		free((char*)new_entry->file.contents);
+		free((char*)new_entry->path);
+		free(new_entry);
+	}
+
+	return &entry->tokenizer;
+}
+void HeaderCache_takeNewPaths(array*paths){
+	pthread_mutex_lock(&header_cache_mutex);
+	for(int i=0;i<header_cache_new_paths.len;i++){
+		array_append(paths,array_get(&header_cache_new_paths,i));
+	}
+	header_cache_new_paths.len=0;
+	pthread_mutex_unlock(&header_cache_mutex);
+}
@@ -0,0 +1,651 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include<util/util.h>
+
+#include<preprocessor/preprocessor.h>
+
+/* maximum number of values on the stack while evaluating an expression */
+#define PREPROCESSOR_IF_MAX_STACK_DEPTH 64
+
+bool PreprocessorMacroDependencies_areValid(struct Preprocessor*preprocessor,const array*dependencies){
+	for(int i=0;i<dependencies->len;i++){
+		struct PreprocessorMacroDependency*dependency=array_get((array*)dependencies,i);
+		if(Preprocessor_getMacroBinding(preprocessor,dependency->macro).generation!=dependency->generation){
+			return false;
+		}
+	}
+	return true;
+}
+
+/* state while compiling an expanded expression into postfix instructions */
+struct PreprocessorIfCompiler{
+	struct Preprocessor*preprocessor;
+	struct PreprocessorIfExpression*expr;
+
+	/* expanded expression tokens */
+	array tokens;
+	int next_token_index;
+
+	/* number of values on the stack after the instructions emitted so far */
+	int stack_depth;
+};
+
+/* binary operators, with binding power (higher binds stronger) */
+static const struct{
+	const char*spelling;
+	int binding_power;
+	enum PreprocessorIfOpcode op;
+}PREPROCESSOR_IF_BINARY_OPERATORS[]={
+	{"*",10,PREPROCESSOR_IF_OP_MULTIPLY},
+	{"/",10,PREPROCESSOR_IF_OP_DIVIDE},
+	{"%",10,PREPROCESSOR_IF_OP_MODULO},
+	{"+",9,PREPROCESSOR_IF_OP_ADD},
+	{"-",9,PREPROCESSOR_IF_OP_SUBTRACT},
+	{"<<",8,PREPROCESSOR_IF_OP_SHIFT_LEFT},
+	{">>",8,PREPROCESSOR_IF_OP_SHIFT_RIGHT},
+	{"<",7,PREPROCESSOR_IF_OP_LESSER_THAN},
+	{"<=",7,PREPROCESSOR_IF_OP_LESSER_THAN_OR_EQUAL},
+	{">",7,PREPROCESSOR_IF_OP_GREATER_THAN},
+	{">=",7,PREPROCESSOR_IF_OP_GREATER_THAN_OR_EQUAL},
+	{"==",6,PREPROCESSOR_IF_OP_EQUAL},
+	{"!=",6,PREPROCESSOR_IF_OP_UNEQUAL},
+	{"&",5,PREPROCESSOR_IF_OP_BITWISE_AND},
+	{"^",4,PREPROCESSOR_IF_OP_BITWISE_XOR},
+	{"|",3,PREPROCESSOR_IF_OP_BITWISE_OR},
+	// && and || are emitted as jumps
+	{"&&",2,PREPROCESSOR_IF_OP_JUMP_IF_ZERO},
+	{"||",1,PREPROCESSOR_IF_OP_JUMP_IF_NOT_ZERO},
+};
+static const int PREPROCESSOR_IF_NUM_BINARY_OPERATORS=sizeof(PREPROCESSOR_IF_BINARY_OPERATORS)/sizeof(PREPROCESSOR_IF_BINARY_OPERATORS[0]);
+
+static Token* PreprocessorIfCompiler_peek(struct PreprocessorIfCompiler*compiler){
+	return array_get(&compiler->tokens,compiler->next_token_index);
+}
+static Token* PreprocessorIfCompiler_next(struct PreprocessorIfCompiler*compiler){
+	Token*token=PreprocessorIfCompiler_peek(compiler);
+	if(token==nullptr){
+		Token*last_token=array_get(&compiler->tokens,compiler->tokens.len-1);
+		fatal("unexpected end of preprocessor expression after %s",last_token==nullptr?"<empty expression>":Token_print(last_token));
+	}
+	compiler->next_token_index++;
+	return token;
+}
+/* emit instruction, returns index of the instruction */
+static int PreprocessorIfCompiler_emit(struct PreprocessorIfCompiler*compiler,struct PreprocessorIfInstruction instruction,int stack_effect){
+	array_append(&compiler->expr->program,&instruction);
+
+	compiler->stack_depth+=stack_effect;
+	if(compiler->stack_depth>compiler->expr->max_stack_depth){
+		compiler->expr->max_stack_depth=compiler->stack_depth;
+	}
+	if(compiler->expr->max_stack_depth>PREPROCESSOR_IF_MAX_STACK_DEPTH){
+		fatal("preprocessor expression is nested too deeply");
+	}
+
+	return compiler->expr->program.len-1;
+}
+/* point jump instruction at the next instruction that will be emitted */
+static void PreprocessorIfCompiler_patchJump(struct PreprocessorIfCompiler*compiler,int jump_index){
+	struct PreprocessorIfInstruction*jump=array_get(&compiler->expr->program,jump_index);
+	jump->target=compiler->expr->program.len;
+}
+/*
+get value of a numeric token, allowing integer suffixes. the value is unsigned if it has the suffix u, or does not fit
+into intmax_t, the length suffixes are ignored
+*/
+static struct PreprocessorIfValue PreprocessorIfCompiler_numericValue(Token*token){
+	if(token->tag==TOKEN_TAG_LITERAL && token->literal.tag==TOKEN_LITERAL_TAG_NUMERIC && token->literal.numeric.tag!=TOKEN_LITERAL_NUMERIC_TAG_INTEGER){
+		if(token->literal.numeric.tag==TOKEN_LITERAL_NUMERIC_TAG_FLOAT || token->literal.numeric.tag==TOKEN_LITERAL_NUMERIC_TAG_DOUBLE){
+			fatal("floating point literal in preprocessor expression %s",Token_print(token));
+		}
+		int64_t value=0;
+		uint64_t uvalue=0;
+		TokenLiteral_getNumericValue(token,&uvalue,&value,nullptr);
+		// character constants have type int
+		return (struct PreprocessorIfValue){.value=value|(int64_t)uvalue,.is_unsigned=false};
+	}
+
+	char*spelling=calloc(token->len+1,1);
+	memcpy(spelling,token->p,token->len);
+
+	int base=10;
+	const char*digits=spelling;
+	if(spelling[0]=='0' && (spelling[1]=='x' || spelling[1]=='X')){
+		base=16;
+		digits+=2;
+	}else if(spelling[0]=='0' && (spelling[1]=='b' || spelling[1]=='B')){
+		base=2;
+		digits+=2;
+	}else if(spelling[0]=='0'){
+		base=8;
+	}
+
+	char*end=nullptr;
+	errno=0;
+	uint64_t value=strtoull(digits,&end,base);
+	if(errno==ERANGE){
+		fatal("integer literal in preprocessor expression is too large %s",Token_print(token));
+	}
+	bool is_unsigned=value>INT64_MAX;
+	// only integer suffixes may follow the digits
+	for(;*end!=0;end++){
+		if(*end!='u' && *end!='U' && *end!='l' && *end!='L'){
+			fatal("invalid integer literal in preprocessor expression %s",Token_print(token));
+		}
+		is_unsigned=is_unsigned || *end=='u' || *end=='U';
+	}
+
+	free(spelling);
+	return (struct PreprocessorIfValue){.value=(int64_t)value,.is_unsigned=is_unsigned};
+}
+
+static bool PreprocessorIfCompiler_compileConditional(struct PreprocessorIfCompiler*compiler);
+
+/* standard attributes, with the value of __has_c_attribute for them (from C23) */
+static const struct{
+	const char*name;
+	const char*value;
+}PREPROCESSOR_IF_C_ATTRIBUTES[]={
+	{"deprecated","201904"},
+	{"fallthrough","201904"},
+	{"maybe_unused","201904"},
+	{"nodiscard","202003"},
+	{"noreturn","202202"},
+	{"_Noreturn","202202"},
+	{"unsequenced","202207"},
+	{"reproducible","202207"},
+};
+static const int PREPROCESSOR_IF_NUM_C_ATTRIBUTES=sizeof(PREPROCESSOR_IF_C_ATTRIBUTES)/sizeof(PREPROCESSOR_IF_C_ATTRIBUTES[0]);
+
+/*
+get value of __has_c_attribute for the attribute spelled by tokens (attributes with a prefix, e.g. gnu::packed, are not
+supported). the name may also be surrounded by double underscores (e.g. __nodiscard__)
+*/
+static const char* PreprocessorIfCompiler_cAttributeValue(int num_tokens,const Token*tokens){
+	if(num_tokens!=1){
+		return "0";
+	}
+	const Token*name=&tokens[0];
+	for(int i=0;i<PREPROCESSOR_IF_NUM_C_ATTRIBUTES;i++){
+		const char*attribute=PREPROCESSOR_IF_C_ATTRIBUTES[i].name;
+		int attribute_len=(int)strlen(attribute);
+		bool matches=Token_equalString(name,attribute) || (
+			name->len==attribute_len+4
+			&& memcmp(name->p,"__",2)==0
+			&& memcmp(name->p+2,attribute,(size_t)attribute_len)==0
+			&& memcmp(name->p+2+attribute_len,"__",2)==0
+		);
+		if(matches){
+			return PREPROCESSOR_IF_C_ATTRIBUTES[i].value;
+		}
+	}
+	return "0";
+}
+
+/*
+the compile functions return whether the value they leave on the stack is unsigned, which only depends on the literals
+and operators of the expression (and is only needed to convert the operands of ?:)
+*/
+static bool PreprocessorIfCompiler_compileUnary(struct PreprocessorIfCompiler*compiler){
+	Token*token=PreprocessorIfCompiler_next(compiler);
+
+	if(Token_equalString(token,"(")){
+		bool is_unsigned=PreprocessorIfCompiler_compileConditional(compiler);
+		Token*closing_token=PreprocessorIfCompiler_next(compiler);
+		if(!Token_equalString(closing_token,")")){
+			fatal("expected ) in preprocessor expression, got instead %s",Token_print(closing_token));
+		}
+		return is_unsigned;
+	}
+
+	static const struct{
+		const char*spelling;
+		enum PreprocessorIfOpcode op;
+	}UNARY_OPERATORS[]={
+		{"!",PREPROCESSOR_IF_OP_NOT},
+		{"~",PREPROCESSOR_IF_OP_BITWISE_NOT},
+		{"-",PREPROCESSOR_IF_OP_NEGATE},
+		{"+",PREPROCESSOR_IF_OP_TO_BOOL /* placeholder, not emitted */},
+	};
+	static const int NUM_UNARY_OPERATORS=sizeof(UNARY_OPERATORS)/sizeof(UNARY_OPERATORS[0]);
+	for(int i=0;i<NUM_UNARY_OPERATORS;i++){
+		if(token->tag==TOKEN_TAG_KEYWORD && Token_equalString(token,UNARY_OPERATORS[i].spelling)){
+			bool is_unsigned=PreprocessorIfCompiler_compileUnary(compiler);
+			// unary plus does not change the value
+			if(!Token_equalString(token,"+")){
+				PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=UNARY_OPERATORS[i].op},0);
+			}
+			return is_unsigned && UNARY_OPERATORS[i].op!=PREPROCESSOR_IF_OP_NOT;
+		}
+	}
+
+	// defined operator, which has been marked before macro expansion (see PreprocessorIfExpression_compile)
+	if(token->tag==TOKEN_TAG_KEYWORD && Token_equalString(token,"defined")){
+		Token*name=PreprocessorIfCompiler_next(compiler);
+		struct PreprocessorMacro*macro=Preprocessor_getMacro(compiler->preprocessor,name->p,name->len);
+		PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_DEFINED,.macro=macro},1);
+		return false;
+	}
+
+	// __has_include operator, whose header name has been taken out of the expression before macro expansion
+	if(token->tag==TOKEN_TAG_KEYWORD && Token_equalString(token,"__has_include")){
+		Token*argument=PreprocessorIfCompiler_next(compiler);
+		const char*include_argument=arena_copy_string(&compiler->preprocessor->arena,argument->p,(size_t)argument->len);
+		PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_HAS_INCLUDE,.include_argument=include_argument},1);
+		compiler->expr->depends_on_files=true;
+		return false;
+	}
+
+	if(token->len>0 && ((token->p[0]>='0' && token->p[0]<='9') || token->tag==TOKEN_TAG_LITERAL)){
+		if(token->tag==TOKEN_TAG_LITERAL && token->literal.tag==TOKEN_LITERAL_TAG_STRING){
+			fatal("string literal in preprocessor expression %s",Token_print(token));
+		}
+		struct PreprocessorIfValue value=PreprocessorIfCompiler_numericValue(token);
+		PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_PUSH,.value=value},1);
+		return value.is_unsigned;
+	}
+
+	if(token->tag==TOKEN_TAG_SYMBOL || token->tag==TOKEN_TAG_KEYWORD){
+		if(Token_equalString(token,")") || Token_equalString(token,":") || Token_equalString(token,",")){
+			fatal("expected expression, got instead %s",Token_print(token));
+		}
+
+		// identifiers that are left after macro expansion evaluate to 0 (except true, per C23)
+		struct PreprocessorIfValue value={.value=Token_equalString(token,"true")?1:0};
+		PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_PUSH,.value=value},1);
+
+		// skip argument list of undefined function-like macro
+		Token*next_token=PreprocessorIfCompiler_peek(compiler);
+		if(next_token!=nullptr && Token_equalString(next_token,"(")){
+			int open_paranthesis=0;
+			do{
+				next_token=PreprocessorIfCompiler_next(compiler);
+				if(Token_equalString(next_token,"(")){
+					open_paranthesis++;
+				}else if(Token_equalString(next_token,")")){
+					open_paranthesis--;
+				}
+			}while(open_paranthesis>0);
+		}
+		return false;
+	}
+
+	fatal("unexpected token in preprocessor expression %s",Token_print(token));
+}
+/* compile binary operators with binding power of at least min_binding_power */
+static bool PreprocessorIfCompiler_compileBinary(struct PreprocessorIfCompiler*compiler,int min_binding_power){
+	bool is_unsigned=PreprocessorIfCompiler_compileUnary(compiler);
+
+	while(1){
+		Token*token=PreprocessorIfCompiler_peek(compiler);
+		if(token==nullptr || token->tag!=TOKEN_TAG_KEYWORD || token->len>2){
+			return is_unsigned;
+		}
+
+		// the tokenizer does not merge << and >>, so look for two adjacent < or > tokens
+		char spelling[3]={};
+		int num_operator_tokens=1;
+		memcpy(spelling,token->p,token->len);
+		Token*following_token=array_get(&compiler->tokens,compiler->next_token_index+1);
+		if(
+			token->len==1 && (token->p[0]=='<' || token->p[0]=='>')
+			&& following_token!=nullptr && following_token->len==1 && following_token->p[0]==token->p[0]
+			&& following_token->p==token->p+1
+		){
+			spelling[1]=token->p[0];
+			num_operator_tokens=2;
+		}
+
+		int operator_index=-1;
+		for(int i=0;i<PREPROCESSOR_IF_NUM_BINARY_OPERATORS;i++){
+			if(strcmp(spelling,PREPROCESSOR_IF_BINARY_OPERATORS[i].spelling)==0){
+				operator_index=i;
+				break;
+			}
+		}
+		if(operator_index<0 || PREPROCESSOR_IF_BINARY_OPERATORS[operator_index].binding_power<min_binding_power){
+			return is_unsigned;
+		}
+		compiler->next_token_index+=num_operator_tokens;
+
+		enum PreprocessorIfOpcode op=PREPROCESSOR_IF_BINARY_OPERATORS[operator_index].op;
+		int binding_power=PREPROCESSOR_IF_BINARY_OPERATORS[operator_index].binding_power;
+		// all binary operators are left associative
+		if(op==PREPROCESSOR_IF_OP_JUMP_IF_ZERO || op==PREPROCESSOR_IF_OP_JUMP_IF_NOT_ZERO){
+			// lhs; jump to short_circuit if lhs decides the result; rhs; to_bool; jump to end; short_circuit: push result; end:
+			int short_circuit_jump=PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=op},-1);
+			PreprocessorIfCompiler_compileBinary(compiler,binding_power+1);
+			PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_TO_BOOL},0);
+			int end_jump=PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_JUMP},-1);
+
+			PreprocessorIfCompiler_patchJump(compiler,short_circuit_jump);
+			struct PreprocessorIfValue short_circuit_value={.value=op==PREPROCESSOR_IF_OP_JUMP_IF_NOT_ZERO};
+			PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_PUSH,.value=short_circuit_value},1);
+			PreprocessorIfCompiler_patchJump(compiler,end_jump);
+			is_unsigned=false;
+			continue;
+		}
+
+		bool rhs_is_unsigned=PreprocessorIfCompiler_compileBinary(compiler,binding_power+1);
+		PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=op},-1);
+		if(op>=PREPROCESSOR_IF_OP_LESSER_THAN && op<=PREPROCESSOR_IF_OP_UNEQUAL){
+			// comparisons have type int
+			is_unsigned=false;
+		}else if(op!=PREPROCESSOR_IF_OP_SHIFT_LEFT && op!=PREPROCESSOR_IF_OP_SHIFT_RIGHT){
+			// the result of a shift has the type of its left operand
+			is_unsigned=is_unsigned || rhs_is_unsigned;
+		}
+	}
+}
+/* compile conditional operator (lowest precedence, right associative) */
+static bool PreprocessorIfCompiler_compileConditional(struct PreprocessorIfCompiler*compiler){
+	bool is_unsigned=PreprocessorIfCompiler_compileBinary(compiler,0);
+
+	Token*token=PreprocessorIfCompiler_peek(compiler);
+	if(token==nullptr || !Token_equalString(token,"?")){
+		return is_unsigned;
+	}
+	compiler->next_token_index++;
+
+	// condition; jump to else if zero; then; jump to end; else: else; end:
+	int else_jump=PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_JUMP_IF_ZERO},-1);
+	bool then_is_unsigned=PreprocessorIfCompiler_compileConditional(compiler);
+	int end_jump=PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_JUMP},-1);
+
+	Token*colon_token=PreprocessorIfCompiler_next(compiler);
+	if(!Token_equalString(colon_token,":")){
+		fatal("expected : after ? in preprocessor expression, got instead %s",Token_print(colon_token));
+	}
+
+	PreprocessorIfCompiler_patchJump(compiler,else_jump);
+	bool else_is_unsigned=PreprocessorIfCompiler_compileConditional(compiler);
+	PreprocessorIfCompiler_patchJump(compiler,end_jump);
+
+	// both operands are converted to their common type
+	if(then_is_unsigned || else_is_unsigned){
+		PreprocessorIfCompiler_emit(compiler,(struct PreprocessorIfInstruction){.op=PREPROCESSOR_IF_OP_TO_UNSIGNED},0);
+		return true;
+	}
+	return false;
+}
+
+void PreprocessorIfExpression_compile(struct Preprocessor*preprocessor,struct PreprocessorIfExpression*expr,int num_tokens,const Token*tokens){
+	expr->program.len=0;
+	expr->max_stack_depth=0;
+	expr->expansion_dependencies.len=0;
+	expr->value_is_known=false;
+	expr->depends_on_files=false;
+
+	// mark operands of defined, __has_include and __has_c_attribute, so that they are not expanded
+	array marked_tokens={};
+	array_init(&marked_tokens,sizeof(Token));
+	for(int i=0;i<num_tokens;i++){
+		Token token=tokens[i];
+		if(token.tag==TOKEN_TAG_SYMBOL && (Token_equalString(&token,"__has_include") || Token_equalString(&token,"__has_c_attribute"))){
+			if(i+1>=num_tokens || !Token_equalString(&tokens[i+1],"(")){
+				fatal("expected ( after %s",Token_print(&token));
+			}
+			int close_index=i+2;
+			while(close_index<num_tokens && !Token_equalString(&tokens[close_index],")")){
+				close_index++;
+			}
+			if(close_index>=num_tokens){
+				fatal("expected closing paranthesis after %s",Token_print(&token));
+			}
+			int first_operand=i+2;
+			int num_operand_tokens=close_index-first_operand;
+
+			if(Token_equalString(&token,"__has_c_attribute")){
+				// the value does not depend on anything, so it is replaced right away
+				Token value=token;
+				value.tag=TOKEN_TAG_KEYWORD;
+				value.p=PreprocessorIfCompiler_cAttributeValue(num_operand_tokens,&tokens[first_operand]);
+				value.len=(int)strlen(value.p);
+				array_append(&marked_tokens,&value);
+				i=close_index;
+				continue;
+			}
+
+			// header name is either a string literal, or the tokens between < and > (which are adjacent in the source)
+			Token argument={};
+			const Token*first=&tokens[first_operand];
+			const Token*last=&tokens[close_index-1];
+			if(num_operand_tokens==1 && first->tag==TOKEN_TAG_LITERAL && first->literal.tag==TOKEN_LITERAL_TAG_STRING){
+				argument=*first;
+			}else if(
+				num_operand_tokens>=2
+				&& Token_equalString(first,"<") && Token_equalString(last,">")
+				&& first->filename==last->filename && last->p>first->p
+			){
+				argument=*first;
+				argument.len=(int)(last->p+last->len-first->p);
+			}else{
+				fatal("expected header name after %s",Token_print(&token));
+			}
+			token.tag=TOKEN_TAG_KEYWORD;
+			array_append(&marked_tokens,&token);
+			argument.tag=TOKEN_TAG_PREP_INCLUDE_ARGUMENT;
+			array_append(&marked_tokens,&argument);
+			i=close_index;
+			continue;
+		}
+		if(!(token.tag==TOKEN_TAG_SYMBOL && Token_equalString(&token,"defined"))){
+			array_append(&marked_tokens,&token);
+			continue;
+		}
+
+		// operand can be freestanding, or surrounded by paranthesis
+		bool paranthesis=i+1<num_tokens && Token_equalString(&tokens[i+1],"(");
+		int name_index=i+1+(int)paranthesis;
+		if(name_index>=num_tokens || tokens[name_index].tag!=TOKEN_TAG_SYMBOL){
+			fatal("expected symbol after defined keyword, got instead %s",Token_print(name_index<num_tokens?&tokens[name_index]:&token));
+		}
+		if(paranthesis && (name_index+1>=num_tokens || !Token_equalString(&tokens[name_index+1],")"))){
+			fatal("expected closing paranthesis after defined keyword at %s",Token_print(&token));
+		}
+
+		// keywords are not expanded
+		token.tag=TOKEN_TAG_KEYWORD;
+		array_append(&marked_tokens,&token);
+		Token name=tokens[name_index];
+		name.tag=TOKEN_TAG_KEYWORD;
+		array_append(&marked_tokens,&name);
+
+		i=name_index+(int)paranthesis;
+	}
+
+	// expand macros in expression, while recording all macros that the expansion depends on
+	struct PreprocessorIfCompiler compiler={
+		.preprocessor=preprocessor,
+		.expr=expr,
+	};
+	array_init(&compiler.tokens,sizeof(Token));
+
+	preprocessor->macro_dependencies=&expr->expansion_dependencies;
+	Preprocessor_expandMacros(preprocessor,marked_tokens.len,marked_tokens.data,&compiler.tokens);
+	preprocessor->macro_dependencies=nullptr;
+
+	discard PreprocessorIfCompiler_compileConditional(&compiler);
+	Token*leftover_token=PreprocessorIfCompiler_peek(&compiler);
+	if(leftover_token!=nullptr){
+		fatal("unexpected token in preprocessor expression %s",Token_print(leftover_token));
+	}
+
+	array_free(&marked_tokens);
+	array_free(&compiler.tokens);
+}
+
+/* apply binary operator op, with the usual arithmetic conversions (fatal where the operation would be undefined in C) */
+static struct PreprocessorIfValue PreprocessorIfExpression_applyBinary(enum PreprocessorIfOpcode op,struct PreprocessorIfValue lhs,struct PreprocessorIfValue rhs){
+	if(op==PREPROCESSOR_IF_OP_SHIFT_LEFT || op==PREPROCESSOR_IF_OP_SHIFT_RIGHT){
+		// the result has the type of the left operand, the type of the shift count does not matter
+		if(rhs.is_unsigned && (uint64_t)rhs.value>=64){
+			fatal("shift count %llu is out of range in preprocessor expression",(unsigned long long)rhs.value);
+		}
+		if(!rhs.is_unsigned && (rhs.value<0 || rhs.value>=64)){
+			fatal("shift count %lld is out of range in preprocessor expression",(long long)rhs.value);
+		}
+		int count=(int)rhs.value;
+		uint64_t bits=(uint64_t)lhs.value;
+		if(op==PREPROCESSOR_IF_OP_SHIFT_LEFT){
+			if(!lhs.is_unsigned && (lhs.value<0 || lhs.value>(INT64_MAX>>count))){
+				fatal("overflow in left shift in preprocessor expression");
+			}
+			return (struct PreprocessorIfValue){.value=(int64_t)(bits<<count),.is_unsigned=lhs.is_unsigned};
+		}
+		if(lhs.is_unsigned){
+			return (struct PreprocessorIfValue){.value=(int64_t)(bits>>count),.is_unsigned=true};
+		}
+		// right shift of a negative value is implementation-defined (and sign-extends with gcc and clang)
+		return (struct PreprocessorIfValue){.value=lhs.value>>count};
+	}
+
+	if(lhs.is_unsigned || rhs.is_unsigned){
+		uint64_t a=(uint64_t)lhs.value;
+		uint64_t b=(uint64_t)rhs.value;
+		uint64_t result=0;
+		switch(op){
+			case PREPROCESSOR_IF_OP_MULTIPLY: result=a*b; break;
+			case PREPROCESSOR_IF_OP_DIVIDE:
+				if(b==0) fatal("division by zero in preprocessor expression");
+				result=a/b;
+				break;
+			case PREPROCESSOR_IF_OP_MODULO:
+				if(b==0) fatal("division by zero in preprocessor expression");
+				result=a%b;
+				break;
+			case PREPROCESSOR_IF_OP_ADD: result=a+b; break;
+			case PREPROCESSOR_IF_OP_SUBTRACT: result=a-b; break;
+			// comparisons have type int
+			case PREPROCESSOR_IF_OP_LESSER_THAN: return (struct PreprocessorIfValue){.value=a<b};
+			case PREPROCESSOR_IF_OP_LESSER_THAN_OR_EQUAL: return (struct PreprocessorIfValue){.value=a<=b};
+			case PREPROCESSOR_IF_OP_GREATER_THAN: return (struct PreprocessorIfValue){.value=a>b};
+			case PREPROCESSOR_IF_OP_GREATER_THAN_OR_EQUAL: return (struct PreprocessorIfValue){.value=a>=b};
+			case PREPROCESSOR_IF_OP_EQUAL: return (struct PreprocessorIfValue){.value=a==b};
+			case PREPROCESSOR_IF_OP_UNEQUAL: return (struct PreprocessorIfValue){.value=a!=b};
+			case PREPROCESSOR_IF_OP_BITWISE_AND: result=a&b; break;
+			case PREPROCESSOR_IF_OP_BITWISE_XOR: result=a^b; break;
+			case PREPROCESSOR_IF_OP_BITWISE_OR: result=a|b; break;
+			default:
+				fatal("unknown preprocessor expression instruction %d",op);
+		}
+		return (struct PreprocessorIfValue){.value=(int64_t)result,.is_unsigned=true};
+	}
+
+	int64_t a=lhs.value;
+	int64_t b=rhs.value;
+	int64_t result=0;
+	switch(op){
+		case PREPROCESSOR_IF_OP_MULTIPLY:
+			if(__builtin_mul_overflow(a,b,&result)) fatal("overflow in multiplication in preprocessor expression");
+			break;
+		case PREPROCESSOR_IF_OP_DIVIDE:
+		case PREPROCESSOR_IF_OP_MODULO:
+			if(b==0) fatal("division by zero in preprocessor expression");
+			// the quotient is not representable, which makes the remainder undefined as well (C11 6.5.5)
+			if(a==INT64_MIN && b==-1) fatal("overflow in division in preprocessor expression");
+			result=op==PREPROCESSOR_IF_OP_DIVIDE?a/b:a%b;
+			break;
+		case PREPROCESSOR_IF_OP_ADD:
+			if(__builtin_add_overflow(a,b,&result)) fatal("overflow in addition in preprocessor expression");
+			break;
+		case PREPROCESSOR_IF_OP_SUBTRACT:
+			if(__builtin_sub_overflow(a,b,&result)) fatal("overflow in subtraction in preprocessor expression");
+			break;
+		case PREPROCESSOR_IF_OP_LESSER_THAN: result=a<b; break;
+		case PREPROCESSOR_IF_OP_LESSER_THAN_OR_EQUAL: result=a<=b; break;
+		case PREPROCESSOR_IF_OP_GREATER_THAN: result=a>b; break;
+		case PREPROCESSOR_IF_OP_GREATER_THAN_OR_EQUAL: result=a>=b; break;
+		case PREPROCESSOR_IF_OP_EQUAL: result=a==b; break;
+		case PREPROCESSOR_IF_OP_UNEQUAL: result=a!=b; break;
+		case PREPROCESSOR_IF_OP_BITWISE_AND: result=a&b; break;
+		case PREPROCESSOR_IF_OP_BITWISE_XOR: result=a^b; break;
+		case PREPROCESSOR_IF_OP_BITWISE_OR: result=a|b; break;
+		default:
+			fatal("unknown preprocessor expression instruction %d",op);
+	}
+	return (struct PreprocessorIfValue){.value=result};
+}
+
+int64_t PreprocessorIfExpression_evaluate(struct Preprocessor*preprocessor,struct PreprocessorIfExpression*expr){
+	if(expr->value_is_known && !expr->depends_on_files && PreprocessorMacroDependencies_areValid(preprocessor,&expr->defined_dependencies)){
+		return expr->value;
+	}
+
+	expr->defined_dependencies.len=0;
+
+	struct PreprocessorIfValue stack[PREPROCESSOR_IF_MAX_STACK_DEPTH];
+	int stack_len=0;
+
+	struct PreprocessorIfInstruction*program=expr->program.data;
+	for(int pc=0;pc<expr->program.len;){
+		struct PreprocessorIfInstruction*instruction=&program[pc++];
+		switch(instruction->op){
+			case PREPROCESSOR_IF_OP_PUSH:
+				stack[stack_len++]=instruction->value;
+				break;
+			case PREPROCESSOR_IF_OP_DEFINED:{
+				struct PreprocessorMacroBinding binding=Preprocessor_getMacroBinding(preprocessor,instruction->macro);
+				array_append(&expr->defined_dependencies,&(struct PreprocessorMacroDependency){
+					.macro=instruction->macro,
+					.generation=binding.generation,
+				});
+				stack[stack_len++]=(struct PreprocessorIfValue){.value=binding.define_index>=0};
+				break;
+			}
+			case PREPROCESSOR_IF_OP_HAS_INCLUDE:
+				stack[stack_len++]=(struct PreprocessorIfValue){.value=Preprocessor_hasInclude(preprocessor,instruction->include_argument)};
+				break;
+
+			case PREPROCESSOR_IF_OP_NEGATE:
+				if(stack[stack_len-1].is_unsigned){
+					stack[stack_len-1].value=(int64_t)(0-(uint64_t)stack[stack_len-1].value);
+				}else if(stack[stack_len-1].value==INT64_MIN){
+					fatal("overflow in negation in preprocessor expression");
+				}else{
+					stack[stack_len-1].value=-stack[stack_len-1].value;
+				}
+				break;
+			case PREPROCESSOR_IF_OP_NOT:
+				stack[stack_len-1]=(struct PreprocessorIfValue){.value=stack[stack_len-1].value==0};
+				break;
+			case PREPROCESSOR_IF_OP_BITWISE_NOT:
+				stack[stack_len-1].value=~stack[stack_len-1].value;
+				break;
+			case PREPROCESSOR_IF_OP_TO_BOOL:
+				stack[stack_len-1]=(struct PreprocessorIfValue){.value=stack[stack_len-1].value!=0};
+				break;
+			case PREPROCESSOR_IF_OP_TO_UNSIGNED:
+				stack[stack_len-1].is_unsigned=true;
+				break;
+
+			case PREPROCESSOR_IF_OP_JUMP:
+				pc=instruction->target;
+				break;
+			case PREPROCESSOR_IF_OP_JUMP_IF_ZERO:
+				stack_len--;
+				if(stack[stack_len].value==0){
+					pc=instruction->target;
+				}
+				break;
+			case PREPROCESSOR_IF_OP_JUMP_IF_NOT_ZERO:
+				stack_len--;
+				if(stack[stack_len].value!=0){
+					pc=instruction->target;
+				}
+				break;
+
+			default:
+				stack_len--;
+				stack[stack_len-1]=PreprocessorIfExpression_applyBinary(instruction->op,stack[stack_len-1],stack[stack_len]);
+				break;
+		}
+	}
+	if(stack_len!=1) fatal("bug: preprocessor expression left %d values on the stack",stack_len);
+
+	expr->value=stack[0].value;
+	expr->value_is_known=true;
+	return expr->value;
+}
@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include<util/util.h>
+#include<util/hashmap.h>
+
+#include<preprocessor/include_report.h>
+
+struct IncludeReportEdge{
+	struct PreprocessorIncludedFile*include;
+	/* index of the included file in the file table */
+	int file_index;
+	/* edges in [index of this edge + 1, subtree_end) are the includes nested in this one */
+	int subtree_end;
+	/* tokens brought in by the include, including nested includes */
+	int64_t num_tokens;
+	/* nothing defined in the included files is used from outside of them */
+	bool removable;
+};
+/* use of file definition_index from file reference_index, also the key in the map of unique uses */
+struct IncludeReportUse{
+	int reference_index;
+	int definition_index;
+};
+
+/* get index of path in the file table (paths are added on first use) */
+static int IncludeReport_fileIndex(hashmap*files,const char*path){
+	int path_len=(int)strlen(path);
+	intptr_t index=(intptr_t)hashmap_get(files,path,path_len);
+	if(index==0){
+		// values are offset by one, since nullptr marks missing entries
+		index=files->len+1;
+		hashmap_set(files,path,path_len,(void*)index);
+	}
+	return (int)index-1;
+}
+
+static int IncludeReportEdge_compareTokens(const void*a,const void*b){
+	const struct IncludeReportEdge*lhs=*(const struct IncludeReportEdge*const*)a;
+	const struct IncludeReportEdge*rhs=*(const struct IncludeReportEdge*const*)b;
+	if(lhs->num_tokens!=rhs->num_tokens){
+		return lhs->num_tokens>rhs->num_tokens?-1:1;
+	}
+	// keep includes with the same number of tokens in graph order
+	return lhs<rhs?-1:(lhs>rhs?1:0);
+}
+
+static void IncludeReport_writeLocation(writer*out,const struct PreprocessorIncludedFile*include){
+	writer_write_str(out,include->includer);
+	writer_write_char(out,':');
+	writer_write_int(out,include->line);
+	writer_write_str(out,": ");
+	writer_write_str(out,include->path);
+}
+
+void Preprocessor_writeIncludeReport(struct Preprocessor*preprocessor,array*uses,writer*out){
+	hashmap files={};
+	hashmap_init(&files);
+
+	// collect include edges (in order of the directives, i.e. nested includes directly follow their includer)
+	int num_edges=0;
+	struct IncludeReportEdge*edges=calloc(preprocessor->included_files.len+1,sizeof(struct IncludeReportEdge));
+	for(int i=0;i<preprocessor->included_files.len;i++){
+		struct PreprocessorIncludedFile*include=array_get(&preprocessor->included_files,i);
+		if(include->depth==0){
+			continue;
+		}
+		edges[num_edges++]=(struct IncludeReportEdge){
+			.include=include,
+			.file_index=IncludeReport_fileIndex(&files,include->path),
+		};
+	}
+	for(int i=0;i<num_edges;i++){
+		struct IncludeReportEdge*edge=&edges[i];
+		edge->subtree_end=i+1;
+		edge->num_tokens=edge->include->num_tokens;
+		while(edge->subtree_end<num_edges && edges[edge->subtree_end].include->depth>edge->include->depth){
+			edge->num_tokens+=edges[edge->subtree_end].include->num_tokens;
+			edge->subtree_end++;
+		}
+	}
+
+	// map uses to file indices, each pair of files only once
+	int num_unique_uses=0;
+	struct IncludeReportUse*unique_uses=calloc(uses->len+1,sizeof(struct IncludeReportUse));
+	hashmap seen_uses={};
+	hashmap_init(&seen_uses);
+	for(int i=0;i<uses->len;i++){
+		struct PreprocessorFileUse*use=array_get(uses,i);
+		struct IncludeReportUse*unique_use=&unique_uses[num_unique_uses];
+		*unique_use=(struct IncludeReportUse){
+			.reference_index=IncludeReport_fileIndex(&files,use->reference_file),
+			.definition_index=IncludeReport_fileIndex(&files,use->definition_file),
+		};
+		if(hashmap_get(&seen_uses,(const char*)unique_use,sizeof(struct IncludeReportUse))==nullptr){
+			hashmap_set(&seen_uses,(const char*)unique_use,sizeof(struct IncludeReportUse),unique_use);
+			num_unique_uses++;
+		}
+	}
+
+	// an include is required if anything defined in its subtree is used from outside of the subtree
+	bool*in_subtree=calloc(files.len+1,sizeof(bool));
+	for(int i=0;i<num_edges;i++){
+		struct IncludeReportEdge*edge=&edges[i];
+		if(edge->include->skipped){
+			continue;
+		}
+
+		for(int j=i;j<edge->subtree_end;j++){
+			if(!edges[j].include->skipped){
+				in_subtree[edges[j].file_index]=true;
+			}
+		}
+		edge->removable=true;
+		for(int j=0;j<num_unique_uses;j++){
+			if(in_subtree[unique_uses[j].definition_index] && !in_subtree[unique_uses[j].reference_index]){
+				edge->removable=false;
+				break;
+			}
+		}
+		for(int j=i;j<edge->subtree_end;j++){
+			in_subtree[edges[j].file_index]=false;
+		}
+	}
+
+	writer_write_str(out,"include graph:\n");
+	for(int i=0;i<num_edges;i++){
+		struct IncludeReportEdge*edge=&edges[i];
+		for(int depth=1;depth<edge->include->depth;depth++){
+			writer_write_str(out,"  ");
+		}
+		IncludeReport_writeLocation(out,edge->include);
+		if(edge->include->skipped){
+			writer_write_str(out," (skipped)\n");
+		}else{
+			writer_write_str(out," (");
+			writer_write_int(out,edge->num_tokens);
+			writer_write_str(out," tokens)\n");
+		}
+	}
+
+	// includes nested in a removable include are removed with it
+	int num_removable=0;
+	struct IncludeReportEdge**removable=calloc(num_edges+1,sizeof(struct IncludeReportEdge*));
+	for(int i=0;i<num_edges;){
+		if(!edges[i].include->skipped && edges[i].removable){
+			removable[num_removable++]=&edges[i];
+			i=edges[i].subtree_end;
+		}else{
+			i++;
+		}
+	}
+	qsort(removable,num_removable,sizeof(struct IncludeReportEdge*),IncludeReportEdge_compareTokens);
+
+	writer_write_str(out,"removable includes:\n");
+	for(int i=0;i<num_removable;i++){
+		char tokens[32];
+		discard snprintf(tokens,sizeof(tokens),"%10lld  ",(long long)removable[i]->num_tokens);
+		writer_write_str(out,tokens);
+		IncludeReport_writeLocation(out,removable[i]->include);
+		writer_write_char(out,'\n');
+	}
+
+	free(removable);
+	free(in_subtree);
+	hashmap_free(&seen_uses);
+	free(unique_uses);
+	free(edges);
+	hashmap_free(&files);
+}
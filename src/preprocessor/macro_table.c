@@ -0,0 +1,102 @@
+#include<util/util.h>
+
+#include<preprocessor/macro_table.h>
+
+static const struct PreprocessorMacroBinding PREPROCESSOR_MACRO_UNBOUND={.define_index=-1,.generation=0};
+
+void PreprocessorMacroTable_init(struct PreprocessorMacroTable*table){
+	*table=(struct PreprocessorMacroTable){
+		.root=nullptr,
+		.depth=0,
+		.epoch=0,
+	};
+}
+
+/* allocate node of the current epoch, leaves start out with all macros unbound, inner nodes without children */
+static struct PreprocessorMacroTableNode* PreprocessorMacroTable_newNode(struct PreprocessorMacroTable*table,arena*node_arena,bool is_leaf){
+	struct PreprocessorMacroTableNode*node=arena_alloc(node_arena,sizeof(struct PreprocessorMacroTableNode));
+	node->epoch=table->epoch;
+	if(is_leaf){
+		for(int i=0;i<PREPROCESSOR_MACRO_TABLE_FANOUT;i++){
+			node->bindings[i]=PREPROCESSOR_MACRO_UNBOUND;
+		}
+	}else{
+		for(int i=0;i<PREPROCESSOR_MACRO_TABLE_FANOUT;i++){
+			node->children[i]=nullptr;
+		}
+	}
+	return node;
+}
+/* get node that can be changed in place, i.e. copy node if it may be shared with a snapshot */
+static struct PreprocessorMacroTableNode* PreprocessorMacroTable_ownNode(struct PreprocessorMacroTable*table,arena*node_arena,struct PreprocessorMacroTableNode*node){
+	if(node->epoch==table->epoch){
+		return node;
+	}
+	struct PreprocessorMacroTableNode*copy=arena_copy(node_arena,sizeof(struct PreprocessorMacroTableNode),node);
+	copy->epoch=table->epoch;
+	return copy;
+}
+
+struct PreprocessorMacroBinding PreprocessorMacroTable_get(const struct PreprocessorMacroTable*table,int id){
+	int shift=table->depth*PREPROCESSOR_MACRO_TABLE_BITS;
+	if(table->root==nullptr || (id>>shift)>=PREPROCESSOR_MACRO_TABLE_FANOUT){
+		return PREPROCESSOR_MACRO_UNBOUND;
+	}
+
+	const struct PreprocessorMacroTableNode*node=table->root;
+	for(;shift>0;shift-=PREPROCESSOR_MACRO_TABLE_BITS){
+		node=node->children[(id>>shift)&(PREPROCESSOR_MACRO_TABLE_FANOUT-1)];
+		if(node==nullptr){
+			return PREPROCESSOR_MACRO_UNBOUND;
+		}
+	}
+	return node->bindings[id&(PREPROCESSOR_MACRO_TABLE_FANOUT-1)];
+}
+void PreprocessorMacroTable_set(struct PreprocessorMacroTable*table,arena*node_arena,int id,struct PreprocessorMacroBinding binding){
+	if(id<0){
+		fatal("invalid macro id %d",id);
+	}
+
+	if(table->root==nullptr){
+		table->root=PreprocessorMacroTable_newNode(table,node_arena,true);
+		table->depth=0;
+	}
+	// add levels on top until the id fits, the old root becomes the first child of the new root
+	while((id>>(table->depth*PREPROCESSOR_MACRO_TABLE_BITS))>=PREPROCESSOR_MACRO_TABLE_FANOUT){
+		struct PreprocessorMacroTableNode*new_root=PreprocessorMacroTable_newNode(table,node_arena,false);
+		new_root->children[0]=table->root;
+		table->root=new_root;
+		table->depth++;
+	}
+
+	// copy path from the root to the binding (only nodes that may be shared)
+	table->root=PreprocessorMacroTable_ownNode(table,node_arena,table->root);
+	struct PreprocessorMacroTableNode*node=table->root;
+	for(int level=table->depth;level>0;level--){
+		int child_index=(id>>(level*PREPROCESSOR_MACRO_TABLE_BITS))&(PREPROCESSOR_MACRO_TABLE_FANOUT-1);
+		struct PreprocessorMacroTableNode*child=node->children[child_index];
+		if(child==nullptr){
+			child=PreprocessorMacroTable_newNode(table,node_arena,level==1);
+		}else{
+			child=PreprocessorMacroTable_ownNode(table,node_arena,child);
+		}
+		node->children[child_index]=child;
+		node=child;
+	}
+	node->bindings[id&(PREPROCESSOR_MACRO_TABLE_FANOUT-1)]=binding;
+}
+
+struct PreprocessorMacroTableSnapshot PreprocessorMacroTable_snapshot(struct PreprocessorMacroTable*table){
+	// all nodes that exist now are shared with the snapshot from here on
+	table->epoch++;
+	return (struct PreprocessorMacroTableSnapshot){
+		.root=table->root,
+		.depth=table->depth,
+	};
+}
+void PreprocessorMacroTable_restore(struct PreprocessorMacroTable*table,struct PreprocessorMacroTableSnapshot snapshot){
+	// the snapshot must stay intact, so that it can be restored again
+	table->epoch++;
+	table->root=snapshot.root;
+	table->depth=snapshot.depth;
+}
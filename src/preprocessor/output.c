@@ -0,0 +1,199 @@
+#include <string.h>
+
+#include<preprocessor/output.h>
+#include<preprocessor/preprocessor.h>
+
+/* output lines skipped with empty lines at most, a line marker is written for larger gaps */
+#define PREPROCESSOR_OUTPUT_MAX_EMPTY_LINES 8
+
+void PreprocessorOutput_init(struct PreprocessorOutput*output,writer*out){
+	*output=(struct PreprocessorOutput){
+		.out=out,
+		.filename=nullptr,
+		.line=0,
+		.at_line_start=true,
+		.line_markers=true,
+		.has_last_token=false,
+	};
+}
+
+static bool PreprocessorOutput_isSameFile(const char*a,const char*b){
+	if(a==b){
+		return true;
+	}
+	return a!=nullptr && b!=nullptr && strcmp(a,b)==0;
+}
+static void PreprocessorOutput_writeSpaces(struct PreprocessorOutput*output,int num_spaces){
+	for(int i=0;i<num_spaces;i++){
+		writer_write_char(output->out,' ');
+	}
+}
+/* returns true if token a is located before token b in the same file */
+static bool PreprocessorOutput_isBefore(const Token*a,const Token*b){
+	return a->line<b->line || (a->line==b->line && a->col<b->col);
+}
+/* start a new output line at the line of token, and indent it like the token is indented in the source */
+static void PreprocessorOutput_moveToLine(struct PreprocessorOutput*output,const Token*token){
+	bool is_far=
+		!PreprocessorOutput_isSameFile(output->filename,token->filename)
+		|| token->line<output->line
+		|| token->line>output->line+PREPROCESSOR_OUTPUT_MAX_EMPTY_LINES;
+	if(is_far && !output->line_markers){
+		// without line markers, a large gap is collapsed into a single empty line
+		if(!output->at_line_start){
+			writer_write_char(output->out,'\n');
+		}
+		if(output->filename!=nullptr){
+			writer_write_char(output->out,'\n');
+		}
+
+		output->filename=token->filename;
+		output->line=token->line;
+		output->at_line_start=true;
+	}else if(is_far){
+		if(!output->at_line_start){
+			writer_write_char(output->out,'\n');
+		}
+		writer_write_str(output->out,"# ");
+		writer_write_int(output->out,token->line);
+		writer_write_str(output->out," \"");
+		writer_write_escaped(output->out,token->filename);
+		writer_write_str(output->out,"\"\n");
+
+		output->filename=token->filename;
+		output->line=token->line;
+		output->at_line_start=true;
+	}else{
+		for(;output->line<token->line;output->line++){
+			writer_write_char(output->out,'\n');
+			output->at_line_start=true;
+		}
+	}
+
+	if(!output->at_line_start){
+		return;
+	}
+
+	PreprocessorOutput_writeSpaces(output,token->col-1);
+}
+/*
+write separation between the last token and token, which are written on the same line
+
+if keep_distance is set, the tokens are placed as far apart as they are in the source
+*/
+static void PreprocessorOutput_separate(struct PreprocessorOutput*output,const Token*token,bool keep_distance){
+	if(output->at_line_start){
+		return;
+	}
+
+	const Token*last_token=&output->last_token;
+	if(
+		keep_distance
+		&& output->has_last_token
+		&& token->filename!=nullptr
+		&& last_token->filename==token->filename
+		&& last_token->line==token->line
+		&& last_token->col+last_token->len<=token->col
+	){
+		PreprocessorOutput_writeSpaces(output,token->col-(last_token->col+last_token->len));
+		return;
+	}
+
+	writer_write_char(output->out,' ');
+}
+
+/* returns the outermost macro invocation whose expansion produced token, nullptr if there is none (or it is unknown) */
+static const struct PreprocessorExpansion* PreprocessorOutput_getInvocation(struct PreprocessorOutput*output,const Token*token){
+	if(output->expansions==nullptr || token->expansion==0){
+		return nullptr;
+	}
+	const struct PreprocessorExpansion*expansion=array_get(output->expansions,(int)token->expansion-1);
+	while(expansion->parent!=0){
+		expansion=array_get(output->expansions,(int)expansion->parent-1);
+	}
+	return expansion;
+}
+/* write spelling of token, embedded bytes are spelled as a comma separated list of integers (all on one line) */
+static void PreprocessorOutput_writeSpelling(struct PreprocessorOutput*output,const Token*token){
+	if(token->tag!=TOKEN_TAG_LITERAL || token->literal.tag!=TOKEN_LITERAL_TAG_EMBED){
+		writer_write(output->out,token->p,token->len);
+		return;
+	}
+
+	for(int64_t i=0;i<token->literal.embed.len;i++){
+		if(i>0){
+			writer_write_char(output->out,',');
+		}
+		writer_write_int(output->out,token->literal.embed.data[i]);
+	}
+}
+
+void PreprocessorOutput_writeTokens(
+	struct PreprocessorOutput*output,
+	int num_source_tokens,
+	const Token*source_tokens,
+	int num_tokens,
+	const Token*tokens
+){
+	if(num_tokens==0){
+		return;
+	}
+
+	PreprocessorOutput_moveToLine(output,&source_tokens[0]);
+
+	/*
+	tokens from the source range appear in the output in source order, tokens that were produced by macro expansion
+	are located elsewhere (in the macro definition, or not in a source file at all).
+	(token spellings may be shared between tokens, so locations are compared by line and column)
+	*/
+	int next_source_index=0;
+	/* index of the last written token in source_tokens, -1 if it was produced by macro expansion */
+	int last_source_index=-1;
+	for(int i=0;i<num_tokens;i++){
+		const Token*token=&tokens[i];
+
+		int source_index=next_source_index;
+		while(source_index<num_source_tokens && PreprocessorOutput_isBefore(&source_tokens[source_index],token)){
+			source_index++;
+		}
+		// (tokens created by ## keep the location of their left operand, but are not part of the source)
+		bool is_source_token=
+			token->expansion==0
+			&& source_index<num_source_tokens
+			&& token->filename==source_tokens[source_index].filename
+			&& token->line==source_tokens[source_index].line
+			&& token->col==source_tokens[source_index].col;
+
+		if(is_source_token){
+			if(token->line!=output->line){
+				PreprocessorOutput_moveToLine(output,token);
+			}else{
+				// source tokens that were removed in between (e.g. a macro name) do not leave a gap
+				PreprocessorOutput_separate(output,token,last_source_index>=0 && source_index==last_source_index+1);
+			}
+			next_source_index=source_index;
+			last_source_index=source_index;
+		}else{
+			const struct PreprocessorExpansion*invocation=PreprocessorOutput_getInvocation(output,token);
+			if(invocation!=nullptr && PreprocessorOutput_isSameFile(output->filename,invocation->filename) && invocation->line>output->line){
+				// the expansion starts on the line of the macro invocation
+				PreprocessorOutput_moveToLine(output,&(Token){.filename=invocation->filename,.line=invocation->line,.col=invocation->col});
+			}else{
+				// tokens from the same macro definition keep their spacing
+				PreprocessorOutput_separate(output,token,last_source_index<0);
+			}
+			last_source_index=-1;
+		}
+
+		PreprocessorOutput_writeSpelling(output,token);
+		output->at_line_start=false;
+		output->last_token=*token;
+		output->has_last_token=true;
+	}
+}
+void PreprocessorOutput_finish(struct PreprocessorOutput*output){
+	if(!output->at_line_start){
+		writer_write_char(output->out,'\n');
+		output->at_line_start=true;
+	}
+}
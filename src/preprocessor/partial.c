@@ -0,0 +1,277 @@
+#include <string.h>
+
+#include<util/util.h>
+
+#include<preprocessor/partial.h>
+
+/* value of a condition in partial mode */
+enum PreprocessorPartialValue{
+	PREPROCESSOR_PARTIAL_VALUE_FALSE,
+	PREPROCESSOR_PARTIAL_VALUE_TRUE,
+	/* depends on a macro that is not known, i.e. the directive is kept */
+	PREPROCESSOR_PARTIAL_VALUE_UNKNOWN,
+};
+
+void PreprocessorPartial_init(struct PreprocessorPartial*partial){
+	*partial=(struct PreprocessorPartial){};
+	hashmap_init(&partial->undefined_macros);
+}
+void PreprocessorPartial_free(struct PreprocessorPartial*partial){
+	hashmap_free(&partial->undefined_macros);
+}
+void PreprocessorPartial_addUndefined(struct PreprocessorPartial*partial,const char*name){
+	hashmap_set(&partial->undefined_macros,name,(int)strlen(name),(void*)name);
+}
+void PreprocessorPartial_attach(struct PreprocessorPartial*partial,struct Preprocessor*preprocessor){
+	Preprocessor_removeDefine(preprocessor,&(Token){.tag=TOKEN_TAG_SYMBOL,.p="__FILE__",.len=(int)strlen("__FILE__")});
+	Preprocessor_removeDefine(preprocessor,&(Token){.tag=TOKEN_TAG_SYMBOL,.p="__LINE__",.len=(int)strlen("__LINE__")});
+	preprocessor->partial=partial;
+}
+
+static bool PreprocessorPartial_isKnown(struct Preprocessor*preprocessor,const Token*name){
+	return Preprocessor_getDefine(preprocessor,name)!=nullptr
+		|| hashmap_get(&preprocessor->partial->undefined_macros,name->p,name->len)!=nullptr;
+}
+static bool PreprocessorPartial_isIdentifier(const Token*token){
+	if(token->tag!=TOKEN_TAG_SYMBOL && token->tag!=TOKEN_TAG_KEYWORD){
+		return false;
+	}
+	char c=token->p[0];
+	return (c>='a' && c<='z') || (c>='A' && c<='Z') || c=='_';
+}
+/*
+append the rest of the directive line to line_tokens, starting with the current token (line continuations are kept)
+
+the current token is the first token after the directive afterwards
+*/
+static void PreprocessorPartial_readLine(struct Preprocessor*preprocessor,array*line_tokens){
+	Token token;
+	if(!TokenIter_lastToken(&preprocessor->token_iter,&token)){
+		return;
+	}
+	int line_num=token.line;
+	while(token.line<=line_num){
+		array_append(line_tokens,&token);
+		bool is_continuation=Token_equalString(&token,"\\");
+		if(!TokenIter_nextToken(&preprocessor->token_iter,&token)){
+			return;
+		}
+		if(is_continuation){
+			line_num=token.line;
+		}
+	}
+}
+/* write tokens of a directive line to the output */
+static void PreprocessorPartial_writeLine(struct Preprocessor*preprocessor,int num_tokens,const Token*tokens){
+	if(preprocessor->output!=nullptr){
+		PreprocessorOutput_writeTokens(preprocessor->output,num_tokens,tokens,num_tokens,tokens);
+		return;
+	}
+	for(int i=0;i<num_tokens;i++){
+		array_append(&preprocessor->tokens_out,&tokens[i]);
+	}
+}
+/*
+write directive line with the name of the directive (the second token) replaced by name, the rest of the line moves
+along so that the spacing stays the same
+*/
+static void PreprocessorPartial_writeRenamedLine(struct Preprocessor*preprocessor,int num_tokens,const Token*tokens,const char*name){
+	int col_shift=(int)strlen(name)-tokens[1].len;
+
+	array renamed_tokens={};
+	array_init(&renamed_tokens,sizeof(Token));
+	for(int i=0;i<num_tokens;i++){
+		Token token=tokens[i];
+		if(i==1){
+			token.p=name;
+			token.len=(int)strlen(name);
+		}else if(i>1 && token.line==tokens[1].line){
+			token.col+=col_shift;
+		}
+		array_append(&renamed_tokens,&token);
+	}
+	PreprocessorPartial_writeLine(preprocessor,renamed_tokens.len,renamed_tokens.data);
+	array_free(&renamed_tokens);
+}
+
+/*
+get value of the condition of an #if/#ifdef/#ifndef/#elif directive, which is in line_tokens ('#', name, operands)
+
+the condition is only evaluated if all identifiers in it are known macros. condition_start is the position of the
+iterator at the name of the directive (the expression is parsed from there, like a regular #if)
+*/
+static enum PreprocessorPartialValue PreprocessorPartial_evaluate(
+	struct Preprocessor*preprocessor,
+	array*line_tokens,
+	const struct TokenIter*condition_start
+){
+	const Token*name=array_get(line_tokens,1);
+	const Token*first_operand=nullptr;
+	for(int i=2;i<line_tokens->len;i++){
+		const Token*token=array_get(line_tokens,i);
+		if(Token_equalString(token,"\\")){
+			continue;
+		}
+		if(first_operand==nullptr){
+			first_operand=token;
+		}
+		if(!PreprocessorPartial_isIdentifier(token)){
+			continue;
+		}
+
+		// the result of __has_include depends on the include paths where the reduced header is used
+		if(Token_equalString(token,"__has_include") || Token_equalString(token,"__has_include_next")){
+			return PREPROCESSOR_PARTIAL_VALUE_UNKNOWN;
+		}
+		// attribute names are not macros
+		if(Token_equalString(token,"__has_c_attribute")){
+			int open_paranthesis=0;
+			for(i++;i<line_tokens->len;i++){
+				const Token*argument_token=array_get(line_tokens,i);
+				if(Token_equalString(argument_token,"(")){
+					open_paranthesis++;
+				}else if(Token_equalString(argument_token,")") && --open_paranthesis==0){
+					break;
+				}
+			}
+			continue;
+		}
+		if(Token_equalString(token,"defined") || Token_equalString(token,"true") || Token_equalString(token,"false")){
+			continue;
+		}
+		if(!PreprocessorPartial_isKnown(preprocessor,token)){
+			return PREPROCESSOR_PARTIAL_VALUE_UNKNOWN;
+		}
+	}
+
+	if(Token_equalString(name,"ifdef") || Token_equalString(name,"ifndef")){
+		if(first_operand==nullptr || first_operand->tag!=TOKEN_TAG_SYMBOL){
+			fatal("expected symbol after #%.*s directive at %s",name->len,name->p,Token_loc(name));
+		}
+		bool is_defined=Preprocessor_getDefine(preprocessor,first_operand)!=nullptr;
+		return is_defined==Token_equalString(name,"ifdef")?PREPROCESSOR_PARTIAL_VALUE_TRUE:PREPROCESSOR_PARTIAL_VALUE_FALSE;
+	}
+
+	// parse the expression again from the start, like a regular #if
+	struct TokenIter line_end=preprocessor->token_iter;
+	preprocessor->token_iter=*condition_start;
+	Token token;
+	if(!TokenIter_nextToken(&preprocessor->token_iter,&token)){
+		fatal("missing expression after #%.*s directive at %s",name->len,name->p,Token_loc(name));
+	}
+	int64_t value=Preprocessor_parseIfExpression(preprocessor,nullptr);
+	preprocessor->token_iter=line_end;
+
+	return value!=0?PREPROCESSOR_PARTIAL_VALUE_TRUE:PREPROCESSOR_PARTIAL_VALUE_FALSE;
+}
+/* take the path after a directive of if_stack, whose condition has value */
+static void PreprocessorPartial_takePath(struct Preprocessor*preprocessor,struct PreprocessorIfStack*if_stack,enum PreprocessorPartialValue value){
+	preprocessor->doSkip=if_stack->inherited_doSkip || if_stack->anyPathEvaluatedToTrue || value==PREPROCESSOR_PARTIAL_VALUE_FALSE;
+	if_stack->anyPathEvaluatedToTrue|=value==PREPROCESSOR_PARTIAL_VALUE_TRUE;
+	if_stack->doSkip=preprocessor->doSkip;
+}
+void PreprocessorPartial_processDirective(struct Preprocessor*preprocessor,const Token*hash_token){
+	Token name;
+	discard TokenIter_lastToken(&preprocessor->token_iter,&name);
+	struct TokenIter condition_start=preprocessor->token_iter;
+
+	array line_tokens={};
+	array_init(&line_tokens,sizeof(Token));
+	array_append(&line_tokens,hash_token);
+	PreprocessorPartial_readLine(preprocessor,&line_tokens);
+
+	if(Token_equalString(&name,"if") || Token_equalString(&name,"ifdef") || Token_equalString(&name,"ifndef")){
+		struct PreprocessorIfStack new_if_stack={
+			.inherited_doSkip=preprocessor->doSkip,
+			.anyPathEvaluatedToTrue=false,
+			.last_directive=-1,
+			.directive_file=nullptr,
+			.items={},
+		};
+		array_init(&new_if_stack.items,sizeof(struct PreprocessorIfStackItem));
+
+		// conditions in skipped blocks are not evaluated
+		enum PreprocessorPartialValue value=PREPROCESSOR_PARTIAL_VALUE_FALSE;
+		if(!new_if_stack.inherited_doSkip){
+			value=PreprocessorPartial_evaluate(preprocessor,&line_tokens,&condition_start);
+		}
+		if(value==PREPROCESSOR_PARTIAL_VALUE_UNKNOWN){
+			PreprocessorPartial_writeLine(preprocessor,line_tokens.len,line_tokens.data);
+			new_if_stack.is_written=true;
+		}
+
+		array_append(&new_if_stack.items,&(struct PreprocessorIfStackItem){
+			.tag=PREPROCESSOR_STACK_ITEM_TYPE_IF,
+			.if_={
+				.if_token=name,
+				.value=value!=PREPROCESSOR_PARTIAL_VALUE_FALSE,
+			},
+		});
+		PreprocessorPartial_takePath(preprocessor,&new_if_stack,value);
+		array_append(&preprocessor->stack,&new_if_stack);
+	}else if(Token_equalString(&name,"elif")){
+		if(preprocessor->stack.len==0) fatal("elif without if at %s",Token_loc(&name));
+		struct PreprocessorIfStack*if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
+
+		enum PreprocessorPartialValue value=PREPROCESSOR_PARTIAL_VALUE_FALSE;
+		if(!if_stack->inherited_doSkip && !if_stack->anyPathEvaluatedToTrue){
+			value=PreprocessorPartial_evaluate(preprocessor,&line_tokens,&condition_start);
+		}
+		if(value==PREPROCESSOR_PARTIAL_VALUE_UNKNOWN){
+			// the first kept directive of a chain opens it
+			if(if_stack->is_written){
+				PreprocessorPartial_writeLine(preprocessor,line_tokens.len,line_tokens.data);
+			}else{
+				PreprocessorPartial_writeRenamedLine(preprocessor,line_tokens.len,line_tokens.data,"if");
+			}
+			if_stack->is_written=true;
+		}else if(value==PREPROCESSOR_PARTIAL_VALUE_TRUE && if_stack->is_written){
+			// the condition is dropped, and the remaining directives of the chain are all removed
+			PreprocessorPartial_writeRenamedLine(preprocessor,2,line_tokens.data,"else");
+		}
+
+		array_append(&if_stack->items,&(struct PreprocessorIfStackItem){
+			.tag=PREPROCESSOR_STACK_ITEM_TYPE_ELSE_IF,
+			.else_if={
+				.else_token=name,
+				.value=value!=PREPROCESSOR_PARTIAL_VALUE_FALSE,
+			},
+		});
+		PreprocessorPartial_takePath(preprocessor,if_stack,value);
+	}else if(Token_equalString(&name,"else")){
+		if(preprocessor->stack.len==0) fatal("else without if at %s",Token_loc(&name));
+		struct PreprocessorIfStack*if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
+
+		enum PreprocessorPartialValue value=PREPROCESSOR_PARTIAL_VALUE_TRUE;
+		if(if_stack->is_written && !if_stack->inherited_doSkip && !if_stack->anyPathEvaluatedToTrue){
+			PreprocessorPartial_writeLine(preprocessor,line_tokens.len,line_tokens.data);
+		}
+
+		array_append(&if_stack->items,&(struct PreprocessorIfStackItem){
+			.tag=PREPROCESSOR_STACK_ITEM_TYPE_ELSE,
+			.else_={
+				.else_token=name,
+			},
+		});
+		PreprocessorPartial_takePath(preprocessor,if_stack,value);
+	}else if(Token_equalString(&name,"endif")){
+		if(preprocessor->stack.len==0) fatal("endif without if at %s",Token_loc(&name));
+		struct PreprocessorIfStack*if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
+		if(if_stack->is_written){
+			PreprocessorPartial_writeLine(preprocessor,line_tokens.len,line_tokens.data);
+		}
+		array_free(&if_stack->items);
+		array_pop_back(&preprocessor->stack);
+
+		if(preprocessor->stack.len==0){
+			preprocessor->doSkip=false;
+		}else{
+			preprocessor->doSkip=((struct PreprocessorIfStack*)array_get(&preprocessor->stack,preprocessor->stack.len-1))->doSkip;
+		}
+	}else if(!preprocessor->doSkip){
+		// any other directive is kept as it is
+		PreprocessorPartial_writeLine(preprocessor,line_tokens.len,line_tokens.data);
+	}
+
+	array_free(&line_tokens);
+}
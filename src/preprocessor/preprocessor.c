@@ -1,10 +1,22 @@
+// struct stat.st_mtim (modification time with nanoseconds)
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h> // open
 #include <libgen.h>
 #include <string.h>
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h>
 #include <unistd.h> // access
 
 #include<util/util.h>
 
 #include<preprocessor/preprocessor.h>
+#include<preprocessor/header_cache.h>
+#include<preprocessor/stats.h>
+#include<preprocessor/conditional_cache.h>
+#include<preprocessor/partial.h>
+#include<time_report.h>
+#include<time_trace.h>
 
 static const char*const PLACEHOLDER_FILENAME="unknownfile";
 
@@ -16,14 +28,36 @@ void Preprocessor_init(struct Preprocessor*preprocessor){
 	*preprocessor=(struct Preprocessor){};
 
 	array_init(&preprocessor->include_paths,sizeof(char*));
+	array_init(&preprocessor->system_include_paths,sizeof(char*));
 	array_init(&preprocessor->defines,sizeof(struct PreprocessorDefine));
-
-	array_init(&preprocessor->already_included_files,sizeof(char*));	
+	hashmap_init(&preprocessor->macros);
+	PreprocessorMacroTable_init(&preprocessor->macro_table);
+	array_init(&preprocessor->expansions,sizeof(struct PreprocessorExpansion));
+	hashmap_init(&preprocessor->if_expressions);
+
+	hashmap_init(&preprocessor->files);
+	hashmap_init(&preprocessor->include_lookups);
+	array_init(&preprocessor->source_files,sizeof(const char*));
+	array_init(&preprocessor->included_files,sizeof(struct PreprocessorIncludedFile));
+	array_init(&preprocessor->pushed_files,sizeof(Tokenizer*));
+	array_init(&preprocessor->pragma_once_files,sizeof(struct PreprocessorFileInfo*));
+	array_init(&preprocessor->embedded_files,sizeof(struct PreprocessorEmbeddedFile));
+	array_init(&preprocessor->snapshot_mappings,sizeof(struct PreprocessorSnapshotMapping));
 
 	array_init(&preprocessor->stack,sizeof(struct PreprocessorIfStack));
 
+	array_init(&preprocessor->include_stack,sizeof(struct TokenIter));
+	preprocessor->max_include_depth=PREPROCESSOR_DEFAULT_MAX_INCLUDE_DEPTH;
+	preprocessor->max_run_tokens=0;
+
+	array_init(&preprocessor->checkpoints,sizeof(struct PreprocessorCheckpoint));
+
 	// read all tokens into memory
 	array_init(&preprocessor->tokens_out,sizeof(Token));
+	array_init(&preprocessor->run_tokens,sizeof(Token));
+	arena_init(&preprocessor->spellings);
+	arena_init(&preprocessor->arena);
+	arena_init(&preprocessor->expansion_arena);
 
 	// include some standard defined macros
 	array a__FILE__tokens={};
@@ -35,11 +69,11 @@ void Preprocessor_init(struct Preprocessor*preprocessor){
 		.literal={
 			.string={
 				.len=(int)strlen(PLACEHOLDER_FILENAME),
-				.str=allocAndCopy(strlen(PLACEHOLDER_FILENAME)+1,PLACEHOLDER_FILENAME),
+				.str=arena_copy_string(&preprocessor->arena,PLACEHOLDER_FILENAME,strlen(PLACEHOLDER_FILENAME)),
 			}
 		}
 	});
-	array_append(&preprocessor->defines,&(struct PreprocessorDefine){
+	Preprocessor_addDefine(preprocessor,&(struct PreprocessorDefine){
 		.name={ .tag=TOKEN_TAG_SYMBOL, .p="__FILE__", .len=strlen("__FILE__"), },
 		.tokens=a__FILE__tokens,
 	});
@@ -51,7 +85,7 @@ void Preprocessor_init(struct Preprocessor*preprocessor){
 		.p="1",
 		.len=strlen("1"),
 	});
-	array_append(&preprocessor->defines,&(struct PreprocessorDefine){
+	Preprocessor_addDefine(preprocessor,&(struct PreprocessorDefine){
 		.name={ .tag=TOKEN_TAG_SYMBOL, .p="__LINE__", .len=strlen("__LINE__"), },
 		.tokens=a__LINE__tokens,
 	});
@@ -63,7 +97,7 @@ void Preprocessor_init(struct Preprocessor*preprocessor){
 		.p="1",
 		.len=strlen("1"),
 	});
-	array_append(&preprocessor->defines,&(struct PreprocessorDefine){
+	Preprocessor_addDefine(preprocessor,&(struct PreprocessorDefine){
 		.name={ .tag=TOKEN_TAG_SYMBOL, .p="__STDC__", .len=strlen("__STDC__"), },
 		.tokens=a__STDC__tokens,
 	});
@@ -84,7 +118,7 @@ void Preprocessor_init(struct Preprocessor*preprocessor){
 		.p="202311L",
 		.len=strlen("202311L"),
 	});
-	array_append(&preprocessor->defines,&(struct PreprocessorDefine){
+	Preprocessor_addDefine(preprocessor,&(struct PreprocessorDefine){
 		.name={ .tag=TOKEN_TAG_SYMBOL, .p="__STDC_VERSION__", .len=strlen("__STDC_VERSION__"), },
 		.tokens=a__STDC_VERSION__tokens,
 	});
@@ -96,79 +130,456 @@ void Preprocessor_init(struct Preprocessor*preprocessor){
 		.p="1",
 		.len=strlen("1"),
 	});
-	array_append(&preprocessor->defines,&(struct PreprocessorDefine){
+	Preprocessor_addDefine(preprocessor,&(struct PreprocessorDefine){
 		.name={ .tag=TOKEN_TAG_SYMBOL, .p="__STDC_HOSTED__", .len=strlen("__STDC_HOSTED__"), },
 		.tokens=a__STDC_HOSTED__tokens,
 	});
 }
 
-int Preprocessor_evalExpression(struct Preprocessor *preprocessor,struct PreprocessorExpression*expr){
-	if(expr->value_is_known){
-		return expr->value;
+/* free list of struct PreprocessorIfStack, including the items of each stack */
+static void PreprocessorIfStacks_free(array*stacks){
+	for(int i=0;i<stacks->len;i++){
+		array_free(&((struct PreprocessorIfStack*)array_get(stacks,i))->items);
+	}
+	array_free(stacks);
+}
+/* copy list of struct PreprocessorIfStack, including the items of each stack */
+static array PreprocessorIfStacks_copy(array*stacks){
+	array copy={};
+	array_init(&copy,sizeof(struct PreprocessorIfStack));
+	for(int i=0;i<stacks->len;i++){
+		struct PreprocessorIfStack stack=*(struct PreprocessorIfStack*)array_get(stacks,i);
+		array items=stack.items;
+		array_init(&stack.items,sizeof(struct PreprocessorIfStackItem));
+		for(int j=0;j<items.len;j++){
+			array_append(&stack.items,array_get(&items,j));
+		}
+		array_append(&copy,&stack);
+	}
+	return copy;
+}
+
+void Preprocessor_free(struct Preprocessor*preprocessor){
+	for(int i=0;i<preprocessor->defines.len;i++){
+		struct PreprocessorDefine*define=array_get(&preprocessor->defines,i);
+		array_free(&define->tokens);
+		if(define->args!=nullptr){
+			array_free(define->args);
+		}
+	}
+	array_free(&preprocessor->defines);
+	array_free(&preprocessor->expansions);
+	hashmap_free(&preprocessor->macros);
+
+	// the cache owns the expression spellings that are used as keys
+	for(int i=0;i<preprocessor->if_expressions.cap;i++){
+		struct hashmap_entry*entry=&preprocessor->if_expressions.entries[i];
+		if(entry->key==nullptr){
+			continue;
+		}
+		struct PreprocessorIfExpression*if_expr=entry->value;
+		array_free(&if_expr->program);
+		array_free(&if_expr->expansion_dependencies);
+		array_free(&if_expr->defined_dependencies);
+		free((char*)entry->key);
 	}
+	hashmap_free(&preprocessor->if_expressions);
+	hashmap_free(&preprocessor->files);
+	hashmap_free(&preprocessor->include_lookups);
 
-	switch(expr->tag){
-		case PREPROCESSOR_EXPRESSION_TAG_DEFINED:
-			expr->value=0;
-			for(int i=0;i<preprocessor->defines.len;i++){
-				Token* define_token=array_get(&preprocessor->defines,i);
-				if(Token_equalString(define_token,expr->defined.name)){
-					expr->value=1;
-					break;
+	PreprocessorIfStacks_free(&preprocessor->stack);
+	for(int i=0;i<preprocessor->checkpoints.len;i++){
+		PreprocessorIfStacks_free(&((struct PreprocessorCheckpoint*)array_get(&preprocessor->checkpoints,i))->stack);
+	}
+	array_free(&preprocessor->checkpoints);
+
+	array_free(&preprocessor->include_paths);
+	array_free(&preprocessor->system_include_paths);
+	array_free(&preprocessor->source_files);
+	array_free(&preprocessor->included_files);
+	array_free(&preprocessor->pushed_files);
+	array_free(&preprocessor->pragma_once_files);
+	for(int i=0;i<preprocessor->embedded_files.len;i++){
+		struct PreprocessorEmbeddedFile*embedded_file=array_get(&preprocessor->embedded_files,i);
+		if(embedded_file->mapping!=nullptr){
+			munmap(embedded_file->mapping,embedded_file->size);
+		}
+	}
+	array_free(&preprocessor->embedded_files);
+	array_free(&preprocessor->include_stack);
+	array_free(&preprocessor->tokens_out);
+	array_free(&preprocessor->run_tokens);
+
+	arena_free(&preprocessor->spellings);
+	arena_free(&preprocessor->arena);
+	arena_free(&preprocessor->expansion_arena);
+
+	for(int i=0;i<preprocessor->snapshot_mappings.len;i++){
+		struct PreprocessorSnapshotMapping*snapshot_mapping=array_get(&preprocessor->snapshot_mappings,i);
+		munmap(snapshot_mapping->mapping,snapshot_mapping->size);
+	}
+	array_free(&preprocessor->snapshot_mappings);
+
+	*preprocessor=(struct Preprocessor){};
+}
+
+struct PreprocessorMacro* Preprocessor_getMacro(struct Preprocessor*preprocessor,const char*name,int name_len){
+	struct PreprocessorMacro*macro=hashmap_get(&preprocessor->macros,name,name_len);
+	if(macro==nullptr){
+		macro=arena_copy(&preprocessor->arena,sizeof(struct PreprocessorMacro),&(struct PreprocessorMacro){
+			.id=preprocessor->macros.len,
+			.name=name,
+			.name_len=name_len,
+		});
+		hashmap_set(&preprocessor->macros,name,name_len,macro);
+	}
+	return macro;
+}
+struct PreprocessorMacroBinding Preprocessor_getMacroBinding(struct Preprocessor*preprocessor,const struct PreprocessorMacro*macro){
+	return PreprocessorMacroTable_get(&preprocessor->macro_table,macro->id);
+}
+struct PreprocessorDefine* Preprocessor_getDefine(struct Preprocessor*preprocessor,const Token*name){
+	struct PreprocessorMacro*macro=nullptr;
+	if(preprocessor->macro_dependencies!=nullptr){
+		// record lookup, including lookups of macros that are not defined
+		macro=Preprocessor_getMacro(preprocessor,name->p,name->len);
+
+		bool already_recorded=false;
+		for(int i=0;i<preprocessor->macro_dependencies->len;i++){
+			struct PreprocessorMacroDependency*dependency=array_get(preprocessor->macro_dependencies,i);
+			if(dependency->macro==macro){
+				already_recorded=true;
+				break;
+			}
+		}
+		if(!already_recorded){
+			array_append(preprocessor->macro_dependencies,&(struct PreprocessorMacroDependency){
+				.macro=macro,
+				.generation=Preprocessor_getMacroBinding(preprocessor,macro).generation,
+			});
+		}
+	}else{
+		macro=hashmap_get(&preprocessor->macros,name->p,name->len);
+	}
+
+	if(macro==nullptr){
+		return nullptr;
+	}
+	int define_index=Preprocessor_getMacroBinding(preprocessor,macro).define_index;
+	if(define_index<0){
+		return nullptr;
+	}
+	return array_get(&preprocessor->defines,define_index);
+}
+/* add entry for the invocation of define at name (the macro name at the invocation), returns the reference to it */
+static uint32_t Preprocessor_addExpansion(struct Preprocessor*preprocessor,const struct PreprocessorDefine*define,const Token*name){
+	if(preprocessor->expansions.len==INT32_MAX){
+		fatal("too many macro expansions at %s",Token_loc(name));
+	}
+	const struct PreprocessorMacro*macro=hashmap_get(&preprocessor->macros,name->p,name->len);
+	array_append(&preprocessor->expansions,&(struct PreprocessorExpansion){
+		.macro_id=macro->id,
+		.define_index=(int)(define-(const struct PreprocessorDefine*)preprocessor->defines.data),
+		.filename=name->filename,
+		.line=name->line,
+		.col=name->col,
+		.parent=name->expansion,
+	});
+	return (uint32_t)preprocessor->expansions.len;
+}
+const struct PreprocessorExpansion* Preprocessor_getExpansion(struct Preprocessor*preprocessor,uint32_t expansion){
+	if(expansion==0){
+		return nullptr;
+	}
+	return array_get(&preprocessor->expansions,(int)expansion-1);
+}
+/* entry of an expansion trace: macro name, definition location, invocation location */
+#define PREPROCESSOR_EXPANSION_TRACE_FORMAT " (in expansion of macro %.*s defined at %s:%d:%d, invoked at %s:%d:%d)"
+const char* Preprocessor_expansionTrace(struct Preprocessor*preprocessor,const Token*token){
+	array trace={};
+	array_init(&trace,sizeof(char));
+	for(
+		const struct PreprocessorExpansion*expansion=Preprocessor_getExpansion(preprocessor,token->expansion);
+		expansion!=nullptr;
+		expansion=Preprocessor_getExpansion(preprocessor,expansion->parent)
+	){
+		const struct PreprocessorDefine*define=array_get(&preprocessor->defines,expansion->define_index);
+		const char*definition_file=define->name.filename!=nullptr?define->name.filename:"<command line>";
+		int entry_len=snprintf(nullptr,0,PREPROCESSOR_EXPANSION_TRACE_FORMAT,
+			define->name.len,define->name.p,definition_file,define->name.line,define->name.col,
+			expansion->filename,expansion->line,expansion->col
+		);
+		char*entry=malloc((size_t)entry_len+1);
+		discard snprintf(entry,(size_t)entry_len+1,PREPROCESSOR_EXPANSION_TRACE_FORMAT,
+			define->name.len,define->name.p,definition_file,define->name.line,define->name.col,
+			expansion->filename,expansion->line,expansion->col
+		);
+		for(int i=0;i<entry_len;i++){
+			array_append(&trace,&entry[i]);
+		}
+		free(entry);
+	}
+	const char*ret=arena_copy_string(&preprocessor->arena,trace.data!=nullptr?trace.data:"",(size_t)trace.len);
+	array_free(&trace);
+	return ret;
+}
+/* record use of define from reference_file in file_uses (if enabled), uses within a file are not recorded */
+static void Preprocessor_recordFileUse(struct Preprocessor*preprocessor,const char*reference_file,const struct PreprocessorDefine*define){
+	const char*definition_file=define->name.filename;
+	if(preprocessor->file_uses==nullptr || reference_file==nullptr || definition_file==nullptr || strcmp(reference_file,definition_file)==0){
+		return;
+	}
+
+	// uses tend to repeat, e.g. the same macro in consecutive lines
+	if(preprocessor->file_uses->len>0){
+		struct PreprocessorFileUse*last_use=array_get(preprocessor->file_uses,preprocessor->file_uses->len-1);
+		if(last_use->reference_file==reference_file && last_use->definition_file==definition_file){
+			return;
+		}
+	}
+	array_append(preprocessor->file_uses,&(struct PreprocessorFileUse){
+		.reference_file=reference_file,
+		.definition_file=definition_file,
+	});
+}
+/* record uses of all macros that are defined and that the value of expr depends on */
+static void Preprocessor_recordIfExpressionUses(struct Preprocessor*preprocessor,struct PreprocessorIfExpression*expr){
+	const char*reference_file=preprocessor->token_iter.tokenizer->token_src;
+	for(int i=0;i<expr->program.len;i++){
+		struct PreprocessorIfInstruction*instruction=array_get(&expr->program,i);
+		if(instruction->op!=PREPROCESSOR_IF_OP_DEFINED){
+			continue;
+		}
+		int define_index=Preprocessor_getMacroBinding(preprocessor,instruction->macro).define_index;
+		if(define_index>=0){
+			Preprocessor_recordFileUse(preprocessor,reference_file,array_get(&preprocessor->defines,define_index));
+		}
+	}
+	for(int i=0;i<expr->expansion_dependencies.len;i++){
+		struct PreprocessorMacroDependency*dependency=array_get(&expr->expansion_dependencies,i);
+		int define_index=Preprocessor_getMacroBinding(preprocessor,dependency->macro).define_index;
+		if(define_index>=0){
+			Preprocessor_recordFileUse(preprocessor,reference_file,array_get(&preprocessor->defines,define_index));
+		}
+	}
+}
+void Preprocessor_addDefine(struct Preprocessor*preprocessor,const struct PreprocessorDefine*define){
+	struct PreprocessorMacro*macro=Preprocessor_getMacro(preprocessor,define->name.p,define->name.len);
+
+	// previous definitions stay in defines, since expansions (see Preprocessor.expansions) may still refer to them
+	array_append(&preprocessor->defines,define);
+	PreprocessorMacroTable_set(&preprocessor->macro_table,&preprocessor->arena,macro->id,(struct PreprocessorMacroBinding){
+		.define_index=preprocessor->defines.len-1,
+		.generation=++preprocessor->macro_generation,
+	});
+}
+void Preprocessor_removeDefine(struct Preprocessor*preprocessor,const Token*name){
+	struct PreprocessorMacro*macro=hashmap_get(&preprocessor->macros,name->p,name->len);
+	if(macro==nullptr || Preprocessor_getMacroBinding(preprocessor,macro).define_index<0){
+		return;
+	}
+
+	PreprocessorMacroTable_set(&preprocessor->macro_table,&preprocessor->arena,macro->id,(struct PreprocessorMacroBinding){
+		.define_index=-1,
+		.generation=++preprocessor->macro_generation,
+	});
+}
+
+struct PreprocessorFileInfo* Preprocessor_getFileInfo(struct Preprocessor*preprocessor,const char*path){
+	struct stat file_stat;
+	if(stat(path,&file_stat)!=0){
+		return nullptr;
+	}
+
+	struct PreprocessorFileId id={};
+	id.dev=file_stat.st_dev;
+	id.ino=file_stat.st_ino;
+
+	struct PreprocessorFileInfo*file_info=hashmap_get(&preprocessor->files,(const char*)&id,sizeof(id));
+	if(file_info==nullptr){
+		file_info=arena_alloc(&preprocessor->arena,sizeof(struct PreprocessorFileInfo));
+		*file_info=(struct PreprocessorFileInfo){
+			.id=id,
+			.path=arena_copy_string(&preprocessor->arena,path,strlen(path)),
+		};
+		hashmap_set(&preprocessor->files,(const char*)&file_info->id,sizeof(file_info->id),file_info);
+	}
+	return file_info;
+}
+/* returns true if the token at index i in tokens is the # that starts a directive, i.e. is the first token on its line */
+static bool Preprocessor_isDirectiveStart(array*tokens,int i){
+	const Token*token=array_get(tokens,i);
+	return Token_equalString(token,"#") && (i==0 || ((const Token*)array_get(tokens,i-1))->line!=token->line);
+}
+/*
+find the include guard of a file, i.e. the macro X if the file (ignoring comments) has the form
+
+#ifndef X (or #if !defined X, or #if !defined(X))
+...
+#endif
+
+returns nullptr if the file is not guarded this way
+*/
+static struct PreprocessorMacro* Preprocessor_findIncludeGuard(struct Preprocessor*preprocessor,const Tokenizer*tokenizer){
+	array tokens={};
+	array_init(&tokens,sizeof(Token));
+	for(int i=0;i<tokenizer->num_tokens;i++){
+		if(tokenizer->tokens[i].tag!=TOKEN_TAG_COMMENT){
+			array_append(&tokens,&tokenizer->tokens[i]);
+		}
+	}
+
+	struct PreprocessorMacro*guard_macro=nullptr;
+	const Token*guard_name=nullptr;
+	int i=0;
+	if(tokens.len>=3 && Preprocessor_isDirectiveStart(&tokens,0)){
+		const Token*directive=array_get(&tokens,1);
+		const Token*operands=array_get(&tokens,2);
+		int num_operands=0;
+		for(int t=2;t<tokens.len && ((const Token*)array_get(&tokens,t))->line==directive->line;t++){
+			num_operands++;
+		}
+
+		if(Token_equalString(directive,"ifndef") && num_operands==1){
+			guard_name=&operands[0];
+		}else if(Token_equalString(directive,"if") && num_operands>=3
+			&& Token_equalString(&operands[0],"!") && Token_equalString(&operands[1],"defined")
+		){
+			if(num_operands==3){
+				guard_name=&operands[2];
+			}else if(num_operands==5 && Token_equalString(&operands[2],"(") && Token_equalString(&operands[4],")")){
+				guard_name=&operands[3];
+			}
+		}
+		i=2+num_operands;
+	}
+	if(guard_name==nullptr || guard_name->tag!=TOKEN_TAG_SYMBOL){
+		goto PREPROCESSOR_FINDINCLUDEGUARD_DONE;
+	}
+
+	// the conditional opened by the guard must only be closed by the last directive in the file
+	int depth=1;
+	for(;i<tokens.len;i++){
+		if(!Preprocessor_isDirectiveStart(&tokens,i) || i+1>=tokens.len){
+			continue;
+		}
+		const Token*directive=array_get(&tokens,i+1);
+		if(Token_equalString(directive,"if") || Token_equalString(directive,"ifdef") || Token_equalString(directive,"ifndef")){
+			depth++;
+		}else if(depth==1 && (Token_equalString(directive,"else") || Token_equalString(directive,"elif"))){
+			goto PREPROCESSOR_FINDINCLUDEGUARD_DONE;
+		}else if(Token_equalString(directive,"endif")){
+			depth--;
+			if(depth==0){
+				// nothing may follow the #endif (apart from tokens on the same line, which are ignored)
+				const Token*last_token=array_get(&tokens,tokens.len-1);
+				if(last_token->line==directive->line){
+					guard_macro=Preprocessor_getMacro(preprocessor,guard_name->p,guard_name->len);
 				}
+				goto PREPROCESSOR_FINDINCLUDEGUARD_DONE;
 			}
+		}
+	}
+
+PREPROCESSOR_FINDINCLUDEGUARD_DONE:
+	array_free(&tokens);
+	return guard_macro;
+}
+
+/* returns true if the macro name is defined (recorded as a use of the definition, see Preprocessor.file_uses) */
+static bool Preprocessor_isDefined(struct Preprocessor*preprocessor,const Token*name){
+	struct PreprocessorDefine*define=Preprocessor_getDefine(preprocessor,name);
+	if(define!=nullptr && preprocessor->file_uses!=nullptr){
+		Preprocessor_recordFileUse(preprocessor,preprocessor->token_iter.tokenizer->token_src,define);
+	}
+	return define!=nullptr;
+}
+
+/*
+search file named by an include argument (without quotes or angle brackets): relative to the current file first for
+local includes ("..."), then in the include paths, then in the system include paths. returns the path of the file
+(allocated in the preprocessor arena), or nullptr if the file does not exist
+*/
+static char* Preprocessor_searchIncludeFile(struct Preprocessor*preprocessor,const char*include_path,bool local_include_path,bool*is_system_header){
+	// go through each entry in include paths and check if file exists there
+	char* include_file_path=nullptr;
+	int num_include_dirs=preprocessor->include_paths.len+preprocessor->system_include_paths.len;
+	for(int i=0-((int)local_include_path);i<num_include_dirs;i++){
+		char* include_dir=nullptr;
+		/* copy of the current file name, which dirname may modify */
+		char*tok_filename=nullptr;
+		if(i==-1){
+			unsigned tok_filename_len=strlen(preprocessor->token_iter.tokenizer->token_src);
+			tok_filename=calloc(tok_filename_len+1,1);
+			strncpy(tok_filename, preprocessor->token_iter.tokenizer->token_src, tok_filename_len);
+			include_dir=dirname(tok_filename);
+		}else if(i<preprocessor->include_paths.len){
+			include_dir=*(char**)array_get(&preprocessor->include_paths,i);
+		}else{
+			include_dir=*(char**)array_get(&preprocessor->system_include_paths,i-preprocessor->include_paths.len);
+			*is_system_header=true;
+		}
+
+		static const int num_extra_chars=2; // for slash and terminating zero
+		include_file_path=calloc(strlen(include_dir)+strlen(include_path)+num_extra_chars,1);
+		discard sprintf(include_file_path,"%s/%s",include_dir,include_path);
+		free(tok_filename);
+
+		if(access(include_file_path,F_OK)!=-1){
+			// the path outlives this function, e.g. for dependency output
+			char*found_path=arena_copy_string(&preprocessor->arena,include_file_path,strlen(include_file_path));
+			free(include_file_path);
+			include_file_path=found_path;
 			break;
-		case PREPROCESSOR_EXPRESSION_TAG_NOT:
-			expr->value=!Preprocessor_evalExpression(preprocessor,expr->not.expr);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_AND:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->and.lhs) && Preprocessor_evalExpression(preprocessor,expr->and.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_OR:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->or.lhs) || Preprocessor_evalExpression(preprocessor,expr->or.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_SUBTRACT:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->subtract.lhs) - Preprocessor_evalExpression(preprocessor,expr->subtract.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_ADD:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->add.lhs) - Preprocessor_evalExpression(preprocessor,expr->add.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_ELSE:
-			expr->value=1;
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_EQUAL:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->equal.lhs) == Preprocessor_evalExpression(preprocessor,expr->equal.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_UNEQUAL:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->equal.lhs) != Preprocessor_evalExpression(preprocessor,expr->equal.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_GREATER_THAN:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->greater_than.lhs) > Preprocessor_evalExpression(preprocessor,expr->greater_than.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_GREATER_THAN_OR_EQUAL:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->greater_than_or_equal.lhs) >= Preprocessor_evalExpression(preprocessor,expr->greater_than_or_equal.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_LESSER_THAN:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->lesser_than.lhs) < Preprocessor_evalExpression(preprocessor,expr->lesser_than.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_LESSER_THAN_OR_EQUAL:
-			expr->value=Preprocessor_evalExpression(preprocessor,expr->lesser_than_or_equal.lhs) <= Preprocessor_evalExpression(preprocessor,expr->lesser_than_or_equal.rhs);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_LITERAL:
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_TERNARY:
-			expr->value=
-				Preprocessor_evalExpression(preprocessor,expr->ternary.condition)
-				? Preprocessor_evalExpression(preprocessor,expr->ternary.then)
-				: Preprocessor_evalExpression(preprocessor,expr->ternary.else_);
-			break;
-		default:
-			fatal("unknown preprocessor expression tag %d",expr->tag);
+		}
+
+		// if file does not exist, free memory and set pointer to null
+		free(include_file_path);
+		include_file_path=nullptr;
 	}
-	expr->value_is_known=true;
-	return expr->value;
+	return include_file_path;
 }
+/*
+like Preprocessor_searchIncludeFile, but every search is only done once per preprocessor (the result of searching a
+"..." argument also depends on the directory of the current file, which is hence part of the key)
+*/
+static const char* Preprocessor_findIncludeFile(struct Preprocessor*preprocessor,const char*include_path,bool local_include_path,bool*is_system_header){
+	const char*current_file=preprocessor->token_iter.tokenizer->token_src;
+	int key_len=(int)strlen(include_path)+2;
+	if(local_include_path){
+		key_len+=(int)strlen(current_file)+1;
+	}
+	char*key=arena_alloc(&preprocessor->arena,(size_t)key_len+1);
+	if(local_include_path){
+		discard sprintf(key,"%s\n\"%s\"",current_file,include_path);
+	}else{
+		discard sprintf(key,"<%s>",include_path);
+	}
 
+	struct PreprocessorIncludeLookup*lookup=hashmap_get(&preprocessor->include_lookups,key,key_len);
+	if(lookup==nullptr){
+		bool found_system_header=false;
+		const char*path=Preprocessor_searchIncludeFile(preprocessor,include_path,local_include_path,&found_system_header);
+		lookup=arena_copy(&preprocessor->arena,sizeof(struct PreprocessorIncludeLookup),&(struct PreprocessorIncludeLookup){
+			.path=path,
+			.is_system_header=found_system_header,
+		});
+		// the key is not copied by the hashmap, and lives in the arena
+		hashmap_set(&preprocessor->include_lookups,key,key_len,lookup);
+	}
+	*is_system_header=lookup->is_system_header;
+	return lookup->path;
+}
+bool Preprocessor_hasInclude(struct Preprocessor*preprocessor,const char*include_argument){
+	int argument_len=(int)strlen(include_argument);
+	if(argument_len<2){
+		fatal("invalid include argument %s",include_argument);
+	}
+	bool local_include_path=include_argument[0]=='"';
+	char*include_path=arena_copy_string(&preprocessor->arena,include_argument+1,(size_t)argument_len-2);
+	bool is_system_header=false;
+	return Preprocessor_findIncludeFile(preprocessor,include_path,local_include_path,&is_system_header)!=nullptr;
+}
 void Preprocessor_processInclude(struct Preprocessor*preprocessor){
 	Token token;
 
@@ -180,69 +591,284 @@ void Preprocessor_processInclude(struct Preprocessor*preprocessor){
 	}
 
 	bool local_include_path=token.p[0]=='"';
+	int include_line=token.line;
 
-	char* include_path=calloc(token.len-1,1);
-	discard sprintf(include_path,"%.*s",token.len-2,token.p+1);
+	char* include_path=arena_copy_string(&preprocessor->arena,token.p+1,token.len-2);
 
 	ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
 	// we just consume the token, we don't use it in the rest of the function body
 	discard ntr;
 
 	if(!preprocessor->doSkip){
-		// go through each entry in include paths and check if file exists there
-		char* include_file_path=nullptr;
-		for(int i=0-((int)local_include_path);i<preprocessor->include_paths.len;i++){
-			char* include_dir=nullptr;
-			if(i==-1){
-				unsigned tok_filename_len=strlen(preprocessor->token_iter.tokenizer->token_src);
-				char*tok_filename=calloc(tok_filename_len+1,1);
-				strncpy(tok_filename, preprocessor->token_iter.tokenizer->token_src, tok_filename_len);
-				include_dir=dirname(tok_filename);
-			}else{
-				include_dir=*(char**)array_get(&preprocessor->include_paths,i);
-			}
+		bool is_system_header=false;
+		const char*include_file_path=Preprocessor_findIncludeFile(preprocessor,include_path,local_include_path,&is_system_header);
+		if(include_file_path==nullptr){
+			fatal("could not find include file %s",include_path);
+		}
 
-			static const int num_extra_chars=2; // for slash and terminating zero
-			include_file_path=calloc(strlen(include_dir)+strlen(include_path)+num_extra_chars,1);
-			discard sprintf(include_file_path,"%s/%s",include_dir,include_path);
+		struct PreprocessorFileInfo*file_info=Preprocessor_getFileInfo(preprocessor,include_file_path);
+		if(file_info==nullptr){
+			fatal("could not stat include file %s",include_file_path);
+		}
 
-			if(access(include_file_path,F_OK)!=-1){
-				break;
+		// remember include for dependency output and the include graph
+		struct PreprocessorIncludedFile included_file={
+			.path=include_file_path,
+			.file_info=file_info,
+			.is_system_header=is_system_header,
+			.includer=preprocessor->token_iter.tokenizer->token_src,
+			.line=include_line,
+			.depth=preprocessor->include_stack.len+1,
+			.skipped=false,
+			.num_tokens=0,
+		};
+
+		// skip files that were already included, if they are protected against that (by #pragma once or an include guard)
+		if(file_info->pragma_once || (file_info->guard_macro!=nullptr && Preprocessor_getMacroBinding(preprocessor,file_info->guard_macro).define_index>=0)){
+			if(preprocessor->stats!=nullptr){
+				PreprocessorStats_skipFile(preprocessor->stats,file_info);
 			}
+			included_file.skipped=true;
+			array_append(&preprocessor->included_files,&included_file);
+			return;
+		}
 
-			// if file does not exist, free memory and set pointer to null
-			free(include_file_path);
-			include_file_path=nullptr;
+		// read and tokenize include file (shared with all other preprocessors in this process)
+		TimeReport_begin("include I/O");
+		Tokenizer*include_tokenizer=HeaderCache_get(include_file_path);
+		TimeReport_end();
+		included_file.num_tokens=include_tokenizer->num_tokens;
+		array_append(&preprocessor->included_files,&included_file);
+		if(!file_info->guard_detected){
+			file_info->guard_macro=Preprocessor_findIncludeGuard(preprocessor,include_tokenizer);
+			file_info->guard_detected=true;
 		}
-		if(include_file_path==nullptr){
-			fatal("could not find include file %s",include_path);
+		struct TokenIter include_token_iter;
+		TokenIter_init(&include_token_iter,include_tokenizer,(struct TokenIterConfig){.skip_comments=true});
+
+		// the current file is on the include stack while the included file is processed
+		int include_depth=preprocessor->include_stack.len+1;
+		if(include_depth>preprocessor->max_include_depth){
+			fatal("#include nested depth %d exceeds maximum of %d (use -fmax-include-depth=DEPTH to increase the maximum)",include_depth,preprocessor->max_include_depth);
+		}
+
+		// the included file is processed next, and the current file is resumed afterwards
+		Preprocessor_pushFile(preprocessor,&include_token_iter);
+	}
+}
+/* parameter of an #embed directive */
+struct PreprocessorEmbedParameter{
+	const char*name;
+	bool present;
+	/* range of the tokens between the parentheses of the parameter, in the directive tokens */
+	int first_token;
+	int num_tokens;
+};
+/* returns true if token is the parameter name, or the name surrounded by double underscores (e.g. __limit__) */
+static bool Preprocessor_isEmbedParameterName(const Token*token,const char*name){
+	int name_len=(int)strlen(name);
+	if(token->len==name_len){
+		return memcmp(token->p,name,(size_t)name_len)==0;
+	}
+	return token->len==name_len+4
+		&& memcmp(token->p,"__",2)==0
+		&& memcmp(token->p+2,name,(size_t)name_len)==0
+		&& memcmp(token->p+2+name_len,"__",2)==0;
+}
+/* get mapping of the file at path, which is mapped on first use */
+static const struct PreprocessorEmbeddedFile* Preprocessor_mapEmbeddedFile(struct Preprocessor*preprocessor,const char*path){
+	for(int i=0;i<preprocessor->embedded_files.len;i++){
+		const struct PreprocessorEmbeddedFile*embedded_file=array_get(&preprocessor->embedded_files,i);
+		if(strcmp(embedded_file->path,path)==0){
+			return embedded_file;
+		}
+	}
+
+	int fd=open(path,O_RDONLY);
+	if(fd<0){
+		fatal("could not open embedded file %s",path);
+	}
+	struct stat file_stat;
+	if(fstat(fd,&file_stat)!=0){
+		fatal("could not stat embedded file %s",path);
+	}
+
+	struct PreprocessorEmbeddedFile embedded_file={
+		.path=path,
+		.mapping=nullptr,
+		.size=(size_t)file_stat.st_size,
+		.dev=file_stat.st_dev,
+		.ino=file_stat.st_ino,
+		.mtime=file_stat.st_mtim,
+	};
+	// empty files cannot be mapped, and have no bytes to point to anyway
+	if(embedded_file.size>0){
+		embedded_file.mapping=mmap(nullptr,embedded_file.size,PROT_READ,MAP_PRIVATE,fd,0);
+		if(embedded_file.mapping==MAP_FAILED){
+			fatal("could not map embedded file %s",path);
+		}
+	}
+	close(fd);
+
+	array_append(&preprocessor->embedded_files,&embedded_file);
+	return array_get(&preprocessor->embedded_files,preprocessor->embedded_files.len-1);
+}
+void Preprocessor_processEmbed(struct Preprocessor*preprocessor){
+	Token token;
+
+	// read resource name
+	int ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+	if(!ntr) fatal("no resource name after #embed");
+	if(token.tag!=TOKEN_TAG_PREP_INCLUDE_ARGUMENT && !(token.tag==TOKEN_TAG_LITERAL && token.literal.tag==TOKEN_LITERAL_TAG_STRING)){
+		fatal("expected resource name after #embed directive but got instead %.*s",token.len,token.p);
+	}
+
+	// read all tokens of the directive (resource name first, then the parameters)
+	array directive_tokens={};
+	array_init(&directive_tokens,sizeof(Token));
+	array_append(&directive_tokens,&token);
+	int line_num=token.line;
+	ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+	while(ntr){
+		// check for line continuation
+		if(Token_equalString(&token,"\\")){
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(ntr){
+				line_num=token.line;
+			}
+			continue;
+		}
+		if(token.line>line_num){
+			break;
 		}
+		array_append(&directive_tokens,&token);
+		ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+	}
 
-		// check if file was already included
-		bool file_already_included=false;
-		for(int i=0;i<preprocessor->already_included_files.len;i++){
-			char* already_included_file=*(char**)array_get(&preprocessor->already_included_files,i);
-			if(strcmp(already_included_file,include_file_path)==0){
-				file_already_included=true;
+	if(preprocessor->doSkip){
+		array_free(&directive_tokens);
+		return;
+	}
+
+	Token*tokens=directive_tokens.data;
+	const Token*resource=&tokens[0];
+
+	// parse parameters, i.e. name(balanced tokens)
+	enum{EMBED_LIMIT,EMBED_PREFIX,EMBED_SUFFIX,EMBED_IF_EMPTY,EMBED_NUM_PARAMETERS};
+	struct PreprocessorEmbedParameter parameters[EMBED_NUM_PARAMETERS]={
+		[EMBED_LIMIT]={.name="limit"},
+		[EMBED_PREFIX]={.name="prefix"},
+		[EMBED_SUFFIX]={.name="suffix"},
+		[EMBED_IF_EMPTY]={.name="if_empty"},
+	};
+	for(int i=1;i<directive_tokens.len;){
+		const Token*name=&tokens[i];
+		struct PreprocessorEmbedParameter*parameter=nullptr;
+		for(int p=0;p<EMBED_NUM_PARAMETERS;p++){
+			if(Preprocessor_isEmbedParameterName(name,parameters[p].name)){
+				parameter=&parameters[p];
 				break;
 			}
 		}
-		if(file_already_included){
-			return;
+		if(parameter==nullptr){
+			fatal("unknown #embed parameter %s",Token_print(name));
+		}
+		if(parameter->present){
+			fatal("duplicate #embed parameter %s",Token_print(name));
+		}
+		if(i+1>=directive_tokens.len || !Token_equalString(&tokens[i+1],"(")){
+			fatal("expected ( after #embed parameter %s",Token_print(name));
 		}
 
-		// read include file
-		File include_file;
-		File_read(include_file_path,&include_file);
-		// tokenize include file
-		Tokenizer include_tokenizer;
-		Tokenizer_init(&include_tokenizer,&include_file);
-		struct TokenIter include_token_iter;
-		TokenIter_init(&include_token_iter,&include_tokenizer,(struct TokenIterConfig){.skip_comments=true});
+		// find the matching closing parenthesis
+		int depth=0;
+		int end=i+1;
+		for(;end<directive_tokens.len;end++){
+			const Token*argument_token=&tokens[end];
+			if(Token_equalString(argument_token,"(") || Token_equalString(argument_token,"[") || Token_equalString(argument_token,"{")){
+				depth++;
+			}else if(Token_equalString(argument_token,")") || Token_equalString(argument_token,"]") || Token_equalString(argument_token,"}")){
+				depth--;
+				if(depth==0){
+					break;
+				}
+			}
+		}
+		if(end==directive_tokens.len){
+			fatal("unterminated #embed parameter %s",Token_print(name));
+		}
+
+		parameter->present=true;
+		parameter->first_token=i+2;
+		parameter->num_tokens=end-(i+2);
+		i=end+1;
+	}
+
+	bool local_path=resource->p[0]=='"';
+	char*resource_name=arena_copy_string(&preprocessor->arena,resource->p+1,(size_t)resource->len-2);
+	bool is_system_file=false;
+	const char*path=Preprocessor_findIncludeFile(preprocessor,resource_name,local_path,&is_system_file);
+	if(path==nullptr){
+		fatal("could not find embedded file %s",resource_name);
+	}
+	const struct PreprocessorEmbeddedFile*embedded_file=Preprocessor_mapEmbeddedFile(preprocessor,path);
+	// the output depends on the file contents (e.g. for dependency output and snapshots)
+	array_append(&preprocessor->source_files,&embedded_file->path);
+
+	int64_t num_bytes=(int64_t)embedded_file->size;
+	if(parameters[EMBED_LIMIT].present){
+		// the limit is evaluated like an #if expression, but is not cached
+		struct PreprocessorIfExpression limit_expr={};
+		array_init(&limit_expr.program,sizeof(struct PreprocessorIfInstruction));
+		array_init(&limit_expr.expansion_dependencies,sizeof(struct PreprocessorMacroDependency));
+		array_init(&limit_expr.defined_dependencies,sizeof(struct PreprocessorMacroDependency));
+		PreprocessorIfExpression_compile(preprocessor,&limit_expr,parameters[EMBED_LIMIT].num_tokens,&tokens[parameters[EMBED_LIMIT].first_token]);
+		int64_t limit=PreprocessorIfExpression_evaluate(preprocessor,&limit_expr);
+		array_free(&limit_expr.program);
+		array_free(&limit_expr.expansion_dependencies);
+		array_free(&limit_expr.defined_dependencies);
+
+		if(limit<0){
+			fatal("#embed limit must not be negative, but is %lld at %s",(long long)limit,Token_loc(resource));
+		}
+		if(limit<num_bytes){
+			num_bytes=limit;
+		}
+	}
+
+	int first_new_token=preprocessor->tokens_out.len;
+	if(num_bytes==0){
+		if(parameters[EMBED_IF_EMPTY].present){
+			Preprocessor_expandMacros(preprocessor,parameters[EMBED_IF_EMPTY].num_tokens,&tokens[parameters[EMBED_IF_EMPTY].first_token],&preprocessor->tokens_out);
+		}
+	}else{
+		if(parameters[EMBED_PREFIX].present){
+			Preprocessor_expandMacros(preprocessor,parameters[EMBED_PREFIX].num_tokens,&tokens[parameters[EMBED_PREFIX].first_token],&preprocessor->tokens_out);
+		}
+
+		// all bytes travel as a single token, which points into the mapping
+		Token embed_token=*resource;
+		embed_token.tag=TOKEN_TAG_LITERAL;
+		embed_token.literal.tag=TOKEN_LITERAL_TAG_EMBED;
+		embed_token.literal.embed.data=embedded_file->mapping;
+		embed_token.literal.embed.len=num_bytes;
+		array_append(&preprocessor->tokens_out,&embed_token);
 
-		Preprocessor_consume(preprocessor,&include_token_iter);
+		if(parameters[EMBED_SUFFIX].present){
+			Preprocessor_expandMacros(preprocessor,parameters[EMBED_SUFFIX].num_tokens,&tokens[parameters[EMBED_SUFFIX].first_token],&preprocessor->tokens_out);
+		}
+	}
+
+	if(preprocessor->output!=nullptr){
+		PreprocessorOutput_writeTokens(
+			preprocessor->output,
+			directive_tokens.len,directive_tokens.data,
+			preprocessor->tokens_out.len-first_new_token,array_get(&preprocessor->tokens_out,first_new_token)
+		);
+		// streamed tokens are not kept around
+		preprocessor->tokens_out.len=first_new_token;
 	}
-	free(include_path);
+	array_free(&directive_tokens);
 }
 void Preprocessor_processDefine(struct Preprocessor*preprocessor){
 	Token token;
@@ -291,7 +917,10 @@ void Preprocessor_processDefine(struct Preprocessor*preprocessor){
 				new_arg=(struct PreprocessorDefineFunctionlikeArg){
 					.tag=PREPROCESSOR_DEFINE_FUNCTIONLIKE_ARG_TYPE_VARARGS,
 					.name={
-						.name=*Token_fromString("__VA_ARGS__")
+						.name={
+							.len=(int)strlen("__VA_ARGS__"),
+							.p="__VA_ARGS__",
+						}
 					}
 				};
 			}
@@ -303,7 +932,7 @@ void Preprocessor_processDefine(struct Preprocessor*preprocessor){
 		if(Token_equalString(&token,"(") && args==nullptr && token.col==define_name.len+define_name.col /* i.e. no whitespace between macro name and open paranthesis */){
 			done_parsing_args=false;
 
-			args=malloc(sizeof(array));
+			args=arena_alloc(&preprocessor->arena,sizeof(array));
 			array_init(args,sizeof(struct PreprocessorDefineFunctionlikeArg));
 			continue;
 		}
@@ -344,14 +973,19 @@ void Preprocessor_processDefine(struct Preprocessor*preprocessor){
 			printf("\n");
 		}
 
-		array_append(
-			&preprocessor->defines,
+		Preprocessor_addDefine(
+			preprocessor,
 			&(struct PreprocessorDefine){
 				.name=define_name,
 				.tokens=define_value,
 				.args=args,
 			}
 		);
+	}else{
+		array_free(&define_value);
+		if(args!=nullptr){
+			array_free(args);
+		}
 	}
 }
 void Preprocessor_processUndefine(struct Preprocessor*preprocessor){
@@ -362,27 +996,15 @@ void Preprocessor_processUndefine(struct Preprocessor*preprocessor){
 		fatal("expected symbol after #undef directive but got instead %s",Token_print(&token));
 	}
 
-	// copy undef name to string
-	char* define_name=calloc(token.len+1,1);
-	discard sprintf(define_name,"%.*s",token.len,token.p);
+	Token define_name=token;
 
 	// iter past undef argument
 	ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
 
 	// remove define from list of defines
 	if(!preprocessor->doSkip){
-		for(int i=0;i<preprocessor->defines.len;i++){
-			Token* define_token=array_get(&preprocessor->defines,i);
-			if(Token_equalString(define_token,define_name)){
-				// TODO(patrick): this needs a better solution, but the array api
-				// currently does not support removing elements from
-				// an arbitrary index
-				define_token->len=0;
-				break;
-			}
-		}
+		Preprocessor_removeDefine(preprocessor,&define_name);
 	}
-	free(define_name);
 }
 void Preprocessor_processPragma(struct Preprocessor*preprocessor){
 	Token token={};
@@ -396,10 +1018,16 @@ void Preprocessor_processPragma(struct Preprocessor*preprocessor){
 			return;
 		}
 
-		// add file to list of already included files
+		// mark current file as included once
 		const char*include_path=preprocessor->token_iter.tokenizer->token_src;
-		char* include_path_copy=allocAndCopy(strlen(include_path)+1,include_path);
-		array_append(&preprocessor->already_included_files,&include_path_copy);
+		struct PreprocessorFileInfo*file_info=Preprocessor_getFileInfo(preprocessor,include_path);
+		if(file_info==nullptr){
+			fatal("could not stat file %s",include_path);
+		}
+		if(!file_info->pragma_once){
+			file_info->pragma_once=true;
+			array_append(&preprocessor->pragma_once_files,&file_info);
+		}
 
 		return;
 	}
@@ -468,43 +1096,251 @@ some rules/observations:
 - function-like macro arguments cannot be expanded into an argument list, e.g. #define F1(a) (a) // #define F2 F1(1,2) <- this does not work
 - recursive expansion is not allowed, which makes it possible to have a macro with the same name as a function (the macro will be replaced once, emitting the same name again, but because of forbidden recursion, the name will not be recognized as another macro and hence not be expanded again)
 */
+struct PreprocessorGenerator{
+	struct PreprocessorDefine*define;
+	/* generators of the macro invocation (shared by all tokens emitted by the invocation) */
+	const struct PreprocessorGenerator*parent;
+};
 struct PreprocessorExpandedToken{
 	Token token;
-	/* names of macros that generated this token, i.e. item type is struct PreprocessorDefine* */
-	array generators;
+	/* macros that generated this token, innermost first (nullptr if the token was not generated by a macro) */
+	const struct PreprocessorGenerator*generators;
 };
-
 /*
-expand tokens in tokens_in and append expanded tokens to tokens_out
+fully macro-expanded value of a function-like macro argument
 
-tokens_out must already be initialized
-
-preprocessor directives in tokens_in are not allowed
+computed on first use, and then reused for all other uses of the argument in the same macro invocation. arguments
+that are only used as operands of # or ## are never expanded.
 */
-void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_in_arg,Token*tokens_in_arg,array*tokens_out_arg){
-	if(num_tokens_in_arg==0){
-		return;
-	}
+struct PreprocessorArgumentExpansion{
+	bool expanded;
+	/* item type is Token */
+	array tokens;
+};
 
-	// copy input arguments into expansion struct (PreprocessorExpandedToken)
-	array tokens_in_={};
-	array*tokens_in=&tokens_in_;
-	array_init(&tokens_in_,sizeof(struct PreprocessorExpandedToken));
+static void Preprocessor_expandExpandedTokens(struct Preprocessor*preprocessor,array*tokens_in_arg,array*tokens_out_arg);
 
-	for(int i=0;i<num_tokens_in_arg;i++){
-		/*tokens_in[i].token=tokens_in_arg[i];
-		array_init(&tokens_in[i].generators,sizeof(struct PreprocessorDefine));*/
-		struct PreprocessorExpandedToken token_in={
-			.token=tokens_in_arg[i],
-		};
-		array_init(&token_in.generators,sizeof(struct PreprocessorDefine*));
+/* returns true if c may appear in an identifier */
+static bool Preprocessor_isIdentifierChar(char c){
+	return (c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='_';
+}
+/* returns true if tokens a and b were separated by whitespace in the source */
+static bool Preprocessor_tokensAreSeparated(const Token*a,const Token*b){
+	return a->filename!=b->filename || a->line!=b->line || a->col+a->len<b->col;
+}
 
-		array_append(&tokens_in_,&token_in);
+/* returns true if token is a string or character literal (with or without encoding prefix) */
+static bool Preprocessor_isQuotedLiteral(const Token*token){
+	if(token->tag!=TOKEN_TAG_LITERAL){
+		return false;
+	}
+	// skip the encoding prefix (L, u, U or u8)
+	int quote_index=0;
+	while(quote_index<token->len && quote_index<2 && strchr("LuU8",token->p[quote_index])!=nullptr){
+		quote_index++;
+	}
+	return quote_index<token->len && (token->p[quote_index]=='"' || token->p[quote_index]=='\'');
+}
+/* create string literal token from the spelling of tokens (# operator), spelling is allocated in the preprocessor arena */
+static Token Preprocessor_stringify(struct Preprocessor*preprocessor,const Token*hash_token,int num_tokens,const Token*tokens){
+	// get length first, to allocate the spelling in one go
+	int len=2;
+	for(int i=0;i<num_tokens;i++){
+		const Token*token=&tokens[i];
+		if(i>0 && Preprocessor_tokensAreSeparated(&tokens[i-1],token)){
+			len++;
+		}
+		bool escape=Preprocessor_isQuotedLiteral(token);
+		for(int c=0;c<token->len;c++){
+			len+=1+(int)(escape && (token->p[c]=='"' || token->p[c]=='\\'));
+		}
 	}
 
-	/* write output into this array, which may be overwritten at any expansion level */
-	array tokens_out_={};
-	array*tokens_out=&tokens_out_;
+	// whitespace between tokens becomes a single space, and quotes and backslashes in literals are escaped
+	char*spelling=arena_alloc(&preprocessor->spellings,len+1);
+	int offset=0;
+	spelling[offset++]='"';
+	for(int i=0;i<num_tokens;i++){
+		const Token*token=&tokens[i];
+		if(i>0 && Preprocessor_tokensAreSeparated(&tokens[i-1],token)){
+			spelling[offset++]=' ';
+		}
+		bool escape=Preprocessor_isQuotedLiteral(token);
+		for(int c=0;c<token->len;c++){
+			if(escape && (token->p[c]=='"' || token->p[c]=='\\')){
+				spelling[offset++]='\\';
+			}
+			spelling[offset++]=token->p[c];
+		}
+	}
+	spelling[offset++]='"';
+	spelling[offset]=0;
+
+	return (Token){
+		.tag=TOKEN_TAG_LITERAL,
+		.filename=hash_token->filename,
+		.line=hash_token->line,
+		.col=hash_token->col,
+		.len=len,
+		.p=spelling,
+		.literal={
+			.tag=TOKEN_LITERAL_TAG_STRING,
+			.string={
+				.len=len-2,
+				.str=spelling+1,
+			}
+		}
+	};
+}
+/*
+returns true if the tokens at index and index+1 of a replacement list form the concatenation operator (##)
+
+the tokenizer splits ## into two # tokens, which only form the operator if they are adjacent in the source, e.g. the
+replacement list # ## # pastes two (separate) # tokens
+*/
+static bool Preprocessor_isConcatenation(array*replacement_tokens,int index){
+	if(index+1>=replacement_tokens->len){
+		return false;
+	}
+	const Token*first=array_get(replacement_tokens,index);
+	const Token*second=array_get(replacement_tokens,index+1);
+	return Token_equalString(first,"#")
+		&& Token_equalString(second,"#")
+		&& first->filename==second->filename
+		&& first->line==second->line
+		&& first->col+1==second->col;
+}
+/* returns true if token is a placemarker, which stands in for an empty operand of ## */
+static bool Preprocessor_isPlacemarker(const Token*token){
+	return token->tag==TOKEN_TAG_UNDEFINED && token->len==0;
+}
+/* returns the index of the argument (item type struct PreprocessorDefine) named by token, -1 if there is none */
+static int Preprocessor_getArgumentIndex(array*arguments,const Token*token){
+	for(int arg_index=0;arg_index<arguments->len;arg_index++){
+		const struct PreprocessorDefine*arg_define=array_get(arguments,arg_index);
+		if(Token_equalToken(token,&arg_define->name)){
+			return arg_index;
+		}
+	}
+	return -1;
+}
+/* concatenate spelling of two tokens into a new token (## operator), spelling is allocated in the preprocessor arena */
+static Token Preprocessor_pasteTokens(struct Preprocessor*preprocessor,const Token*left,const Token*right){
+	int len=left->len+right->len;
+	// followed by a newline, because the tokenizer only finishes tokens that are terminated by some other character
+	char*spelling=arena_alloc(&preprocessor->spellings,len+2);
+	memcpy(spelling,left->p,left->len);
+	memcpy(spelling+left->len,right->p,right->len);
+	spelling[len]='\n';
+	spelling[len+1]=0;
+
+	Token pasted_token={
+		.tag=TOKEN_TAG_SYMBOL,
+		.len=len,
+		.p=spelling,
+	};
+
+	// fast path: pasting identifiers (and numbers to identifiers) gives an identifier (or keyword)
+	bool is_identifier=len>0 && !(spelling[0]>='0' && spelling[0]<='9');
+	for(int i=0;i<len && is_identifier;i++){
+		is_identifier=Preprocessor_isIdentifierChar(spelling[i]);
+	}
+	if(is_identifier){
+		Token_map(&pasted_token);
+	}else{
+		// lex the result like any other source text, to classify it (e.g. as numeric literal)
+		File pasted_file;
+		File_fromString(left->filename,spelling,&pasted_file);
+		Tokenizer pasted_tokenizer={};
+		Tokenizer_init(&pasted_tokenizer,&pasted_file);
+		int num_pasted_tokens=pasted_tokenizer.num_tokens;
+		if(num_pasted_tokens==1){
+			pasted_token=pasted_tokenizer.tokens[0];
+		}
+		free(pasted_tokenizer.tokens);
+
+		if(num_pasted_tokens!=1){
+			// the tokenizer does not merge some punctuators (e.g. <<), which still form a single token
+			for(int i=0;i<len;i++){
+				if(Preprocessor_isIdentifierChar(spelling[i]) || spelling[i]=='"' || spelling[i]=='\''){
+					fatal("pasting %s and %s does not give a valid preprocessing token",Token_print(left),Token_print(right));
+				}
+			}
+			pasted_token.tag=TOKEN_TAG_KEYWORD;
+		}
+	}
+
+	pasted_token.filename=left->filename;
+	pasted_token.line=left->line;
+	pasted_token.col=left->col;
+	return pasted_token;
+}
+
+/*
+expand tokens in tokens_in and append expanded tokens to tokens_out
+
+tokens_out must already be initialized
+
+preprocessor directives in tokens_in are not allowed
+*/
+void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_in_arg,Token*tokens_in_arg,array*tokens_out_arg){
+	if(num_tokens_in_arg==0){
+		return;
+	}
+
+	TimeReport_begin("macro expansion");
+
+	// copy input arguments into expansion struct (PreprocessorExpandedToken)
+	array tokens_in_={};
+	array*tokens_in=&tokens_in_;
+	array_init_arena(&tokens_in_,sizeof(struct PreprocessorExpandedToken),&preprocessor->expansion_arena);
+
+	for(int i=0;i<num_tokens_in_arg;i++){
+		/*tokens_in[i].token=tokens_in_arg[i];
+		array_init(&tokens_in[i].generators,sizeof(struct PreprocessorDefine));*/
+		struct PreprocessorExpandedToken token_in={
+			.token=tokens_in_arg[i],
+			.generators=nullptr,
+		};
+		array_append(&tokens_in_,&token_in);
+	}
+
+	Preprocessor_expandExpandedTokens(preprocessor,tokens_in,tokens_out_arg);
+	arena_reset(&preprocessor->expansion_arena);
+
+	TimeReport_end();
+}
+/*
+expand a function-like macro argument (argument pre-expansion)
+
+argument_tokens is the argument as it appeared in the invocation (item type struct PreprocessorExpandedToken), so that
+the argument is expanded in the context of the macros that generated its tokens. expanded tokens are appended to
+tokens_out (item type Token).
+*/
+static void Preprocessor_expandArgument(struct Preprocessor*preprocessor,array*argument_tokens,array*tokens_out){
+	if(argument_tokens->len==0){
+		return;
+	}
+
+	array tokens_in={};
+	array_init_arena(&tokens_in,sizeof(struct PreprocessorExpandedToken),&preprocessor->expansion_arena);
+	for(int i=0;i<argument_tokens->len;i++){
+		array_append(&tokens_in,array_get(argument_tokens,i));
+	}
+
+	Preprocessor_expandExpandedTokens(preprocessor,&tokens_in,tokens_out);
+}
+/*
+expand tokens in tokens_in_arg (item type struct PreprocessorExpandedToken, which is consumed) and append expanded
+tokens to tokens_out_arg (item type Token)
+*/
+static void Preprocessor_expandExpandedTokens(struct Preprocessor*preprocessor,array*tokens_in_arg,array*tokens_out_arg){
+	array tokens_in_=*tokens_in_arg;
+	array*tokens_in=&tokens_in_;
+
+	/* write output into this array, which may be overwritten at any expansion level */
+	array tokens_out_={};
+	array*tokens_out=&tokens_out_;
 
 	/* indicate if any token got expanded in current expansion level */
 	bool anyTokenGotExpanded=false;
@@ -513,7 +1349,7 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 	while(1){
 		anyTokenGotExpanded=false;
 
-		array_init(tokens_out,sizeof(struct PreprocessorExpandedToken));
+		array_init_arena(tokens_out,sizeof(struct PreprocessorExpandedToken),&preprocessor->expansion_arena);
 
 		for(int i=0;i<tokens_in->len;i++){
 			struct PreprocessorExpandedToken* token_in=array_get(tokens_in,i);
@@ -527,30 +1363,47 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 				default:
 					goto PREPROCESSOR_EXPANDMACROS_APPEND_TOKEN;
 			}
+			// tokens that were not expanded because they named a macro that generated them are never expanded again
+			if(token_in->token.alreadyExpanded){
+				goto PREPROCESSOR_EXPANDMACROS_APPEND_TOKEN;
+			}
 
 			// check if token is a macro
 			bool current_token_was_expanded=false;
-			for(int j=0;(!current_token_was_expanded) && (j<preprocessor->defines.len);j++){
-				struct PreprocessorDefine* define=array_get(&preprocessor->defines,j);
-				
-				if(Token_equalToken(&define->name,&token_in->token)){
-					// check if this macro was already expanded
-					bool already_expanded=false;
-					for(int k=0;k<token_in->generators.len;k++){
-						struct PreprocessorDefine* generator=*(struct PreprocessorDefine**)array_get(&token_in->generators,k);
-						if(generator==define){
-							already_expanded=true;
-							break;
-						}
-					}
-					if(already_expanded){
-						continue;
+			struct PreprocessorDefine* define=Preprocessor_getDefine(preprocessor,&token_in->token);
+			if(define!=nullptr){
+				// check if this macro was already expanded
+				bool already_expanded=false;
+				for(const struct PreprocessorGenerator*generator=token_in->generators;generator!=nullptr;generator=generator->parent){
+					if(generator->define==define){
+						already_expanded=true;
+						break;
 					}
+				}
+				if(already_expanded){
+					// the token may end up in an argument that is expanded on its own, where the generators are not known
+					token_in->token.alreadyExpanded=true;
+				}
+
+				// the name of a function-like macro is only an invocation if it is followed by an argument list
+				bool is_invocation=define->args==nullptr || (
+					i+1<tokens_in->len
+					&& Token_equalString(&((struct PreprocessorExpandedToken*)array_get(tokens_in,i+1))->token,"(")
+				);
 
+				if(!already_expanded && is_invocation){
 					current_token_was_expanded=true;
 
-					// append matched macro to list of generators for expanded_token
-					array_append(&expanded_token->generators,&define);
+					// all tokens emitted by this invocation are generated by the matched macro, in addition to the
+					// generators of the invocation itself
+					struct PreprocessorGenerator*invocation_generators=arena_alloc(&preprocessor->arena,sizeof(struct PreprocessorGenerator));
+					*invocation_generators=(struct PreprocessorGenerator){
+						.define=define,
+						.parent=expanded_token->generators,
+					};
+					// tokens from the replacement list refer to this invocation
+					uint32_t invocation_expansion=Preprocessor_addExpansion(preprocessor,define,&expanded_token->token);
+					TimeTrace_begin("macro expansion",define->name.p,define->name.len);
 
 					// print info about which token got expanded
 					if(DEBUG_PRINTS){
@@ -565,7 +1418,10 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 					// get input arguments, store them to allow expansion
 					// item type is struct PreprocessorDefine, since arguments and defines work essentially the same, only that arguments are only valid for one expansion step
 					array arguments={};
-					array_init(&arguments,sizeof(struct PreprocessorDefine));
+					array_init_arena(&arguments,sizeof(struct PreprocessorDefine),&preprocessor->expansion_arena);
+					// tokens of each argument including their generators (item type is array of struct PreprocessorExpandedToken)
+					array argument_sources={};
+					array_init_arena(&argument_sources,sizeof(array),&preprocessor->expansion_arena);
 
 					// if the macro is function-like, parse and store arguments
 					if(define->args!=nullptr){
@@ -582,10 +1438,12 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 						// handle macro arguments
 						while(1){
 							array arg_tokens={};
-							array_init(&arg_tokens,sizeof(Token));
+							array_init_arena(&arg_tokens,sizeof(Token),&preprocessor->expansion_arena);
+							array arg_source={};
+							array_init_arena(&arg_source,sizeof(struct PreprocessorExpandedToken),&preprocessor->expansion_arena);
 							/* list of chars to close nested statements, though only () qualify, others, e.g. curly braces, do not have to be closed */
 							array nested_char_stack={};
-							array_init(&nested_char_stack,sizeof(char));
+							array_init_arena(&nested_char_stack,sizeof(char),&preprocessor->expansion_arena);
 							while(1){
 								if(i>=tokens_in->len) fatal("expected argument list after function-like macro %s",Token_print(&token_in->token));
 								struct PreprocessorExpandedToken* define_token=array_get(tokens_in,i);
@@ -612,8 +1470,10 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 									array_pop_back(&nested_char_stack);
 								}
 								i+=1;
-								array_append(&arg_tokens,define_token);
+								array_append(&arg_tokens,&define_token->token);
+								array_append(&arg_source,define_token);
 							}
+							array_free(&nested_char_stack);
 							// 3) create temporary define
 							struct PreprocessorDefine arg_define={
 								.name={},
@@ -622,6 +1482,7 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 							};
 							// 4) add define to preprocessor
 							array_append(&arguments,&arg_define);
+							array_append(&argument_sources,&arg_source);
 
 							// 5) if next token is closing paranthesis, break
 							const Token token_in_token=((struct PreprocessorExpandedToken*)array_get(tokens_in,i))->token;
@@ -651,16 +1512,18 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 
 						int min_number_of_args=define->args->len-(int)macro_has_vararg_argument;
 						if(arguments.len<min_number_of_args){
-							fatal("not enough arguments at %s",Token_print(&expanded_token->token));
+							fatal("not enough arguments at %s%s",Token_print(&expanded_token->token),Preprocessor_expansionTrace(preprocessor,&expanded_token->token));
 						}
 						if(arguments.len>min_number_of_args && !macro_has_vararg_argument){
-							fatal("too many arguments at %s",Token_print(&expanded_token->token));
+							fatal("too many arguments at %s%s",Token_print(&expanded_token->token),Preprocessor_expansionTrace(preprocessor,&expanded_token->token));
 						}
 
 						// combine trailing arguments into __VA_ARGS__ argument
 						if(macro_has_vararg_argument){
 							array args={};
-							array_init(&args,sizeof(Token));
+							array_init_arena(&args,sizeof(Token),&preprocessor->expansion_arena);
+							array args_source={};
+							array_init_arena(&args_source,sizeof(struct PreprocessorExpandedToken),&preprocessor->expansion_arena);
 
 							// count number of items to pop from macro invocation argument list
 							int num_args_to_pop=0;
@@ -669,7 +1532,15 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 
 								// vararg is expanded as argument list, i.e. commas between arguments need to be preserved
 								if(i>min_number_of_args){ // on all iterations except the first one
-									array_append(&args,Token_fromString(","));
+									Token comma={
+										.len=1,
+										.p=",",
+									};
+									array_append(&args,&comma);
+									array_append(&args_source,&(struct PreprocessorExpandedToken){
+										.token=comma,
+										.generators=nullptr,
+									});
 								}
 
 								// append tokens from arg
@@ -678,10 +1549,19 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 									Token*tok=array_get(&arg->tokens,a);
 									array_append(&args,tok);
 								}
+								array_free(&arg->tokens);
+								array*arg_source=array_get(&argument_sources,i);
+								for(int a=0;a<arg_source->len;a++){
+									array_append(&args_source,array_get(arg_source,a));
+								}
+								array_free(arg_source);
 							}
 
 							struct PreprocessorDefine vararg={
-								.name=*Token_fromString("__VA_ARGS__"),
+								.name={
+									.len=(int)strlen("__VA_ARGS__"),
+									.p="__VA_ARGS__",
+								},
 								.tokens=args,
 							};
 
@@ -689,10 +1569,12 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 							while(num_args_to_pop>0){
 								num_args_to_pop-=1;
 								array_pop_back(&arguments);
+								array_pop_back(&argument_sources);
 							}
 
 							// append vararg
 							array_append(&arguments,&vararg);
+							array_append(&argument_sources,&args_source);
 						}
 
 						for(int arg_index=0;arg_index<define->args->len;arg_index++){
@@ -714,161 +1596,141 @@ void Preprocessor_expandMacros(struct Preprocessor*preprocessor,int num_tokens_i
 						// do not skip over closing paranthesis (with i++) here because the loop step will do that
 					}
 
-					// go through each token emitted by the macro, check if it matches the name of an argument, and replace it with the argument value if it does
+					// arguments are expanded lazily, and at most once per invocation
+					array argument_expansions={};
+					array_init_arena(&argument_expansions,sizeof(struct PreprocessorArgumentExpansion),&preprocessor->expansion_arena);
+					for(int arg_index=0;arg_index<arguments.len;arg_index++){
+						array_append(&argument_expansions,&(struct PreprocessorArgumentExpansion){});
+					}
+
+					// go through each token emitted by the macro, and replace the names of arguments with their values
 					array new_tokens_={};
-					array_init(&new_tokens_,sizeof(Token));
+					array_init_arena(&new_tokens_,sizeof(Token),&preprocessor->expansion_arena);
 					array*new_tokens=&new_tokens_;
+					/* index in new_tokens of the right operand of a pending concatenation (##), -1 if there is none */
+					int paste_index=-1;
 					for(int define_token_index=0;define_token_index<define->tokens.len;define_token_index++){
 						// this is the next token emitted by the macro
 						Token define_token=*(Token*)array_get(&define->tokens,define_token_index);
 
-						// go through arguments and replace token if it is found there
-						bool replaced=false;
-						for(int arg_index=0;arg_index<arguments.len;arg_index++){
-							struct PreprocessorDefine* arg_define=array_get(&arguments,arg_index);
-							if(Token_equalToken(&define_token,&arg_define->name)){
-								
-								// check for preprocessor operators, part 1/2: stringification operator, which is only allowed on macro arguments
-								if(new_tokens->len>=1
-									&& /* n-1 token is hash */ Token_equalString(array_get(new_tokens,new_tokens->len-1),"#")
-									&& !(new_tokens->len>=2 && /* n-2 token is not hash (i.e. this is not preceding a concatenation operator) */ Token_equalString(array_get(new_tokens,new_tokens->len-2),"#"))
-								){
-									// pop last token (hash)
-									Token hashToken=*(Token*)array_get(new_tokens,new_tokens->len-1);
-									array_pop_back(new_tokens);
-
-									// concatenate all tokens in arg_define to a single string
-									int total_str_len=0;
-									for(int j=0;j<arg_define->tokens.len;j++){
-										Token* arg_define_token=array_get(&arg_define->tokens,j);
-										total_str_len+=arg_define_token->len;
-									}
-									char* arg_str=calloc(total_str_len+1,1);
-									int str_offset=0;
-									for(int j=0;j<arg_define->tokens.len;j++){
-										Token* arg_define_token=array_get(&arg_define->tokens,j);
-										strncpy(arg_str+str_offset,arg_define_token->p,arg_define_token->len);
-										str_offset+=arg_define_token->len;
-									}
-									println("stringified %.*s to %s",arg_define->name.len,arg_define->name.p,arg_str);
-
-									char* arg_str_out=calloc(1,total_str_len+3);
-									discard snprintf(arg_str_out,total_str_len+3,"\"%s\"",arg_str);
-									// replace last token in token_out with string literal
-									Token string_literal_token={
-										.tag=TOKEN_TAG_LITERAL,
-										.line=hashToken.line,
-										.col=hashToken.col,
-										.len=total_str_len+2,
-										.p=arg_str_out,
-										.literal={
-											.tag=TOKEN_LITERAL_TAG_STRING,
-											.string={
-												.len=total_str_len,
-												.str=arg_str,
-											}
-										}
-									};
-									array_append(new_tokens,&string_literal_token);
+						// concatenation operator, the operands are pasted once the right one has been replaced
+						if(Preprocessor_isConcatenation(&define->tokens,define_token_index)){
+							if(new_tokens->len==0 || define_token_index+2>=define->tokens.len){
+								fatal("## at the edge of the replacement list of macro %s",Token_print(&define->name));
+							}
+							paste_index=new_tokens->len;
+							define_token_index++;
+							continue;
+						}
 
-									replaced=true;
-									current_token_was_expanded=true;
-									continue;
+						// stringification operator, which is only allowed on macro arguments
+						int stringified_arg_index=-1;
+						if(define->args!=nullptr && Token_equalString(&define_token,"#") && define_token_index+1<define->tokens.len){
+							stringified_arg_index=Preprocessor_getArgumentIndex(&arguments,array_get(&define->tokens,define_token_index+1));
+						}
+						int arg_index=Preprocessor_getArgumentIndex(&arguments,&define_token);
+
+						if(stringified_arg_index>=0){
+							struct PreprocessorDefine*arg_define=array_get(&arguments,stringified_arg_index);
+							Token string_literal_token=Preprocessor_stringify(preprocessor,&define_token,arg_define->tokens.len,arg_define->tokens.data);
+							string_literal_token.expansion=invocation_expansion;
+							array_append(new_tokens,&string_literal_token);
+							define_token_index++;
+						}else if(arg_index>=0){
+							struct PreprocessorDefine*arg_define=array_get(&arguments,arg_index);
+
+							// operands of the concatenation operator are not expanded
+							bool is_paste_operand=paste_index>=0 || Preprocessor_isConcatenation(&define->tokens,define_token_index+1);
+
+							array*arg_value=&arg_define->tokens;
+							if(!is_paste_operand){
+								struct PreprocessorArgumentExpansion*expansion=array_get(&argument_expansions,arg_index);
+								if(!expansion->expanded){
+									array_init_arena(&expansion->tokens,sizeof(Token),&preprocessor->expansion_arena);
+									Preprocessor_expandArgument(preprocessor,array_get(&argument_sources,arg_index),&expansion->tokens);
+									expansion->expanded=true;
 								}
+								arg_value=&expansion->tokens;
+							}
 
-								// expand argument by just copying all tokens in the argument to the output
-								for(int j=0;j<arg_define->tokens.len;j++){
-									Token* arg_define_token=array_get(&arg_define->tokens,j);
-									array_append(new_tokens,arg_define_token);
-								}
-								
-								replaced=true;
-								break;
+							// copy all tokens of the (expanded) argument to the output
+							for(int j=0;j<arg_value->len;j++){
+								Token* arg_token=array_get(arg_value,j);
+								array_append(new_tokens,arg_token);
 							}
-						}
-						if(replaced){
-							continue;
+							// an empty operand of ## is a placemarker (C11 6.10.3.3)
+							if(is_paste_operand && arg_value->len==0){
+								array_append(new_tokens,&(Token){
+									.tag=TOKEN_TAG_UNDEFINED,
+									.filename=define_token.filename,
+									.line=define_token.line,
+									.col=define_token.col,
+									.len=0,
+									.p="",
+								});
+							}
+						}else{
+							define_token.expansion=invocation_expansion;
+							array_append(new_tokens,&define_token);
 						}
 
-						// adjust source location of the output token
-						//define_token.line=first_token.line;
-						// offset col slightly to make it more readable
-						//define_token.col=first_token.col+d*2;
-						array_append(new_tokens,&define_token);
+						if(paste_index>=0){
+							// last token of the left operand, and first token of the right operand
+							Token*left=array_get(new_tokens,paste_index-1);
+							Token*right=array_get(new_tokens,paste_index);
+							if(Preprocessor_isPlacemarker(left)){
+								*left=*right;
+							}else if(!Preprocessor_isPlacemarker(right)){
+								*left=Preprocessor_pasteTokens(preprocessor,left,right);
+								left->expansion=invocation_expansion;
+							}
+							memmove(right,right+1,(size_t)(new_tokens->len-paste_index-1)*sizeof(Token));
+							new_tokens->len--;
+							paste_index=-1;
+						}
 					}
 
 					// append new tokens in new_tokens to tokens_out
 					for(int j=0;j<new_tokens->len;j++){
 						Token* new_token=array_get(new_tokens,j);
-
-						// check for preprocessor operators, part 2/2: concatenation operator
-						if(j>=2){
-							struct PreprocessorExpandedToken *n_1_token=array_get(tokens_out,tokens_out->len-1);
-							struct PreprocessorExpandedToken *n_2_token=array_get(tokens_out,tokens_out->len-2);
-
-							if(
-								/* n-1 token is hash */ Token_equalString(&n_1_token->token,"#")
-								&& /* n-2 token is hash */ Token_equalString(&n_2_token->token,"#")
-							){
-								// get n-3 token
-								Token last_token=*(Token*)array_get(tokens_out,tokens_out->len-3);
-
-								// pop last two tokens (at n-1 and n-2, the hash characters)
-								array_pop_back(tokens_out);
-								array_pop_back(tokens_out);
-
-								// pop n-3 token
-								array_pop_back(tokens_out);
-
-								Token left=last_token;
-								Token right=*new_token;
-
-								// expand macros on both, i.e. create new array to write expansion into, the expand, then read back from array
-								array left_tokens={};
-								array_init(&left_tokens,sizeof(Token));
-								array right_tokens={};
-								array_init(&right_tokens,sizeof(Token));
-								Preprocessor_expandMacros(preprocessor,1,&left,&left_tokens);
-								Preprocessor_expandMacros(preprocessor,1,&right,&right_tokens);
-								if(left_tokens.len!=1 || right_tokens.len!=1)
-									fatal("expected exactly one token after macro expansion");
-								left=*(Token*)array_get(&left_tokens,0);
-								right=*(Token*)array_get(&right_tokens,0);
-
-								// append current token to last_token
-								char* concatenated_token_p=calloc(left.len+right.len+1/*+1 for zero termination*/,1);
-								Token concatenated_token={
-									.tag=TOKEN_TAG_SYMBOL,
-									.line=left.line,
-									.col=left.col,
-									.len=left.len+right.len,
-									.p=concatenated_token_p
-								};
-								discard sprintf(concatenated_token_p,"%.*s%.*s",left.len,left.p,right.len,right.p);
-
-								struct PreprocessorExpandedToken concatenated_token_expanded={
-									.token=concatenated_token,
-								};
-								array_init(&concatenated_token_expanded.generators,sizeof(struct PreprocessorDefine*));
-
-								array_append(tokens_out,&concatenated_token_expanded);
-								println("concatenated to %.*s",concatenated_token.len,concatenated_token.p);
-
-								continue;
-							}
+						if(Preprocessor_isPlacemarker(new_token)){
+							continue;
 						}
 
 						struct PreprocessorExpandedToken new_expand_token={
 							.token=*new_token,
+							.generators=invocation_generators,
 						};
-						array_init(&new_expand_token.generators,sizeof(struct PreprocessorDefine*));
-						// copy generators from expanded_token to new_expand_token
-						for(int k=0;k<expanded_token->generators.len;k++){
-							struct PreprocessorDefine* generator=*(struct PreprocessorDefine**)array_get(&expanded_token->generators,k);
-							array_append(&new_expand_token.generators,&generator);
-						}
 						array_append(tokens_out,&new_expand_token);
 					}
+					if(preprocessor->stats!=nullptr){
+						int rescan_depth=0;
+						for(const struct PreprocessorGenerator*generator=expanded_token->generators;generator!=nullptr;generator=generator->parent){
+							rescan_depth++;
+						}
+						PreprocessorStats_recordExpansion(preprocessor->stats,define->name.p,define->name.len,new_tokens->len,rescan_depth);
+					}
+					if(preprocessor->file_uses!=nullptr){
+						Preprocessor_recordFileUse(preprocessor,expanded_token->token.filename,define);
+					}
+					array_free(new_tokens);
+
+					for(int arg_index=0;arg_index<argument_expansions.len;arg_index++){
+						struct PreprocessorArgumentExpansion*expansion=array_get(&argument_expansions,arg_index);
+						if(expansion->expanded){
+							array_free(&expansion->tokens);
+						}
+					}
+					array_free(&argument_expansions);
+
+					for(int arg_index=0;arg_index<arguments.len;arg_index++){
+						array_free(&((struct PreprocessorDefine*)array_get(&arguments,arg_index))->tokens);
+						array_free(array_get(&argument_sources,arg_index));
+					}
+					array_free(&arguments);
+					array_free(&argument_sources);
+
+					TimeTrace_end();
 				}
 			}
 
@@ -887,7 +1749,7 @@ PREPROCESSOR_EXPANDMACROS_APPEND_TOKEN:
 		}
 
 		// make output new input
-		// TODO(patrick) free resources of tokens_in
+		array_free(tokens_in);
 		*tokens_in=*tokens_out;
 		*tokens_out=(array){};
 		debug_expansion_level++;
@@ -913,563 +1775,9 @@ PREPROCESSOR_EXPANDMACROS_APPEND_TOKEN:
 
 		array_append(tokens_out_arg,&expanded_token->token);
 	}
-}
-
-/* higher precedence means lower binding power */
-enum PreprocessorOperatorPrecedence{
-	PREPROCESSOR_OPERATOR_PRECEDENCE_UNKNOWN=0,
-
-	PREPROCESSOR_OPERATOR_PRECEDENCE_CALL=1,
-	PREPROCESSOR_OPERATOR_PRECEDENCE_NOT=2,
-
-	PREPROCESSOR_OPERATOR_PRECEDENCE_ADD=4,
-	PREPROCESSOR_OPERATOR_PRECEDENCE_SUBTRACT=4,
-
-	PREPROCESSOR_OPERATOR_PRECEDENCE_LESSER_THAN=6,
-	PREPROCESSOR_OPERATOR_PRECEDENCE_GREATER_THAN=6,
-	PREPROCESSOR_OPERATOR_PRECEDENCE_LESSER_THAN_OR_EQUAL=6,
-	PREPROCESSOR_OPERATOR_PRECEDENCE_GREATER_THAN_OR_EQUAL=6,
 
-	PREPROCESSOR_OPERATOR_PRECEDENCE_EQUAL=7,
-	PREPROCESSOR_OPERATOR_PRECEDENCE_UNEQUAL=7,
-
-	PREPROCESSOR_OPERATOR_PRECEDENCE_AND=11,
-	PREPROCESSOR_OPERATOR_PRECEDENCE_OR=12,
-	PREPROCESSOR_OPERATOR_PRECEDENCE_TERNARY=13,
-
-	PREPROCESSOR_OPERATOR_PRECEDENCE_MAX=0xFF,
-};
-
-const char*PreprocessorExpression_print(struct PreprocessorExpression*expr){
-	if(expr==nullptr)fatal("expr is null");
-
-	char*ret=makeString();
-	switch(expr->tag){
-		case PREPROCESSOR_EXPRESSION_TAG_LITERAL:
-			stringAppend(ret,"%d",expr->value);
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_NOT:
-			stringAppend(ret,"not( %s )",PreprocessorExpression_print(expr->not.expr));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_OR:
-			stringAppend(ret,"( %s ) or ( %s )",PreprocessorExpression_print(expr->or.lhs),PreprocessorExpression_print(expr->or.rhs));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_AND:
-			stringAppend(ret,"( %s ) and ( %s )",PreprocessorExpression_print(expr->and.lhs),PreprocessorExpression_print(expr->and.rhs));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_UNKNOWN:
-			stringAppend(ret,"unknown");
-			break;
-
-		case PREPROCESSOR_EXPRESSION_TAG_EQUAL:
-			stringAppend(ret,"( %s ) == ( %s )",PreprocessorExpression_print(expr->equal.lhs),PreprocessorExpression_print(expr->equal.rhs));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_UNEQUAL:
-			stringAppend(ret,"( %s ) != ( %s )",PreprocessorExpression_print(expr->equal.lhs),PreprocessorExpression_print(expr->equal.rhs));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_GREATER_THAN:
-			stringAppend(ret,"( %s ) > ( %s )",PreprocessorExpression_print(expr->greater_than.lhs),PreprocessorExpression_print(expr->greater_than.rhs));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_GREATER_THAN_OR_EQUAL:
-			stringAppend(ret,"( %s ) >= ( %s )",PreprocessorExpression_print(expr->greater_than_or_equal.lhs),PreprocessorExpression_print(expr->greater_than_or_equal.rhs));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_LESSER_THAN:
-			stringAppend(ret,"( %s ) < ( %s )",PreprocessorExpression_print(expr->lesser_than.lhs),PreprocessorExpression_print(expr->lesser_than.rhs));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_LESSER_THAN_OR_EQUAL:
-			stringAppend(ret,"( %s ) <= ( %s )",PreprocessorExpression_print(expr->lesser_than_or_equal.lhs),PreprocessorExpression_print(expr->lesser_than_or_equal.rhs));
-			break;
-
-		case PREPROCESSOR_EXPRESSION_TAG_SUBTRACT:
-			stringAppend(ret,"( %s ) - ( %s )",PreprocessorExpression_print(expr->subtract.lhs),PreprocessorExpression_print(expr->subtract.rhs));
-			break;
-		case PREPROCESSOR_EXPRESSION_TAG_ADD:
-			stringAppend(ret,"( %s ) + ( %s )",PreprocessorExpression_print(expr->add.lhs),PreprocessorExpression_print(expr->add.rhs));
-			break;
-
-		case PREPROCESSOR_EXPRESSION_TAG_DEFINED:
-		case PREPROCESSOR_EXPRESSION_TAG_TERNARY:
-		case PREPROCESSOR_EXPRESSION_TAG_ELSE:
-			fatal("unimplemented tag %d",expr->tag);
-	}
-
-	return ret;
-}
-
-// for internal use only
-int PreprocessorExpression_parse(
-	struct Preprocessor*preprocessor,
-	array if_expr_tokens,
-	struct PreprocessorExpression *out,
-	int precedence
-);
-
-/*
-for internal use only, from inside PreprocessorExpression_parse (arguments carry internal state)
-
-*/
-void PreprocessorExpression_parse_processOperator(
-	struct Preprocessor*preprocessor,
-
-	int num_operands,
-
-	int *nextTokenIndex,
-	struct PreprocessorExpression*out,
-	array if_expr_tokens,
-	int precedence,
-	enum PreprocessorExpressionTag operator_expression_tag,
-	Token*nextToken
-){
-	if(num_operands>1 && out->tag==0)fatal("n>1 operand operation was not preceded by another operand, instead got token %s",Token_print(nextToken));
-	if(num_operands==1 && out->tag!=0)fatal("unexpected token %s, %s",Token_print(nextToken),PreprocessorExpression_print(out));
-	(*nextTokenIndex)++;
-
-	switch(num_operands){
-		case 1: case 2: case 3:break;
-		default:fatal("invalid number of operands %d",num_operands);
-	}
-
-	// parse new expression
-	struct PreprocessorExpression sub_expr[2]={};
-
-	int num_operands_yet_to_parse=0;
-	switch(num_operands){
-		case 1:
-			// for unary operations, the operatand follows the operator
-			num_operands_yet_to_parse=1;
-			break;
-		case 2:
-			// for binary and tertiary operations, the second (and third) operands follow the operator
-			num_operands_yet_to_parse=1;
-			break;
-		case 3:
-			num_operands_yet_to_parse=2;
-			break;
-		default:fatal("unreachable");
-	}
-	for(int i=0;i<num_operands_yet_to_parse;i++){
-		(*nextTokenIndex)+=PreprocessorExpression_parse(
-			preprocessor,
-			(array){
-				.data=((Token*)if_expr_tokens.data)+nextTokenIndex[0],
-				.len=if_expr_tokens.len-nextTokenIndex[0],
-				.elem_size=if_expr_tokens.elem_size,
-				// omit cap
-			},
-			&sub_expr[i],
-			precedence
-		);
-	}
-
-	switch(num_operands){
-		case 1:
-			*out=(struct PreprocessorExpression){
-				.tag=operator_expression_tag,
-				.unary_operand={
-					.expr=allocAndCopy(sizeof(struct PreprocessorExpression),&sub_expr[0]),
-				}
-			};
-			return;
-		case 2:
-			if(sub_expr[0].tag==0)fatal("");
-			*out=(struct PreprocessorExpression){
-				.tag=operator_expression_tag,
-				.binary_operands={
-					.lhs=allocAndCopy(sizeof(struct PreprocessorExpression),out),
-					.rhs=allocAndCopy(sizeof(struct PreprocessorExpression),&sub_expr[0])
-				}
-			};
-			return;
-		case 3:fatal("unimplemented");
-		default:fatal("unreachable");
-	}
-	fatal("unreachable");
-}
-
-#define PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(OPERATOR_PRECEDENCE) \
-	if(precedence<=(OPERATOR_PRECEDENCE)) \
-		goto PREPROCESSOR_EXPRESSION_PARSE_RET_SUCCESS;
-
-/*
-parse expression by consuming tokens (until end of line), then evaluating the expression
-
-returns number of tokens consumed
-*/
-int PreprocessorExpression_parse(
-	struct Preprocessor*preprocessor,
-	array if_expr_tokens,
-	struct PreprocessorExpression *out,
-	int precedence
-){
-	//print all tokens
-	if(DEBUG_PRINTS){
-		println("PreprocessorExpression_parse tokens:");
-		for(int i=0;i<if_expr_tokens.len;i++){
-			Token* token=array_get(&if_expr_tokens,i);
-			println("%s",Token_print(token));
-		}
-	}
-	// init out
-	*out=(struct PreprocessorExpression){};
-	/* track number of currently open paranthesis */
-	int openParanthesis=0;
-
-	int nextTokenIndex=0;
-	Token* nextToken=nullptr;
-	for(;nextTokenIndex<if_expr_tokens.len;){
-		nextToken=array_get(&if_expr_tokens,nextTokenIndex);
-
-		switch(nextToken->tag){
-			case TOKEN_TAG_LITERAL:
-				if(out->tag!=0){
-					fatal("unexpected token %s, %d",Token_print(nextToken),out->tag);
-				}
-				nextTokenIndex++;
-
-				if(nextToken->literal.tag!=TOKEN_LITERAL_TAG_NUMERIC)fatal("unexpected literal %s",Token_print(nextToken));
-
-				out->tag=PREPROCESSOR_EXPRESSION_TAG_LITERAL;
-				int64_t value=0;
-				TokenLiteral_getNumericValue(nextToken,nullptr,&value,nullptr);
-				out->value=(int)value;
-				break;
-			case TOKEN_TAG_SYMBOL:
-				{
-					// if this symbol is defined, replace it with the defined value
-					// otherwise, replace it with 0 (per spec)
-					if(out->tag!=0)fatal("unexpected token %s",Token_print(nextToken));
-					nextTokenIndex++;
-
-					// check if symbol is defined
-					int defined=0;
-					for(int i=0;i<preprocessor->defines.len;i++){
-						Token* define_token=array_get(&preprocessor->defines,i);
-						if(Token_equalToken(define_token,nextToken)){
-							defined=1;
-							// assume new token is a literal
-							out->tag=PREPROCESSOR_EXPRESSION_TAG_LITERAL;
-							// get value from define_token->p, which is a string of len define_token->len
-							char* value=calloc(define_token->len+1,1);
-							discard sprintf(value,"%.*s",define_token->len,define_token->p);
-
-							static const int BASE_10=10;
-							out->value=(int)strtol(value,nullptr,BASE_10);
-							free(value);
-							break;
-						}
-					}
-					if(!defined){
-						out->tag=PREPROCESSOR_EXPRESSION_TAG_LITERAL;
-						out->value=0;
-					}
-					break;
-				}
-				break;
-			case TOKEN_TAG_KEYWORD:
-				{
-					if(Token_equalString(nextToken,"(")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_CALL)
-
-						bool skip_expression=false;
-						if(out->tag!=0){
-							if(out->tag==PREPROCESSOR_EXPRESSION_TAG_LITERAL && out->value==0){
-								// if the last token was a 0, we can skip the paranthesis
-								// and return a 0
-								skip_expression=true;
-							}else{
-								fatal("unexpected token %s",Token_print(nextToken));
-							}
-						}
-						nextTokenIndex++;
-
-						if(!skip_expression){
-							openParanthesis++;
-
-							// parse new expression
-							struct PreprocessorExpression sub_expr={};
-							nextTokenIndex+=PreprocessorExpression_parse(
-								preprocessor,
-								(array){
-									.data=((Token*)if_expr_tokens.data)+nextTokenIndex,
-									.len=if_expr_tokens.len-nextTokenIndex,
-									.elem_size=if_expr_tokens.elem_size,
-									// omit cap
-								},
-								&sub_expr,
-								PREPROCESSOR_OPERATOR_PRECEDENCE_MAX // no precedence, just parse until closing paranthesis
-							);
-							*out=sub_expr;
-						}else{
-							int discardOpenParanthesis=1;
-							// skip over tokens, while:
-							// 1) counting the number of opened paranthesis
-							// 2) decreasing that count on close paranthesis
-							// 3) stopping when the count reaches 0
-							while(nextTokenIndex<if_expr_tokens.len){
-								nextToken=array_get(&if_expr_tokens,nextTokenIndex);
-								nextTokenIndex++;
-								if(Token_equalString(nextToken,"(")){
-									discardOpenParanthesis++;
-								}else if(Token_equalString(nextToken,")")){
-									discardOpenParanthesis--;
-									if(discardOpenParanthesis==0){
-										break;
-									}
-								}
-							}
-							// out is already literal 0
-						}
-						break;
-					}
-					if(Token_equalString(nextToken,")")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_CALL)
-
-						// if there are no open paranthesis, we may be inside a subexpression, hence return without consuming the token
-						if(openParanthesis==0){
-							goto PREPROCESSOR_EXPRESSION_PARSE_RET_SUCCESS;
-						}
-
-						nextTokenIndex++;
-						openParanthesis--;
-
-						break;
-					}
-					if(Token_equalString(nextToken,"||")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_OR)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_OR,
-							PREPROCESSOR_EXPRESSION_TAG_OR,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"&&")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_AND)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_AND,
-							PREPROCESSOR_EXPRESSION_TAG_AND,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,">")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_GREATER_THAN)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_GREATER_THAN,
-							PREPROCESSOR_EXPRESSION_TAG_GREATER_THAN,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,">=")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_GREATER_THAN_OR_EQUAL)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_GREATER_THAN_OR_EQUAL,
-							PREPROCESSOR_EXPRESSION_TAG_GREATER_THAN_OR_EQUAL,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"<")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_LESSER_THAN)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_LESSER_THAN,
-							PREPROCESSOR_EXPRESSION_TAG_LESSER_THAN,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"<=")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_LESSER_THAN_OR_EQUAL)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_LESSER_THAN_OR_EQUAL,
-							PREPROCESSOR_EXPRESSION_TAG_LESSER_THAN_OR_EQUAL,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"==")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_EQUAL)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_EQUAL,
-							PREPROCESSOR_EXPRESSION_TAG_EQUAL,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"!=")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_UNEQUAL)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_UNEQUAL,
-							PREPROCESSOR_EXPRESSION_TAG_UNEQUAL,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"+")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_ADD)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_ADD,
-							PREPROCESSOR_EXPRESSION_TAG_ADD,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"-")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_SUBTRACT)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							2,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_SUBTRACT,
-							PREPROCESSOR_EXPRESSION_TAG_SUBTRACT,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"!")){
-						//PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_NOT)
-
-						PreprocessorExpression_parse_processOperator(
-							preprocessor,
-							1,
-							&nextTokenIndex,
-							out,
-							if_expr_tokens,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_NOT,
-							PREPROCESSOR_EXPRESSION_TAG_NOT,
-							nextToken
-						);
-						break;
-					}
-					if(Token_equalString(nextToken,"?")){
-						if(out->tag==0)fatal("unexpected token %s",Token_print(nextToken));
-						nextTokenIndex++;
-
-						// parse new expression
-						struct PreprocessorExpression sub_expr={};
-						nextTokenIndex+=PreprocessorExpression_parse(
-							preprocessor,
-							(array){
-								.data=((Token*)if_expr_tokens.data)+nextTokenIndex,
-								.len=if_expr_tokens.len-nextTokenIndex,
-								.elem_size=if_expr_tokens.elem_size,
-								// omit cap
-							},
-							&sub_expr,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_TERNARY
-						);
-
-						if(nextTokenIndex>=if_expr_tokens.len)fatal("expected : after ?");
-
-						nextToken=array_get(&if_expr_tokens,nextTokenIndex);
-						if(!Token_equalString(nextToken,":"))fatal("expected : after ?");
-
-						nextTokenIndex++;
-
-						// parse new expression
-						struct PreprocessorExpression sub_expr2={};
-						nextTokenIndex+=PreprocessorExpression_parse(
-							preprocessor,
-							(array){
-								.data=((Token*)if_expr_tokens.data)+nextTokenIndex,
-								.len=if_expr_tokens.len-nextTokenIndex,
-								.elem_size=if_expr_tokens.elem_size,
-								// omit cap
-							},
-							&sub_expr2,
-							PREPROCESSOR_OPERATOR_PRECEDENCE_TERNARY
-						);
-
-						*out=(struct PreprocessorExpression){
-							.tag=PREPROCESSOR_EXPRESSION_TAG_TERNARY,
-							.ternary={
-								.condition=allocAndCopy(sizeof(struct PreprocessorExpression),out),
-								.then=allocAndCopy(sizeof(struct PreprocessorExpression),&sub_expr),
-								.else_=allocAndCopy(sizeof(struct PreprocessorExpression),&sub_expr2)
-							}
-						};
-						break;
-					}
-
-					if(Token_equalString(nextToken,":")){
-						PREPROCESSOR_EXPRESSION_PARSE_CHECK_PRECEDENCE(PREPROCESSOR_OPERATOR_PRECEDENCE_TERNARY)
-
-						fatal("unexpected token %s",Token_print(nextToken));
-					}
-
-					fatal("unexpected keyword %s",Token_print(nextToken));
-				}
-				break;
-			default:
-				fatal("unimplemented token: %s",Token_print(nextToken));
-		}
-	}
-	if(openParanthesis>0)fatal("%d unmatched paranthesis at %s",openParanthesis,Token_print(array_get(&if_expr_tokens,0)));
-
-PREPROCESSOR_EXPRESSION_PARSE_RET_SUCCESS:
-	if(out->tag==0){
-PREPROCESSOR_EXPRESSION_PARSE_RET_FAILURE:
-		fatal("expected expression, got instead %s",Token_print(nextToken));
-	}
-	return nextTokenIndex;
+	array_free(tokens_in);
+	array_free(tokens_out);
 }
 
 bool PreprocessorIfStack_getLastValue(struct PreprocessorIfStack*item){
@@ -1477,22 +1785,24 @@ bool PreprocessorIfStack_getLastValue(struct PreprocessorIfStack*item){
 	struct PreprocessorIfStackItem*last_item=array_get(&item->items,item->items.len-1);
 	switch(last_item->tag){
 		case PREPROCESSOR_STACK_ITEM_TYPE_IF:
-			return last_item->if_.expr->value;
+			return last_item->if_.value;
 		case PREPROCESSOR_STACK_ITEM_TYPE_ELSE_IF:
-			return last_item->else_if.expr->value;
+			return last_item->else_if.value;
 		case PREPROCESSOR_STACK_ITEM_TYPE_ELSE:
 			return true;
 		default:
 			fatal("unknown preprocessor stack item tag %d",last_item->tag);
 	}
 }
-/* parse preprocessor expression starting from current token */
-struct PreprocessorExpression* Preprocessor_parseExpression(struct Preprocessor*preprocessor){
+int64_t Preprocessor_parseIfExpression(struct Preprocessor*preprocessor,struct PreprocessorIfExpression**compiled){
 	Token token={};
 	int ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
 
 	array if_expr_tokens={};
 	array_init(&if_expr_tokens,sizeof(Token));
+	/* raw spelling of the expression (tokens separated by a single space), used as cache key */
+	array if_expr_spelling={};
+	array_init(&if_expr_spelling,sizeof(char));
 	// read tokens until newline
 	int line_num=token.line;
 	while(!TokenIter_isEmpty(&preprocessor->token_iter)){
@@ -1508,406 +1818,765 @@ struct PreprocessorExpression* Preprocessor_parseExpression(struct Preprocessor*
 			break;
 		}
 
-		if(Token_equalString(&token,"defined")){
-			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-			if(!ntr) fatal("expected symbol after defined keyword");
-
-			// next argument can be freestanding, or surrounded by paranthesis
-			bool paranthesis=false;
-			if(Token_equalString(&token,"(")){
-				paranthesis=true;
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("expected symbol after defined keyword");
-			}
-			if(token.tag!=TOKEN_TAG_SYMBOL){							
-				fatal("expected symbol after defined keyword, got instead %s",Token_print(&token));
-			}
+		array_append(&if_expr_tokens,&token);
+		for(int i=0;i<token.len;i++){
+			array_append(&if_expr_spelling,&token.p[i]);
+		}
+		array_append(&if_expr_spelling,&(char){' '});
 
-			// check if symbol is defined
-			int defined=0;
-			for(int i=0;i<preprocessor->defines.len;i++){
-				Token* define_token=array_get(&preprocessor->defines,i);
-				if(Token_equalToken(define_token,&token)){
-					defined=1;
-					break;
-				}
-			}
+		ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+		if(!ntr) fatal("");
+	}
 
-			// append 1 or 0 to if_expr_tokens
-			array_append(&if_expr_tokens,(Token[]){
-				{
-					.tag=TOKEN_TAG_LITERAL,
-					.filename=token.filename,
-					.line=token.line,
-					.col=token.col,
-					.len=1,
-					.p=defined?"1":"0",
-					.literal={
-						.tag=TOKEN_LITERAL_TAG_NUMERIC,
-						.numeric={
-							.tag=TOKEN_LITERAL_NUMERIC_TAG_INTEGER,
-							.value.int_=defined?1:0
-						}
-					}
-				}
-			});
+	// get compiled expression from cache, (re)compile if necessary
+	struct PreprocessorIfExpression*if_expr=hashmap_get(&preprocessor->if_expressions,if_expr_spelling.data,if_expr_spelling.len);
+	if(if_expr==nullptr){
+		if_expr=arena_copy(&preprocessor->arena,sizeof(struct PreprocessorIfExpression),&(struct PreprocessorIfExpression){});
+		array_init(&if_expr->program,sizeof(struct PreprocessorIfInstruction));
+		array_init(&if_expr->expansion_dependencies,sizeof(struct PreprocessorMacroDependency));
+		array_init(&if_expr->defined_dependencies,sizeof(struct PreprocessorMacroDependency));
 
-			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-			if(!ntr) fatal("expected symbol after defined keyword");
+		// cache takes ownership of the spelling
+		hashmap_set(&preprocessor->if_expressions,if_expr_spelling.data,if_expr_spelling.len,if_expr);
+
+		PreprocessorIfExpression_compile(preprocessor,if_expr,if_expr_tokens.len,if_expr_tokens.data);
+	}else{
+		array_free(&if_expr_spelling);
+
+		if(!PreprocessorMacroDependencies_areValid(preprocessor,&if_expr->expansion_dependencies)){
+			PreprocessorIfExpression_compile(preprocessor,if_expr,if_expr_tokens.len,if_expr_tokens.data);
+		}
+	}
+	array_free(&if_expr_tokens);
+
+	int64_t value=PreprocessorIfExpression_evaluate(preprocessor,if_expr);
+	if(preprocessor->file_uses!=nullptr){
+		Preprocessor_recordIfExpressionUses(preprocessor,if_expr);
+	}
+
+	if(compiled!=nullptr){
+		*compiled=if_expr;
+	}
+	return value;
+}
+
+/* conditional map of the file that is currently processed, nullptr if the conditional cache is not enabled */
+static struct PreprocessorConditionalMap* Preprocessor_getConditionalMap(struct Preprocessor*preprocessor){
+	if(preprocessor->conditional_cache==nullptr){
+		return nullptr;
+	}
+	return PreprocessorConditionalCache_getMap(preprocessor->conditional_cache,preprocessor->token_iter.tokenizer);
+}
+/* record current definition of macro as dependency of conditional */
+static void Preprocessor_addConditionalDependency(
+	struct Preprocessor*preprocessor,
+	struct PreprocessorConditionalMap*map,
+	struct PreprocessorConditional*conditional,
+	const struct PreprocessorMacro*macro
+){
+	int define_index=Preprocessor_getMacroBinding(preprocessor,macro).define_index;
+	const struct PreprocessorDefine*define=define_index>=0?array_get(&preprocessor->defines,define_index):nullptr;
+	PreprocessorConditionalMap_addDependency(map,conditional,macro->name,macro->name_len,PreprocessorDefine_fingerprint(define));
+}
+/* returns true if all macros that the recorded value of conditional depends on still have the same definition */
+static bool Preprocessor_conditionalIsValid(struct Preprocessor*preprocessor,struct PreprocessorConditionalMap*map,const struct PreprocessorConditional*conditional){
+	for(int i=0;i<conditional->num_dependencies;i++){
+		const struct PreprocessorConditionalDependency*dependency=array_get(&map->dependencies,conditional->first_dependency+i);
+		const Token name={
+			.tag=TOKEN_TAG_SYMBOL,
+			.p=(const char*)map->names.data+dependency->name_offset,
+			.len=dependency->name_len,
+		};
+		if(PreprocessorDefine_fingerprint(Preprocessor_getDefine(preprocessor,&name))!=dependency->fingerprint){
+			return false;
+		}
+	}
+	return true;
+}
+/*
+get value of the condition of the #if/#elif directive at token index directive, starting at the current token
 
-			if(paranthesis){
-				// check for closing paranthesis
-				if(!Token_equalString(&token,")")) fatal("expected closing paranthesis after defined keyword");
+the value is taken from the conditional map (if enabled) without parsing the expression, as long as none of the macros
+it depends on has changed. otherwise the expression is evaluated, and the value is recorded in the map.
+*/
+static bool Preprocessor_evaluateCondition(struct Preprocessor*preprocessor,int directive){
+	struct PreprocessorConditionalMap*map=Preprocessor_getConditionalMap(preprocessor);
+	if(map==nullptr){
+		return Preprocessor_parseIfExpression(preprocessor,nullptr)!=0;
+	}
 
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("expected symbol after defined keyword");
+	struct PreprocessorConditional*conditional=PreprocessorConditionalMap_get(map,directive);
+	if(conditional!=nullptr && conditional->end>=0 && Preprocessor_conditionalIsValid(preprocessor,map,conditional)){
+		preprocessor->token_iter.next_token_index=conditional->end;
+
+		if(preprocessor->file_uses!=nullptr){
+			const char*reference_file=preprocessor->token_iter.tokenizer->token_src;
+			for(int i=0;i<conditional->num_dependencies;i++){
+				const struct PreprocessorConditionalDependency*dependency=array_get(&map->dependencies,conditional->first_dependency+i);
+				const Token name={
+					.tag=TOKEN_TAG_SYMBOL,
+					.p=(const char*)map->names.data+dependency->name_offset,
+					.len=dependency->name_len,
+				};
+				const struct PreprocessorDefine*define=Preprocessor_getDefine(preprocessor,&name);
+				if(define!=nullptr){
+					Preprocessor_recordFileUse(preprocessor,reference_file,define);
+				}
 			}
+		}
 
-			continue;
+		return conditional->value;
+	}
+
+	struct PreprocessorIfExpression*compiled=nullptr;
+	bool value=Preprocessor_parseIfExpression(preprocessor,&compiled)!=0;
+
+	// the value depends on the macros tested with defined(), and on the macros looked up while expanding the expression
+	conditional=PreprocessorConditionalMap_add(map,directive);
+	if(compiled->depends_on_files){
+		// __has_include is answered from the include lookups, which are not tracked by the map
+		return value;
+	}
+	PreprocessorConditionalMap_setValue(map,conditional,preprocessor->token_iter.next_token_index,value);
+	for(int i=0;i<compiled->program.len;i++){
+		struct PreprocessorIfInstruction*instruction=array_get(&compiled->program,i);
+		if(instruction->op==PREPROCESSOR_IF_OP_DEFINED){
+			Preprocessor_addConditionalDependency(preprocessor,map,conditional,instruction->macro);
 		}
+	}
+	for(int i=0;i<compiled->expansion_dependencies.len;i++){
+		struct PreprocessorMacroDependency*dependency=array_get(&compiled->expansion_dependencies,i);
+		Preprocessor_addConditionalDependency(preprocessor,map,conditional,dependency->macro);
+	}
+	return value;
+}
+/* record directive at token index directive as the next directive of if_stack in the conditional map (if enabled) */
+static void Preprocessor_linkConditional(struct Preprocessor*preprocessor,struct PreprocessorIfStack*if_stack,int directive){
+	struct PreprocessorConditionalMap*map=Preprocessor_getConditionalMap(preprocessor);
+	if(map==nullptr){
+		return;
+	}
+	// chains that span files (i.e. unbalanced includes) are not recorded
+	if(if_stack->directive_file==preprocessor->token_iter.tokenizer){
+		PreprocessorConditionalMap_link(map,if_stack->last_directive,directive);
+	}
+	if_stack->last_directive=directive;
+	if_stack->directive_file=preprocessor->token_iter.tokenizer;
+}
+/*
+if the block after the conditional directive at token index directive is skipped, continue at the next directive of the
+chain right away, if it is known from the conditional map (if enabled)
+*/
+static void Preprocessor_skipConditionalBlock(struct Preprocessor*preprocessor,int directive){
+	if(!preprocessor->doSkip){
+		return;
+	}
+	struct PreprocessorConditionalMap*map=Preprocessor_getConditionalMap(preprocessor);
+	if(map==nullptr){
+		return;
+	}
+	struct PreprocessorConditional*conditional=PreprocessorConditionalMap_get(map,directive);
+	if(conditional!=nullptr && conditional->next>=0){
+		// the '#' of the next directive becomes the last token, i.e. the next step processes the directive
+		preprocessor->token_iter.next_token_index=conditional->next+1;
+	}
+}
 
-		array_append(&if_expr_tokens,&token);
-		ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-		if(!ntr) fatal("");
+/* record state at position in the main file, i.e. at the '#' of an include directive or at the first token of the file */
+static void Preprocessor_takeCheckpoint(struct Preprocessor*preprocessor,const struct TokenIter*position){
+	struct PreprocessorOutput output={};
+	int64_t output_len=0;
+	if(preprocessor->output!=nullptr){
+		output=*preprocessor->output;
+		output_len=writer_length(preprocessor->output->out);
+	}
+
+	array_append(&preprocessor->checkpoints,&(struct PreprocessorCheckpoint){
+		.token_iter=*position,
+		.macros=PreprocessorMacroTable_snapshot(&preprocessor->macro_table),
+		.stack=PreprocessorIfStacks_copy(&preprocessor->stack),
+		.doSkip=preprocessor->doSkip,
+
+		.output=output,
+		.output_len=output_len,
+
+		.num_defines=preprocessor->defines.len,
+		.num_expansions=preprocessor->expansions.len,
+		.num_tokens_out=preprocessor->tokens_out.len,
+		.num_source_files=preprocessor->source_files.len,
+		.num_included_files=preprocessor->included_files.len,
+		.num_embedded_files=preprocessor->embedded_files.len,
+		.num_pushed_files=preprocessor->pushed_files.len,
+		.num_pragma_once_files=preprocessor->pragma_once_files.len,
+	});
+}
+void Preprocessor_pushFile(struct Preprocessor*preprocessor,struct TokenIter*token_iter){
+	// suspend the file that is currently processed (if any), it is resumed once the new file is done
+	bool is_main_file=preprocessor->token_iter.tokenizer==nullptr;
+	if(!is_main_file){
+		array_append(&preprocessor->include_stack,&preprocessor->token_iter);
 	}
+	preprocessor->token_iter=*token_iter;
 
-	// expand macros in expression
-	array expanded_expr_tokens={};
-	array_init(&expanded_expr_tokens,sizeof(Token));
-	Preprocessor_expandMacros(preprocessor,if_expr_tokens.len,if_expr_tokens.data,&expanded_expr_tokens);
+	// remember all files that contribute to the output
+	array_append(&preprocessor->source_files,&token_iter->tokenizer->token_src);
+	array_append(&preprocessor->pushed_files,&token_iter->tokenizer);
 
-	// parse expression from tokens
-	struct PreprocessorExpression if_expr={};
-	// print expanded_expr_tokens
-	if(DEBUG_PRINTS){
-		println("expanded expression:");
-		for(int i=0;i<expanded_expr_tokens.len;i++){
-			Token* token=array_get(&expanded_expr_tokens,i);
-			printf("%s\n",Token_print(token));
+	if(preprocessor->stats!=nullptr){
+		// a file reached by another path than before is counted as the same file
+		struct PreprocessorFileInfo*file_info=Preprocessor_getFileInfo(preprocessor,token_iter->tokenizer->token_src);
+		if(file_info==nullptr){
+			fatal("could not stat file %s",token_iter->tokenizer->token_src);
 		}
+		PreprocessorStats_enterFile(preprocessor->stats,file_info,token_iter->tokenizer->num_tokens);
 	}
-	PreprocessorExpression_parse(preprocessor,expanded_expr_tokens,&if_expr,PREPROCESSOR_OPERATOR_PRECEDENCE_MAX);
-	Preprocessor_evalExpression(preprocessor,&if_expr);
+	TimeTrace_begin("source file",token_iter->tokenizer->token_src,(int)strlen(token_iter->tokenizer->token_src));
+
+	// fetch first token (an empty file is finished right away)
+	Token token;
+	discard TokenIter_nextToken(&preprocessor->token_iter,&token);
 
-	return allocAndCopy(sizeof(struct PreprocessorExpression),&if_expr);
+	if(is_main_file && preprocessor->take_checkpoints){
+		Preprocessor_takeCheckpoint(preprocessor,&preprocessor->token_iter);
+	}
 }
+bool Preprocessor_step(struct Preprocessor *preprocessor){
+	Token token;
 
-void Preprocessor_consume(struct Preprocessor *preprocessor, struct TokenIter *token_iter){
-	struct TokenIter old_token_iter=preprocessor->token_iter;
-	preprocessor->token_iter=*token_iter;
+	// when the current file is done, continue with the file that included it
+	while(!TokenIter_lastToken(&preprocessor->token_iter,&token)){
+		if(preprocessor->stats!=nullptr){
+			PreprocessorStats_leaveFile(preprocessor->stats);
+		}
+		TimeTrace_end();
+		if(preprocessor->include_stack.len==0){
+			return false;
+		}
+		preprocessor->token_iter=*(struct TokenIter*)array_get(&preprocessor->include_stack,preprocessor->include_stack.len-1);
+		array_pop_back(&preprocessor->include_stack);
+	}
 
 	/* last attempt to fetch a token was successfull? */
 	int ntr=1;
-	Token token;
 
-	ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-	if(!ntr) fatal("");
-	while(ntr){
-		// check for preprocessor directives
-		if(token.len==1 && token.p[0]=='#'){
+	// check for preprocessor directives
+	if(token.len==1 && token.p[0]=='#'){
+		/* position of the directive */
+		struct TokenIter directive_start=preprocessor->token_iter;
+		/* token index of the '#' */
+		int directive=directive_start.next_token_index-1;
+
+		ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+		if(!ntr) fatal("");
+
+		if(preprocessor->partial!=nullptr){
+			Token hash_token;
+			discard TokenIter_lastToken(&directive_start,&hash_token);
+			PreprocessorPartial_processDirective(preprocessor,&hash_token);
+			return true;
+		}
+
+		if(Token_equalString(&token, "if")){
+			Token ifToken=token;
+			// get next token
 			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
 			if(!ntr) fatal("");
 
-			if(Token_equalString(&token, "if")){
-				Token ifToken=token;
-				// get next token
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("");
+			// parse expression
+			TimeReport_begin("#if evaluation");
+			bool value=Preprocessor_evaluateCondition(preprocessor,directive);
+			TimeReport_end();
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+
+			struct PreprocessorIfStack new_if_stack=(struct PreprocessorIfStack){
+				.anyPathEvaluatedToTrue=false,
+				.inherited_doSkip=preprocessor->doSkip,
+				.last_directive=directive,
+				.directive_file=preprocessor->token_iter.tokenizer,
+				.items={}
+			};
+			array_init(&new_if_stack.items, sizeof(struct PreprocessorIfStackItem));
 
-				// parse expression
-				struct PreprocessorExpression* if_expr=Preprocessor_parseExpression(preprocessor);
-				ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+			struct PreprocessorIfStackItem item={
+				.tag=PREPROCESSOR_STACK_ITEM_TYPE_IF,
+				.if_={
+					.if_token=ifToken,
+					.value=value,
+				}
+			};
+			array_append(&new_if_stack.items,&item);
 
-				struct PreprocessorIfStack new_if_stack=(struct PreprocessorIfStack){
-					.anyPathEvaluatedToTrue=false,
-					.inherited_doSkip=preprocessor->doSkip,
-					.items={}
-				};
-				array_init(&new_if_stack.items, sizeof(struct PreprocessorIfStackItem));
+			preprocessor->doSkip=new_if_stack.inherited_doSkip || new_if_stack.anyPathEvaluatedToTrue || !value;
+			new_if_stack.anyPathEvaluatedToTrue|=value;
+			new_if_stack.doSkip=preprocessor->doSkip;
 
-				struct PreprocessorIfStackItem item={
-					.tag=PREPROCESSOR_STACK_ITEM_TYPE_IF,
-					.if_={
-						.if_token=ifToken,
-						.expr=allocAndCopy(sizeof(struct PreprocessorExpression),if_expr)
-					}
-				};
-				array_append(&new_if_stack.items,&item);
+			array_append(&preprocessor->stack,&new_if_stack);
+			Preprocessor_skipConditionalBlock(preprocessor,directive);
 
-				preprocessor->doSkip=new_if_stack.inherited_doSkip || new_if_stack.anyPathEvaluatedToTrue || !if_expr->value;
-				new_if_stack.anyPathEvaluatedToTrue|=(bool)if_expr->value;
+			return true;
+		}
+		if(Token_equalString(&token, "ifndef")){
+			Token ifToken=token;
+			// read define argument
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("");
+			if(token.tag!=TOKEN_TAG_SYMBOL){
+				fatal("expected symbol after #ifdef directive but got instead %s",Token_print(&token));
+			}
 
-				array_append(&preprocessor->stack,&new_if_stack);
+			// check if define is already defined
+			bool value=!Preprocessor_isDefined(preprocessor,&token);
 
-				continue;
-			}
-			if(Token_equalString(&token, "ifndef")){
-				Token ifToken=token;
-				// read define argument
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("");
-				if(token.tag!=TOKEN_TAG_SYMBOL){
-					fatal("expected symbol after #ifdef directive but got instead %s",Token_print(&token));
-				}
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("");
 
-				char* define_name=calloc(token.len+1,1);
-				discard sprintf(define_name,"%.*s",token.len,token.p);
+			// create new stack
+			struct PreprocessorIfStack new_if_stack=(struct PreprocessorIfStack){
+				.anyPathEvaluatedToTrue=false,
+				.inherited_doSkip=preprocessor->doSkip,
+				.last_directive=directive,
+				.directive_file=preprocessor->token_iter.tokenizer,
+				.items={}
+			};
+			array_init(&new_if_stack.items, sizeof(struct PreprocessorIfStackItem));
+
+			// push if statement on stack
+			struct PreprocessorIfStackItem item={
+				.tag=PREPROCESSOR_STACK_ITEM_TYPE_IF,
+				.if_={
+					.if_token=ifToken,
+					.value=value,
+				}
+			};
+			array_append(&new_if_stack.items,&item);
 
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("");
+			// update stack evaluation state
+			preprocessor->doSkip=new_if_stack.inherited_doSkip || new_if_stack.anyPathEvaluatedToTrue || !value;
+			new_if_stack.anyPathEvaluatedToTrue|=value;
+			new_if_stack.doSkip=preprocessor->doSkip;
 
-				// check if define is already defined
-				struct PreprocessorExpression if_expr={
-					.tag=PREPROCESSOR_EXPRESSION_TAG_NOT,
-					.not={
-						.expr=allocAndCopy(sizeof(struct PreprocessorExpression),&(struct PreprocessorExpression){
-							.tag=PREPROCESSOR_EXPRESSION_TAG_DEFINED,
-							.defined={
-								.name=define_name
-							}
-						}
-					)}
-				};
-				Preprocessor_evalExpression(preprocessor,&if_expr);
+			// push stack on stack list
+			array_append(&preprocessor->stack,&new_if_stack);
+			Preprocessor_skipConditionalBlock(preprocessor,directive);
 
-				// create new stack
-				struct PreprocessorIfStack new_if_stack=(struct PreprocessorIfStack){
-					.anyPathEvaluatedToTrue=false,
-					.inherited_doSkip=preprocessor->doSkip,
-					.items={}
-				};
-				array_init(&new_if_stack.items, sizeof(struct PreprocessorIfStackItem));
-
-				// push if statement on stack
-				struct PreprocessorIfStackItem item={
-					.tag=PREPROCESSOR_STACK_ITEM_TYPE_IF,
-					.if_={
-						.if_token=ifToken,
-						.expr=allocAndCopy(sizeof(if_expr),&if_expr)
-					}
-				};
-				array_append(&new_if_stack.items,&item);
+			return true;
+		}
+		if(Token_equalString(&token,"ifdef")){
+			Token ifToken=token;
+			// read define argument
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("");
+			if(token.tag!=TOKEN_TAG_SYMBOL){
+				fatal("expected symbol after #ifdef directive but got instead %s",Token_print(&token));
+			}
 
-				// update stack evaluation state
-				preprocessor->doSkip=new_if_stack.inherited_doSkip || new_if_stack.anyPathEvaluatedToTrue || !if_expr.value;
-				new_if_stack.anyPathEvaluatedToTrue|=(bool)if_expr.value;
+			// check if define is already defined
+			bool value=Preprocessor_isDefined(preprocessor,&token);
 
-				// push stack on stack list
-				array_append(&preprocessor->stack,&new_if_stack);
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("");
 
-				continue;
-			}
-			if(Token_equalString(&token,"ifdef")){
-				Token ifToken=token;
-				// read define argument
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("");
-				if(token.tag!=TOKEN_TAG_SYMBOL){
-					fatal("expected symbol after #ifdef directive but got instead %s",Token_print(&token));
+			// create new stack
+			struct PreprocessorIfStack new_if_stack=(struct PreprocessorIfStack){
+				.anyPathEvaluatedToTrue=false,
+				.inherited_doSkip=preprocessor->doSkip,
+				.last_directive=directive,
+				.directive_file=preprocessor->token_iter.tokenizer,
+				.items={}
+			};
+			array_init(&new_if_stack.items, sizeof(struct PreprocessorIfStackItem));
+
+			// update stack evaluation state
+			preprocessor->doSkip=new_if_stack.inherited_doSkip || new_if_stack.anyPathEvaluatedToTrue || !value;
+			new_if_stack.anyPathEvaluatedToTrue|=value;
+			new_if_stack.doSkip=preprocessor->doSkip;
+
+			// push if statement on stack
+			struct PreprocessorIfStackItem item={
+				.tag=PREPROCESSOR_STACK_ITEM_TYPE_IF,
+				.if_={
+					.if_token=ifToken,
+					.value=value,
 				}
+			};
+			array_append(&new_if_stack.items,&item);
 
-				char* define_name=calloc(token.len+1,1);
-				discard sprintf(define_name,"%.*s",token.len,token.p);
+			// push stack on stack list
+			array_append(&preprocessor->stack,&new_if_stack);
+			Preprocessor_skipConditionalBlock(preprocessor,directive);
 
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("");
+			return true;
+		}
+		if(Token_equalString(&token,"elif")){
+			Token elifToken=token;
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("");
 
-				// check if define is already defined
-				struct PreprocessorExpression if_expr={
-					.tag=PREPROCESSOR_EXPRESSION_TAG_DEFINED,
-					.defined={.name=define_name}
-				};
-				Preprocessor_evalExpression(preprocessor,&if_expr);
+			// parse expression from tokens
+			TimeReport_begin("#if evaluation");
+			bool value=Preprocessor_evaluateCondition(preprocessor,directive);
+			TimeReport_end();
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+
+			// get reference to last ifstack
+			if(preprocessor->stack.len==0) fatal("elif without if");
+			struct PreprocessorIfStack* if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
+			Preprocessor_linkConditional(preprocessor,if_stack,directive);
+
+			// write back to stack
+			struct PreprocessorIfStackItem item={
+				.tag=PREPROCESSOR_STACK_ITEM_TYPE_ELSE_IF,
+				.else_if={
+					.else_token=elifToken,
+					.value=value,
+				}
+			};
+			array_append(&if_stack->items,&item);
 
-				// create new stack
-				struct PreprocessorIfStack new_if_stack=(struct PreprocessorIfStack){
-					.anyPathEvaluatedToTrue=false,
-					.inherited_doSkip=preprocessor->doSkip,
-					.items={}
-				};
-				array_init(&new_if_stack.items, sizeof(struct PreprocessorIfStackItem));
-
-				// update stack evaluation state
-				preprocessor->doSkip=new_if_stack.inherited_doSkip || new_if_stack.anyPathEvaluatedToTrue || !if_expr.value;
-				new_if_stack.anyPathEvaluatedToTrue|=(bool)if_expr.value;
-
-				// push if statement on stack
-				struct PreprocessorIfStackItem item={
-					.tag=PREPROCESSOR_STACK_ITEM_TYPE_IF,
-					.if_={
-						.if_token=ifToken,
-						.expr=allocAndCopy(sizeof(if_expr),&if_expr)
-					}
-				};
-				array_append(&new_if_stack.items,&item);
+			preprocessor->doSkip=if_stack->inherited_doSkip || if_stack->anyPathEvaluatedToTrue || !value;
+			if_stack->anyPathEvaluatedToTrue|=value;
+			if_stack->doSkip=preprocessor->doSkip;
+			Preprocessor_skipConditionalBlock(preprocessor,directive);
 
-				// push stack on stack list
-				array_append(&preprocessor->stack,&new_if_stack);
+			return true;
+		}
+		if(Token_equalString(&token,"else")){
+			Token elseToken=token;
+			TokenIter_nextToken(&preprocessor->token_iter,&token);
+
+			// push else statement on stack
+			struct PreprocessorIfStackItem item={
+				.tag=PREPROCESSOR_STACK_ITEM_TYPE_ELSE,
+				.else_={
+					.else_token=elseToken
+				}
+			};
+			
+			// get reference to last ifstack
+			if(preprocessor->stack.len==0) fatal("else without if at %s",Token_print(&elseToken));
+			struct PreprocessorIfStack* if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
 
-				continue;
-			}
-			if(Token_equalString(&token,"elif")){
-				Token elifToken=token;
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("");
+			// append else to stack
+			array_append(&if_stack->items,&item);
+			Preprocessor_linkConditional(preprocessor,if_stack,directive);
 
-				// parse expression from tokens
-				struct PreprocessorExpression *if_expr=Preprocessor_parseExpression(preprocessor);
-				ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+			// set doSkip to inherited doSkip
+			preprocessor->doSkip=if_stack->inherited_doSkip || if_stack->anyPathEvaluatedToTrue;
+			if_stack->anyPathEvaluatedToTrue=true; // superfluous, but for clarity
+			if_stack->doSkip=preprocessor->doSkip;
+			Preprocessor_skipConditionalBlock(preprocessor,directive);
 
-				// get reference to last ifstack
-				if(preprocessor->stack.len==0) fatal("elif without if");
-				struct PreprocessorIfStack* if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
+			return true;
+		}
+		if(Token_equalString(&token,"endif")){
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
 
-				// write back to stack
-				struct PreprocessorIfStackItem item={
-					.tag=PREPROCESSOR_STACK_ITEM_TYPE_ELSE_IF,
-					.else_if={
-						.else_token=elifToken,
-						.expr=allocAndCopy(sizeof(struct PreprocessorExpression),if_expr),
-					}
-				};
-				array_append(&if_stack->items,&item);
+			if(preprocessor->stack.len==0) fatal("endif without if");
+			Preprocessor_linkConditional(preprocessor,array_get(&preprocessor->stack,preprocessor->stack.len-1),directive);
+			// pop stack
+			array_free(&((struct PreprocessorIfStack*)array_get(&preprocessor->stack,preprocessor->stack.len-1))->items);
+			array_pop_back(&preprocessor->stack);
 
-				preprocessor->doSkip=if_stack->inherited_doSkip || if_stack->anyPathEvaluatedToTrue || !if_expr->value;
-				if_stack->anyPathEvaluatedToTrue|=(bool)if_expr->value;
+			// continue the path of the enclosing stack (an #else after a taken path is skipped, even though its value is true)
+			if(preprocessor->stack.len==0){
+				preprocessor->doSkip=false;
+			}else{
+				struct PreprocessorIfStack* if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
+				preprocessor->doSkip=if_stack->doSkip;
+			}
+			
+			return true;
+		}
 
-				continue;
+		// free-standing preprocessor directives
+		if(Token_equalString(&token,"include")){
+			if(preprocessor->take_checkpoints && preprocessor->include_stack.len==0 && !preprocessor->doSkip){
+				Preprocessor_takeCheckpoint(preprocessor,&directive_start);
 			}
-			if(Token_equalString(&token,"else")){
-				Token elseToken=token;
-				TokenIter_nextToken(&preprocessor->token_iter,&token);
-
-				// push else statement on stack
-				struct PreprocessorIfStackItem item={
-					.tag=PREPROCESSOR_STACK_ITEM_TYPE_ELSE,
-					.else_={
-						.else_token=elseToken
-					}
-				};
-				
-				// get reference to last ifstack
-				if(preprocessor->stack.len==0) fatal("else without if at %s",Token_print(&elseToken));
-				struct PreprocessorIfStack* if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
 
-				// append else to stack
-				array_append(&if_stack->items,&item);
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("no token after #include %s",Token_print(&token));
 
-				// set doSkip to inherited doSkip
-				preprocessor->doSkip=if_stack->inherited_doSkip || if_stack->anyPathEvaluatedToTrue;
-				if_stack->anyPathEvaluatedToTrue=true; // superfluous, but for clarity
+			Preprocessor_processInclude(preprocessor);
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
 
-				continue;
-			}
-			if(Token_equalString(&token,"endif")){
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			return true;
+		}
+		if(Token_equalString(&token,"embed")){
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("no token after #embed");
 
-				if(preprocessor->stack.len==0) fatal("endif without if");
-				// pop stack
-				array_pop_back(&preprocessor->stack);
+			Preprocessor_processEmbed(preprocessor);
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
 
-				// set doSkip to inherited doSkip
-				if(preprocessor->stack.len==0){
-					preprocessor->doSkip=false;
-				}else{
-					struct PreprocessorIfStack* if_stack=array_get(&preprocessor->stack,preprocessor->stack.len-1);
-					preprocessor->doSkip=if_stack->inherited_doSkip || !PreprocessorIfStack_getLastValue(if_stack);
-				}
-				
-				continue;
-			}
+			return true;
+		}
+		if(Token_equalString(&token,"define")){
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("no token after #define");
 
-			// free-standing preprocessor directives
-			if(Token_equalString(&token,"include")){
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("no token after #include %s",Token_print(&token));
+			Preprocessor_processDefine(preprocessor);
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
 
-				Preprocessor_processInclude(preprocessor);
-				ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+			return true;
+		}
+		if(Token_equalString(&token,"undef")){
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("no token after #undef");
 
-				continue;
-			}
-			if(Token_equalString(&token,"define")){
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("no token after #define");
+			Preprocessor_processUndefine(preprocessor);
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
 
-				Preprocessor_processDefine(preprocessor);
-				ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+			return true;
+		}
+		if(Token_equalString(&token, "pragma")){
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("no token after #pragma");
 
-				continue;
-			}
-			if(Token_equalString(&token,"undef")){
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("no token after #undef");
+			Preprocessor_processPragma(preprocessor);
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
 
-				Preprocessor_processUndefine(preprocessor);
-				ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+			return true;
+		}
+		if(Token_equalString(&token,"error")){
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("no token after #error");
 
-				continue;
-			}
-			if(Token_equalString(&token, "pragma")){
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("no token after #pragma");
+			Preprocessor_processError(preprocessor);
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
 
-				Preprocessor_processPragma(preprocessor);
-				ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+			return true;
+		}
+		if(Token_equalString(&token,"warning")){
+			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+			if(!ntr) fatal("no token after #warning");
 
-				continue;
-			}
-			if(Token_equalString(&token,"error")){
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("no token after #error");
+			Preprocessor_processWarning(preprocessor);
+			ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
 
-				Preprocessor_processError(preprocessor);
-				ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+			return true;
+		}
 
-				continue;
-			}
-			if(Token_equalString(&token,"warning")){
-				ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-				if(!ntr) fatal("no token after #warning");
+		fatal("unknown preprocessor directive %s",Token_print(&token));
+	}
 
-				Preprocessor_processWarning(preprocessor);
-				ntr=TokenIter_lastToken(&preprocessor->token_iter,&token);
+	// get view of all tokens until next preprocessor directive (or until the run is long enough, see max_run_tokens)
+	array*new_tokens=&preprocessor->run_tokens;
+	new_tokens->len=0;
+	int paren_depth=0;
+	while(1){
+		bool run_done=false;
+		if(!preprocessor->doSkip){
+			array_append(new_tokens,&token);
 
-				continue;
+			if(preprocessor->max_run_tokens>0){
+				if(Token_equalString(&token,"(")){
+					paren_depth++;
+				}else if(Token_equalString(&token,")")){
+					paren_depth--;
+				}
+				run_done=new_tokens->len>=preprocessor->max_run_tokens && paren_depth==0 && Token_equalString(&token,";");
 			}
+		}
 
-			fatal("unknown preprocessor directive %s",Token_print(&token));
+		if(TokenIter_isEmpty(&preprocessor->token_iter)){
+			break;
 		}
 
-		// get view of all tokens until next preprocessor directive
-		array new_tokens={};
-		array_init(&new_tokens,sizeof(Token));
-		while(1){
-			if(!preprocessor->doSkip){
-				array_append(&new_tokens,&token);
-			}
+		ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
+		if(!ntr){
+			break;
+		}
 
-			if(TokenIter_isEmpty(&preprocessor->token_iter)){
-				break;
-			}
+		if(run_done || Token_equalString(&token,"#")){
+			break;
+		}
+	}
 
-			ntr=TokenIter_nextToken(&preprocessor->token_iter,&token);
-			if(!ntr){
-				break;
-			}
+	if(!preprocessor->doSkip){
+		int first_new_token=preprocessor->tokens_out.len;
+
+		// expand the single token
+		Preprocessor_expandMacros(preprocessor,new_tokens->len,new_tokens->data,&preprocessor->tokens_out);
+
+		if(preprocessor->output!=nullptr){
+			PreprocessorOutput_writeTokens(
+				preprocessor->output,
+				new_tokens->len,new_tokens->data,
+				preprocessor->tokens_out.len-first_new_token,array_get(&preprocessor->tokens_out,first_new_token)
+			);
+			// streamed tokens are not kept around
+			preprocessor->tokens_out.len=first_new_token;
+		}
+	}
 
-			if(Token_equalString(&token,"#")){
-				break;
-			}
+	if(TokenIter_isEmpty(&preprocessor->token_iter)){
+		// move past the end, which marks the file as done
+		discard TokenIter_nextToken(&preprocessor->token_iter,&token);
+	}
+
+	return true;
+}
+void Preprocessor_consume(struct Preprocessor *preprocessor, struct TokenIter *token_iter){
+	Preprocessor_pushFile(preprocessor,token_iter);
+	while(Preprocessor_step(preprocessor)){}
+}
+
+/* returns true if tokenizer is the current entry of the header cache for its file, i.e. the file has not changed on disk */
+static bool Preprocessor_isFileUnchanged(const Tokenizer*tokenizer){
+	// the header cache cannot read a file that was removed
+	if(access(tokenizer->token_src,F_OK)!=0){
+		return false;
+	}
+	return HeaderCache_get(tokenizer->token_src)==tokenizer;
+}
+static bool PreprocessorEmbeddedFile_isUnchanged(const struct PreprocessorEmbeddedFile*embedded_file){
+	struct stat file_stat;
+	return stat(embedded_file->path,&file_stat)==0
+		&& file_stat.st_dev==embedded_file->dev
+		&& file_stat.st_ino==embedded_file->ino
+		&& (size_t)file_stat.st_size==embedded_file->size
+		&& file_stat.st_mtim.tv_sec==embedded_file->mtime.tv_sec
+		&& file_stat.st_mtim.tv_nsec==embedded_file->mtime.tv_nsec;
+}
+/* number of leading tokens that two versions of a file have in common, i.e. with the same spelling at the same location */
+static int Preprocessor_countSameTokens(const Tokenizer*a,const Tokenizer*b){
+	int num_same=0;
+	for(;num_same<a->num_tokens && num_same<b->num_tokens;num_same++){
+		const Token*token_a=&a->tokens[num_same];
+		const Token*token_b=&b->tokens[num_same];
+		if(
+			token_a->tag!=token_b->tag
+			|| token_a->line!=token_b->line
+			|| token_a->col!=token_b->col
+			|| token_a->len!=token_b->len
+			|| memcmp(token_a->p,token_b->p,(size_t)token_a->len)!=0
+		){
+			break;
 		}
+	}
+	return num_same;
+}
+bool Preprocessor_resume(struct Preprocessor*preprocessor){
+	if(preprocessor->checkpoints.len==0){
+		fatal("cannot resume preprocessing without checkpoints");
+	}
+	// both refer to directives by their position in a file, which is only valid for one version of the file
+	if(preprocessor->conditional_cache!=nullptr || preprocessor->partial!=nullptr){
+		fatal("cannot resume preprocessing with a conditional cache or in partial mode");
+	}
 
-		if(!preprocessor->doSkip){
-			// expand the single token
-			Preprocessor_expandMacros(preprocessor,new_tokens.len,new_tokens.data,&preprocessor->tokens_out);
+	// the main file can change after the last checkpoint that is still used
+	Tokenizer*old_main_tokenizer=*(Tokenizer**)array_get(&preprocessor->pushed_files,0);
+	if(access(old_main_tokenizer->token_src,F_OK)!=0){
+		return false;
+	}
+	Tokenizer*main_tokenizer=HeaderCache_get(old_main_tokenizer->token_src);
+	int num_same_main_tokens=main_tokenizer==old_main_tokenizer?main_tokenizer->num_tokens:Preprocessor_countSameTokens(old_main_tokenizer,main_tokenizer);
+
+	// find the first file that was read and has changed (or was removed) since, every other file is read again anyway
+	int first_changed_pushed_file=preprocessor->pushed_files.len;
+	for(int i=1;i<preprocessor->pushed_files.len;i++){
+		const Tokenizer*tokenizer=*(Tokenizer**)array_get(&preprocessor->pushed_files,i);
+		if(Preprocessor_isFileUnchanged(tokenizer)){
+			continue;
 		}
+		if(first_changed_pushed_file==preprocessor->pushed_files.len){
+			first_changed_pushed_file=i;
+		}
+		// the include guard may have changed with the contents
+		struct PreprocessorFileInfo*file_info=Preprocessor_getFileInfo(preprocessor,tokenizer->token_src);
+		if(file_info!=nullptr){
+			file_info->guard_detected=false;
+			file_info->guard_macro=nullptr;
+		}
+	}
+	int first_changed_embedded_file=preprocessor->embedded_files.len;
+	for(int i=0;i<preprocessor->embedded_files.len;i++){
+		if(!PreprocessorEmbeddedFile_isUnchanged(array_get(&preprocessor->embedded_files,i))){
+			first_changed_embedded_file=i;
+			break;
+		}
+	}
+	if(
+		main_tokenizer==old_main_tokenizer
+		&& first_changed_pushed_file==preprocessor->pushed_files.len
+		&& first_changed_embedded_file==preprocessor->embedded_files.len
+	){
+		return false;
+	}
 
-		if(TokenIter_isEmpty(&preprocessor->token_iter)){
+	// latest checkpoint that was taken before any change was read (the start of the main file is never affected)
+	int checkpoint_index=preprocessor->checkpoints.len-1;
+	for(;checkpoint_index>0;checkpoint_index--){
+		const struct PreprocessorCheckpoint*checkpoint=array_get(&preprocessor->checkpoints,checkpoint_index);
+		if(
+			checkpoint->num_pushed_files<=first_changed_pushed_file
+			&& checkpoint->num_embedded_files<=first_changed_embedded_file
+			&& checkpoint->token_iter.next_token_index<=num_same_main_tokens
+		){
 			break;
 		}
 	}
+	struct PreprocessorCheckpoint*checkpoint=array_get(&preprocessor->checkpoints,checkpoint_index);
+
+	// the main file continues in its current version, which is the same up to the checkpoint
+	if(checkpoint_index==0){
+		Token token;
+		TokenIter_init(&checkpoint->token_iter,main_tokenizer,checkpoint->token_iter.config);
+		discard TokenIter_nextToken(&checkpoint->token_iter,&token);
+	}
+	for(int i=0;i<=checkpoint_index;i++){
+		((struct PreprocessorCheckpoint*)array_get(&preprocessor->checkpoints,i))->token_iter.tokenizer=main_tokenizer;
+	}
+	*(Tokenizer**)array_get(&preprocessor->pushed_files,0)=main_tokenizer;
+
+	PreprocessorIfStacks_free(&preprocessor->stack);
+	preprocessor->stack=PreprocessorIfStacks_copy(&checkpoint->stack);
+	preprocessor->doSkip=checkpoint->doSkip;
+
+	PreprocessorMacroTable_restore(&preprocessor->macro_table,checkpoint->macros);
+	for(int i=checkpoint->num_defines;i<preprocessor->defines.len;i++){
+		struct PreprocessorDefine*define=array_get(&preprocessor->defines,i);
+		array_free(&define->tokens);
+		if(define->args!=nullptr){
+			array_free(define->args);
+		}
+	}
+	preprocessor->defines.len=checkpoint->num_defines;
+	preprocessor->expansions.len=checkpoint->num_expansions;
+
+	for(int i=checkpoint->num_pragma_once_files;i<preprocessor->pragma_once_files.len;i++){
+		(*(struct PreprocessorFileInfo**)array_get(&preprocessor->pragma_once_files,i))->pragma_once=false;
+	}
+	preprocessor->pragma_once_files.len=checkpoint->num_pragma_once_files;
+
+	for(int i=checkpoint->num_embedded_files;i<preprocessor->embedded_files.len;i++){
+		struct PreprocessorEmbeddedFile*embedded_file=array_get(&preprocessor->embedded_files,i);
+		if(embedded_file->mapping!=nullptr){
+			munmap(embedded_file->mapping,embedded_file->size);
+		}
+	}
+	preprocessor->embedded_files.len=checkpoint->num_embedded_files;
+
+	preprocessor->tokens_out.len=checkpoint->num_tokens_out;
+	if(preprocessor->output!=nullptr){
+		writer_truncate(preprocessor->output->out,checkpoint->output_len);
+		*preprocessor->output=checkpoint->output;
+	}
+	preprocessor->source_files.len=checkpoint->num_source_files;
+	preprocessor->included_files.len=checkpoint->num_included_files;
+	preprocessor->pushed_files.len=checkpoint->num_pushed_files;
+
+	preprocessor->include_stack.len=0;
+	preprocessor->token_iter=checkpoint->token_iter;
+
+	// an include directive takes its checkpoint again when it is processed, the start of the main file is kept
+	int num_kept_checkpoints=checkpoint_index>0?checkpoint_index:1;
+	for(int i=num_kept_checkpoints;i<preprocessor->checkpoints.len;i++){
+		PreprocessorIfStacks_free(&((struct PreprocessorCheckpoint*)array_get(&preprocessor->checkpoints,i))->stack);
+	}
+	preprocessor->checkpoints.len=num_kept_checkpoints;
 
-	// restore old token iter
-	preprocessor->token_iter=old_token_iter;
+	return true;
 }
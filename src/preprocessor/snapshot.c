@@ -0,0 +1,584 @@
+// struct stat.st_mtim (modification time with nanoseconds)
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h> // open
+#include <limits.h> // INT_MAX
+#include <string.h>
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // stat
+#include <unistd.h> // close
+
+#include<util/util.h>
+
+#include<preprocessor/snapshot.h>
+
+static const char SNAPSHOT_MAGIC[8]="PACCSNAP";
+static const uint32_t SNAPSHOT_VERSION=2;
+/* string offset used to encode nullptr */
+static const uint32_t SNAPSHOT_NO_STRING=UINT32_MAX;
+
+/* range of elements in the snapshot file */
+struct SnapshotSection{
+	/* offset in bytes from the start of the file */
+	uint64_t offset;
+	/* number of elements */
+	uint32_t len;
+	uint32_t _reserved;
+};
+struct SnapshotHeader{
+	char magic[8];
+	uint32_t version;
+	/* sizeof(Token) on the platform that wrote this snapshot, snapshots are not portable between platforms */
+	uint32_t token_size;
+
+	/* zero terminated strings, element type is char */
+	struct SnapshotSection strings;
+	/* element type is struct SnapshotFile */
+	struct SnapshotSection files;
+	/* element type is struct SnapshotDefine */
+	struct SnapshotSection defines;
+	/* element type is struct SnapshotDefineArg */
+	struct SnapshotSection define_args;
+	/* element type is struct SnapshotToken */
+	struct SnapshotSection tokens;
+	/* element type is uint32_t (offset into strings) */
+	struct SnapshotSection already_included_files;
+
+	/* range of tokens_out in tokens */
+	uint32_t tokens_out_first;
+	uint32_t tokens_out_len;
+};
+/* file that contributed to a snapshot */
+struct SnapshotFile{
+	/* offset into strings */
+	uint32_t path;
+	/* nanoseconds of the modification time */
+	uint32_t mtime_nsec;
+	int64_t size;
+	/* seconds of the modification time */
+	int64_t mtime;
+	uint64_t hash;
+};
+struct SnapshotToken{
+	uint32_t tag;
+	int32_t len;
+	/* offset into strings */
+	uint32_t p;
+	/* offset into strings */
+	uint32_t filename;
+	int32_t line;
+	int32_t col;
+
+	uint8_t alreadyExpanded;
+	uint8_t literal_tag;
+	uint8_t literal_numeric_tag;
+	uint8_t _reserved;
+
+	int32_t literal_string_len;
+	/* offset into strings */
+	uint32_t literal_string_str;
+	uint32_t _reserved2;
+
+	/* raw bytes of the numeric value union */
+	uint64_t literal_numeric_value;
+	/* raw bytes of the numeric literal metainformation */
+	uint8_t literal_numeric_num_info[16];
+};
+_Static_assert(sizeof(((Token*)nullptr)->literal.numeric.value)<=sizeof(uint64_t),"numeric literal value does not fit into snapshot");
+_Static_assert(sizeof(((Token*)nullptr)->literal.numeric.num_info)<=16,"numeric literal info does not fit into snapshot");
+
+struct SnapshotDefine{
+	struct SnapshotToken name;
+	/* range of define value in tokens */
+	uint32_t first_token;
+	uint32_t num_tokens;
+	/* range of arguments in define_args, num_args is -1 if the define is not function-like */
+	uint32_t first_arg;
+	int32_t num_args;
+};
+struct SnapshotDefineArg{
+	uint32_t tag;
+	uint32_t _reserved;
+	struct SnapshotToken name;
+};
+
+struct SnapshotWriter{
+	/* element type is char */
+	array strings;
+	/* element type is struct SnapshotFile */
+	array files;
+	/* element type is struct SnapshotDefine */
+	array defines;
+	/* element type is struct SnapshotDefineArg */
+	array define_args;
+	/* element type is struct SnapshotToken */
+	array tokens;
+	/* element type is uint32_t */
+	array already_included_files;
+
+	/* filenames already written into strings, element type is struct SnapshotWriterFilename */
+	array filenames;
+};
+/* tokens of a file share the same filename pointer, which is hence only written once */
+struct SnapshotWriterFilename{
+	const char*filename;
+	uint32_t offset;
+};
+
+static uint32_t SnapshotWriter_addString(struct SnapshotWriter*snapshot_writer,const char*str,int len){
+	if(str==nullptr){
+		return SNAPSHOT_NO_STRING;
+	}
+
+	// offsets are 32 bits wide, and the section must stay addressable by an array (so snapshots are limited to INT_MAX bytes of strings)
+	if(len<0 || snapshot_writer->strings.len>INT_MAX-1-len){
+		fatal("snapshot is too large, the strings exceed %d bytes",INT_MAX);
+	}
+
+	uint32_t offset=(uint32_t)snapshot_writer->strings.len;
+	for(int i=0;i<len;i++){
+		array_append(&snapshot_writer->strings,&str[i]);
+	}
+	const char zero_terminator=0;
+	array_append(&snapshot_writer->strings,&zero_terminator);
+	return offset;
+}
+static uint32_t SnapshotWriter_addFilename(struct SnapshotWriter*snapshot_writer,const char*filename){
+	if(filename==nullptr){
+		return SNAPSHOT_NO_STRING;
+	}
+
+	// search backwards, because the last filename is most likely to be the same
+	for(int i=snapshot_writer->filenames.len-1;i>=0;i--){
+		struct SnapshotWriterFilename*known_filename=array_get(&snapshot_writer->filenames,i);
+		if(known_filename->filename==filename){
+			return known_filename->offset;
+		}
+	}
+
+	struct SnapshotWriterFilename new_filename={
+		.filename=filename,
+		.offset=SnapshotWriter_addString(snapshot_writer,filename,(int)strlen(filename)),
+	};
+	array_append(&snapshot_writer->filenames,&new_filename);
+	return new_filename.offset;
+}
+static struct SnapshotToken SnapshotWriter_convertToken(struct SnapshotWriter*snapshot_writer,const Token*token){
+	struct SnapshotToken ret={
+		.tag=token->tag,
+		.len=token->len,
+		.p=SnapshotWriter_addString(snapshot_writer,token->p,token->len),
+		.filename=SnapshotWriter_addFilename(snapshot_writer,token->filename),
+		.line=token->line,
+		.col=token->col,
+
+		.alreadyExpanded=token->alreadyExpanded,
+		.literal_tag=(uint8_t)token->literal.tag,
+		.literal_numeric_tag=(uint8_t)token->literal.numeric.tag,
+
+		.literal_string_str=SNAPSHOT_NO_STRING,
+	};
+	if(token->literal.tag==TOKEN_LITERAL_TAG_STRING){
+		ret.literal_string_len=token->literal.string.len;
+		ret.literal_string_str=SnapshotWriter_addString(snapshot_writer,token->literal.string.str,token->literal.string.len);
+	}else if(token->literal.tag==TOKEN_LITERAL_TAG_EMBED){
+		// embedded bytes are stored with the strings, so that they can be used straight from the mapping when loaded
+		if(token->literal.embed.len>INT32_MAX){
+			fatal("embedded file at %s is too large for a snapshot",Token_loc(token));
+		}
+		ret.literal_string_len=(int32_t)token->literal.embed.len;
+		ret.literal_string_str=SnapshotWriter_addString(snapshot_writer,(const char*)token->literal.embed.data,(int)token->literal.embed.len);
+	}else{
+		memcpy(&ret.literal_numeric_value,&token->literal.numeric.value,sizeof(token->literal.numeric.value));
+		memcpy(ret.literal_numeric_num_info,&token->literal.numeric.num_info,sizeof(token->literal.numeric.num_info));
+	}
+	return ret;
+}
+static void SnapshotWriter_addFile(struct SnapshotWriter*snapshot_writer,const char*path){
+	// files can be consumed more than once, but need to be recorded only once
+	for(int i=0;i<snapshot_writer->files.len;i++){
+		struct SnapshotFile*file=array_get(&snapshot_writer->files,i);
+		const char*known_path=array_get(&snapshot_writer->strings,(int)file->path);
+		if(strcmp(known_path,path)==0){
+			return;
+		}
+	}
+
+	struct stat file_stat;
+	if(stat(path,&file_stat)!=0){
+		fatal("could not stat file %s for snapshot",path);
+	}
+
+	File file;
+	File_read(path,&file);
+	struct SnapshotFile snapshot_file={
+		.path=SnapshotWriter_addString(snapshot_writer,path,(int)strlen(path)),
+		.mtime_nsec=(uint32_t)file_stat.st_mtim.tv_nsec,
+		.size=file_stat.st_size,
+		.mtime=file_stat.st_mtim.tv_sec,
+		.hash=hashBytes(file.contents,file.contents_len),
+	};
+	free((char*)file.contents);
+
+	array_append(&snapshot_writer->files,&snapshot_file);
+}
+
+void Preprocessor_writeSnapshot(struct Preprocessor*preprocessor,const char*path){
+	if(preprocessor->stack.len>0){
+		fatal("cannot write snapshot %s with unterminated conditional directive",path);
+	}
+
+	struct SnapshotWriter snapshot_writer={};
+	array_init(&snapshot_writer.strings,sizeof(char));
+	array_init(&snapshot_writer.files,sizeof(struct SnapshotFile));
+	array_init(&snapshot_writer.defines,sizeof(struct SnapshotDefine));
+	array_init(&snapshot_writer.define_args,sizeof(struct SnapshotDefineArg));
+	array_init(&snapshot_writer.tokens,sizeof(struct SnapshotToken));
+	array_init(&snapshot_writer.already_included_files,sizeof(uint32_t));
+	array_init(&snapshot_writer.filenames,sizeof(struct SnapshotWriterFilename));
+
+	for(int i=0;i<preprocessor->source_files.len;i++){
+		const char*source_file=*(const char**)array_get(&preprocessor->source_files,i);
+		SnapshotWriter_addFile(&snapshot_writer,source_file);
+	}
+
+	for(int i=0;i<preprocessor->defines.len;i++){
+		struct PreprocessorDefine*define=array_get(&preprocessor->defines,i);
+		// skip defines that have been undefined or replaced
+		if(Preprocessor_getDefine(preprocessor,&define->name)!=define){
+			continue;
+		}
+
+		struct SnapshotDefine snapshot_define={
+			.name=SnapshotWriter_convertToken(&snapshot_writer,&define->name),
+			.first_token=(uint32_t)snapshot_writer.tokens.len,
+			.num_tokens=(uint32_t)define->tokens.len,
+			.first_arg=(uint32_t)snapshot_writer.define_args.len,
+			.num_args=-1,
+		};
+		for(int j=0;j<define->tokens.len;j++){
+			struct SnapshotToken token=SnapshotWriter_convertToken(&snapshot_writer,array_get(&define->tokens,j));
+			array_append(&snapshot_writer.tokens,&token);
+		}
+		if(define->args!=nullptr){
+			snapshot_define.num_args=define->args->len;
+			for(int j=0;j<define->args->len;j++){
+				struct PreprocessorDefineFunctionlikeArg*arg=array_get(define->args,j);
+				struct SnapshotDefineArg snapshot_arg={
+					.tag=arg->tag,
+					.name=SnapshotWriter_convertToken(&snapshot_writer,&arg->name.name),
+				};
+				array_append(&snapshot_writer.define_args,&snapshot_arg);
+			}
+		}
+		array_append(&snapshot_writer.defines,&snapshot_define);
+	}
+
+	// file identities are not stable across machines, hence files with #pragma once are stored by path
+	for(int i=0;i<preprocessor->files.cap;i++){
+		const struct hashmap_entry*entry=&preprocessor->files.entries[i];
+		const struct PreprocessorFileInfo*file_info=entry->value;
+		if(entry->key==nullptr || !file_info->pragma_once){
+			continue;
+		}
+		uint32_t offset=SnapshotWriter_addString(&snapshot_writer,file_info->path,(int)strlen(file_info->path));
+		array_append(&snapshot_writer.already_included_files,&offset);
+	}
+
+	uint32_t tokens_out_first=(uint32_t)snapshot_writer.tokens.len;
+	for(int i=0;i<preprocessor->tokens_out.len;i++){
+		struct SnapshotToken token=SnapshotWriter_convertToken(&snapshot_writer,array_get(&preprocessor->tokens_out,i));
+		array_append(&snapshot_writer.tokens,&token);
+	}
+
+	// lay out sections after the header, in the order they are written
+	struct SnapshotHeader header={
+		.version=SNAPSHOT_VERSION,
+		.token_size=sizeof(Token),
+		.tokens_out_first=tokens_out_first,
+		.tokens_out_len=(uint32_t)preprocessor->tokens_out.len,
+	};
+	memcpy(header.magic,SNAPSHOT_MAGIC,sizeof(header.magic));
+
+	struct{
+		struct SnapshotSection*section;
+		array*data;
+	}sections[]={
+		{&header.files,&snapshot_writer.files},
+		{&header.defines,&snapshot_writer.defines},
+		{&header.define_args,&snapshot_writer.define_args},
+		{&header.tokens,&snapshot_writer.tokens},
+		{&header.already_included_files,&snapshot_writer.already_included_files},
+		// strings go last, because they do not require any alignment
+		{&header.strings,&snapshot_writer.strings},
+	};
+	static const int NUM_SECTIONS=sizeof(sections)/sizeof(sections[0]);
+
+	uint64_t offset=sizeof(struct SnapshotHeader);
+	for(int i=0;i<NUM_SECTIONS;i++){
+		*sections[i].section=(struct SnapshotSection){
+			.offset=offset,
+			.len=(uint32_t)sections[i].data->len,
+		};
+		offset+=(uint64_t)sections[i].data->len*sections[i].data->elem_size;
+	}
+
+	FILE*file=fopen(path,"wb");
+	if(!file){
+		fatal("could not open snapshot file %s for writing",path);
+	}
+	bool write_failed=fwrite(&header,sizeof(header),1,file)!=1;
+	for(int i=0;i<NUM_SECTIONS;i++){
+		array*data=sections[i].data;
+		if(data->len==0){
+			continue;
+		}
+		write_failed|=fwrite(data->data,data->elem_size,data->len,file)!=(size_t)data->len;
+	}
+	write_failed|=fclose(file)!=0;
+	if(write_failed){
+		fatal("could not write snapshot file %s",path);
+	}
+
+	array_free(&snapshot_writer.strings);
+	array_free(&snapshot_writer.files);
+	array_free(&snapshot_writer.defines);
+	array_free(&snapshot_writer.define_args);
+	array_free(&snapshot_writer.tokens);
+	array_free(&snapshot_writer.already_included_files);
+	array_free(&snapshot_writer.filenames);
+}
+
+/* mapped snapshot file, with sections resolved to pointers */
+struct SnapshotReader{
+	const char*base;
+	size_t size;
+
+	const struct SnapshotHeader*header;
+	const char*strings;
+	const struct SnapshotFile*files;
+	const struct SnapshotDefine*defines;
+	const struct SnapshotDefineArg*define_args;
+	const struct SnapshotToken*tokens;
+	const uint32_t*already_included_files;
+};
+
+/* get zero terminated string at offset (nullptr for SNAPSHOT_NO_STRING) */
+static const char*SnapshotReader_getString(const struct SnapshotReader*reader,uint32_t offset){
+	if(offset==SNAPSHOT_NO_STRING){
+		return nullptr;
+	}
+	if(offset>=reader->header->strings.len){
+		fatal("corrupt snapshot: string offset %u out of range",offset);
+	}
+	if(memchr(reader->strings+offset,0,reader->header->strings.len-offset)==nullptr){
+		fatal("corrupt snapshot: string at offset %u is not terminated",offset);
+	}
+	return reader->strings+offset;
+}
+/* get string of len bytes at offset (nullptr for SNAPSHOT_NO_STRING), which is followed by a zero terminator */
+static const char*SnapshotReader_getStringN(const struct SnapshotReader*reader,uint32_t offset,int32_t len){
+	if(offset==SNAPSHOT_NO_STRING){
+		return nullptr;
+	}
+	if(len<0 || offset>=reader->header->strings.len || reader->header->strings.len-offset<=(uint32_t)len){
+		fatal("corrupt snapshot: string at offset %u with length %d out of range",offset,len);
+	}
+	if(reader->strings[offset+(uint32_t)len]!=0){
+		fatal("corrupt snapshot: string at offset %u is not terminated",offset);
+	}
+	return reader->strings+offset;
+}
+/* resolve section to pointer into the mapping, after checking that the section is within bounds */
+static const void*SnapshotReader_getSection(const struct SnapshotReader*reader,const struct SnapshotSection*section,size_t elem_size){
+	if(section->offset>reader->size || (reader->size-section->offset)/elem_size<section->len){
+		fatal("corrupt snapshot: section out of range");
+	}
+	return reader->base+section->offset;
+}
+static Token SnapshotReader_convertToken(const struct SnapshotReader*reader,const struct SnapshotToken*snapshot_token){
+	Token token={
+		.tag=(enum TOKEN_TAG)snapshot_token->tag,
+		.len=snapshot_token->len,
+		.p=SnapshotReader_getStringN(reader,snapshot_token->p,snapshot_token->len),
+		.filename=SnapshotReader_getString(reader,snapshot_token->filename),
+		.line=snapshot_token->line,
+		.col=snapshot_token->col,
+		.alreadyExpanded=snapshot_token->alreadyExpanded,
+	};
+	token.literal.tag=(enum Token_LiteralTag)snapshot_token->literal_tag;
+	if(token.literal.tag==TOKEN_LITERAL_TAG_STRING){
+		token.literal.string.len=snapshot_token->literal_string_len;
+		// the string is not mutated, the cast only drops the const qualifier of the mapping
+		token.literal.string.str=(char*)SnapshotReader_getStringN(reader,snapshot_token->literal_string_str,snapshot_token->literal_string_len);
+	}else if(token.literal.tag==TOKEN_LITERAL_TAG_EMBED){
+		// embedded bytes may contain zeros, but are followed by a terminator like any other string
+		const char*data=SnapshotReader_getStringN(reader,snapshot_token->literal_string_str,snapshot_token->literal_string_len);
+		token.literal.embed.data=(const unsigned char*)data;
+		token.literal.embed.len=snapshot_token->literal_string_len;
+	}else{
+		token.literal.numeric.tag=(enum Token_LiteralNumeric_Tag)snapshot_token->literal_numeric_tag;
+		memcpy(&token.literal.numeric.value,&snapshot_token->literal_numeric_value,sizeof(token.literal.numeric.value));
+		memcpy(&token.literal.numeric.num_info,snapshot_token->literal_numeric_num_info,sizeof(token.literal.numeric.num_info));
+	}
+	return token;
+}
+/* returns true if file has not changed since it was recorded in the snapshot */
+static bool SnapshotReader_fileIsUnchanged(const struct SnapshotReader*reader,const struct SnapshotFile*snapshot_file){
+	const char*path=SnapshotReader_getString(reader,snapshot_file->path);
+
+	struct stat file_stat;
+	if(stat(path,&file_stat)!=0){
+		return false;
+	}
+	if(file_stat.st_size!=snapshot_file->size){
+		return false;
+	}
+	// with the full resolution of the timestamp, so that an edit right after the snapshot was written is noticed
+	if(file_stat.st_mtim.tv_sec==snapshot_file->mtime && file_stat.st_mtim.tv_nsec==snapshot_file->mtime_nsec){
+		return true;
+	}
+
+	// file has been touched, but the contents may still be the same
+	File file;
+	File_read(path,&file);
+	bool unchanged=hashBytes(file.contents,file.contents_len)==snapshot_file->hash;
+	free((char*)file.contents);
+	return unchanged;
+}
+
+bool Preprocessor_loadSnapshot(struct Preprocessor*preprocessor,const char*path){
+	int fd=open(path,O_RDONLY);
+	if(fd<0){
+		fatal("could not open snapshot file %s",path);
+	}
+	struct stat file_stat;
+	if(fstat(fd,&file_stat)!=0){
+		fatal("could not stat snapshot file %s",path);
+	}
+	if((size_t)file_stat.st_size<sizeof(struct SnapshotHeader)){
+		fatal("snapshot file %s is too small",path);
+	}
+
+	// the mapping stays alive as long as the preprocessor, since tokens point into it (see Preprocessor_free)
+	void*mapping=mmap(nullptr,file_stat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(mapping==MAP_FAILED){
+		fatal("could not map snapshot file %s",path);
+	}
+
+	struct SnapshotReader reader={
+		.base=mapping,
+		.size=file_stat.st_size,
+		.header=mapping,
+	};
+	if(memcmp(reader.header->magic,SNAPSHOT_MAGIC,sizeof(SNAPSHOT_MAGIC))!=0){
+		fatal("%s is not a snapshot file",path);
+	}
+	if(reader.header->version!=SNAPSHOT_VERSION || reader.header->token_size!=sizeof(Token)){
+		fatal("snapshot file %s was written by an incompatible version",path);
+	}
+	reader.strings=SnapshotReader_getSection(&reader,&reader.header->strings,sizeof(char));
+	reader.files=SnapshotReader_getSection(&reader,&reader.header->files,sizeof(struct SnapshotFile));
+	reader.defines=SnapshotReader_getSection(&reader,&reader.header->defines,sizeof(struct SnapshotDefine));
+	reader.define_args=SnapshotReader_getSection(&reader,&reader.header->define_args,sizeof(struct SnapshotDefineArg));
+	reader.tokens=SnapshotReader_getSection(&reader,&reader.header->tokens,sizeof(struct SnapshotToken));
+	reader.already_included_files=SnapshotReader_getSection(&reader,&reader.header->already_included_files,sizeof(uint32_t));
+
+	// check that no file that contributed to the snapshot has changed
+	for(uint32_t i=0;i<reader.header->files.len;i++){
+		if(!SnapshotReader_fileIsUnchanged(&reader,&reader.files[i])){
+			munmap(mapping,file_stat.st_size);
+			return false;
+		}
+	}
+
+	if(
+		reader.header->tokens_out_first>reader.header->tokens.len
+		|| reader.header->tokens.len-reader.header->tokens_out_first<reader.header->tokens_out_len
+	){
+		fatal("corrupt snapshot: emitted tokens out of range");
+	}
+
+	// replace preprocessor state with snapshot contents
+	for(int i=0;i<preprocessor->defines.len;i++){
+		struct PreprocessorDefine*define=array_get(&preprocessor->defines,i);
+		Preprocessor_removeDefine(preprocessor,&define->name);
+	}
+	for(uint32_t i=0;i<reader.header->defines.len;i++){
+		const struct SnapshotDefine*snapshot_define=&reader.defines[i];
+		if(
+			snapshot_define->first_token>reader.header->tokens.len
+			|| reader.header->tokens.len-snapshot_define->first_token<snapshot_define->num_tokens
+		){
+			fatal("corrupt snapshot: define tokens out of range");
+		}
+
+		struct PreprocessorDefine define={
+			.name=SnapshotReader_convertToken(&reader,&snapshot_define->name),
+			.tokens={},
+			.args=nullptr,
+		};
+		array_init(&define.tokens,sizeof(Token));
+		for(uint32_t j=0;j<snapshot_define->num_tokens;j++){
+			Token token=SnapshotReader_convertToken(&reader,&reader.tokens[snapshot_define->first_token+j]);
+			array_append(&define.tokens,&token);
+		}
+
+		if(snapshot_define->num_args>=0){
+			if(
+				snapshot_define->first_arg>reader.header->define_args.len
+				|| reader.header->define_args.len-snapshot_define->first_arg<(uint32_t)snapshot_define->num_args
+			){
+				fatal("corrupt snapshot: define arguments out of range");
+			}
+
+			define.args=arena_alloc(&preprocessor->arena,sizeof(array));
+			array_init(define.args,sizeof(struct PreprocessorDefineFunctionlikeArg));
+			for(int j=0;j<snapshot_define->num_args;j++){
+				const struct SnapshotDefineArg*snapshot_arg=&reader.define_args[snapshot_define->first_arg+j];
+				struct PreprocessorDefineFunctionlikeArg arg={
+					.tag=(enum PreprocessorDefineFunctionlikeArgType)snapshot_arg->tag,
+					.name={
+						.name=SnapshotReader_convertToken(&reader,&snapshot_arg->name),
+					},
+				};
+				array_append(define.args,&arg);
+			}
+		}
+
+		Preprocessor_addDefine(preprocessor,&define);
+	}
+
+	for(uint32_t i=0;i<reader.header->already_included_files.len;i++){
+		const char*already_included_file=SnapshotReader_getString(&reader,reader.already_included_files[i]);
+		// files that no longer exist cannot be included again anyway
+		struct PreprocessorFileInfo*file_info=Preprocessor_getFileInfo(preprocessor,already_included_file);
+		if(file_info!=nullptr){
+			file_info->pragma_once=true;
+		}
+	}
+
+	// the files that contributed to the snapshot also contribute to everything that is built on top of it
+	for(uint32_t i=0;i<reader.header->files.len;i++){
+		const char*source_file=SnapshotReader_getString(&reader,reader.files[i].path);
+		array_append(&preprocessor->source_files,&source_file);
+		array_append(&preprocessor->included_files,&(struct PreprocessorIncludedFile){
+			.path=source_file,
+			.is_system_header=false,
+		});
+	}
+
+	array_append(&preprocessor->snapshot_mappings,&(struct PreprocessorSnapshotMapping){
+		.mapping=mapping,
+		.size=file_stat.st_size,
+	});
+
+	preprocessor->tokens_out.len=0;
+	for(uint32_t i=0;i<reader.header->tokens_out_len;i++){
+		Token token=SnapshotReader_convertToken(&reader,&reader.tokens[reader.header->tokens_out_first+i]);
+		array_append(&preprocessor->tokens_out,&token);
+	}
+
+	return true;
+}
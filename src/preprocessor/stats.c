@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include<util/util.h>
+
+#include<preprocessor/stats.h>
+#include<preprocessor/preprocessor.h>
+
+/* current time in nanoseconds (standard C, so that no posix feature macros are required) */
+static int64_t PreprocessorStats_now(void){
+	struct timespec now;
+	discard timespec_get(&now,TIME_UTC);
+	return (int64_t)now.tv_sec*1000000000+now.tv_nsec;
+}
+
+void PreprocessorStats_init(struct PreprocessorStats*stats){
+	hashmap_init(&stats->headers);
+	hashmap_init(&stats->macros);
+	array_init(&stats->frames,sizeof(struct PreprocessorStatsFrame));
+	arena_init(&stats->arena);
+}
+void PreprocessorStats_free(struct PreprocessorStats*stats){
+	hashmap_free(&stats->headers);
+	hashmap_free(&stats->macros);
+	array_free(&stats->frames);
+	arena_free(&stats->arena);
+}
+
+static struct PreprocessorHeaderStats* PreprocessorStats_getHeader(struct PreprocessorStats*stats,const struct PreprocessorFileInfo*file){
+	struct PreprocessorHeaderStats*header=hashmap_get(&stats->headers,(const char*)&file,sizeof(file));
+	if(header==nullptr){
+		header=arena_alloc(&stats->arena,sizeof(struct PreprocessorHeaderStats));
+		*header=(struct PreprocessorHeaderStats){
+			.file=file,
+			.path=arena_copy_string(&stats->arena,file->path,strlen(file->path)),
+		};
+		hashmap_set(&stats->headers,(const char*)&header->file,sizeof(header->file),header);
+	}
+	return header;
+}
+
+void PreprocessorStats_enterFile(struct PreprocessorStats*stats,const struct PreprocessorFileInfo*file,int num_tokens){
+	struct PreprocessorHeaderStats*header=PreprocessorStats_getHeader(stats,file);
+	header->times_included++;
+	header->num_tokens+=num_tokens;
+
+	array_append(&stats->frames,&(struct PreprocessorStatsFrame){
+		.header=header,
+		.start_ns=PreprocessorStats_now(),
+		.children_ns=0,
+	});
+}
+void PreprocessorStats_leaveFile(struct PreprocessorStats*stats){
+	if(stats->frames.len==0){
+		return;
+	}
+
+	struct PreprocessorStatsFrame frame=*(struct PreprocessorStatsFrame*)array_get(&stats->frames,stats->frames.len-1);
+	array_pop_back(&stats->frames);
+
+	int64_t duration_ns=PreprocessorStats_now()-frame.start_ns;
+	frame.header->inclusive_ns+=duration_ns;
+	frame.header->exclusive_ns+=duration_ns-frame.children_ns;
+
+	if(stats->frames.len>0){
+		struct PreprocessorStatsFrame*parent=array_get(&stats->frames,stats->frames.len-1);
+		parent->children_ns+=duration_ns;
+	}
+}
+void PreprocessorStats_skipFile(struct PreprocessorStats*stats,const struct PreprocessorFileInfo*file){
+	PreprocessorStats_getHeader(stats,file)->times_skipped++;
+}
+
+void PreprocessorStats_recordExpansion(struct PreprocessorStats*stats,const char*name,int name_len,int num_tokens,int rescan_depth){
+	struct PreprocessorMacroStats*macro=hashmap_get(&stats->macros,name,name_len);
+	if(macro==nullptr){
+		macro=arena_alloc(&stats->arena,sizeof(struct PreprocessorMacroStats));
+		*macro=(struct PreprocessorMacroStats){
+			.name=arena_copy_string(&stats->arena,name,name_len),
+		};
+		hashmap_set(&stats->macros,macro->name,name_len,macro);
+	}
+
+	macro->num_expansions++;
+	macro->num_tokens_produced+=num_tokens;
+	if(rescan_depth>macro->max_rescan_depth){
+		macro->max_rescan_depth=rescan_depth;
+	}
+}
+
+static int PreprocessorHeaderStats_compare(const void*a,const void*b){
+	const struct PreprocessorHeaderStats*lhs=*(const struct PreprocessorHeaderStats*const*)a;
+	const struct PreprocessorHeaderStats*rhs=*(const struct PreprocessorHeaderStats*const*)b;
+	if(lhs->inclusive_ns!=rhs->inclusive_ns){
+		return lhs->inclusive_ns>rhs->inclusive_ns?-1:1;
+	}
+	return strcmp(lhs->path,rhs->path);
+}
+static int PreprocessorMacroStats_compare(const void*a,const void*b){
+	const struct PreprocessorMacroStats*lhs=*(const struct PreprocessorMacroStats*const*)a;
+	const struct PreprocessorMacroStats*rhs=*(const struct PreprocessorMacroStats*const*)b;
+	if(lhs->num_expansions!=rhs->num_expansions){
+		return lhs->num_expansions>rhs->num_expansions?-1:1;
+	}
+	return strcmp(lhs->name,rhs->name);
+}
+
+/* values of map as array of pointers, sorted with compare. caller frees the array */
+static void** PreprocessorStats_sorted(const hashmap*map,int(*compare)(const void*,const void*)){
+	void**values=calloc(map->len>0?map->len:1,sizeof(void*));
+	int num_values=0;
+	for(int i=0;i<map->cap;i++){
+		if(map->entries[i].key!=nullptr){
+			values[num_values++]=map->entries[i].value;
+		}
+	}
+	qsort(values,num_values,sizeof(void*),compare);
+	return values;
+}
+
+void PreprocessorStats_print(struct PreprocessorStats*stats,writer*out){
+	char line[256];
+
+	writer_write_str(out,"headers (sorted by inclusive time):\n");
+	writer_write_str(out,"  incl. ms   excl. ms     tokens included  skipped  path\n");
+	struct PreprocessorHeaderStats**headers=(struct PreprocessorHeaderStats**)PreprocessorStats_sorted(&stats->headers,PreprocessorHeaderStats_compare);
+	for(int i=0;i<stats->headers.len;i++){
+		struct PreprocessorHeaderStats*header=headers[i];
+		discard snprintf(line,sizeof(line),"%10.3f %10.3f %10lld %8d %8d  ",
+			(double)header->inclusive_ns/1e6,
+			(double)header->exclusive_ns/1e6,
+			(long long)header->num_tokens,
+			header->times_included,
+			header->times_skipped
+		);
+		writer_write_str(out,line);
+		writer_write_str(out,header->path);
+		writer_write_char(out,'\n');
+	}
+	free(headers);
+
+	writer_write_str(out,"macros (sorted by number of expansions):\n");
+	writer_write_str(out,"  expansions     tokens  max depth  name\n");
+	struct PreprocessorMacroStats**macros=(struct PreprocessorMacroStats**)PreprocessorStats_sorted(&stats->macros,PreprocessorMacroStats_compare);
+	for(int i=0;i<stats->macros.len;i++){
+		struct PreprocessorMacroStats*macro=macros[i];
+		discard snprintf(line,sizeof(line),"%12lld %10lld %10d  ",
+			(long long)macro->num_expansions,
+			(long long)macro->num_tokens_produced,
+			macro->max_rescan_depth
+		);
+		writer_write_str(out,line);
+		writer_write_str(out,macro->name);
+		writer_write_char(out,'\n');
+	}
+	free(macros);
+}
+
+void PreprocessorStats_writeJson(struct PreprocessorStats*stats,const char*path){
+	writer out={};
+	writer_open(&out,path);
+
+	writer_write_str(&out,"{\n  \"headers\": [");
+	struct PreprocessorHeaderStats**headers=(struct PreprocessorHeaderStats**)PreprocessorStats_sorted(&stats->headers,PreprocessorHeaderStats_compare);
+	for(int i=0;i<stats->headers.len;i++){
+		struct PreprocessorHeaderStats*header=headers[i];
+		writer_write_str(&out,i==0?"\n    {\"path\": \"":",\n    {\"path\": \"");
+		writer_write_escaped(&out,header->path);
+		writer_write_str(&out,"\", \"inclusive_ns\": ");
+		writer_write_int(&out,header->inclusive_ns);
+		writer_write_str(&out,", \"exclusive_ns\": ");
+		writer_write_int(&out,header->exclusive_ns);
+		writer_write_str(&out,", \"tokens\": ");
+		writer_write_int(&out,header->num_tokens);
+		writer_write_str(&out,", \"included\": ");
+		writer_write_int(&out,header->times_included);
+		writer_write_str(&out,", \"skipped\": ");
+		writer_write_int(&out,header->times_skipped);
+		writer_write_char(&out,'}');
+	}
+	free(headers);
+
+	writer_write_str(&out,"\n  ],\n  \"macros\": [");
+	struct PreprocessorMacroStats**macros=(struct PreprocessorMacroStats**)PreprocessorStats_sorted(&stats->macros,PreprocessorMacroStats_compare);
+	for(int i=0;i<stats->macros.len;i++){
+		struct PreprocessorMacroStats*macro=macros[i];
+		writer_write_str(&out,i==0?"\n    {\"name\": \"":",\n    {\"name\": \"");
+		writer_write_escaped(&out,macro->name);
+		writer_write_str(&out,"\", \"expansions\": ");
+		writer_write_int(&out,macro->num_expansions);
+		writer_write_str(&out,", \"tokens\": ");
+		writer_write_int(&out,macro->num_tokens_produced);
+		writer_write_str(&out,", \"max_rescan_depth\": ");
+		writer_write_int(&out,macro->max_rescan_depth);
+		writer_write_char(&out,'}');
+	}
+	free(macros);
+	writer_write_str(&out,"\n  ]\n}\n");
+
+	writer_close(&out);
+}
@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include<util/util.h>
+
+#include<preprocessor/target.h>
+#include<preprocessor/snapshot.h>
+
+/* predefined macros of gcc for x86_64-linux-gnu (without compiler specific macros, e.g. __GNUC__) */
+static const struct PreprocessorTargetMacro PREPROCESSOR_TARGET_X86_64_LINUX_GNU[]={
+	{"_LP64","1"},
+	{"__LP64__","1"},
+	{"__amd64","1"},
+	{"__amd64__","1"},
+	{"__x86_64","1"},
+	{"__x86_64__","1"},
+	{"__ELF__","1"},
+	{"__gnu_linux__","1"},
+	{"__linux","1"},
+	{"__linux__","1"},
+	{"__unix","1"},
+	{"__unix__","1"},
+	{"__BYTE_ORDER__","__ORDER_LITTLE_ENDIAN__"},
+	{"__CHAR16_TYPE__","short unsigned int"},
+	{"__CHAR32_TYPE__","unsigned int"},
+	{"__CHAR_BIT__","8"},
+	{"__FLOAT_WORD_ORDER__","__ORDER_LITTLE_ENDIAN__"},
+	{"__INT16_MAX__","0x7fff"},
+	{"__INT16_TYPE__","short int"},
+	{"__INT32_MAX__","0x7fffffff"},
+	{"__INT32_TYPE__","int"},
+	{"__INT64_MAX__","0x7fffffffffffffffL"},
+	{"__INT64_TYPE__","long int"},
+	{"__INT8_MAX__","0x7f"},
+	{"__INT8_TYPE__","signed char"},
+	{"__INTMAX_MAX__","0x7fffffffffffffffL"},
+	{"__INTMAX_TYPE__","long int"},
+	{"__INTPTR_MAX__","0x7fffffffffffffffL"},
+	{"__INTPTR_TYPE__","long int"},
+	{"__INT_MAX__","0x7fffffff"},
+	{"__LONG_LONG_MAX__","0x7fffffffffffffffLL"},
+	{"__LONG_MAX__","0x7fffffffffffffffL"},
+	{"__ORDER_BIG_ENDIAN__","4321"},
+	{"__ORDER_LITTLE_ENDIAN__","1234"},
+	{"__ORDER_PDP_ENDIAN__","3412"},
+	{"__PTRDIFF_MAX__","0x7fffffffffffffffL"},
+	{"__PTRDIFF_TYPE__","long int"},
+	{"__SCHAR_MAX__","0x7f"},
+	{"__SHRT_MAX__","0x7fff"},
+	{"__SIG_ATOMIC_MAX__","0x7fffffff"},
+	{"__SIG_ATOMIC_MIN__","(-__SIG_ATOMIC_MAX__ - 1)"},
+	{"__SIG_ATOMIC_TYPE__","int"},
+	{"__SIZEOF_DOUBLE__","8"},
+	{"__SIZEOF_FLOAT__","4"},
+	{"__SIZEOF_INT__","4"},
+	{"__SIZEOF_LONG_DOUBLE__","16"},
+	{"__SIZEOF_LONG_LONG__","8"},
+	{"__SIZEOF_LONG__","8"},
+	{"__SIZEOF_POINTER__","8"},
+	{"__SIZEOF_PTRDIFF_T__","8"},
+	{"__SIZEOF_SHORT__","2"},
+	{"__SIZEOF_SIZE_T__","8"},
+	{"__SIZEOF_WCHAR_T__","4"},
+	{"__SIZEOF_WINT_T__","4"},
+	{"__SIZE_MAX__","0xffffffffffffffffUL"},
+	{"__SIZE_TYPE__","long unsigned int"},
+	{"__STDC_IEC_559_COMPLEX__","1"},
+	{"__STDC_IEC_559__","1"},
+	{"__STDC_UTF_16__","1"},
+	{"__STDC_UTF_32__","1"},
+	{"__UINT16_MAX__","0xffff"},
+	{"__UINT16_TYPE__","short unsigned int"},
+	{"__UINT32_MAX__","0xffffffffU"},
+	{"__UINT32_TYPE__","unsigned int"},
+	{"__UINT64_MAX__","0xffffffffffffffffUL"},
+	{"__UINT64_TYPE__","long unsigned int"},
+	{"__UINT8_MAX__","0xff"},
+	{"__UINT8_TYPE__","unsigned char"},
+	{"__UINTMAX_MAX__","0xffffffffffffffffUL"},
+	{"__UINTMAX_TYPE__","long unsigned int"},
+	{"__UINTPTR_MAX__","0xffffffffffffffffUL"},
+	{"__UINTPTR_TYPE__","long unsigned int"},
+	{"__WCHAR_MAX__","0x7fffffff"},
+	{"__WCHAR_MIN__","(-__WCHAR_MAX__ - 1)"},
+	{"__WCHAR_TYPE__","int"},
+	{"__WINT_MAX__","0xffffffffU"},
+	{"__WINT_MIN__","0U"},
+	{"__WINT_TYPE__","unsigned int"},
+};
+
+static const struct PreprocessorTarget PREPROCESSOR_TARGETS[]={
+	{
+		.name="x86_64-linux-gnu",
+		.macros=PREPROCESSOR_TARGET_X86_64_LINUX_GNU,
+		.num_macros=sizeof(PREPROCESSOR_TARGET_X86_64_LINUX_GNU)/sizeof(PREPROCESSOR_TARGET_X86_64_LINUX_GNU[0]),
+	},
+};
+static const int PREPROCESSOR_NUM_TARGETS=sizeof(PREPROCESSOR_TARGETS)/sizeof(PREPROCESSOR_TARGETS[0]);
+
+const struct PreprocessorTarget* PreprocessorTarget_get(const char*name){
+	for(int i=0;i<PREPROCESSOR_NUM_TARGETS;i++){
+		if(strcmp(PREPROCESSOR_TARGETS[i].name,name)==0){
+			return &PREPROCESSOR_TARGETS[i];
+		}
+	}
+	fatal("unknown target %s (built-in target is %s)",name,PREPROCESSOR_TARGETS[0].name);
+}
+void PreprocessorTarget_apply(struct Preprocessor*preprocessor,const struct PreprocessorTarget*target){
+	for(int i=0;i<target->num_macros;i++){
+		const struct PreprocessorTargetMacro*macro=&target->macros[i];
+
+		// the replacement list is tokenized like a line of a file, which ends in a newline (the last token of a file
+		// without one would be lost). the tokens point into this copy, which lives in the arena of the preprocessor.
+		size_t value_len=strlen(macro->value);
+		char*value_line=arena_alloc(&preprocessor->arena,value_len+2);
+		memcpy(value_line,macro->value,value_len);
+		value_line[value_len]='\n';
+		value_line[value_len+1]=0;
+		File value_file;
+		File_fromString(target->name,value_line,&value_file);
+		Tokenizer value_tokenizer={};
+		Tokenizer_init(&value_tokenizer,&value_file);
+
+		// the name is copied as well, macros of -D flags are released before the preprocessor
+		size_t name_len=strlen(macro->name);
+		char*name=arena_alloc(&preprocessor->arena,name_len+1);
+		memcpy(name,macro->name,name_len+1);
+
+		struct PreprocessorDefine define={
+			.name=(Token){
+				.tag=TOKEN_TAG_SYMBOL,
+				.p=name,
+				.len=(int)name_len,
+				// like defines from the command line, the macro is not defined in any file
+				.filename=nullptr,
+			},
+			.tokens={},
+			.args=nullptr,
+		};
+		array_init(&define.tokens,sizeof(Token));
+		for(int j=0;j<value_tokenizer.num_tokens;j++){
+			array_append(&define.tokens,&value_tokenizer.tokens[j]);
+		}
+		free(value_tokenizer.tokens);
+
+		Preprocessor_addDefine(preprocessor,&define);
+	}
+}
+
+void PreprocessorTargetMacro_parseDefine(const char*define,struct PreprocessorTargetMacro*macro){
+	const char*equals=strchr(define,'=');
+	size_t name_len=equals!=nullptr?(size_t)(equals-define):strlen(define);
+	char*name=calloc(name_len+1,1);
+	memcpy(name,define,name_len);
+	const char*value=equals!=nullptr?equals+1:"1";
+	*macro=(struct PreprocessorTargetMacro){
+		.name=name,
+		.value=allocAndCopy(strlen(value)+1,value),
+	};
+}
+void PreprocessorTargetMacros_apply(struct Preprocessor*preprocessor,array*macros){
+	PreprocessorTarget_apply(preprocessor,&(struct PreprocessorTarget){
+		.name="<command line>",
+		.macros=macros->data,
+		.num_macros=macros->len,
+	});
+}
+void PreprocessorTargetMacros_free(array*macros){
+	for(int i=0;i<macros->len;i++){
+		struct PreprocessorTargetMacro*macro=array_get(macros,i);
+		free((char*)macro->name);
+		free((char*)macro->value);
+	}
+	array_free(macros);
+}
+
+void PreprocessorTarget_writeProfile(struct Preprocessor*preprocessor,const char*path){
+	if(preprocessor->tokens_out.len>0 || preprocessor->source_files.len>0){
+		fatal("target profile %s can only be written before any file is preprocessed",path);
+	}
+	Preprocessor_writeSnapshot(preprocessor,path);
+}
+void PreprocessorTarget_loadProfile(struct Preprocessor*preprocessor,const char*path){
+	int num_source_files=preprocessor->source_files.len;
+	// a profile does not depend on any file, so it cannot be stale
+	if(!Preprocessor_loadSnapshot(preprocessor,path) || preprocessor->source_files.len!=num_source_files || preprocessor->tokens_out.len>0){
+		fatal("%s is not a target profile (but e.g. a precompiled header)",path);
+	}
+}
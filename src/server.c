@@ -0,0 +1,497 @@
+// unix sockets, passing file descriptors over them (SCM_RIGHTS) and the credentials of the peer (SO_PEERCRED)
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include<util/util.h>
+#include<util/array.h>
+
+#include<preprocessor/header_cache.h>
+#include<server.h>
+
+/*
+a request is a header, which carries the standard streams of the client (stdin, stdout, stderr), followed by payload_len
+bytes: the working directory and then num_args arguments, each zero terminated. the response is the wait status of
+the compilation (see waitpid), as int.
+*/
+struct ServerRequestHeader{
+	uint32_t payload_len;
+	uint32_t num_args;
+};
+#define SERVER_NUM_STREAMS 3
+/* number of headers the server tokenizes between two checks for new requests (see Server_warmHeaderCache) */
+#define SERVER_WARM_HEADERS_PER_STEP 4
+
+/* compilation that is running */
+struct ServerRequest{
+	pid_t pid;
+	/* connection to the client, which waits for the response */
+	int client_fd;
+	/* the client closed the connection early (e.g. it was killed), the compilation is killed as well then */
+	bool client_gone;
+	/* read end of the pipe the compilation writes the paths of the headers it tokenized to */
+	int report_fd;
+	/* paths received so far, each zero terminated, element type is char */
+	array report;
+	/* working directory of the compilation (opened in the server), which relative header paths are resolved against */
+	int directory_fd;
+};
+/* headers reported by a finished compilation, which are not all in the header cache of the server yet */
+struct ServerWarmJob{
+	/* paths, each zero terminated, element type is char */
+	array report;
+	/* offset in report of the next path to tokenize */
+	int offset;
+	/* working directory of the compilation */
+	int directory_fd;
+};
+
+/* write end of the pipe to the server, in the process of a compilation */
+static int server_report_fd=-1;
+/* working directory of the server, which it returns to after warming the header cache (see Server_warmHeaderCache) */
+static int server_directory_fd=-1;
+
+/* returns false if the connection was closed before len bytes were read */
+static bool Server_readAll(int fd,void*data,size_t len){
+	while(len>0){
+		ssize_t num_read=read(fd,data,len);
+		if(num_read<0 && errno==EINTR){
+			continue;
+		}
+		if(num_read<=0){
+			return false;
+		}
+		data=(char*)data+num_read;
+		len-=(size_t)num_read;
+	}
+	return true;
+}
+static bool Server_writeAll(int fd,const void*data,size_t len){
+	while(len>0){
+		ssize_t num_written=write(fd,data,len);
+		if(num_written<0 && errno==EINTR){
+			continue;
+		}
+		if(num_written<=0){
+			return false;
+		}
+		data=(const char*)data+num_written;
+		len-=(size_t)num_written;
+	}
+	return true;
+}
+
+static void Server_initAddress(struct sockaddr_un*address,const char*socket_path){
+	*address=(struct sockaddr_un){.sun_family=AF_UNIX};
+	if(strlen(socket_path)>=sizeof(address->sun_path)){
+		fatal("socket path %s is too long",socket_path);
+	}
+	strcpy(address->sun_path,socket_path);
+}
+
+/* send the paths of the headers tokenized by the compilation to the server (registered with atexit) */
+static void Server_reportHeaders(void){
+	array paths={};
+	array_init(&paths,sizeof(const char*));
+	HeaderCache_takeNewPaths(&paths);
+	for(int i=0;i<paths.len;i++){
+		const char*path=*(const char**)array_get(&paths,i);
+		if(!Server_writeAll(server_report_fd,path,strlen(path)+1)){
+			break;
+		}
+	}
+	array_free(&paths);
+	close(server_report_fd);
+}
+
+/* tokenize the header at path into the header cache, headers that cannot be read anymore are skipped */
+static void Server_warmHeader(const char*path){
+	struct FatalHandler handler;
+	if(setjmp(handler.jump)==0){
+		fatal_setHandler(&handler);
+		discard HeaderCache_get(path);
+	}
+	fatal_setHandler(nullptr);
+}
+/*
+tokenize the next few headers that compilations reported (element type of warm_jobs is struct ServerWarmJob), so that
+later compilations find them in the header cache. finished jobs are removed.
+
+this runs between polls, so a new request waits for at most SERVER_WARM_HEADERS_PER_STEP headers instead of all
+headers of the previous compilation. in turn, the cache is only complete a little while after a compilation is done.
+*/
+static void Server_warmHeaderCache(array*warm_jobs){
+	if(warm_jobs->len==0){
+		return;
+	}
+	struct ServerWarmJob*job=array_get(warm_jobs,warm_jobs->len-1);
+
+	// the paths are relative to the working directory of the compilation, which the server only enters for this
+	if(fchdir(job->directory_fd)!=0){
+		job->offset=job->report.len;
+	}else{
+		for(int i=0;i<SERVER_WARM_HEADERS_PER_STEP && job->offset<job->report.len;i++){
+			const char*path=(const char*)job->report.data+job->offset;
+			job->offset+=(int)strlen(path)+1;
+			Server_warmHeader(path);
+		}
+		if(fchdir(server_directory_fd)!=0){
+			fatal("compile server could not return to its working directory: %s",strerror(errno));
+		}
+	}
+	if(job->offset>=job->report.len){
+		array_free(&job->report);
+		close(job->directory_fd);
+		array_pop_back(warm_jobs);
+	}
+
+	// the server tokenized all of them on behalf of the compilation, so they are not reported again
+	array tokenized_paths={};
+	array_init(&tokenized_paths,sizeof(const char*));
+	HeaderCache_takeNewPaths(&tokenized_paths);
+	array_free(&tokenized_paths);
+}
+
+/* returns true if the client on the other end of client_fd runs as the same user as the server */
+static bool Server_isSameUser(int client_fd){
+	struct ucred credentials={};
+	socklen_t credentials_len=sizeof(credentials);
+	if(getsockopt(client_fd,SOL_SOCKET,SO_PEERCRED,&credentials,&credentials_len)!=0){
+		return false;
+	}
+	return credentials.uid==geteuid();
+}
+
+/*
+read the request of a newly connected client, and fork the compilation. returns false if the request is invalid, then
+the connection is closed
+*/
+static bool Server_startRequest(int listen_fd,int client_fd,array*requests,ServerCompileFunction*compile){
+	struct ServerRequestHeader header={};
+	int streams[SERVER_NUM_STREAMS]={-1,-1,-1};
+
+	// the header carries the streams of the client
+	union{
+		char data[CMSG_SPACE(sizeof(streams))];
+		struct cmsghdr align;
+	}control={};
+	struct iovec header_data={.iov_base=&header,.iov_len=sizeof(header)};
+	struct msghdr message={
+		.msg_iov=&header_data,
+		.msg_iovlen=1,
+		.msg_control=control.data,
+		.msg_controllen=sizeof(control.data),
+	};
+	ssize_t num_received=recvmsg(client_fd,&message,0);
+	struct cmsghdr*control_message=CMSG_FIRSTHDR(&message);
+	if(
+		control_message==nullptr
+		|| control_message->cmsg_level!=SOL_SOCKET
+		|| control_message->cmsg_type!=SCM_RIGHTS
+		|| control_message->cmsg_len!=CMSG_LEN(sizeof(streams))
+	){
+		return false;
+	}
+	memcpy(streams,CMSG_DATA(control_message),sizeof(streams));
+
+	char*payload=nullptr;
+	const char**args=nullptr;
+	bool is_valid=num_received==(ssize_t)sizeof(header) && header.num_args>0;
+	if(is_valid){
+		payload=calloc((size_t)header.payload_len+1,1);
+		is_valid=Server_readAll(client_fd,payload,header.payload_len);
+	}
+	if(is_valid){
+		// the working directory and the arguments are zero terminated, and the payload ends after the last argument
+		args=calloc(header.num_args+1,sizeof(const char*));
+		uint32_t offset=(uint32_t)strlen(payload)+1;
+		for(uint32_t i=0;i<header.num_args && is_valid;i++){
+			is_valid=offset<header.payload_len;
+			if(is_valid){
+				args[i]=payload+offset;
+				offset+=(uint32_t)strlen(payload+offset)+1;
+			}
+		}
+		is_valid=is_valid && offset==header.payload_len;
+	}
+	int directory_fd=-1;
+	if(is_valid){
+		// the compilation changes into the working directory, the server itself stays where it is
+		directory_fd=open(payload,O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+		is_valid=directory_fd>=0;
+		if(!is_valid){
+			static const char message_text[]="compile server could not open the working directory\n";
+			discard Server_writeAll(streams[2],message_text,strlen(message_text));
+		}
+	}
+
+	int report_pipe[2]={-1,-1};
+	pid_t pid=-1;
+	if(is_valid && pipe(report_pipe)==0){
+		// nothing buffered may be written twice
+		discard fflush(stdout);
+		discard fflush(stderr);
+		pid=fork();
+	}
+	if(pid==0){
+		// the compilation only keeps the streams of its client, and the write end of its report pipe
+		close(listen_fd);
+		close(client_fd);
+		close(report_pipe[0]);
+		close(server_directory_fd);
+		for(int i=0;i<requests->len;i++){
+			struct ServerRequest*other=array_get(requests,i);
+			close(other->client_fd);
+			close(other->report_fd);
+			close(other->directory_fd);
+		}
+		for(int i=0;i<SERVER_NUM_STREAMS;i++){
+			dup2(streams[i],i);
+			close(streams[i]);
+		}
+		if(fchdir(directory_fd)!=0){
+			static const char message_text[]="compile server could not change to the working directory\n";
+			discard Server_writeAll(STDERR_FILENO,message_text,strlen(message_text));
+			exit(1);
+		}
+		close(directory_fd);
+		// the server ignores broken pipes, a compilation on its own does not
+		signal(SIGPIPE,SIG_DFL);
+
+		server_report_fd=report_pipe[1];
+		atexit(Server_reportHeaders);
+		exit(compile((int)header.num_args,args));
+	}
+
+	for(int i=0;i<SERVER_NUM_STREAMS;i++){
+		if(streams[i]>=0){
+			close(streams[i]);
+		}
+	}
+	free(args);
+	free(payload);
+	if(pid<0){
+		if(directory_fd>=0){
+			close(directory_fd);
+		}
+		if(report_pipe[0]>=0){
+			close(report_pipe[0]);
+			close(report_pipe[1]);
+		}
+		return false;
+	}
+	close(report_pipe[1]);
+
+	struct ServerRequest request={
+		.pid=pid,
+		.client_fd=client_fd,
+		.client_gone=false,
+		.report_fd=report_pipe[0],
+		.report={},
+		.directory_fd=directory_fd,
+	};
+	array_init(&request.report,sizeof(char));
+	array_append(requests,&request);
+	return true;
+}
+
+/*
+read what the compilation of request reported. once it is done (i.e. the report ends), send its status to the client,
+and queue the reported headers in warm_jobs (see Server_warmHeaderCache). returns true if the request is done, it is
+freed then
+*/
+static bool Server_continueRequest(struct ServerRequest*request,array*warm_jobs){
+	char data[4096];
+	ssize_t num_read=read(request->report_fd,data,sizeof(data));
+	if(num_read<0 && errno==EINTR){
+		return false;
+	}
+	if(num_read>0){
+		for(ssize_t i=0;i<num_read;i++){
+			array_append(&request->report,&data[i]);
+		}
+		return false;
+	}
+
+	int status=0;
+	while(waitpid(request->pid,&status,0)<0 && errno==EINTR){}
+	// the client may be gone already, which only affects this request
+	discard Server_writeAll(request->client_fd,&status,sizeof(status));
+	close(request->client_fd);
+	close(request->report_fd);
+
+	if(request->report.len>0){
+		array_append(warm_jobs,&(struct ServerWarmJob){
+			.report=request->report,
+			.offset=0,
+			.directory_fd=request->directory_fd,
+		});
+	}else{
+		array_free(&request->report);
+		close(request->directory_fd);
+	}
+	return true;
+}
+
+void Server_run(const char*socket_path,ServerCompileFunction*compile){
+	struct sockaddr_un address;
+	Server_initAddress(&address,socket_path);
+
+	int listen_fd=socket(AF_UNIX,SOCK_STREAM,0);
+	if(listen_fd<0){
+		fatal("could not create socket: %s",strerror(errno));
+	}
+	// a socket left behind by a previous server is replaced
+	discard unlink(socket_path);
+	if(bind(listen_fd,(struct sockaddr*)&address,sizeof(address))!=0){
+		fatal("could not bind socket %s: %s",socket_path,strerror(errno));
+	}
+	if(listen(listen_fd,SOMAXCONN)!=0){
+		fatal("could not listen on socket %s: %s",socket_path,strerror(errno));
+	}
+
+	server_directory_fd=open(".",O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if(server_directory_fd<0){
+		fatal("could not open working directory: %s",strerror(errno));
+	}
+
+	// writing the response to a client that is gone must not terminate the server
+	signal(SIGPIPE,SIG_IGN);
+
+	/* compilations that are running, element type is struct ServerRequest */
+	array requests={};
+	array_init(&requests,sizeof(struct ServerRequest));
+	/* headers to tokenize while there is nothing else to do, element type is struct ServerWarmJob */
+	array warm_jobs={};
+	array_init(&warm_jobs,sizeof(struct ServerWarmJob));
+	/* listening socket first, then the report pipe and the client connection of every request */
+	array poll_fds={};
+	array_init(&poll_fds,sizeof(struct pollfd));
+	while(true){
+		poll_fds.len=0;
+		array_append(&poll_fds,&(struct pollfd){.fd=listen_fd,.events=POLLIN});
+		for(int i=0;i<requests.len;i++){
+			const struct ServerRequest*request=array_get(&requests,i);
+			array_append(&poll_fds,&(struct pollfd){.fd=request->report_fd,.events=POLLIN});
+			// clients send nothing after the request, so the connection only becomes readable when it is closed
+			array_append(&poll_fds,&(struct pollfd){.fd=request->client_gone?-1:request->client_fd,.events=POLLIN});
+		}
+		// while headers are left to tokenize, poll only checks for events, and the next few headers are tokenized afterwards
+		if(poll(poll_fds.data,(nfds_t)poll_fds.len,warm_jobs.len>0?0:-1)<0){
+			if(errno==EINTR){
+				continue;
+			}
+			fatal("could not wait for requests: %s",strerror(errno));
+		}
+
+		// requests are removed by moving the last one into their place, so they are visited from the back
+		for(int i=requests.len-1;i>=0;i--){
+			struct ServerRequest*request=array_get(&requests,i);
+			if(((struct pollfd*)array_get(&poll_fds,1+2*i+1))->revents!=0){
+				request->client_gone=true;
+				discard kill(request->pid,SIGKILL);
+			}
+			if(((struct pollfd*)array_get(&poll_fds,1+2*i))->revents==0){
+				continue;
+			}
+			if(Server_continueRequest(request,&warm_jobs)){
+				memcpy(array_get(&requests,i),array_get(&requests,requests.len-1),sizeof(struct ServerRequest));
+				array_pop_back(&requests);
+			}
+		}
+
+		if(((struct pollfd*)array_get(&poll_fds,0))->revents!=0){
+			int client_fd=accept(listen_fd,nullptr,nullptr);
+			// compilations run with the rights of the server, so other users are not served
+			if(client_fd>=0 && (!Server_isSameUser(client_fd) || !Server_startRequest(listen_fd,client_fd,&requests,compile))){
+				close(client_fd);
+			}
+		}
+
+		Server_warmHeaderCache(&warm_jobs);
+	}
+}
+
+int Server_forward(const char*socket_path,int argc,const char**argv){
+	struct sockaddr_un address;
+	Server_initAddress(&address,socket_path);
+
+	int server_fd=socket(AF_UNIX,SOCK_STREAM,0);
+	if(server_fd<0){
+		fatal("could not create socket: %s",strerror(errno));
+	}
+	if(connect(server_fd,(struct sockaddr*)&address,sizeof(address))!=0){
+		fatal("could not connect to compile server %s: %s",socket_path,strerror(errno));
+	}
+
+	// payload is the working directory, followed by the arguments
+	array payload={};
+	array_init(&payload,sizeof(char));
+	char*working_directory=getcwd(nullptr,0);
+	if(working_directory==nullptr){
+		fatal("could not get working directory: %s",strerror(errno));
+	}
+	for(const char*c=working_directory;;c++){
+		array_append(&payload,c);
+		if(*c==0){
+			break;
+		}
+	}
+	free(working_directory);
+	for(int i=0;i<argc;i++){
+		for(const char*c=argv[i];;c++){
+			array_append(&payload,c);
+			if(*c==0){
+				break;
+			}
+		}
+	}
+
+	struct ServerRequestHeader header={
+		.payload_len=(uint32_t)payload.len,
+		.num_args=(uint32_t)argc,
+	};
+	const int streams[SERVER_NUM_STREAMS]={STDIN_FILENO,STDOUT_FILENO,STDERR_FILENO};
+	union{
+		char data[CMSG_SPACE(sizeof(streams))];
+		struct cmsghdr align;
+	}control={};
+	struct iovec header_data={.iov_base=&header,.iov_len=sizeof(header)};
+	struct msghdr message={
+		.msg_iov=&header_data,
+		.msg_iovlen=1,
+		.msg_control=control.data,
+		.msg_controllen=sizeof(control.data),
+	};
+	struct cmsghdr*control_message=CMSG_FIRSTHDR(&message);
+	control_message->cmsg_level=SOL_SOCKET;
+	control_message->cmsg_type=SCM_RIGHTS;
+	control_message->cmsg_len=CMSG_LEN(sizeof(streams));
+	memcpy(CMSG_DATA(control_message),streams,sizeof(streams));
+
+	if(sendmsg(server_fd,&message,0)!=(ssize_t)sizeof(header) || !Server_writeAll(server_fd,payload.data,(size_t)payload.len)){
+		fatal("could not send request to compile server %s",socket_path);
+	}
+	array_free(&payload);
+
+	int status=0;
+	if(!Server_readAll(server_fd,&status,sizeof(status))){
+		fatal("compile server %s closed the connection",socket_path);
+	}
+	close(server_fd);
+
+	if(WIFSIGNALED(status)){
+		signal(WTERMSIG(status),SIG_DFL);
+		raise(WTERMSIG(status));
+	}
+	return WEXITSTATUS(status);
+}
@@ -0,0 +1,132 @@
+#include<string.h>
+
+#include<util/util.h>
+
+#include<string_literals.h>
+
+static bool StringLiterals_isString(const Token*token){
+	return token->tag==TOKEN_TAG_LITERAL && token->literal.tag==TOKEN_LITERAL_TAG_STRING;
+}
+/* returns true if token is an encoding prefix that is directly attached to the string literal next */
+static bool StringLiterals_isPrefix(const Token*token,const Token*next){
+	if(token->tag!=TOKEN_TAG_SYMBOL || !StringLiterals_isString(next) || token->p+token->len!=next->p){
+		return false;
+	}
+	return Token_equalString(token,"u8") || Token_equalString(token,"L") || Token_equalString(token,"u") || Token_equalString(token,"U");
+}
+/*
+get number of tokens of the string literal at index (0 if there is none), i.e. 2 if the literal has an encoding prefix
+(which is stored in prefix), 1 otherwise
+*/
+static int StringLiterals_literalAt(const Tokenizer*tokenizer,int index,const Token**prefix){
+	*prefix=nullptr;
+	if(index>=tokenizer->num_tokens){
+		return 0;
+	}
+	const Token*token=&tokenizer->tokens[index];
+	if(StringLiterals_isString(token)){
+		return 1;
+	}
+	if(index+1<tokenizer->num_tokens && StringLiterals_isPrefix(token,&tokenizer->tokens[index+1])){
+		*prefix=token;
+		return 2;
+	}
+	return 0;
+}
+/* skip comments starting at index, returns index of the first token that is not a comment */
+static int StringLiterals_skipComments(const Tokenizer*tokenizer,int index){
+	while(index<tokenizer->num_tokens && tokenizer->tokens[index].tag==TOKEN_TAG_COMMENT){
+		index++;
+	}
+	return index;
+}
+
+void StringLiterals_concatenate(Tokenizer*tokenizer,arena*spellings){
+	int num_tokens_out=0;
+	for(int index=0;index<tokenizer->num_tokens;){
+		const Token*prefix=nullptr;
+		int literal_num_tokens=StringLiterals_literalAt(tokenizer,index,&prefix);
+		if(literal_num_tokens==0){
+			tokenizer->tokens[num_tokens_out++]=tokenizer->tokens[index++];
+			continue;
+		}
+
+		// find end of the run and the total length of the literal contents, and check that the prefixes agree
+		const Token*run_prefix=prefix;
+		int num_literals=0;
+		int contents_len=0;
+		int run_end=index;
+		while(true){
+			const Token*literal_prefix=nullptr;
+			int num_literal_tokens=StringLiterals_literalAt(tokenizer,run_end,&literal_prefix);
+			if(num_literal_tokens==0){
+				break;
+			}
+			if(literal_prefix!=nullptr){
+				if(run_prefix!=nullptr && !Token_equalToken(run_prefix,literal_prefix)){
+					fatal("concatenation of string literals with different encoding prefixes %.*s and %.*s at %s",
+						run_prefix->len,run_prefix->p,
+						literal_prefix->len,literal_prefix->p,
+						Token_loc(literal_prefix)
+					);
+				}
+				run_prefix=literal_prefix;
+			}
+
+			const Token*literal=&tokenizer->tokens[run_end+num_literal_tokens-1];
+			// spelling without the quotes
+			contents_len+=literal->len-2;
+			num_literals++;
+
+			int next=StringLiterals_skipComments(tokenizer,run_end+num_literal_tokens);
+			const Token*next_prefix=nullptr;
+			if(StringLiterals_literalAt(tokenizer,next,&next_prefix)==0){
+				run_end+=num_literal_tokens;
+				break;
+			}
+			run_end=next;
+		}
+
+		// a single literal without prefix stays as it is
+		if(num_literals==1 && run_prefix==nullptr){
+			tokenizer->tokens[num_tokens_out++]=tokenizer->tokens[index];
+			index=run_end;
+			continue;
+		}
+
+		// build joined spelling once: prefix, quote, contents of all literals, quote
+		int prefix_len=run_prefix!=nullptr?run_prefix->len:0;
+		int joined_len=prefix_len+contents_len+2;
+		char*joined=arena_alloc(spellings,(size_t)joined_len+1);
+		char*write_pos=joined;
+		if(run_prefix!=nullptr){
+			memcpy(write_pos,run_prefix->p,(size_t)prefix_len);
+			write_pos+=prefix_len;
+		}
+		*write_pos++='"';
+		for(int i=index;i<run_end;i++){
+			const Token*literal=&tokenizer->tokens[i];
+			if(!StringLiterals_isString(literal)){
+				// prefix or comment
+				continue;
+			}
+			memcpy(write_pos,literal->p+1,(size_t)literal->len-2);
+			write_pos+=literal->len-2;
+		}
+		*write_pos++='"';
+		*write_pos=0;
+
+		// the joined literal is located at the start of the run
+		Token joined_token=tokenizer->tokens[index];
+		joined_token.tag=TOKEN_TAG_LITERAL;
+		joined_token.literal.tag=TOKEN_LITERAL_TAG_STRING;
+		joined_token.p=joined;
+		joined_token.len=joined_len;
+		joined_token.literal.string.str=joined;
+		joined_token.literal.string.len=joined_len;
+		tokenizer->tokens[num_tokens_out++]=joined_token;
+
+		index=run_end;
+	}
+	tokenizer->num_tokens=num_tokens_out;
+}
@@ -0,0 +1,175 @@
+// clock_gettime, with the monotonic and thread cpu time clocks
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <time.h>
+
+#include<util/util.h>
+
+#include<time_report.h>
+
+/* report of the calling thread, nullptr if phases are not recorded */
+static _Thread_local struct TimeReport*active_report=nullptr;
+
+static int64_t TimeReport_clock(clockid_t clock){
+	struct timespec now;
+	discard clock_gettime(clock,&now);
+	return (int64_t)now.tv_sec*1000000000+now.tv_nsec;
+}
+
+void TimeReport_init(struct TimeReport*report){
+	array_init(&report->nodes,sizeof(struct TimeReportNode));
+	array_init(&report->frames,sizeof(struct TimeReportFrame));
+}
+void TimeReport_free(struct TimeReport*report){
+	array_free(&report->nodes);
+	array_free(&report->frames);
+}
+
+void TimeReport_setActive(struct TimeReport*report){
+	active_report=report;
+}
+
+/* index of the node of phase name under parent (-1 for top level), which is created if it does not exist yet */
+static int TimeReport_getNode(struct TimeReport*report,int parent,const char*name){
+	int first_child=-1;
+	if(parent>=0){
+		first_child=((struct TimeReportNode*)array_get(&report->nodes,parent))->first_child;
+	}else if(report->nodes.len>0){
+		first_child=0;
+	}
+
+	int last_child=-1;
+	for(int child=first_child;child>=0;){
+		struct TimeReportNode*node=array_get(&report->nodes,child);
+		if(node->name==name){
+			return child;
+		}
+		last_child=child;
+		child=node->next_sibling;
+	}
+
+	int index=report->nodes.len;
+	array_append(&report->nodes,&(struct TimeReportNode){
+		.name=name,
+		.parent=parent,
+		.first_child=-1,
+		.next_sibling=-1,
+	});
+	if(last_child>=0){
+		((struct TimeReportNode*)array_get(&report->nodes,last_child))->next_sibling=index;
+	}
+	if(parent>=0){
+		struct TimeReportNode*parent_node=array_get(&report->nodes,parent);
+		if(parent_node->first_child<0){
+			parent_node->first_child=index;
+		}
+	}
+	return index;
+}
+
+void TimeReport_begin(const char*name){
+	struct TimeReport*report=active_report;
+	if(report==nullptr){
+		return;
+	}
+
+	// the innermost phase that is recorded is the parent
+	int parent=-1;
+	bool is_running=false;
+	for(int i=report->frames.len-1;i>=0;i--){
+		int node=((struct TimeReportFrame*)array_get(&report->frames,i))->node;
+		if(node<0){
+			continue;
+		}
+		if(parent<0){
+			parent=node;
+		}
+		if(((struct TimeReportNode*)array_get(&report->nodes,node))->name==name){
+			is_running=true;
+			break;
+		}
+	}
+	if(is_running){
+		array_append(&report->frames,&(struct TimeReportFrame){.node=-1});
+		return;
+	}
+
+	int node=TimeReport_getNode(report,parent,name);
+	// allocations of the frame itself are not part of the phase
+	array_append(&report->frames,&(struct TimeReportFrame){.node=node});
+	struct TimeReportFrame*frame=array_get(&report->frames,report->frames.len-1);
+	frame->start_allocations=util_num_allocations;
+	frame->start_cpu_ns=TimeReport_clock(CLOCK_THREAD_CPUTIME_ID);
+	frame->start_wall_ns=TimeReport_clock(CLOCK_MONOTONIC);
+}
+void TimeReport_end(void){
+	struct TimeReport*report=active_report;
+	if(report==nullptr || report->frames.len==0){
+		return;
+	}
+
+	int64_t end_wall_ns=TimeReport_clock(CLOCK_MONOTONIC);
+	int64_t end_cpu_ns=TimeReport_clock(CLOCK_THREAD_CPUTIME_ID);
+
+	struct TimeReportFrame frame=*(struct TimeReportFrame*)array_get(&report->frames,report->frames.len-1);
+	array_pop_back(&report->frames);
+	if(frame.node<0){
+		return;
+	}
+
+	struct TimeReportNode*node=array_get(&report->nodes,frame.node);
+	node->count++;
+	node->wall_ns+=end_wall_ns-frame.start_wall_ns;
+	node->cpu_ns+=end_cpu_ns-frame.start_cpu_ns;
+	node->num_allocations+=util_num_allocations-frame.start_allocations;
+}
+
+static void TimeReport_printNode(struct TimeReport*report,int index,int depth,int64_t total_wall_ns,writer*out){
+	const struct TimeReportNode*node=array_get(&report->nodes,index);
+
+	char line[256];
+	discard snprintf(line,sizeof(line),"%10.3f %6.1f%% %10.3f %12llu %10lld  %*s",
+		(double)node->wall_ns/1e6,
+		total_wall_ns>0?100.0*(double)node->wall_ns/(double)total_wall_ns:0.0,
+		(double)node->cpu_ns/1e6,
+		(unsigned long long)node->num_allocations,
+		(long long)node->count,
+		depth*2,""
+	);
+	writer_write_str(out,line);
+	writer_write_str(out,node->name);
+	writer_write_char(out,'\n');
+
+	for(int child=node->first_child;child>=0;child=((struct TimeReportNode*)array_get(&report->nodes,child))->next_sibling){
+		TimeReport_printNode(report,child,depth+1,total_wall_ns,out);
+	}
+}
+void TimeReport_print(struct TimeReport*report,writer*out){
+	struct TimeReportNode total={.name="total"};
+	for(int top_level=report->nodes.len>0?0:-1;top_level>=0;){
+		const struct TimeReportNode*node=array_get(&report->nodes,top_level);
+		total.wall_ns+=node->wall_ns;
+		total.cpu_ns+=node->cpu_ns;
+		total.num_allocations+=node->num_allocations;
+		top_level=node->next_sibling;
+	}
+
+	writer_write_str(out,"time report (wall and cpu time in ms, heap allocations, sub-phases are indented):\n");
+	writer_write_str(out,"   wall ms   wall%     cpu ms       allocs      calls  phase\n");
+	for(int top_level=report->nodes.len>0?0:-1;top_level>=0;){
+		TimeReport_printNode(report,top_level,0,total.wall_ns,out);
+		top_level=((struct TimeReportNode*)array_get(&report->nodes,top_level))->next_sibling;
+	}
+
+	char line[256];
+	discard snprintf(line,sizeof(line),"%10.3f %6.1f%% %10.3f %12llu %10s  %s\n",
+		(double)total.wall_ns/1e6,
+		100.0,
+		(double)total.cpu_ns/1e6,
+		(unsigned long long)total.num_allocations,
+		"",
+		total.name
+	);
+	writer_write_str(out,line);
+}
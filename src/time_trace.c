@@ -0,0 +1,96 @@
+// clock_gettime, with the monotonic clock
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include<util/util.h>
+#include<util/writer.h>
+
+#include<time_trace.h>
+
+/* trace of the calling thread, nullptr if spans are not recorded */
+static _Thread_local struct TimeTrace*active_trace=nullptr;
+
+static int64_t TimeTrace_now(void){
+	struct timespec now;
+	discard clock_gettime(CLOCK_MONOTONIC,&now);
+	return (int64_t)now.tv_sec*1000000000+now.tv_nsec;
+}
+
+void TimeTrace_init(struct TimeTrace*trace,int64_t min_duration_us){
+	trace->start_ns=TimeTrace_now();
+	trace->min_duration_ns=min_duration_us*1000;
+	array_init(&trace->events,sizeof(struct TimeTraceEvent));
+	arena_init(&trace->details);
+	array_init(&trace->spans,sizeof(struct TimeTraceSpan));
+}
+void TimeTrace_free(struct TimeTrace*trace){
+	array_free(&trace->events);
+	arena_free(&trace->details);
+	array_free(&trace->spans);
+}
+
+void TimeTrace_setActive(struct TimeTrace*trace){
+	active_trace=trace;
+}
+
+void TimeTrace_begin(const char*name,const char*detail,int detail_len){
+	struct TimeTrace*trace=active_trace;
+	if(trace==nullptr){
+		return;
+	}
+
+	array_append(&trace->spans,&(struct TimeTraceSpan){
+		.name=name,
+		.detail=detail,
+		.detail_len=detail_len,
+		.start_ns=TimeTrace_now(),
+	});
+}
+void TimeTrace_end(void){
+	struct TimeTrace*trace=active_trace;
+	if(trace==nullptr || trace->spans.len==0){
+		return;
+	}
+
+	int64_t end_ns=TimeTrace_now();
+
+	const struct TimeTraceSpan span=*(struct TimeTraceSpan*)array_get(&trace->spans,trace->spans.len-1);
+	array_pop_back(&trace->spans);
+	if(trace->spans.len>0 && end_ns-span.start_ns<trace->min_duration_ns){
+		return;
+	}
+
+	array_append(&trace->events,&(struct TimeTraceEvent){
+		.name=span.name,
+		.detail=span.detail!=nullptr?arena_copy_string(&trace->details,span.detail,(size_t)span.detail_len):nullptr,
+		.start_ns=span.start_ns-trace->start_ns,
+		.duration_ns=end_ns-span.start_ns,
+	});
+}
+
+void TimeTrace_write(struct TimeTrace*trace,const char*path){
+	writer out={};
+	writer_open(&out,path);
+
+	// complete events ("X"), which nest by their time ranges
+	writer_write_str(&out,"{\"traceEvents\": [");
+	for(int i=0;i<trace->events.len;i++){
+		const struct TimeTraceEvent*event=array_get(&trace->events,i);
+		writer_write_str(&out,i==0?"\n  {\"name\": \"":",\n  {\"name\": \"");
+		writer_write_escaped(&out,event->name);
+		writer_write_str(&out,"\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": ");
+		writer_write_int(&out,event->start_ns/1000);
+		writer_write_str(&out,", \"dur\": ");
+		writer_write_int(&out,event->duration_ns/1000);
+		if(event->detail!=nullptr){
+			writer_write_str(&out,", \"args\": {\"detail\": \"");
+			writer_write_escaped(&out,event->detail);
+			writer_write_str(&out,"\"}");
+		}
+		writer_write_char(&out,'}');
+	}
+	writer_write_str(&out,"\n], \"displayTimeUnit\": \"ms\"}\n");
+
+	writer_close(&out);
+}
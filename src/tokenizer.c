@@ -254,6 +254,8 @@ int Tokenizer_init(Tokenizer tokenizer[static 1],const File file[static 1]){
 			p++;
 
 			token.len=p-token.p;
+			// the opening quotation mark has been counted already
+			col+=token.len-1;
 		}
 
 		// 2) character literal
@@ -334,6 +336,8 @@ int Tokenizer_init(Tokenizer tokenizer[static 1],const File file[static 1]){
 			p++;
 
 			token.len=p-token.p;
+			// the opening quotation mark has been counted already
+			col+=token.len-1;
 
 			if(is_wchar){
 				// mutate last_token to include L prefix and contents of this token, then continue (omitting new token generation)
@@ -643,7 +647,7 @@ int Tokenizer_init(Tokenizer tokenizer[static 1],const File file[static 1]){
         // parse preprocessor include directive argument which functions as string (i.e. do not strip whitespace)
         if(token.len==1 && token.p[0]=='<' && tokenizer->num_tokens>=2){
             if(
-                // if two preceding tokens are # and include
+                // if two preceding tokens are # and include (or embed, which takes the same argument)
                 // and the hash is either in the first line, or the start of the line
                 (
                     tokenizer->num_tokens==2
@@ -657,7 +661,11 @@ int Tokenizer_init(Tokenizer tokenizer[static 1],const File file[static 1]){
                 &&
                 Token_equalString(&tokenizer->tokens[tokenizer->num_tokens-2],KEYWORD_HASH)
                 &&
-                Token_equalString(&tokenizer->tokens[tokenizer->num_tokens-1],KEYWORD_INCLUDE)
+                (
+                    Token_equalString(&tokenizer->tokens[tokenizer->num_tokens-1],KEYWORD_INCLUDE)
+                    ||
+                    Token_equalString(&tokenizer->tokens[tokenizer->num_tokens-1],KEYWORD_EMBED)
+                )
             ){
                 token.tag=TOKEN_TAG_PREP_INCLUDE_ARGUMENT;
 
@@ -677,6 +685,7 @@ int Tokenizer_init(Tokenizer tokenizer[static 1],const File file[static 1]){
         }
 
 		tokenizer->num_tokens++;
+		util_num_allocations++;
 		tokenizer->tokens=realloc(tokenizer->tokens,(tokenizer->num_tokens)*sizeof(Token));
 
 		tokenizer->tokens[tokenizer->num_tokens-1]=token;
@@ -783,6 +792,9 @@ char*Token_print(const Token*token){
 				case TOKEN_LITERAL_TAG_STRING:
 					token_tag_name="lit string";
 					break;
+				case TOKEN_LITERAL_TAG_EMBED:
+					token_tag_name="lit embed";
+					break;
 				case TOKEN_LITERAL_TAG_NUMERIC:
 					switch(token->literal.numeric.tag){
 						case TOKEN_LITERAL_NUMERIC_TAG_CHAR:
@@ -0,0 +1,72 @@
+#include<stdalign.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include<util/arena.h>
+#include<util/util.h>
+
+struct arena_block{
+    struct arena_block*previous;
+    size_t size;
+    alignas(max_align_t) char data[];
+};
+
+void arena_init(arena*a){
+    *a=(arena){.block=nullptr,.used=0};
+}
+void arena_free(arena*a){
+    struct arena_block*block=a->block;
+    while(block!=nullptr){
+        struct arena_block*previous=block->previous;
+        free(block);
+        block=previous;
+    }
+    arena_init(a);
+}
+void arena_reset(arena*a){
+    if(a->block==nullptr){
+        return;
+    }
+    struct arena_block*block=a->block->previous;
+    while(block!=nullptr){
+        struct arena_block*previous=block->previous;
+        free(block);
+        block=previous;
+    }
+    a->block->previous=nullptr;
+    a->used=0;
+}
+
+void* arena_alloc(arena*a,size_t size){
+    static const size_t alignment=alignof(max_align_t);
+    size=(size+alignment-1)&~(alignment-1);
+
+    if(a->block==nullptr || a->used+size>a->block->size){
+        size_t block_size=size>ARENA_BLOCK_SIZE?size:ARENA_BLOCK_SIZE;
+        util_num_allocations++;
+        struct arena_block*block=malloc(sizeof(struct arena_block)+block_size);
+        if(!block){
+            fatal("arena allocation failed");
+        }
+        block->previous=a->block;
+        block->size=block_size;
+
+        a->block=block;
+        a->used=0;
+    }
+
+    void*ret=a->block->data+a->used;
+    a->used+=size;
+    return ret;
+}
+void* arena_copy(arena*a,size_t size,const void*src){
+    void*ret=arena_alloc(a,size);
+    memcpy(ret,src,size);
+    return ret;
+}
+char* arena_copy_string(arena*a,const char*str,size_t len){
+    char*ret=arena_alloc(a,len+1);
+    memcpy(ret,str,len);
+    ret[len]=0;
+    return ret;
+}
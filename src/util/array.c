@@ -2,12 +2,19 @@
 #include<string.h>
 
 #include<util/array.h>
+#include<util/arena.h>
+#include<util/util.h>
 
 void array_init(array*a,int elem_size){
-    *a=(array){.data=0,.elem_size=elem_size,.len=0,.cap=0};
+    *a=(array){.data=0,.elem_size=elem_size,.len=0,.cap=0,.arena=nullptr};
+}
+void array_init_arena(array*a,int elem_size,arena*element_arena){
+    *a=(array){.data=0,.elem_size=elem_size,.len=0,.cap=0,.arena=element_arena};
 }
 void array_free(array*a){
-    free(a->data);
+    if(a->arena==nullptr){
+        free(a->data);
+    }
     a->data=0;
     a->len=0;
     a->cap=0;
@@ -16,7 +23,17 @@ void array_free(array*a){
 enum ARRAY_APPEND_RESULT array_append(array*a,const void*elem){
     if(a->len==a->cap){
         a->cap=a->cap*2+1;
-        void*newmem=realloc(a->data,a->cap*a->elem_size);
+        void*newmem;
+        if(a->arena!=nullptr){
+            // the previous elements stay in the arena until it is released
+            newmem=arena_alloc(a->arena,(size_t)a->cap*(size_t)a->elem_size);
+            if(a->len>0){
+                memcpy(newmem,a->data,(size_t)a->len*(size_t)a->elem_size);
+            }
+        }else{
+            util_num_allocations++;
+            newmem=realloc(a->data,a->cap*a->elem_size);
+        }
         if(!newmem){
             return ARRAY_APPEND_ALLOC_FAIL;
         }
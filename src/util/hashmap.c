@@ -0,0 +1,73 @@
+#include<stdlib.h>
+#include<string.h>
+
+#include<util/hashmap.h>
+#include<util/util.h>
+
+void hashmap_init(hashmap*m){
+    *m=(hashmap){.entries=nullptr,.len=0,.cap=0};
+}
+void hashmap_free(hashmap*m){
+    free(m->entries);
+    hashmap_init(m);
+}
+
+/* find entry for key, or the empty entry where key would be inserted (map must not be full) */
+static struct hashmap_entry* hashmap_find(const hashmap*m,const char*key,int key_len,uint64_t hash){
+    int mask=m->cap-1;
+    for(int i=(int)(hash&(uint64_t)mask);;i=(i+1)&mask){
+        struct hashmap_entry*entry=&m->entries[i];
+        if(entry->key==nullptr){
+            return entry;
+        }
+        if(entry->hash==hash && entry->key_len==key_len && memcmp(entry->key,key,key_len)==0){
+            return entry;
+        }
+    }
+}
+
+void* hashmap_get(const hashmap*m,const char*key,int key_len){
+    if(m->len==0){
+        return nullptr;
+    }
+
+    struct hashmap_entry*entry=hashmap_find(m,key,key_len,hashBytes(key,key_len));
+    if(entry->key==nullptr){
+        return nullptr;
+    }
+    return entry->value;
+}
+void hashmap_set(hashmap*m,const char*key,int key_len,void*value){
+    // keep load factor at or below 1/2
+    if((m->len+1)*2>m->cap){
+        hashmap old_map=*m;
+
+        m->cap=m->cap==0?16:m->cap*2;
+        util_num_allocations++;
+        m->entries=calloc(m->cap,sizeof(struct hashmap_entry));
+        if(!m->entries){
+            fatal("hashmap allocation failed");
+        }
+
+        for(int i=0;i<old_map.cap;i++){
+            struct hashmap_entry*old_entry=&old_map.entries[i];
+            if(old_entry->key==nullptr){
+                continue;
+            }
+            *hashmap_find(m,old_entry->key,old_entry->key_len,old_entry->hash)=*old_entry;
+        }
+        free(old_map.entries);
+    }
+
+    uint64_t hash=hashBytes(key,key_len);
+    struct hashmap_entry*entry=hashmap_find(m,key,key_len,hash);
+    if(entry->key==nullptr){
+        m->len++;
+    }
+    *entry=(struct hashmap_entry){
+        .key=key,
+        .key_len=key_len,
+        .hash=hash,
+        .value=value,
+    };
+}
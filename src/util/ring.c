@@ -0,0 +1,111 @@
+#include<stdlib.h>
+#include<string.h>
+
+#include<util/ring.h>
+#include<util/util.h>
+
+void ring_init(ring*r,int elem_size,int cap){
+    int pow2_cap=1;
+    while(pow2_cap<cap){
+        pow2_cap*=2;
+    }
+
+    util_num_allocations++;
+    r->data=calloc((size_t)pow2_cap,(size_t)elem_size);
+    r->elem_size=elem_size;
+    r->cap=pow2_cap;
+    atomic_init(&r->head,0);
+    atomic_init(&r->tail,0);
+    atomic_init(&r->closed,false);
+    pthread_mutex_init(&r->mutex,nullptr);
+    pthread_cond_init(&r->cond,nullptr);
+    atomic_init(&r->producer_waits,false);
+    atomic_init(&r->consumer_waits,false);
+}
+void ring_free(ring*r){
+    free(r->data);
+    r->data=nullptr;
+    pthread_mutex_destroy(&r->mutex);
+    pthread_cond_destroy(&r->cond);
+}
+
+/*
+wake the other side if it waits (flag is its waiting flag). the position that was just published is stored before the
+flag is loaded, and the waiting side stores its flag before it loads the position again, so at least one of them sees
+the other (which is why both are sequentially consistent)
+*/
+static void ring_wake(ring*r,atomic_bool*flag){
+    if(atomic_load(flag)){
+        pthread_mutex_lock(&r->mutex);
+        pthread_cond_broadcast(&r->cond);
+        pthread_mutex_unlock(&r->mutex);
+    }
+}
+/* wait until can_continue returns true, flag is the waiting flag of the calling side */
+static void ring_wait(ring*r,atomic_bool*flag,bool(*can_continue)(ring*r)){
+    if(can_continue(r)){
+        return;
+    }
+    pthread_mutex_lock(&r->mutex);
+    atomic_store(flag,true);
+    while(!can_continue(r)){
+        pthread_cond_wait(&r->cond,&r->mutex);
+    }
+    atomic_store(flag,false);
+    pthread_mutex_unlock(&r->mutex);
+}
+static bool ring_hasSpace(ring*r){
+    return atomic_load(&r->head)-atomic_load(&r->tail)<(size_t)r->cap;
+}
+static bool ring_hasElems(ring*r){
+    return atomic_load(&r->head)!=atomic_load(&r->tail) || atomic_load(&r->closed);
+}
+
+void ring_push(ring*r,const void*elems,int num_elems){
+    const char*src=elems;
+    while(num_elems>0){
+        ring_wait(r,&r->producer_waits,ring_hasSpace);
+
+        size_t head=atomic_load_explicit(&r->head,memory_order_relaxed);
+        size_t tail=atomic_load(&r->tail);
+        // copy as much as fits, up to the end of the buffer (the rest wraps around in the next round)
+        int num_copied=r->cap-(int)(head-tail);
+        int index=(int)(head&(size_t)(r->cap-1));
+        if(num_copied>r->cap-index){
+            num_copied=r->cap-index;
+        }
+        if(num_copied>num_elems){
+            num_copied=num_elems;
+        }
+        memcpy(r->data+(size_t)index*(size_t)r->elem_size,src,(size_t)num_copied*(size_t)r->elem_size);
+
+        atomic_store(&r->head,head+(size_t)num_copied);
+        ring_wake(r,&r->consumer_waits);
+
+        src+=(size_t)num_copied*(size_t)r->elem_size;
+        num_elems-=num_copied;
+    }
+}
+void ring_close(ring*r){
+    atomic_store(&r->closed,true);
+    ring_wake(r,&r->consumer_waits);
+}
+int ring_pop(ring*r,void*elems,int max_elems){
+    ring_wait(r,&r->consumer_waits,ring_hasElems);
+
+    size_t tail=atomic_load_explicit(&r->tail,memory_order_relaxed);
+    size_t head=atomic_load(&r->head);
+    int num_copied=(int)(head-tail);
+    int index=(int)(tail&(size_t)(r->cap-1));
+    if(num_copied>r->cap-index){
+        num_copied=r->cap-index;
+    }
+    if(num_copied>max_elems){
+        num_copied=max_elems;
+    }
+    memcpy(elems,r->data+(size_t)index*(size_t)r->elem_size,(size_t)num_copied*(size_t)r->elem_size);
+
+    atomic_store(&r->tail,tail+(size_t)num_copied);
+    ring_wake(r,&r->producer_waits);
+    return num_copied;
+}
@@ -4,7 +4,10 @@
 #include<stdlib.h>
 #include<string.h>
 
+_Thread_local uint64_t util_num_allocations=0;
+
 void* allocAndCopy(size_t size,const void*src){
+    util_num_allocations++;
     void*mem=malloc(size);
     if(!mem)
         return nullptr;
@@ -13,7 +16,32 @@ void* allocAndCopy(size_t size,const void*src){
     return mem;
 }
 
+/* handler of the calling thread, nullptr if fatal errors terminate the process */
+static _Thread_local struct FatalHandler*fatal_handler=nullptr;
+
+void fatal_setHandler(struct FatalHandler*handler){
+    fatal_handler=handler;
+}
+void fatal_report(const char*file,int line,const char*format,...){
+    va_list args;
+    va_start(args,format);
+    if(fatal_handler!=nullptr){
+        fatal_handler->file=file;
+        fatal_handler->line=line;
+        discard vsnprintf(fatal_handler->message,sizeof(fatal_handler->message),format,args);
+        va_end(args);
+        longjmp(fatal_handler->jump,1);
+    }
+
+    discard fprintf(stderr,"%s:%d | ",file,line);
+    discard vfprintf(stderr,format,args);
+    discard fprintf(stderr,"\n");
+    va_end(args);
+    exit(-1);
+}
+
 char* makeStringn(int len){
+    util_num_allocations++;
     char*str=calloc(len,1);
     return str;
 }
@@ -34,3 +62,15 @@ char*ind(int n){
     str[n]='\0';
     return str;
 }
+uint64_t hashBytes(const void*data,size_t len){
+    static const uint64_t FNV_OFFSET_BASIS=0xcbf29ce484222325ULL;
+    static const uint64_t FNV_PRIME=0x100000001b3ULL;
+
+    const unsigned char*bytes=data;
+    uint64_t hash=FNV_OFFSET_BASIS;
+    for(size_t i=0;i<len;i++){
+        hash^=bytes[i];
+        hash*=FNV_PRIME;
+    }
+    return hash;
+}
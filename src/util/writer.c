@@ -0,0 +1,121 @@
+// ftruncate
+#define _POSIX_C_SOURCE 200809L
+
+#include<errno.h>
+#include<fcntl.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+
+#include<util/writer.h>
+#include<util/util.h>
+
+void writer_init_fd(writer*w,int fd){
+    *w=(writer){
+        .fd=fd,
+        .owns_fd=false,
+        .buffer=malloc(WRITER_BUFFER_SIZE),
+        .len=0,
+        .cap=WRITER_BUFFER_SIZE,
+        .flushed=0,
+    };
+    if(!w->buffer){
+        fatal("writer buffer allocation failed");
+    }
+}
+void writer_open(writer*w,const char*path){
+    if(strcmp(path,"-")==0){
+        writer_init_fd(w,STDOUT_FILENO);
+        return;
+    }
+
+    int fd=open(path,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(fd<0){
+        fatal("could not open %s for writing: %s",path,strerror(errno));
+    }
+    writer_init_fd(w,fd);
+    w->owns_fd=true;
+}
+void writer_close(writer*w){
+    writer_flush(w);
+    if(w->owns_fd && close(w->fd)!=0){
+        fatal("could not close output file: %s",strerror(errno));
+    }
+    free(w->buffer);
+    *w=(writer){.fd=-1};
+}
+
+/* write all of data directly to the file */
+static void writer_write_fd(writer*w,const char*data,int len){
+    while(len>0){
+        ssize_t written=write(w->fd,data,len);
+        if(written<0){
+            if(errno==EINTR){
+                continue;
+            }
+            fatal("write failed: %s",strerror(errno));
+        }
+        data+=written;
+        len-=(int)written;
+        w->flushed+=written;
+    }
+}
+void writer_flush(writer*w){
+    writer_write_fd(w,w->buffer,w->len);
+    w->len=0;
+}
+int64_t writer_length(const writer*w){
+    return w->flushed+w->len;
+}
+void writer_truncate(writer*w,int64_t len){
+    writer_flush(w);
+    if(ftruncate(w->fd,(off_t)len)!=0 || lseek(w->fd,(off_t)len,SEEK_SET)<0){
+        fatal("could not truncate output file: %s",strerror(errno));
+    }
+    w->flushed=len;
+}
+
+void writer_write(writer*w,const char*data,int len){
+    if(w->len+len>w->cap){
+        writer_flush(w);
+        // skip the buffer for writes that would not fit anyway
+        if(len>w->cap){
+            writer_write_fd(w,data,len);
+            return;
+        }
+    }
+    memcpy(w->buffer+w->len,data,len);
+    w->len+=len;
+}
+void writer_write_char(writer*w,char c){
+    if(w->len==w->cap){
+        writer_flush(w);
+    }
+    w->buffer[w->len++]=c;
+}
+void writer_write_str(writer*w,const char*str){
+    writer_write(w,str,(int)strlen(str));
+}
+void writer_write_int(writer*w,int64_t value){
+    char digits[24];
+    int num_digits=0;
+
+    uint64_t magnitude=value<0?-(uint64_t)value:(uint64_t)value;
+    do{
+        digits[sizeof(digits)-1-num_digits++]=(char)('0'+magnitude%10);
+        magnitude/=10;
+    }while(magnitude>0);
+    if(value<0){
+        digits[sizeof(digits)-1-num_digits++]='-';
+    }
+
+    writer_write(w,digits+sizeof(digits)-num_digits,num_digits);
+}
+void writer_write_escaped(writer*w,const char*str){
+    for(;*str!=0;str++){
+        if(*str=='"' || *str=='\\'){
+            writer_write_char(w,'\\');
+        }
+        writer_write_char(w,*str);
+    }
+}
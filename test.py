@@ -7,6 +7,7 @@ from pathlib import Path
 import os, sys
 from tqdm import tqdm
 import shlex
+import tempfile
 import threading
 from concurrent import futures as fut
 
@@ -51,6 +52,19 @@ class Test:
     goal: tp.Optional[str] = None
     should_fail: bool = False
 
+    extra_flags: str = ""
+    " appended to the flags of the level, {tmp} is replaced by a directory that only exists while the test runs"
+    setup: tp.Tuple[str,...] = ()
+    " commands that must succeed before the test runs (with {tmp} replaced as in extra_flags)"
+    server: tp.Optional[str] = None
+    " command that runs in the background while the test runs, e.g. a compile server with its socket in {tmp} (the test starts once the server created a file in {tmp})"
+    expected_output: tp.Optional[str] = None
+    " file that contains the expected output (stdout) of the test"
+    expected_error: tp.Optional[str] = None
+    " text that must be part of the error output (stderr) of the test"
+    expected_text: tp.Optional[str] = None
+    " text that must be part of the output (stdout) of the test, e.g. when the rest of it depends on timing"
+
     result:tp.Optional[TestResult]=None
 
     command:tp.Optional[str]=None
@@ -68,6 +82,9 @@ class Test:
         if self.level>=TestLevel.PARSE:
             ret+=" -a"
 
+        if self.extra_flags:
+            ret+=" "+self.extra_flags
+
         return ret
 
     def copy(self)->"Test":
@@ -76,11 +93,40 @@ class Test:
             level=self.level,
             goal=self.goal,
             should_fail=self.should_fail,
+            extra_flags=self.extra_flags,
+            setup=self.setup,
+            server=self.server,
+            expected_output=self.expected_output,
+            expected_error=self.expected_error,
+            expected_text=self.expected_text,
             result=self.result
         )
 
     def run(self,timeout:float=0.5):
-        command=f"bin/main {self.flags or ''} {self.file}"
+        with tempfile.TemporaryDirectory(prefix="pacc_test_") as tmp:
+            server_proc=None
+            try:
+                if self.server is not None:
+                    server_proc=sp.Popen(shlex.split(self.server.format(tmp=tmp)),stdout=sp.DEVNULL,stderr=sp.DEVNULL)
+                    for _ in range(100):
+                        if len(os.listdir(tmp))>0:
+                            break
+                        time.sleep(0.01)
+                self.run_in(tmp,timeout)
+            finally:
+                if server_proc is not None:
+                    server_proc.kill()
+                    server_proc.wait()
+
+    def run_in(self,tmp:str,timeout:float):
+        for setup_command in self.setup:
+            setup_command=setup_command.format(tmp=tmp)
+            if sp.run(shlex.split(setup_command),stdout=sp.DEVNULL,stderr=sp.DEVNULL,timeout=timeout*10).returncode!=0:
+                self.command=setup_command
+                self.result=TestResult.FAILURE
+                return
+
+        command=f"bin/main {self.flags.format(tmp=tmp)} {self.file}"
         self.command=command
         cmd_timed_out=False
 
@@ -135,6 +181,12 @@ class Test:
         did_fail=proc.returncode!=0
 
         test_succeeded=((not did_fail and not self.should_fail) or (did_fail and self.should_fail)) and not cmd_timed_out
+        if self.expected_output is not None:
+            test_succeeded=test_succeeded and "".join(stdout_buffer)==Path(self.expected_output).read_text()
+        if self.expected_error is not None:
+            test_succeeded=test_succeeded and self.expected_error in "".join(stderr_buffer)
+        if self.expected_text is not None:
+            test_succeeded=test_succeeded and self.expected_text in "".join(stdout_buffer)
         if test_succeeded:
             self.result=TestResult.SUCCESS
             return
@@ -218,6 +270,92 @@ TEST_FILES=[
     Test(file="test/test065.c", level=TestLevel.PARSE, goal="accessing non-existent field on a struct", should_fail=True),
     Test(file="test/test066.c", level=TestLevel.PARSE, goal="leftover tokens at end of file", should_fail=True),
     Test(file="test/test067.c", level=TestLevel.PARSE, goal="compound symbol declarations"),
+
+    Test(file="test/test068.c", level=TestLevel.PARSE, goal="precompiled header (macros and declarations from the snapshot)",
+        setup=("bin/main -p --emit-pch={tmp}/test068.pch test/test068_2.c",), extra_flags="--include-pch={tmp}/test068.pch"),
+    Test(file="test/test068.c", level=TestLevel.PARSE, goal="precompiled header is out of date after an edit that keeps the file size", should_fail=True,
+        setup=("cp test/test068_2.c {tmp}/prefix.h","bin/main -p --emit-pch={tmp}/test068.pch {tmp}/prefix.h","sed -i s/42/43/ {tmp}/prefix.h"),
+        extra_flags="--include-pch={tmp}/test068.pch", expected_error="out of date"),
+    Test(file="test/test068.c", level=TestLevel.PREPROCESS, goal="textual output (-E) starts with the output of the precompiled header",
+        setup=("bin/main -p --emit-pch={tmp}/test068.pch test/test068_2.c",), extra_flags="-E --include-pch={tmp}/test068.pch", expected_output="test/test068.i"),
+    Test(file="test/test068_2.c", level=TestLevel.PREPROCESS, goal="a precompiled header cannot be written from textual output (-E)", should_fail=True,
+        extra_flags="-E --emit-pch={tmp}/test068.pch", expected_error="cannot be combined"),
+    Test(file="test/test071.c", level=TestLevel.PREPROCESS, goal="empty operands of ## (placemarkers) and spelling of # operands",
+        extra_flags="-E", expected_output="test/test071.i"),
+    Test(file="test/test073.c", level=TestLevel.PARSE, goal="token pasting with empty operands"),
+    Test(file="test/test072.c", level=TestLevel.PREPROCESS, goal="textual output (-E) places macro expansions on the line of their invocation",
+        extra_flags="-E", expected_output="test/test072.i"),
+    Test(file="test/test070.c", level=TestLevel.TOKENIZE, goal="compile server retokenizes a header after an edit that keeps the file size",
+        server="bin/main --server={tmp}/server.sock",
+        setup=(
+            "cp test/test070_2.c {tmp}/test070.h",
+            # the server tokenizes the header after the first compilation, before it starts the second one
+            "bin/main --client={tmp}/server.sock -E -I{tmp} test/test070.c",
+            "bin/main --client={tmp}/server.sock -E -I{tmp} test/test070.c",
+            # same file and size, only the modification time changes (within the same second)
+            "cp test/test070_3.c {tmp}/test070.h",
+        ),
+        extra_flags="--client={tmp}/server.sock -E -I{tmp}", expected_output="test/test070.i"),
+    Test(file="test/test075.c", level=TestLevel.TOKENIZE, goal="compile server runs the compilation in the working directory of the client, not its own",
+        server="sh -c 'cd {tmp} && exec \"$OLDPWD/bin/main\" --server={tmp}/server.sock'",
+        setup=("bin/main --client={tmp}/server.sock -E -Itest test/test075.c",),
+        extra_flags="--client={tmp}/server.sock -E -Itest", expected_output="test/test075.i"),
+    Test(file="test/test074_2.c", level=TestLevel.TOKENIZE, goal="compile server passes errors and the exit status of the compilation to the client", should_fail=True,
+        server="bin/main --server={tmp}/server.sock",
+        extra_flags="--client={tmp}/server.sock -E", expected_error="too many arguments"),
+    Test(file="test/test074.c", level=TestLevel.TOKENIZE, goal="batch preprocessing, a fatal error during macro expansion only fails its file", should_fail=True,
+        extra_flags="--batch --batch-jobs=2 test/test074_2.c", expected_text="files: 2, failed: 1"),
+    Test(file="test/test076.c", level=TestLevel.PREPROCESS, goal="-DNAME=VALUE defines NAME as VALUE, -DNAME defines NAME as 1",
+        extra_flags="-E -DV=3 -DW", expected_output="test/test076.i"),
+    Test(file="test/test076.c", level=TestLevel.TOKENIZE, goal="batch preprocessing and compile commands define -D flags like the command line",
+        extra_flags="--batch -DV=3 -DW --compile-commands=test/test076.json", expected_text="files: 2, failed: 0"),
+    Test(file="test/test077.c", level=TestLevel.PREPROCESS, goal="-M writes a make rule for the input and all headers, each file once even if reached by several paths",
+        extra_flags="-M -isystem test", expected_output="test/test077.d"),
+    Test(file="test/test077.c", level=TestLevel.PREPROCESS, goal="-MM leaves out system headers, -MP adds phony rules, -MT sets the target",
+        extra_flags="-MM -MP -MT test077.d -isystem test", expected_output="test/test077_2.d"),
+    Test(file="test/test078.c", level=TestLevel.PREPROCESS, goal="arguments are expanded before substitution, except for operands of # and ##",
+        extra_flags="-E", expected_output="test/test078.i"),
+    Test(file="test/test079.c", level=TestLevel.PREPROCESS, goal="#embed with limit, prefix, suffix and if_empty, and __has_embed",
+        extra_flags="-E", expected_output="test/test079.i"),
+    Test(file="test/test079.c", level=TestLevel.PARSE, goal="embedded bytes in initializers and expressions"),
+    Test(file="test/test079_3.c", level=TestLevel.PREPROCESS, goal="#embed of a missing file", should_fail=True,
+        expected_error="could not find embedded file test079_3.txt"),
+    Test(file="test/test080.c", level=TestLevel.PREPROCESS, goal="built-in target profile, __has_include and __has_c_attribute",
+        extra_flags="-E -Itest --target=x86_64-linux-gnu -DPROFILE_VALUE=5", expected_output="test/test080.i"),
+    Test(file="test/test080.c", level=TestLevel.PREPROCESS, goal="target profile file written from a built-in profile and -D flags",
+        setup=("bin/main --target=x86_64-linux-gnu -DPROFILE_VALUE=6 --emit-target-profile={tmp}/profile",),
+        extra_flags="-E -Itest --target-profile={tmp}/profile", expected_output="test/test080_2.i"),
+    Test(file="test/test081.c", level=TestLevel.PREPROCESS, goal="partial preprocessing resolves conditionals on -D and -U macros only, and keeps all others",
+        extra_flags="--partial -DFEATURE=2 -UOFF", expected_output="test/test081.i"),
+    Test(file="test/test082.c", level=TestLevel.PARSE, goal="pipelined parsing splits declarations at semicolons and function bodies, not at initializer braces",
+        extra_flags="--pipeline"),
+    Test(file="test/test079.c", level=TestLevel.PARSE, goal="pipelined parsing of embedded bytes in initializers and expressions",
+        extra_flags="--pipeline"),
+    Test(file="test/test082_2.c", level=TestLevel.PARSE, goal="pipelined parsing reports an error of the preprocessor after an earlier parser error", should_fail=True,
+        extra_flags="--pipeline", expected_error="too many arguments"),
+    Test(file="test/test083.c", level=TestLevel.PREPROCESS, goal="separate # tokens are operands of ##, not the operator (C11 6.10.3.3p4)",
+        extra_flags="-E", expected_output="test/test083.i"),
+    Test(file="test/test084.c", level=TestLevel.PREPROCESS, goal="#if arithmetic converts to unsigned if either operand is unsigned (C11 6.10.1)",
+        extra_flags="-E", expected_output="test/test084.i"),
+    Test(file="test/test084_2.c", level=TestLevel.PREPROCESS, goal="#if shift count out of range", should_fail=True,
+        expected_error="shift count 64 is out of range"),
+    Test(file="test/test084_3.c", level=TestLevel.PREPROCESS, goal="#if signed overflow in division", should_fail=True,
+        expected_error="overflow in division"),
+    Test(file="test/test085.c", level=TestLevel.PREPROCESS, goal="--pp-stats counts a header reached by several paths as one file",
+        extra_flags="-E --pp-stats", expected_error="       1        1  test/test085_2.c"),
+    Test(file="test/test086.c", level=TestLevel.TOKENIZE, goal="--watch rewrites the output after a header and then the input file changed, like a full run",
+        server="sh -c 'cp test/test086.c {tmp}/ && cp test/test086_2.c {tmp}/test086.h && cd {tmp} && exec \"$OLDPWD/bin/main\" -E --watch test086.c -o test086.i'",
+        setup=(
+            "sh -c 'until grep -q after {tmp}/test086.i; do sleep 0.01; done'",
+            # a different size, so that the change is noticed within the same second as well
+            "cp test/test086_3.c {tmp}/test086.h",
+            "sh -c 'until grep -q 1234 {tmp}/test086.i; do sleep 0.01; done'",
+            "sh -c 'cd {tmp} && \"$OLDPWD/bin/main\" -E test086.c | cmp - test086.i'",
+            "sed -i s/after/later/ {tmp}/test086.c",
+            "sh -c 'until grep -q later {tmp}/test086.i; do sleep 0.01; done'",
+            "sh -c 'cd {tmp} && \"$OLDPWD/bin/main\" -E test086.c | cmp - test086.i'",
+        ),
+        extra_flags="-E -I{tmp}", expected_output="test/test086.i"),
 ]
 
 tests=[
@@ -0,0 +1,6 @@
+# 2 "test/test068_2.c"
+int a_func(int x);
+# 1 "test/test068.c"
+int main(){
+    return a_func( 42 );
+}
@@ -0,0 +1,2 @@
+#define ANSWER 42
+int a_func(int x);
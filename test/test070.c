@@ -0,0 +1,2 @@
+#include <test070.h>
+int value=VALUE;
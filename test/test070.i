@@ -0,0 +1,2 @@
+# 2 "test/test070.c"
+int value= 43 ;
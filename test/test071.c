@@ -0,0 +1,13 @@
+#define CAT(a,b) a##b
+#define CAT3(a,b,c) a ## b ## c
+#define str(s) # s
+#define xstr(s) str(s)
+x = CAT(,y);
+x = CAT(x,);
+x = CAT(,) z;
+CAT3(a,,c) CAT3(,,c) CAT3(,,) CAT3(1,2,3)
+CAT(x y, z w)
+xstr(CAT(a,b))
+str(a "b\n"  'c')
+str(L"x\y" u8"q" u'\'' L'b')
+str( a   +   b )
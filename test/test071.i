@@ -0,0 +1,10 @@
+# 5 "test/test071.c"
+x = y ;
+x = x ;
+x = z;
+ac c 123
+    x yz w
+"ab"
+"a \"b\\n\" 'c'"
+"L\"x\\y\" u8\"q\" u'\\'' L'b'"
+"a + b"
@@ -0,0 +1,10 @@
+#define ONE 1
+#define ADD(a,b) ((a)+(b))
+#define TWICE(x) ADD(x,x)
+int a=ONE;
+int b=ADD(ONE,2);
+  int c=TWICE(b)
+    +ONE;
+int d=ADD(
+    a,
+    b);
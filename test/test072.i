@@ -0,0 +1,8 @@
+# 4 "test/test072.c"
+int a= 1 ;
+int b= (( 1 )+( 2 )) ;
+  int c= (( b )+( b ))
+    + 1 ;
+int d= ((
+    a )+(
+    b )) ;
@@ -0,0 +1,7 @@
+#define CAT(a,b) a##b
+int main(){
+    int CAT(x,y)=1;
+    int CAT(,z)=2;
+    int CAT(w,)=3;
+    return xy+CAT(,)z+w;
+}
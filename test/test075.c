@@ -0,0 +1,2 @@
+#include <test075_2.c>
+int value=VALUE;
@@ -0,0 +1,2 @@
+# 2 "test/test075.c"
+int value= 7 ;
@@ -0,0 +1,4 @@
+#if V!=3 || W!=1
+#error -DV=3 -DW must define V as 3 and W as 1
+#endif
+int value=V+W;
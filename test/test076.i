@@ -0,0 +1,2 @@
+# 4 "test/test076.c"
+int value= 3 + 1 ;
@@ -0,0 +1,4 @@
+#if V!=4 || W!=1
+#error -DV=4 -DW of the compile command must define V as 4 and W as 1
+#endif
+int value=V+W;
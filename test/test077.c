@@ -0,0 +1,4 @@
+#include "test077_2.c"
+#include "./test077_2.c"
+#include <test077_3.c>
+int value=USER+SYSTEM;
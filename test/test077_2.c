@@ -0,0 +1 @@
+#define USER 1
@@ -0,0 +1 @@
+#define SYSTEM 2
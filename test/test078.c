@@ -0,0 +1,16 @@
+#define ONE 1
+#define ONE1 11
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define CAT(a,b) a##b
+#define TWICE(x) x+x
+#define IGNORE(x) 0
+#define INC(x) (x+1)
+#define MIXED(x) sizeof STR(x), x, CAT(x,0), CAT(ONE,x)
+int twice=TWICE(ONE);
+int ignored=IGNORE(UNDEFINED(ONE));
+int nested=INC(INC(ONE));
+const char*spelled=STR(ONE);
+const char*expanded=XSTR(ONE);
+int CAT(ONE,2);
+int mixed[]={MIXED(ONE)};
@@ -0,0 +1,8 @@
+# 10 "test/test078.c"
+int twice= 1 + 1 ;
+int ignored= 0 ;
+int nested= ( ( 1 +1) +1) ;
+const char*spelled= "ONE" ;
+const char*expanded= "1" ;
+int ONE2 ;
+int mixed[]={ sizeof "1" , 1 , 10 , 11 };
@@ -0,0 +1,15 @@
+const char bytes[]={
+#embed "test079.txt"
+};
+const char limited[]={
+#embed "test079.txt" limit(2) prefix(0,) suffix(,0)
+};
+const char empty[]={
+#embed "test079_2.txt" prefix(1,) if_empty(0)
+};
+int size=
+#embed "test079.txt" limit(1)
++1;
+#if __has_embed("test079.txt")!=__STDC_EMBED_FOUND__ || __has_embed("test079_2.txt")!=__STDC_EMBED_EMPTY__
+#error __has_embed
+#endif
@@ -0,0 +1,13 @@
+# 1 "test/test079.c"
+const char bytes[]={
+       97,98,99
+};
+const char limited[]={
+       0, 97,98 ,0
+};
+const char empty[]={
+       0
+};
+int size=
+       97
++1;
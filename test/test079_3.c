@@ -0,0 +1,3 @@
+const char bytes[]={
+#embed "test079_3.txt"
+};
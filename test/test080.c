@@ -0,0 +1,11 @@
+#if !__has_include("test080_2.c") || __has_include("test080_3.c") || !__has_include(<test080_2.c>)
+#error __has_include
+#endif
+#if __has_c_attribute(nodiscard)!=202003L || __has_c_attribute(no_such_attribute)
+#error __has_c_attribute
+#endif
+#include "test080_2.c"
+#if !defined(__x86_64__) || !defined(__linux__) || __CHAR_BIT__!=8
+#error --target=x86_64-linux-gnu
+#endif
+int value=PROFILE_VALUE;
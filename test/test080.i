@@ -0,0 +1,4 @@
+# 1 "test/test080_2.c"
+int included;
+# 11 "test/test080.c"
+int value= 5 ;
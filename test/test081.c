@@ -0,0 +1,21 @@
+#ifndef GUARD
+#define GUARD
+#if FEATURE>1
+int feature;
+#else
+int no_feature;
+#endif
+#ifdef UNKNOWN
+int unknown;
+#elif defined(OFF)
+int off;
+#elif FEATURE==2
+int feature_two;
+#else
+int neither;
+#endif
+#if defined(UNKNOWN) && defined(OFF)
+int dropped;
+#endif
+int value=FEATURE+UNKNOWN_VALUE;
+#endif
@@ -0,0 +1,21 @@
+#ifndef GUARD
+#define GUARD
+
+int feature;
+
+
+
+#ifdef UNKNOWN
+int unknown;
+
+
+#else
+int feature_two;
+
+
+#endif
+#if defined(UNKNOWN) && defined(OFF)
+int dropped;
+#endif
+int value= 2 +UNKNOWN_VALUE;
+#endif
@@ -0,0 +1,20 @@
+struct Point{
+    int x;
+    int y;
+};
+typedef struct Point Point;
+int origin[2]={0,0};
+Point corner={.x=1,.y=(int){2}};
+const char*name="split" " string";
+int add(int a,int b);
+int add(int a,int b){
+    struct Point inner={a,b};
+    if(a){
+        return inner.x;
+    }
+    return b;
+}
+#define DOUBLE(x) ((x)+(x))
+int main(){
+    return add(DOUBLE(origin[0]),origin[1]);
+}
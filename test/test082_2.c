@@ -0,0 +1,8 @@
+int first(){
+    return 1;
+}
+int second(){
+    return missing;
+}
+#define ADD(a,b) a+b
+int third=ADD(1,2,3);
@@ -0,0 +1,7 @@
+#define hash_hash # ## #
+#define mkstr(a) # a
+#define in_between(a) mkstr(a)
+#define join(c, d) in_between(c hash_hash d)
+#define CAT(a,b) a ## b
+char p[] = join(x, y);
+int CAT(x,y);
@@ -0,0 +1,3 @@
+# 6 "test/test083.c"
+char p[] = "x ## y" ;
+int xy ;
@@ -0,0 +1,24 @@
+#if -1 > 0u
+int a1;
+#endif
+#if -1 < 0
+int a2;
+#endif
+#if (0 ? -1 : 0u) - 1 > 0
+int a3;
+#endif
+#if 0xffffffffffffffff == -1 && 18446744073709551615 > 0
+int a4;
+#endif
+#if -1 >> 1 == -1 && (0u - 1) >> 63 == 1 && 1u << 63 > 0
+int a5;
+#endif
+#if (-1 < 0u) || (1 ? 2u : -1) < 0 || ~0u < 0 || -1u < 0
+int wrong;
+#endif
+#if (2 || 1u) - 3 < 0 && (1 < 2) - 2 < 0 && !0u - 2 < 0
+int a6;
+#endif
+#if 'a' - 98 < 0 && 9223372036854775807 + 0 > 0 && -9223372036854775807 - 1 < 0
+int a7;
+#endif
@@ -0,0 +1,23 @@
+# 2 "test/test084.c"
+int a1;
+
+
+int a2;
+
+
+int a3;
+
+
+int a4;
+
+
+int a5;
+
+
+
+
+
+int a6;
+
+
+int a7;
@@ -0,0 +1,2 @@
+#if (-9223372036854775807 - 1) / -1
+#endif
@@ -0,0 +1,3 @@
+#include "test085_2.c"
+#include "./test085_2.c"
+int value=VALUE;
@@ -0,0 +1,4 @@
+#include "test086.h"
+int before=VALUE;
+#include "test086.h"
+int after=VALUE;
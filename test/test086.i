@@ -0,0 +1,4 @@
+# 2 "test/test086.c"
+int before= 1234 ;
+
+int after= 1234 ;
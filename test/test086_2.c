@@ -0,0 +1,4 @@
+#ifndef TEST086_H
+#define TEST086_H
+#define VALUE 1
+#endif